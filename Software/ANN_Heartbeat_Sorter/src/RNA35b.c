@@ -17,6 +17,7 @@
 #include "rtGetInf.h"
 #include "rtGetNaN.h"
 #include "rtwtypes.h"
+#include "model_rodata.h"
 
 
 
@@ -40,7 +41,7 @@ static void mapminmax_apply(const emxArray_real_T *x, emxArray_real_T *y)
   int ck;
   double av[28];
   double cv[28];
-  static const double b[28] = { 67.0, 67.0, 199.9677, 99.1, 12.0, 12.0, 0.0,
+  static const double b[28] MODEL_RODATA = { 67.0, 67.0, 199.9677, 99.1, 12.0, 12.0, 0.0,
     -1.83452863491973, -3.07165820315485, -3.64155435581708, -3.56929876883237,
     -3.9707735980554, -3.73633708072196, -3.78325530302861, -4.54917682387727,
     -3.71955449884929, -3.78906494451508, -4.00997471631115, -3.80157516325814,
@@ -51,7 +52,7 @@ static void mapminmax_apply(const emxArray_real_T *x, emxArray_real_T *y)
   emxArray_real_T *a;
   emxArray_real_T *r2;
   int csz_idx_1;
-  static const double b_b[28] = { 0.000977039570102589, 0.000977039570102589,
+  static const double b_b[28] MODEL_RODATA = { 0.000977039570102589, 0.000977039570102589,
     0.0121338901980008, 0.00324254215304799, 0.024390243902439,
     0.00746268656716418, 2.0, 0.588773765559667, 0.330137976487533,
     0.282712269357486, 0.299464370763992, 0.287612918270213, 0.278367452955766,
@@ -495,7 +496,7 @@ void RNA35b(const emxArray_real_T *x1, emxArray_real_T *b_y1)
   int ibtile;
   int br;
   int32_T exitg2;
-  static const double a[35] = { 0.55760350614581422, -1.5539380675798411,
+  static const double a[35] MODEL_RODATA = { 0.55760350614581422, -1.5539380675798411,
     1.4688875378397546, 1.2857138811717186, 1.4283762615169051,
     -3.8079547396796043, -2.5414950482306224, -0.78934648233592586,
     -0.18861568535877715, -1.4615236851544362, -0.32276517636431629,
@@ -514,7 +515,7 @@ void RNA35b(const emxArray_real_T *x1, emxArray_real_T *b_y1)
   int ar;
   int ib;
   int ia;
-  static const double dv0[980] = { 1.2605926238617435, 4.5470916495731277,
+  static const double dv0[980] MODEL_RODATA = { 1.2605926238617435, 4.5470916495731277,
     -0.20226382270753182, -0.045602386616975646, -1.1713327854011704,
     -0.3394280932816619, 0.097696889146480684, -0.43017625294209677,
     -0.50882034302197932, 0.40494879304234216, -2.014720876696348,
@@ -844,11 +845,11 @@ void RNA35b(const emxArray_real_T *x1, emxArray_real_T *b_y1)
 
   emxArray_real_T *r0;
   int32_T exitg1;
-  static const double b_a[5] = { -0.34128348541623793, -0.25524876372801975,
+  static const double b_a[5] MODEL_RODATA = { -0.34128348541623793, -0.25524876372801975,
     -0.18804856774345835, -0.61811533374751182, -0.24752288784977558 };
 
   emxArray_real_T *b_C;
-  static const double dv1[175] = { -1.6273079826376959, -0.66941480789960284,
+  static const double dv1[175] MODEL_RODATA = { -1.6273079826376959, -0.66941480789960284,
     0.38684399587174895, 2.7693373580152567, 1.0954728874861575,
     2.2966771813801823, -4.293366984913245, -1.1204746133734462,
     1.6912607336972458, -0.095448250036583429, 1.1971621433011226,
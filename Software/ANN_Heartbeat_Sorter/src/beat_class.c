@@ -0,0 +1,40 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Beat classes produced by the RNA35b network.
+ *
+ * @file beat_class.c
+ *
+ * @version %G%
+ *
+ */
+
+#include "beat_class.h"
+
+const char *const beat_class_text[BEAT_NUM_CLASSES] = {
+	" N Normal Beat\r\n",
+	"S Supraventricular Ectopic Beat\r\n",
+	"V Ventricular Ectopic Beat\r\n",
+	"F Fusion Beat\r\n",
+	"S Unknown Beat\r\n"
+};
+
+int beat_class_decode(const double *outputs){
+	int i, max_value_pos = 0;
+	double max_value = 0.0;
+
+	/*
+	 * Find the max value in the ANN's output data array and its index.
+	 */
+	for (i=0; i < BEAT_NUM_CLASSES; i ++){
+		if (outputs[i] > max_value){
+			max_value = outputs[i];
+			max_value_pos = i;
+		}
+	}
+	return max_value_pos;
+}
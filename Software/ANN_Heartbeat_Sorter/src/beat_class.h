@@ -0,0 +1,51 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Beat classes produced by the RNA35b network and the text sent for each
+ * one of them through UART.
+ *
+ * @file beat_class.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef BEAT_CLASS_H
+#define BEAT_CLASS_H
+
+/*
+ * Network dimensions: features per beat and outputs per beat.
+ */
+#define BEAT_NUM_FEATURES       28
+#define BEAT_NUM_CLASSES        5
+
+/*
+ * Beat class codes. The code is the index of the max value in the ANN's
+ * output data array.
+ */
+#define BEAT_CLASS_N            0
+#define BEAT_CLASS_S            1
+#define BEAT_CLASS_V            2
+#define BEAT_CLASS_F            3
+#define BEAT_CLASS_Q            4
+
+/*
+ * Text line sent for each beat class, indexed by class code.
+ */
+extern const char *const beat_class_text[BEAT_NUM_CLASSES];
+
+/**
+ * Decode the class of a beat from the ANN's output data.
+ * @function    beat_class_decode()
+ *
+ * @param       outputs     BEAT_NUM_CLASSES output values of one beat
+ *
+ * @return      index of the max value in outputs
+ */
+int beat_class_decode(const double *outputs);
+
+#endif /* BEAT_CLASS_H */
@@ -0,0 +1,131 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Parser and encoder of the binary beat frames.
+ *
+ * The features are sent little endian whatever the byte order of either
+ * side (the Microblaze is big endian), so they are always assembled from
+ * bytes.
+ *
+ * @file beat_rx.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <string.h>
+#include "beat_rx.h"
+#include "result_proto.h"
+
+typedef union {
+	float f;
+	unsigned int u;
+} beat_float_t;
+
+static unsigned long get_le32(const unsigned char *p){
+	return (unsigned long) p[0] | ((unsigned long) p[1] << 8) |
+			((unsigned long) p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+static void put_le32(unsigned char *p, unsigned long v){
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+void beat_rx_init(beat_rx_t *rx){
+	memset(rx, 0, sizeof(*rx));
+}
+
+/*
+ * Check and unpack a complete frame.
+ */
+static int beat_rx_frame(beat_rx_t *rx){
+	const unsigned char *f = rx->frame;
+	unsigned short crc;
+	beat_float_t v;
+	int i;
+
+	crc = (unsigned short)((f[BEAT_FRAME_SIZE - 2] << 8) | f[BEAT_FRAME_SIZE - 1]);
+	if (crc != result_crc16(&f[1], BEAT_FRAME_SIZE - BEAT_CRC_SIZE - 1)) {
+		return 0;
+	}
+	rx->seq = get_le32(&f[2]);
+	for (i=0; i < BEAT_NUM_FEATURES; i++){
+		v.u = (unsigned int) get_le32(&f[BEAT_HEADER_SIZE + 4 * i]);
+		rx->features[i] = v.f;
+	}
+	/*
+	 * A number lower than expected is a host starting over, not a loss.
+	 */
+	if (rx->have_seq && rx->seq > rx->next_seq) {
+		rx->stats.lost_beats += rx->seq - rx->next_seq;
+	}
+	rx->next_seq = rx->seq + 1;
+	rx->have_seq = 1;
+	rx->stats.frames++;
+	return 1;
+}
+
+/*
+ * Drop the first byte of the collected frame and look for the next frame
+ * in the rest. No frame can complete here: the rest is shorter than one.
+ */
+static void beat_rx_resync(beat_rx_t *rx){
+	unsigned char rest[BEAT_FRAME_SIZE];
+	unsigned int i, n = rx->len - 1;
+
+	memcpy(rest, &rx->frame[1], n);
+	rx->len = 0;
+	for (i=0; i < n; i++){
+		beat_rx_put(rx, rest[i]);
+	}
+}
+
+int beat_rx_put(beat_rx_t *rx, unsigned char byte){
+	if (rx->len == 0 && byte != BEAT_FRAME_SYNC) {
+		rx->stats.bytes_skipped++;
+		return 0;
+	}
+	rx->frame[rx->len++] = byte;
+	if (rx->len == 2 && byte != BEAT_NUM_FEATURES) {
+		rx->stats.bad_headers++;
+		rx->stats.bytes_skipped++;
+		beat_rx_resync(rx);
+		return 0;
+	}
+	if (rx->len < BEAT_FRAME_SIZE) {
+		return 0;
+	}
+	if (beat_rx_frame(rx)) {
+		rx->len = 0;
+		return 1;
+	}
+	rx->stats.crc_errors++;
+	rx->stats.bytes_skipped++;
+	beat_rx_resync(rx);
+	return 0;
+}
+
+void beat_frame_encode(unsigned char *frame, unsigned long seq,
+		const double *features){
+	unsigned short crc;
+	beat_float_t v;
+	int i;
+
+	frame[0] = BEAT_FRAME_SYNC;
+	frame[1] = BEAT_NUM_FEATURES;
+	put_le32(&frame[2], seq);
+	for (i=0; i < BEAT_NUM_FEATURES; i++){
+		v.f = (float) features[i];
+		put_le32(&frame[BEAT_HEADER_SIZE + 4 * i], v.u);
+	}
+	crc = result_crc16(&frame[1], BEAT_FRAME_SIZE - BEAT_CRC_SIZE - 1);
+	frame[BEAT_FRAME_SIZE - 2] = (unsigned char)(crc >> 8);
+	frame[BEAT_FRAME_SIZE - 1] = (unsigned char) crc;
+}
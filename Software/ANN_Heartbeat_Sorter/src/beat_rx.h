@@ -0,0 +1,88 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Binary beat frames for UART ingestion. The host sends each beat's
+ * feature vector as one frame:
+ *
+ *   offset  size  field
+ *   0       1     BEAT_FRAME_SYNC
+ *   1       1     number of features, BEAT_NUM_FEATURES
+ *   2       4     beat sequence number, little endian
+ *   6       4*n   features as IEEE-754 single precision, little endian
+ *   6+4n    2     CRC-16/CCITT (see result_proto.h) of bytes 1..5+4n,
+ *                 big endian
+ *
+ * The board answers with result frames (result_proto.h) whose beat
+ * sequence numbers are the ones received here.
+ *
+ * @file beat_rx.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef BEAT_RX_H
+#define BEAT_RX_H
+
+#include "beat_class.h"
+
+#define BEAT_FRAME_SYNC         0xB7
+#define BEAT_HEADER_SIZE        6
+#define BEAT_CRC_SIZE           2
+#define BEAT_FRAME_SIZE         (BEAT_HEADER_SIZE + 4 * BEAT_NUM_FEATURES + BEAT_CRC_SIZE)
+
+/*
+ * Parser statistics.
+ */
+typedef struct {
+	unsigned long frames;           /* good frames */
+	unsigned long crc_errors;       /* frames dropped on a bad CRC */
+	unsigned long bad_headers;      /* sync bytes with a wrong feature count */
+	unsigned long bytes_skipped;    /* bytes discarded while out of sync */
+	unsigned long lost_beats;       /* gaps in the beat sequence numbers */
+} beat_rx_stats_t;
+
+/*
+ * Incremental frame parser. Bytes are pushed one at a time in the order
+ * they arrive, so a frame may be split across any number of reads.
+ */
+typedef struct {
+	unsigned int len;               /* bytes of the frame collected */
+	unsigned long next_seq;         /* expected beat sequence number */
+	int have_seq;
+	unsigned long seq;              /* last complete frame */
+	double features[BEAT_NUM_FEATURES];
+	beat_rx_stats_t stats;
+	unsigned char frame[BEAT_FRAME_SIZE];
+} beat_rx_t;
+
+void beat_rx_init(beat_rx_t *rx);
+
+/**
+ * Push the next received byte.
+ * @function    beat_rx_put()
+ *
+ * @param       rx          parser
+ * @param       byte        received byte
+ *
+ * @return      1 when the byte completes a good frame, whose beat is then
+ *              in rx->seq and rx->features; 0 otherwise
+ */
+int beat_rx_put(beat_rx_t *rx, unsigned char byte);
+
+/**
+ * Build the frame of a beat, as the host sends it.
+ * @function    beat_frame_encode()
+ *
+ * @param       frame       BEAT_FRAME_SIZE bytes
+ * @param       seq         beat sequence number
+ * @param       features    BEAT_NUM_FEATURES values
+ */
+void beat_frame_encode(unsigned char *frame, unsigned long seq,
+		const double *features);
+
+#endif /* BEAT_RX_H */
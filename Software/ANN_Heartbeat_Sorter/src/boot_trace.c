@@ -0,0 +1,88 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Application side of the boot time trace (see boot_trace.h): it carries
+ * on the trace the bootloader started, or starts one, and prints it once.
+ *
+ * @file boot_trace.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include "boot_trace.h"
+
+static const char *const boot_trace_names[BOOT_TRACE_EVENTS] = {
+	"bootloader start",
+	"bootloader init",
+	"image load",
+	"  SREC decode",
+	"  copy to RAM",
+	"jump, C runtime init",
+	"GPIO and UART init",
+	"XUartLite_SelfTest",
+	"mfs_init_genimage",
+	"record load",
+	"first classification",
+};
+
+/**
+ * Record the start of main(). The trace of the bootloader is kept; without
+ * one (a bootloader built without BOOT_TRACE, or a program started from
+ * the debugger) the timer is started here and the trace starts with it.
+ * @function    boot_trace_app_start()
+ */
+void boot_trace_app_start(void){
+	boot_trace_t *trace = BOOT_TRACE_BUF;
+
+	if (trace->magic != BOOT_TRACE_MAGIC) {
+		BOOT_TRACE_TIMER_START();
+		trace->magic = BOOT_TRACE_MAGIC;
+		trace->recorded = 0;
+	}
+	trace->ticks[BOOT_TRACE_APP_START] = BOOT_TRACE_NOW();
+	trace->recorded |= 1UL << BOOT_TRACE_APP_START;
+}
+
+/**
+ * Print the trace in microseconds: for each mark, its time from the start
+ * of the trace and the time of its phase since the mark before it, and the
+ * totals. The trace is then dropped, so it is printed only once.
+ * @function    boot_trace_print()
+ *
+ * @return      number of events printed, 0 if there was no trace
+ */
+int boot_trace_print(void){
+	boot_trace_t *trace = BOOT_TRACE_BUF;
+	unsigned long us, last = 0;
+	int i, printed = 0;
+
+	if (trace->magic != BOOT_TRACE_MAGIC) {
+		return 0;
+	}
+	printf("\r\nBoot time trace (us)\r\n");
+	printf("%-24s %10s %10s\r\n", "phase", "end", "time");
+	for (i = 0; i < BOOT_TRACE_EVENTS; i++) {
+		if (!(trace->recorded & (1UL << i))) {
+			continue;
+		}
+		us = trace->ticks[i] / BOOT_TRACE_TICKS_PER_US;
+		if (BOOT_TRACE_TOTALS & (1UL << i)) {
+			printf("%-24s %10s %10lu\r\n", boot_trace_names[i], "", us);
+		} else if (printed == 0) {
+			printf("%-24s %10lu\r\n", boot_trace_names[i], us);
+			last = us;
+		} else {
+			printf("%-24s %10lu %10lu\r\n", boot_trace_names[i], us, us - last);
+			last = us;
+		}
+		printed++;
+	}
+	trace->magic = 0;
+	return printed;
+}
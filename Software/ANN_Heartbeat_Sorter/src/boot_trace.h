@@ -0,0 +1,113 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Boot time trace, from the start of the bootloader to the first beat
+ * classified by the application. Each phase boundary is recorded as a
+ * timestamp of a free running xps_timer, in a buffer at a fixed address
+ * at the top of the DDR that neither program loads or clears, so what the
+ * bootloader records is still there for the application, which prints it
+ * once (ANN_Heartbeat_Sorter/src/boot_trace.c).
+ *
+ * The same file is in bootloader/src, bootloader_debug/src and
+ * ANN_Heartbeat_Sorter/src: keep them the same.
+ *
+ * Marks are the time at which the phase of their name ends, in timer ticks
+ * from the start of the bootloader. Totals are the time spent in a phase
+ * that is done a piece at a time, such as decoding the SREC records, and
+ * are part of the phase of the mark before them.
+ *
+ * The board has no timer in system.mhs: BOOT_TRACE needs an xps_timer at
+ * BOOT_TRACE_TIMER_BASEADDR, clocked by the 50 MHz bus. Host tests define
+ * BOOT_TRACE_HOST, and give the buffer and a stand-in clock.
+ *
+ * @file boot_trace.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#ifdef BOOT_TRACE_HOST
+#undef BOOT_TRACE
+#define BOOT_TRACE                  1
+#elif !defined(BOOT_TRACE)
+#define BOOT_TRACE                  0
+#endif
+
+#define BOOT_TRACE_MAGIC            0x42545243      /* "BTRC" */
+#define BOOT_TRACE_ADDR             0x8FFFFF00
+#define BOOT_TRACE_TIMER_BASEADDR   0x83C00000
+#define BOOT_TRACE_TICKS_PER_US     50
+
+/* Events, in the order they are printed */
+#define BOOT_TRACE_BL_START         0   /* Mark: the bootloader starts the timer */
+#define BOOT_TRACE_BL_INIT          1   /* Mark: bootloader stdout set up */
+#define BOOT_TRACE_BL_LOAD          2   /* Mark: image loaded, about to jump */
+#define BOOT_TRACE_SREC_DECODE      3   /* Total: decoding SREC records */
+#define BOOT_TRACE_COPY             4   /* Total: copies to RAM */
+#define BOOT_TRACE_APP_START        5   /* Mark: main() of the application */
+#define BOOT_TRACE_DRIVERS          6   /* Mark: GPIO and UART initialized */
+#define BOOT_TRACE_UART_SELFTEST    7   /* Mark: XUartLite_SelfTest done */
+#define BOOT_TRACE_MFS_INIT         8   /* Mark: mfs_init_genimage done */
+#define BOOT_TRACE_RECORD_LOAD      9   /* Mark: beat record read */
+#define BOOT_TRACE_FIRST_BEAT       10  /* Mark: first beat classified */
+#define BOOT_TRACE_EVENTS           11
+
+#define BOOT_TRACE_TOTALS           ((1UL << BOOT_TRACE_SREC_DECODE) | (1UL << BOOT_TRACE_COPY))
+
+typedef struct {
+    unsigned long magic;                        /* BOOT_TRACE_MAGIC while it holds a trace */
+    unsigned long recorded;                     /* Bit of each event recorded */
+    unsigned long ticks[BOOT_TRACE_EVENTS];     /* Time of a mark, or a total */
+} boot_trace_t;
+
+#ifdef BOOT_TRACE_HOST
+extern boot_trace_t boot_trace_host;
+unsigned long boot_trace_host_ticks (void);
+#define BOOT_TRACE_BUF              (&boot_trace_host)
+#define BOOT_TRACE_NOW()            boot_trace_host_ticks ()
+#define BOOT_TRACE_TIMER_START()    ((void)0)
+#else
+/* Timer 0 of the xps_timer: TCSR0, TLR0 and TCR0 */
+#define BOOT_TRACE_TIMER_REG(off)   (*(volatile unsigned long *)(BOOT_TRACE_TIMER_BASEADDR + (off)))
+#define BOOT_TRACE_BUF              ((boot_trace_t *)BOOT_TRACE_ADDR)
+#define BOOT_TRACE_NOW()            BOOT_TRACE_TIMER_REG (0x8)
+/* Load 0, then count up from it with auto reload (ENT | ARHT) */
+#define BOOT_TRACE_TIMER_START()    (BOOT_TRACE_TIMER_REG (0x4) = 0, BOOT_TRACE_TIMER_REG (0x0) = 0x20, \
+                                     BOOT_TRACE_TIMER_REG (0x0) = 0x90)
+#endif
+
+#if BOOT_TRACE
+/* Start the timer and a new trace */
+#define BOOT_TRACE_START() \
+    (BOOT_TRACE_TIMER_START (), BOOT_TRACE_BUF->magic = BOOT_TRACE_MAGIC, \
+     BOOT_TRACE_BUF->recorded = 0, BOOT_TRACE_MARK (BOOT_TRACE_BL_START))
+#define BOOT_TRACE_MARK(id) \
+    (BOOT_TRACE_BUF->ticks[id] = BOOT_TRACE_NOW (), BOOT_TRACE_BUF->recorded |= 1UL << (id))
+/* Add ticks to a total */
+#define BOOT_TRACE_ADD(id, t) \
+    (BOOT_TRACE_BUF->ticks[id] = ((BOOT_TRACE_BUF->recorded >> (id)) & 1 ? BOOT_TRACE_BUF->ticks[id] : 0) \
+                                 + (t), \
+     BOOT_TRACE_BUF->recorded |= 1UL << (id))
+/* Add the time from BOOT_TRACE_BEGIN (t) to a total */
+#define BOOT_TRACE_BEGIN(t)         ((t) = BOOT_TRACE_NOW ())
+#define BOOT_TRACE_END(id, t)       BOOT_TRACE_ADD (id, BOOT_TRACE_NOW () - (t))
+#else
+#define BOOT_TRACE_START()
+#define BOOT_TRACE_MARK(id)
+#define BOOT_TRACE_ADD(id, t)
+#define BOOT_TRACE_BEGIN(t)
+#define BOOT_TRACE_END(id, t)
+#endif
+
+/* Application side, in ANN_Heartbeat_Sorter/src/boot_trace.c */
+void boot_trace_app_start (void);
+int boot_trace_print (void);
+
+#endif /* BOOT_TRACE_H */
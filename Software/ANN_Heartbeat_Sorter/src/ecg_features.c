@@ -0,0 +1,439 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Streaming extraction of the RNA35b input features from raw ECG.
+ *
+ * QRS detection follows Pan & Tompkins: integer low-pass, high-pass,
+ * derivative, squaring and a 150 ms moving window integration, with
+ * adaptive signal/noise peak levels, a 200 ms refractory period and a
+ * search-back for missed beats. The filters run on every sample; the R
+ * peak is then located on the band-passed signal kept in the history.
+ * R + 500 ms after a detection the beat's shape features are measured
+ * from the history, and when the next R peak is known its RR features
+ * are added and the vector is handed out.
+ *
+ * @file ecg_features.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <string.h>
+#include "ecg_features.h"
+
+#define HISTORY_MASK            (ECG_HISTORY_SIZE - 1)
+
+#if (ECG_HISTORY_SIZE & HISTORY_MASK) != 0
+#error "ECG_HISTORY_SIZE must be a power of two"
+#endif
+
+/*
+ * Time constants in samples at ECG_SAMPLE_RATE.
+ */
+#define LEARN_SAMPLES           (2 * ECG_SAMPLE_RATE)   /* threshold learning */
+#define REFRACTORY              72                      /* 200 ms */
+#define MWI_WIDTH               54                      /* 150 ms */
+#define BP_DELAY                21                      /* low + high-pass delay */
+#define R_SEARCH_FROM           110                     /* R window before the */
+#define R_SEARCH_TO             20                      /* MWI peak */
+#define R_REFINE                8
+#define PRE_R                   90                      /* 250 ms */
+#define POST_R                  180                     /* 500 ms */
+#define BASELINE_WIDTH          8
+#define QRS_SEARCH              60
+#define P_SEARCH_FROM           72                      /* 200 ms before onset */
+#define P_SEARCH_TO             14                      /* 40 ms before onset */
+#define T_START                 14                      /* 40 ms after offset */
+#define DERIV_LIMIT             8191
+#define RR_AVERAGE_WEIGHT       256
+#define RR_LOCAL_BEATS          10
+#define P_MIN_MV                0.05
+#define RR_SEARCH_MAX           (2 * ECG_SAMPLE_RATE)
+/*
+ * Oldest noise peak the search-back may still take: its beat window must
+ * remain in the history until it is measured.
+ */
+#define NOISE_PEAK_AGE          (ECG_HISTORY_SIZE - 2 * (PRE_R + POST_R))
+
+#define F_PRE_RR                0
+#define F_POST_RR               1
+#define F_AVERAGE_RR            2
+#define F_LOCAL_RR              3
+#define F_QRS_WIDTH             4
+#define F_T_END                 5
+#define F_P_WAVE                6
+#define F_MORPH                 7
+
+#define RAW(ef, i)              ((ef)->raw[(i) & HISTORY_MASK])
+#define BP(ef, i)               ((ef)->bp[(i) & HISTORY_MASK])
+#define ABS(x)                  ((x) < 0 ? -(x) : (x))
+#define THRESHOLD(ef)           ((ef)->npki + ((ef)->spki > (ef)->npki ? \
+                                        ((ef)->spki - (ef)->npki) / 4 : 0))
+
+/*
+ * Training range of each feature: mapminmax_apply() in RNA35b.c maps
+ * [feature_min, feature_min + 2 / feature_gain] to [-1, 1].
+ */
+static const double feature_min[BEAT_NUM_FEATURES] = { 67.0, 67.0, 199.9677,
+	99.1, 12.0, 12.0, 0.0, -1.83452863491973, -3.07165820315485,
+	-3.64155435581708, -3.56929876883237, -3.9707735980554, -3.73633708072196,
+	-3.78325530302861, -4.54917682387727, -3.71955449884929, -3.78906494451508,
+	-4.00997471631115, -3.80157516325814, -3.79781134003307, -3.31504520558832,
+	-3.10234738748226, -3.17053421944074, -3.1698921100242, -3.63249646300314,
+	-3.21379003518259, -3.40577598144274, -1.70139630611735 };
+
+static const double feature_gain[BEAT_NUM_FEATURES] = { 0.000977039570102589,
+	0.000977039570102589, 0.0121338901980008, 0.00324254215304799,
+	0.024390243902439, 0.00746268656716418, 2.0, 0.588773765559667,
+	0.330137976487533, 0.282712269357486, 0.299464370763992, 0.287612918270213,
+	0.278367452955766, 0.273556898206861, 0.242946122342346, 0.274802545743605,
+	0.27098852941646, 0.268101710906053, 0.267716773371336, 0.279859957010486,
+	0.298157256818297, 0.316005936998485, 0.309725530262211, 0.319868286289054,
+	0.292060807554216, 0.298193556084659, 0.300392065251682, 0.598524638722814 };
+
+void ecg_features_init(ecg_features_t *ef, int adc_zero, double units_per_mv){
+	memset(ef, 0, sizeof(*ef));
+	ef->adc_zero = adc_zero;
+	ef->mv_per_unit = 1.0 / units_per_mv;
+	ef->rr_search = ECG_SAMPLE_RATE;
+}
+
+void ecg_features_get_stats(const ecg_features_t *ef, ecg_features_stats_t *stats){
+	*stats = ef->stats;
+}
+
+void ecg_feature_range(int feature, double *min, double *max){
+	*min = feature_min[feature];
+	*max = feature_min[feature] + 2.0 / feature_gain[feature];
+}
+
+/*
+ * A QRS complex gave an MWI peak at "tp": find its R peak, the largest
+ * band-passed deflection before the peak, refined on the raw signal.
+ */
+static void ecg_qrs(ecg_features_t *ef, unsigned long tp){
+	unsigned long i, ib = tp - R_SEARCH_FROM, r;
+	int best = -1, ref, v;
+	ecg_beat_t *b;
+
+	if (ef->last_peak != 0 && tp > ef->last_peak) {
+		ef->rr_search = (7 * ef->rr_search + (tp - ef->last_peak)) / 8;
+		if (ef->rr_search > RR_SEARCH_MAX) {
+			ef->rr_search = RR_SEARCH_MAX;
+		}
+	}
+	ef->last_peak = tp;
+	ef->noise_best = 0;
+
+	for (i=tp - R_SEARCH_FROM; i <= tp - R_SEARCH_TO; i++){
+		v = ABS(BP(ef, i));
+		if (v > best) {
+			best = v;
+			ib = i;
+		}
+	}
+	ref = RAW(ef, ib - 25);
+	r = ib;
+	best = -1;
+	for (i=ib - R_REFINE; i <= ib + R_REFINE; i++){
+		v = ABS(RAW(ef, i) - ref);
+		if (v > best) {
+			best = v;
+			r = i;
+		}
+	}
+
+	if (ef->num_pending > 0 &&
+			r < ef->pending[ef->num_pending - 1].r + REFRACTORY) {
+		return;
+	}
+	if (ef->num_pending == ECG_PENDING_BEATS) {
+		ef->last_r = ef->pending[0].r;
+		ef->have_last_r = 1;
+		memmove(&ef->pending[0], &ef->pending[1],
+				(ECG_PENDING_BEATS - 1) * sizeof(ecg_beat_t));
+		ef->num_pending--;
+		ef->stats.dropped++;
+	}
+	b = &ef->pending[ef->num_pending++];
+	b->r = r;
+	b->measured = 0;
+	ef->stats.detections++;
+}
+
+/*
+ * Local maximum of the integrated signal at "tp".
+ */
+static void ecg_peak(ecg_features_t *ef, unsigned long tp, unsigned long v){
+	unsigned long thr = THRESHOLD(ef);
+	int refractory = ef->last_peak != 0 && tp < ef->last_peak + REFRACTORY;
+
+	if (v > thr && !refractory) {
+		ef->spki = (v + 7 * ef->spki) / 8;
+		ecg_qrs(ef, tp);
+	} else {
+		ef->npki = (v + 7 * ef->npki) / 8;
+		if (!refractory && v > ef->noise_best) {
+			ef->noise_best = v;
+			ef->noise_best_t = tp;
+		}
+	}
+}
+
+/*
+ * Shape features of a beat whose window [r - PRE_R, r + POST_R] is in the
+ * history.
+ */
+static void ecg_measure(ecg_features_t *ef, ecg_beat_t *b){
+	unsigned long r = b->r, i, s, onset, offset, t_peak, t_end;
+	int lo, hi, range, best_range = -1, thr, v, amp_r, amp_t, amp_p;
+	long sum;
+	double baseline = 0.0, pos, frac;
+	int k;
+
+	/*
+	 * Baseline: the flattest stretch between the P wave window and the
+	 * QRS.
+	 */
+	for (s=r - PRE_R; s + BASELINE_WIDTH <= r - R_SEARCH_TO; s++){
+		lo = hi = RAW(ef, s);
+		sum = 0;
+		for (i=s; i < s + BASELINE_WIDTH; i++){
+			v = RAW(ef, i);
+			lo = v < lo ? v : lo;
+			hi = v > hi ? v : hi;
+			sum += v;
+		}
+		range = hi - lo;
+		if (best_range < 0 || range < best_range) {
+			best_range = range;
+			baseline = (double) sum / BASELINE_WIDTH;
+		}
+	}
+
+	/*
+	 * QRS onset and offset: where the band-passed signal falls below a
+	 * tenth of its peak for three samples.
+	 */
+	thr = 0;
+	for (i=r - R_SEARCH_TO; i <= r + R_SEARCH_TO; i++){
+		v = ABS(BP(ef, i));
+		thr = v > thr ? v : thr;
+	}
+	thr /= 10;
+	onset = r - QRS_SEARCH;
+	for (i=r; i > r - QRS_SEARCH; i--){
+		if (ABS(BP(ef, i)) < thr && ABS(BP(ef, i - 1)) < thr && ABS(BP(ef, i - 2)) < thr) {
+			onset = i;
+			break;
+		}
+	}
+	offset = r + QRS_SEARCH;
+	for (i=r; i < r + QRS_SEARCH; i++){
+		if (ABS(BP(ef, i)) < thr && ABS(BP(ef, i + 1)) < thr && ABS(BP(ef, i + 2)) < thr) {
+			offset = i;
+			break;
+		}
+	}
+	b->shape[F_QRS_WIDTH] = (double)(offset - onset);
+
+	/*
+	 * T wave: largest deflection after the QRS; it ends where it falls
+	 * under 30% of its amplitude.
+	 */
+	amp_r = (int)(RAW(ef, r) - baseline);
+	amp_r = ABS(amp_r);
+	t_peak = offset + T_START;
+	amp_t = 0;
+	for (i=offset + T_START; i < r + POST_R; i++){
+		v = (int)(RAW(ef, i) - baseline);
+		v = ABS(v);
+		if (v > amp_t) {
+			amp_t = v;
+			t_peak = i;
+		}
+	}
+	t_end = r + POST_R;
+	for (i=t_peak; i < r + POST_R; i++){
+		v = (int)(RAW(ef, i) - baseline);
+		if (10 * ABS(v) < 3 * amp_t) {
+			t_end = i;
+			break;
+		}
+	}
+	b->shape[F_T_END] = (double)(t_end - offset);
+
+	/*
+	 * P wave: a peak inside the window before the QRS onset, above a
+	 * small fraction of the R amplitude.
+	 */
+	amp_p = 0;
+	s = onset - P_SEARCH_FROM;
+	for (i=onset - P_SEARCH_FROM; i <= onset - P_SEARCH_TO; i++){
+		v = (int)(RAW(ef, i) - baseline);
+		if (v > amp_p) {
+			amp_p = v;
+			s = i;
+		}
+	}
+	b->shape[F_P_WAVE] = (s > onset - P_SEARCH_FROM && s < onset - P_SEARCH_TO &&
+			amp_p * ef->mv_per_unit >= P_MIN_MV && 20 * amp_p >= amp_r) ? 1.0 : 0.0;
+
+	/*
+	 * Morphology: linear interpolation at ECG_MORPH_POINTS even steps.
+	 */
+	for (k=0; k < ECG_MORPH_POINTS; k++){
+		pos = (double)(PRE_R + POST_R) * k / (ECG_MORPH_POINTS - 1);
+		i = r - PRE_R + (unsigned long) pos;
+		frac = pos - (unsigned long) pos;
+		b->shape[F_MORPH + k] = ((1.0 - frac) * RAW(ef, i) +
+				(k < ECG_MORPH_POINTS - 1 ? frac * RAW(ef, i + 1) : 0.0) -
+				baseline) * ef->mv_per_unit;
+	}
+	b->measured = 1;
+}
+
+/*
+ * Complete the oldest beat with its RR features.
+ */
+static void ecg_emit(ecg_features_t *ef, double *features){
+	ecg_beat_t *b = &ef->pending[0];
+	unsigned int pre = (unsigned int)(b->r - ef->last_r);
+	unsigned int post = (unsigned int)(ef->pending[1].r - b->r);
+	unsigned int k, sum = 0;
+	double min, max;
+
+	if (ef->stats.beats == 0) {
+		ef->rr_average = pre;
+	} else {
+		ef->rr_average += (pre - ef->rr_average) / RR_AVERAGE_WEIGHT;
+	}
+	ef->rr_local[ef->rr_local_pos] = pre;
+	ef->rr_local_pos = (ef->rr_local_pos + 1) % RR_LOCAL_BEATS;
+	if (ef->rr_local_count < RR_LOCAL_BEATS) {
+		ef->rr_local_count++;
+	}
+	for (k=0; k < ef->rr_local_count; k++){
+		sum += ef->rr_local[k];
+	}
+
+	memcpy(features, b->shape, sizeof(b->shape));
+	features[F_PRE_RR] = pre;
+	features[F_POST_RR] = post;
+	features[F_AVERAGE_RR] = ef->rr_average;
+	features[F_LOCAL_RR] = (double) sum / ef->rr_local_count;
+	for (k=0; k < BEAT_NUM_FEATURES; k++){
+		ecg_feature_range(k, &min, &max);
+		if (features[k] < min) {
+			features[k] = min;
+			ef->stats.clamped++;
+		} else if (features[k] > max) {
+			features[k] = max;
+			ef->stats.clamped++;
+		}
+	}
+	ef->stats.beats++;
+}
+
+int ecg_features_put(ecg_features_t *ef, int sample, double *features,
+		unsigned long *r){
+	unsigned long t = ef->t++, q, m;
+	int x, lp, hp, d;
+	unsigned int k;
+
+	/*
+	 * Low-pass (gain 36, 5 samples delay) and high-pass (16 samples
+	 * delay) filters.
+	 */
+	x = sample - ef->adc_zero;
+	RAW(ef, t) = x;
+	lp = 2 * ef->lp_y1 - ef->lp_y2 + x - 2 * RAW(ef, t - 6) + RAW(ef, t - 12);
+	ef->lp_y2 = ef->lp_y1;
+	ef->lp_y1 = lp;
+	ef->lp_hist[t & 63] = lp;
+	ef->hp_sum += lp - ef->lp_hist[(t - 32) & 63];
+	hp = ef->lp_hist[(t - 16) & 63] - ef->hp_sum / 32;
+	BP(ef, t - BP_DELAY) = hp;
+
+	/*
+	 * Derivative, squaring and moving window integration.
+	 */
+	ef->bp_hist[t & 7] = hp;
+	d = (2 * hp + ef->bp_hist[(t - 1) & 7] - ef->bp_hist[(t - 3) & 7] -
+			2 * ef->bp_hist[(t - 4) & 7]) / 8;
+	if (d > DERIV_LIMIT) {
+		d = DERIV_LIMIT;
+	} else if (d < -DERIV_LIMIT) {
+		d = -DERIV_LIMIT;
+	}
+	q = (unsigned long)(d * d);
+	ef->mwi_sum += q - ef->q_hist[(t - MWI_WIDTH) & 63];
+	ef->q_hist[t & 63] = q;
+	m = ef->mwi_sum / MWI_WIDTH;
+
+	if (t < LEARN_SAMPLES) {
+		/*
+		 * The first seconds set the initial peak levels.
+		 */
+		ef->learn_max = m > ef->learn_max ? m : ef->learn_max;
+		ef->learn_sum += m >> 4;
+		if (t == LEARN_SAMPLES - 1) {
+			ef->spki = ef->learn_max / 3;
+			ef->npki = ef->learn_sum / LEARN_SAMPLES * 8;
+			ef->last_peak = t;
+		}
+	} else {
+		if (ef->m1 > ef->m2 && ef->m1 >= m) {
+			ecg_peak(ef, t - 1, ef->m1);
+		}
+		/*
+		 * Search-back: nothing for 166% of the expected RR interval,
+		 * take the highest peak seen since the last QRS.
+		 */
+		if (ef->noise_best != 0 && t - ef->noise_best_t > NOISE_PEAK_AGE) {
+			ef->noise_best = 0;
+		}
+		if (t > ef->last_peak + ef->rr_search * 166 / 100 && ef->noise_best != 0 &&
+				ef->noise_best > THRESHOLD(ef) / 2) {
+			ef->spki = (ef->noise_best + 3 * ef->spki) / 4;
+			ef->stats.searchbacks++;
+			ecg_qrs(ef, ef->noise_best_t);
+		}
+	}
+	ef->m2 = ef->m1;
+	ef->m1 = m;
+
+	/*
+	 * Measure the beats whose window has gone by.
+	 */
+	for (k=0; k < ef->num_pending; k++){
+		if (!ef->pending[k].measured && t >= ef->pending[k].r + POST_R) {
+			ecg_measure(ef, &ef->pending[k]);
+		}
+	}
+
+	/*
+	 * The oldest beat is complete once measured and followed by another
+	 * one. The first beat of all only provides the first pre-RR.
+	 */
+	if (ef->num_pending >= 2 && ef->pending[0].measured) {
+		int ready = ef->have_last_r;
+		if (ready) {
+			ecg_emit(ef, features);
+			if (r != NULL) {
+				*r = ef->pending[0].r;
+			}
+		}
+		ef->last_r = ef->pending[0].r;
+		ef->have_last_r = 1;
+		memmove(&ef->pending[0], &ef->pending[1],
+				(ef->num_pending - 1) * sizeof(ecg_beat_t));
+		ef->num_pending--;
+		return ready;
+	}
+	return 0;
+}
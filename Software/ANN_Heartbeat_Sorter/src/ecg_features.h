@@ -0,0 +1,146 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Streaming extraction of the 28 RNA35b input features from raw ECG
+ * samples. Samples are pushed one at a time; QRS complexes are detected
+ * with integer Pan-Tompkins filters and adaptive thresholds, and once the
+ * R peak after a beat is known the beat's feature vector is complete:
+ *
+ *   0     pre-RR interval                  samples
+ *   1     post-RR interval                 samples
+ *   2     average RR interval (long run)   samples
+ *   3     local RR interval (last 10)      samples
+ *   4     QRS duration                     samples
+ *   5     QRS offset to T wave end         samples
+ *   6     P wave found before the QRS      0 or 1
+ *   7-27  ECG from R-250 ms to R+500 ms, resampled to 21 points,
+ *         baseline removed                 mV
+ *
+ * Every feature is clamped to the input range the network was trained
+ * on, the one mapminmax_apply() in RNA35b.c maps to [-1, 1].
+ *
+ * Memory is constant (a history of ECG_HISTORY_SIZE samples and a few
+ * pending beats) and the work per sample is bounded: the filters run on
+ * every sample and the per-beat measurements scan fixed windows.
+ *
+ * @file ecg_features.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef ECG_FEATURES_H
+#define ECG_FEATURES_H
+
+#include "beat_class.h"
+
+/*
+ * The integer filters and the windows are designed for this rate (the
+ * rate of the MIT-BIH arrhythmia database).
+ */
+#define ECG_SAMPLE_RATE         360
+
+/*
+ * Samples of history kept. Must be a power of two and cover the
+ * detection delay plus the morphology window.
+ */
+#define ECG_HISTORY_SIZE        2048
+
+/*
+ * Detected beats waiting for their measurements or for the next R peak.
+ */
+#define ECG_PENDING_BEATS       4
+
+#define ECG_MORPH_POINTS        21
+
+typedef struct {
+	unsigned long r;                /* sample index of the R peak */
+	int measured;                   /* shape features are computed */
+	double shape[BEAT_NUM_FEATURES];
+} ecg_beat_t;
+
+typedef struct {
+	unsigned long beats;            /* feature vectors produced */
+	unsigned long detections;       /* QRS complexes detected */
+	unsigned long searchbacks;      /* of them, found by search-back */
+	unsigned long dropped;          /* beats lost on a full pending queue */
+	unsigned long clamped;          /* features clamped to their range */
+} ecg_features_stats_t;
+
+typedef struct {
+	/* input scaling */
+	int adc_zero;
+	double mv_per_unit;
+	unsigned long t;                /* index of the next sample */
+
+	/* Pan-Tompkins filter state */
+	int lp_y1, lp_y2;
+	int lp_hist[64];
+	int hp_sum;
+	int bp_hist[8];
+	unsigned long mwi_sum;
+	unsigned long q_hist[64];
+	unsigned long m1, m2;
+
+	/* adaptive thresholds */
+	unsigned long spki, npki;
+	unsigned long learn_max, learn_sum;
+	unsigned long last_peak;        /* MWI time of the last QRS */
+	unsigned long noise_best;       /* highest noise peak since then */
+	unsigned long noise_best_t;
+
+	/* RR statistics */
+	unsigned long last_r;           /* R of the last beat sent out */
+	int have_last_r;
+	double rr_average;
+	unsigned int rr_local[10];
+	unsigned int rr_local_count;
+	unsigned int rr_local_pos;
+	unsigned long rr_search;        /* expected RR for the search-back */
+
+	ecg_beat_t pending[ECG_PENDING_BEATS];
+	unsigned int num_pending;
+
+	ecg_features_stats_t stats;
+
+	int raw[ECG_HISTORY_SIZE];      /* samples minus adc_zero */
+	int bp[ECG_HISTORY_SIZE];       /* band-passed, aligned with raw */
+} ecg_features_t;
+
+/**
+ * Initialize an extractor.
+ * @function    ecg_features_init()
+ *
+ * @param       ef          extractor
+ * @param       adc_zero    sample value of 0 mV
+ * @param       units_per_mv    sample units per mV (200 in MIT-BIH)
+ */
+void ecg_features_init(ecg_features_t *ef, int adc_zero, double units_per_mv);
+
+/**
+ * Push the next ECG sample.
+ * @function    ecg_features_put()
+ *
+ * @param       ef          extractor
+ * @param       sample      raw sample
+ * @param       features    BEAT_NUM_FEATURES values, written when a beat
+ *                          is complete
+ * @param       r           sample index of that beat's R peak, or NULL
+ *
+ * @return      1 when features holds a new beat, 0 otherwise
+ */
+int ecg_features_put(ecg_features_t *ef, int sample, double *features,
+		unsigned long *r);
+
+void ecg_features_get_stats(const ecg_features_t *ef, ecg_features_stats_t *stats);
+
+/**
+ * Training range of a feature, the values features are clamped to.
+ */
+void ecg_feature_range(int feature, double *min, double *max);
+
+#endif /* ECG_FEATURES_H */
@@ -0,0 +1,146 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * In place number scanner over mapped MFS file extents.
+ *
+ * strtod() and strtol() stop at the first character that cannot be part
+ * of a number, so a token followed by white space in the same extent is
+ * converted where it lies even though the image is not NUL terminated.
+ *
+ * @file file_scan.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xstatus.h"
+#include "xilmfs.h"
+#include "file_scan.h"
+
+/*
+ * Map the next extent of the file. Returns 0 at end of file.
+ */
+static int file_scan_next(file_scan_t *scan){
+	scan->len = mfs_file_map(scan->fd, &scan->data);
+	if (scan->len < 0) {
+		scan->error = 1;
+		scan->len = 0;
+	}
+	return scan->len > 0;
+}
+
+/*
+ * Length of the token at the start of the current extent.
+ */
+static int file_scan_span(const file_scan_t *scan){
+	int i;
+
+	for (i=0; i < scan->len && !isspace((unsigned char) scan->data[i]); i++){
+	}
+	return i;
+}
+
+/*
+ * Find the next token and consume it. Returns it in place when white space
+ * follows it in the same extent, assembled in scan->token otherwise, and
+ * NULL at end of file.
+ */
+static const char *file_scan_token(file_scan_t *scan, int *len){
+	const char *token;
+	int n, used = 0;
+
+	for (;;) {
+		while (scan->len > 0 && isspace((unsigned char) *scan->data)) {
+			scan->data++;
+			scan->len--;
+		}
+		if (scan->len > 0) {
+			break;
+		}
+		if (!file_scan_next(scan)) {
+			return NULL;
+		}
+	}
+
+	n = file_scan_span(scan);
+	if (n < scan->len) {
+		token = scan->data;
+		scan->data += n;
+		scan->len -= n;
+		*len = n;
+		return token;
+	}
+
+	/*
+	 * The token runs to the end of the extent, and maybe into the next.
+	 */
+	for (;;) {
+		if (used + n > FILE_SCAN_TOKEN_SIZE) {
+			scan->error = 1;
+			return NULL;
+		}
+		memcpy(&scan->token[used], scan->data, n);
+		used += n;
+		scan->data += n;
+		scan->len -= n;
+		if (scan->len > 0 || !file_scan_next(scan)) {
+			break;
+		}
+		n = file_scan_span(scan);
+	}
+	scan->token[used] = '\0';
+	*len = used;
+	return scan->token;
+}
+
+int file_scan_open(file_scan_t *scan, const char *filename){
+	memset(scan, 0, sizeof(*scan));
+	scan->fd = mfs_file_open(filename, MFS_MODE_READ);
+	return scan->fd < 0 ? XST_FAILURE : XST_SUCCESS;
+}
+
+int file_scan_double(file_scan_t *scan, double *value){
+	const char *token;
+	char *end;
+	int len;
+
+	token = file_scan_token(scan, &len);
+	if (token == NULL) {
+		return 0;
+	}
+	*value = strtod(token, &end);
+	if (end != token + len) {
+		scan->error = 1;
+		return 0;
+	}
+	return 1;
+}
+
+int file_scan_int(file_scan_t *scan, int *value){
+	const char *token;
+	char *end;
+	int len;
+
+	token = file_scan_token(scan, &len);
+	if (token == NULL) {
+		return 0;
+	}
+	*value = (int) strtol(token, &end, 10);
+	if (end != token + len) {
+		scan->error = 1;
+		return 0;
+	}
+	return 1;
+}
+
+int file_scan_close(file_scan_t *scan){
+	mfs_file_close(scan->fd);
+	return scan->error ? XST_FAILURE : XST_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Reads whitespace separated numbers from a text file of the memory file
+ * system in place: the file is walked with mfs_file_map() and numbers are
+ * converted straight from the file system image, without copying the file
+ * into RAM first. Only a number that straddles two blocks is assembled in
+ * a small buffer.
+ *
+ * @file file_scan.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef FILE_SCAN_H
+#define FILE_SCAN_H
+
+/*
+ * Longest number accepted, in characters.
+ */
+#define FILE_SCAN_TOKEN_SIZE    48
+
+typedef struct {
+	int fd;                         /* MFS file descriptor */
+	const char *data;               /* unread part of the current extent */
+	int len;
+	int error;                      /* a token was not a number or too long */
+	char token[FILE_SCAN_TOKEN_SIZE + 1];
+} file_scan_t;
+
+/**
+ * Open an MFS file for scanning.
+ * @function    file_scan_open()
+ *
+ * @param       scan        scanner
+ * @param       filename    file name, as given to mfs_file_open()
+ *
+ * @return      XST_FAILURE the file cannot be opened
+ *              XST_SUCCESS the scanner is ready
+ */
+int file_scan_open(file_scan_t *scan, const char *filename);
+
+/**
+ * Read the next number.
+ * @function    file_scan_double()
+ *
+ * @param       scan        scanner
+ * @param       value       number read
+ *
+ * @return      1 when a number was read, 0 at end of file or when the
+ *              next token is not a number (scan->error is then set)
+ */
+int file_scan_double(file_scan_t *scan, double *value);
+
+/**
+ * Read the next integer. Same as file_scan_double().
+ * @function    file_scan_int()
+ */
+int file_scan_int(file_scan_t *scan, int *value);
+
+/**
+ * Close the file.
+ * @function    file_scan_close()
+ *
+ * @return      XST_FAILURE a token was not a number
+ *              XST_SUCCESS otherwise
+ */
+int file_scan_close(file_scan_t *scan);
+
+#endif /* FILE_SCAN_H */
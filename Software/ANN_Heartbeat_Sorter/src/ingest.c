@@ -0,0 +1,100 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Live beat classification over the UART.
+ *
+ * @file ingest.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <xstatus.h>
+#include "RNA35b.h"
+#include "RNA35b_emxAPI.h"
+#include "ingest.h"
+#include "result_proto.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+
+/*
+ * Bytes taken from the RX ring per read.
+ */
+#define INGEST_READ_SIZE        64
+
+/*
+ * Upper bound of beats per result frame; a frame is normally sent as soon
+ * as the input is caught up.
+ */
+#define INGEST_FRAME_BEATS      64
+
+static struct {
+	beat_rx_t rx;
+	result_encoder_t enc;
+	emxArray_real_T *inputs;
+	emxArray_real_T *outputs;
+	double result[BEAT_NUM_CLASSES];
+} ingest;
+
+int ingest_init(unsigned int result_flags){
+	beat_rx_init(&ingest.rx);
+	result_encoder_init(&ingest.enc, uart_tx_write, result_flags,
+			INGEST_FRAME_BEATS);
+
+	/*
+	 * The network reads the parser's feature vector in place.
+	 */
+	ingest.inputs = emxCreateWrapper_real_T(ingest.rx.features,
+			BEAT_NUM_FEATURES, 1);
+	ingest.outputs = emxCreateWrapper_real_T(ingest.result,
+			BEAT_NUM_CLASSES, 1);
+	if (ingest.inputs == NULL || ingest.outputs == NULL) {
+		return XST_FAILURE;
+	}
+	return XST_SUCCESS;
+}
+
+/*
+ * Classify the beat the parser has just completed.
+ */
+static void ingest_classify(void){
+	int beat_class;
+
+	uart_tx_poll();
+	RNA35b(ingest.inputs, ingest.outputs);
+	uart_tx_poll();
+	beat_class = beat_class_decode(ingest.result);
+	result_encoder_set_seq(&ingest.enc, ingest.rx.seq);
+	result_encoder_put(&ingest.enc, beat_class, ingest.result[beat_class]);
+}
+
+int ingest_poll(void){
+	char buf[INGEST_READ_SIZE];
+	unsigned int n, i;
+	int beats = 0;
+
+	while ((n = uart_rx_read(buf, sizeof(buf))) > 0) {
+		for (i=0; i < n; i++){
+			if (beat_rx_put(&ingest.rx, (unsigned char) buf[i])) {
+				ingest_classify();
+				beats++;
+			}
+		}
+	}
+
+	/*
+	 * Caught up with the input: answer now.
+	 */
+	if (beats > 0) {
+		result_encoder_flush(&ingest.enc);
+	}
+	return beats;
+}
+
+void ingest_get_stats(beat_rx_stats_t *stats){
+	*stats = ingest.rx.stats;
+}
@@ -0,0 +1,50 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Live beat classification over the UART. Beat frames (beat_rx.h) are
+ * taken from the UART RX ring buffer, each beat is classified as soon as
+ * its frame is complete and the classes go back on the same UART as
+ * result frames (result_proto.h) through the TX ring buffer.
+ *
+ * A result frame is sent whenever no further complete beat is waiting, so
+ * a host that sends one beat at a time gets each class back alone, and a
+ * backlog is answered with one frame per batch.
+ *
+ * @file ingest.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "beat_rx.h"
+
+/**
+ * Prepare the classifier. uart_rx_init() and uart_tx_init() must have
+ * been called on the UART.
+ * @function    ingest_init()
+ *
+ * @param       result_flags    RESULT_FLAG_* options of the result frames
+ *
+ * @return      XST_SUCCESS or XST_FAILURE if out of memory
+ */
+int ingest_init(unsigned int result_flags);
+
+/**
+ * Classify every beat whose frame has arrived and send the results.
+ * Never waits for input.
+ * @function    ingest_poll()
+ *
+ * @return      number of beats classified
+ */
+int ingest_poll(void);
+
+void ingest_get_stats(beat_rx_stats_t *stats);
+
+#endif /* INGEST_H */
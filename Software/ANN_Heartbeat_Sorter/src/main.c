@@ -6,11 +6,11 @@
  * Network. Development & implementation on FPGA.
  *
  * This stand-alone program runs an Heartbeat sorter algorithm developed
- * by Alexis Martn Cruz & Lus Mengibar Pozo on a Startan 3E's
+ * by Alexis MartÃ­n Cruz & LuÃ­s Mengibar Pozo on a Startan 3E's
  * Microblaze in order to check its performance running directly on a
  * microprocessor without any hardware acceleration.
  *
- * @Author Pedro Marcos Solrzano
+ * @Author Pedro Marcos SolÃ³rzano
  * @Author Luis Mengibar Pozo (Tutor)
  *
  * @file main.c
@@ -38,6 +38,37 @@
  * UART Configuration
  */
 #define UART_DEVICE_ID          XPAR_UARTLITE_1_DEVICE_ID
+/*
+ * What to do with a classification when the UART TX buffer is full:
+ * UART_TX_BLOCK waits for room, UART_TX_DROP discards it.
+ */
+#define UART_TX_POLICY          UART_TX_BLOCK
+
+/*
+ * Result output format:
+ * RESULT_FORMAT_TEXT    one text line per beat
+ * RESULT_FORMAT_BINARY  run-length coded frames, see result_proto.h. A frame
+ *                       is sent at least every RESULT_FRAME_BEATS beats.
+ */
+#define RESULT_FORMAT_TEXT      0
+#define RESULT_FORMAT_BINARY    1
+#define RESULT_FORMAT           RESULT_FORMAT_TEXT
+#define RESULT_FRAME_BEATS      64
+#define RESULT_FRAME_FLAGS      RESULT_FLAG_CONFIDENCE
+
+/*
+ * Input source:
+ * INPUT_SOURCE_MFS   classify the record stored in the file system image
+ * INPUT_SOURCE_UART  classify the beat frames received on the UART (see
+ *                    beat_rx.h) and answer each with result frames, until
+ *                    the board is reset. RESULT_FORMAT does not apply.
+ * INPUT_SOURCE_ECG   classify the raw ECG stored in the file system image;
+ *                    the beat features are extracted while it is read
+ */
+#define INPUT_SOURCE_MFS        0
+#define INPUT_SOURCE_UART       1
+#define INPUT_SOURCE_ECG        2
+#define INPUT_SOURCE            INPUT_SOURCE_MFS
 
 /*
  * File System configuration
@@ -46,6 +77,44 @@
 #define FILE_SYSTEM_BASEADDR 	0x890F0000
 #define FILE_SYSTEM_SIZE		1024
 
+/*
+ * Block cache of the file system image in DDR, so that the image in flash
+ * is read a block at a time with word accesses, and only once: blocks
+ * cached at most, and blocks read ahead. The cache takes 556 bytes for each
+ * of the FILE_SYSTEM_SIZE / 532 blocks of the image, up to the maximum. An
+ * image of fewer than 2 blocks is read in place, and so is any image when
+ * xilmfs is built without MFS_BLOCK_CACHE 1 (see system.mss).
+ */
+#define FILE_SYSTEM_CACHE_MAX_BLOCKS	64
+#define FILE_SYSTEM_READ_AHEAD	4
+
+/*
+ * Print the file system statistics on the UART once the record is loaded:
+ * 1 to print them. xilmfs must be built with MFS_STATS 1 (and with
+ * MFS_STATS_TIMER for the cycles of each call), otherwise nothing is printed.
+ */
+#define FILE_SYSTEM_STATS		0
+
+/*
+ * Boot time trace (see boot_trace.h): 1 to time the phases of main() up to
+ * the first classification, after those of the bootloader if it was built
+ * with BOOT_TRACE 1 too, and print them once the record is classified.
+ * Needs the xps_timer of boot_trace.h. Not printed with INPUT_SOURCE_UART.
+ */
+#define BOOT_TRACE				0
+
+/*
+ * Reader of the record in INPUT_SOURCE_MFS:
+ * INPUT_READER_SCAN   scan the values in place in the file system image
+ * INPUT_READER_STDIO  fscanf on a stdio stream over the file (mfs_fopen),
+ *                     refilled a buffer of MFS_STDIO_BUFFER_SIZE bytes at
+ *                     a time. Slower (see utils/bench_reader.c), but any
+ *                     stdio code can read the file.
+ */
+#define INPUT_READER_SCAN       0
+#define INPUT_READER_STDIO      1
+#define INPUT_READER            INPUT_READER_SCAN
+
 /*
  * Input data configuration:
  */
@@ -55,6 +124,13 @@
 #define NUM_ROWS_RESULT         5
 #define INPUT_DIR               "file_data"
 
+/*
+ * Raw ECG input configuration: one sample per value, at ECG_SAMPLE_RATE.
+ */
+#define ECG_INPUT_FILE          "ecg_data"
+#define ECG_ADC_ZERO            1024
+#define ECG_UNITS_PER_MV        200.0
+
 
 /*
  * Include files
@@ -66,7 +142,99 @@
 #include <xuartlite.h>
 #include "RNA35b.h"
 #include "RNA35b_emxAPI.h"
+#include "beat_class.h"
+#include "uart_tx.h"
+#include "result_proto.h"
+#include "uart_rx.h"
+#include "ingest.h"
+#include "ecg_features.h"
+#include "file_scan.h"
+#include "boot_trace.h"
+#if INPUT_READER == INPUT_READER_STDIO
+#include "mfs_stdio.h"
+#endif
+
 
+/*
+ * Blocks of the file system block cache.
+ */
+#if FILE_SYSTEM_SIZE / 532 < 2
+#define FILE_SYSTEM_CACHE_BLOCKS	0
+#elif FILE_SYSTEM_SIZE / 532 < FILE_SYSTEM_CACHE_MAX_BLOCKS
+#define FILE_SYSTEM_CACHE_BLOCKS	(FILE_SYSTEM_SIZE / 532)
+#else
+#define FILE_SYSTEM_CACHE_BLOCKS	FILE_SYSTEM_CACHE_MAX_BLOCKS
+#endif
+
+#if FILE_SYSTEM_CACHE_BLOCKS > 0 && INPUT_SOURCE != INPUT_SOURCE_UART
+/*
+ * Memory of the file system block cache.
+ */
+static unsigned int file_system_cache[FILE_SYSTEM_CACHE_BLOCKS * 556 / sizeof(unsigned int)];
+#endif
+
+#if RESULT_FORMAT == RESULT_FORMAT_BINARY
+/*
+ * Binary result frame being built.
+ */
+static result_encoder_t result_encoder;
+#endif
+
+/**
+ * Queue the classification of a beat for UART in the selected format.
+ * @function    send_class()
+ *
+ * @param       beat_class  class code
+ * @param       confidence  ANN output of the class
+ */
+static void send_class(int beat_class, double confidence){
+#if RESULT_FORMAT == RESULT_FORMAT_BINARY
+	result_encoder_put(&result_encoder, beat_class, confidence);
+#else
+	(void) confidence;
+	uart_tx_print(beat_class_text[beat_class]);
+#endif
+}
+
+#if INPUT_SOURCE == INPUT_SOURCE_ECG
+/*
+ * Feature extractor state. Too large for the stack.
+ */
+static ecg_features_t ecg_features;
+
+/**
+ * Classify a raw ECG file sample by sample: every beat is sent to the
+ * network as soon as the extractor completes its features.
+ * @function    classify_ecg()
+ *
+ * @param       ecg_file    scanner of the file with the samples
+ *
+ * @return      XST_FAILURE error reading the file
+ *              XST_SUCCESS the whole file was classified
+ */
+static int classify_ecg(file_scan_t *ecg_file){
+	double features[NUM_ROWS_DATA], result[NUM_ROWS_RESULT];
+	emxArray_real_T *inputs, *outputs;
+	int sample, beat_class;
+
+	inputs = emxCreateWrapper_real_T(features, NUM_ROWS_DATA, NUM_COLUMNS_BEAT);
+	outputs = emxCreateWrapper_real_T(result, NUM_ROWS_RESULT, NUM_COLUMNS_BEAT);
+	ecg_features_init(&ecg_features, ECG_ADC_ZERO, ECG_UNITS_PER_MV);
+	while (file_scan_int(ecg_file, &sample)) {
+		if (ecg_features_put(&ecg_features, sample, features, NULL)) {
+			uart_tx_poll();
+			RNA35b(inputs, outputs);
+			uart_tx_poll();
+			beat_class = beat_class_decode(result);
+			send_class(beat_class, result[beat_class]);
+		}
+		uart_tx_poll();
+	}
+	emxDestroyArray_real_T(inputs);
+	emxDestroyArray_real_T(outputs);
+	return ecg_file->error ? XST_FAILURE : XST_SUCCESS;
+}
+#endif
 
 /**
  * Main code
@@ -83,10 +251,23 @@ int main(){
 	 */
 	XGpio led;
 	XUartLite uart;
-	int status, i, j, max_value_pos, input_processed=0;
-	double max_value, **datas, **result, **datas_input;
+	int status;
+#if INPUT_SOURCE == INPUT_SOURCE_MFS
+	int i, j, max_value_pos, input_processed=0;
+	double **datas, **result, **datas_input;
 	emxArray_real_T *inputs, *outputs;
-	FILE *beats_file = NULL;
+#endif
+#if INPUT_SOURCE == INPUT_SOURCE_ECG || (INPUT_SOURCE == INPUT_SOURCE_MFS && INPUT_READER == INPUT_READER_SCAN)
+	file_scan_t beats_file;
+#endif
+#if INPUT_SOURCE == INPUT_SOURCE_MFS && INPUT_READER == INPUT_READER_STDIO
+	FILE *beats_stream;
+	int read_error = 0;
+#endif
+
+#if BOOT_TRACE
+	boot_trace_app_start();
+#endif
 
 	/*
 	 * LED's GPIO Initialization
@@ -108,17 +289,55 @@ int main(){
 		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_ERROR_STATE);
 		return XST_FAILURE;
 	}
+	BOOT_TRACE_MARK(BOOT_TRACE_DRIVERS);
 
 	status = XUartLite_SelfTest(&uart);
 	if (status != XST_SUCCESS) {
 		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_ERROR_STATE);
 		return XST_FAILURE;
 	}
+	BOOT_TRACE_MARK(BOOT_TRACE_UART_SELFTEST);
 
+	/*
+	 * Beat classifications are queued in the UART TX buffer and sent in
+	 * the background, so inference does not wait for the UART.
+	 */
+	status = uart_tx_init(&uart, UART_TX_POLICY);
+	if (status != XST_SUCCESS) {
+		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_ERROR_STATE);
+		return XST_FAILURE;
+	}
+#if RESULT_FORMAT == RESULT_FORMAT_BINARY
+	result_encoder_init(&result_encoder, uart_tx_write,
+			RESULT_FRAME_FLAGS, RESULT_FRAME_BEATS);
+#endif
+
+#if INPUT_SOURCE == INPUT_SOURCE_UART
+	/*
+	 * Live classification: beats arrive through the UART RX buffer and
+	 * their classes leave through the TX buffer. Never returns.
+	 */
+	status = uart_rx_init(&uart);
+	if (status == XST_SUCCESS) {
+		status = ingest_init(RESULT_FRAME_FLAGS);
+	}
+	if (status != XST_SUCCESS) {
+		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_ERROR_STATE);
+		return XST_FAILURE;
+	}
+	while (1) {
+		ingest_poll();
+	}
+#else
 	/*
 	 * Initialize the memory file system
 	 */
+#if FILE_SYSTEM_CACHE_BLOCKS > 0
+	mfs_set_block_cache((char *) file_system_cache, sizeof(file_system_cache),
+			FILE_SYSTEM_READ_AHEAD);
+#endif
 	mfs_init_genimage(FILE_SYSTEM_SIZE, (char*)(FILE_SYSTEM_BASEADDR), MFSINIT_ROM_IMAGE);
+	BOOT_TRACE_MARK(BOOT_TRACE_MFS_INIT);
 //	status = mfs_change_dir("root");
 //	if (status != 1) {
 //		print("Error setting File System. The program will stop\n");
@@ -127,13 +346,48 @@ int main(){
 //	}
 	int debug = mfs_change_dir("root");
 	printf("%d",debug);
+
+#if INPUT_SOURCE == INPUT_SOURCE_ECG
 	/*
-	 * Open input file in read only mode
+	 * Classify the raw ECG: features are extracted while it is read.
+	 */
+	status = file_scan_open(&beats_file, ECG_INPUT_FILE);
+	if (status != XST_SUCCESS) {
+		print("Error opening file. The program will stop\r\n");
+		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_FILE_ERROR_STATE);
+		return XST_FAILURE;
+	}
+	status = classify_ecg(&beats_file);
+#if RESULT_FORMAT == RESULT_FORMAT_BINARY
+	result_encoder_flush(&result_encoder);
+#endif
+	uart_tx_flush();
+	file_scan_close(&beats_file);
+	if (status != XST_SUCCESS) {
+		print("Error reading file. The program will stop\r\n");
+		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_FILE_ERROR_STATE);
+		return XST_FAILURE;
+	}
+#if BOOT_TRACE
+	boot_trace_print();
+#endif
+	print("The program has finished successfully\r\n");
+	XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_SUCCESS_STATE);
+	return XST_SUCCESS;
+#else
+	/*
+	 * Open input file in read only mode. It is read in place from the
+	 * file system image, or through a stdio stream.
 	 */
 	debug =  mfs_exists_file(INPUT_DIR);
 	printf("%d",debug);
-	beats_file = fopen (INPUT_DIR, "r");
-	if (beats_file==NULL) {
+#if INPUT_READER == INPUT_READER_STDIO
+	beats_stream = mfs_fopen(INPUT_DIR, "r");
+	status = (beats_stream != NULL) ? XST_SUCCESS : XST_FAILURE;
+#else
+	status = file_scan_open(&beats_file, INPUT_DIR);
+#endif
+	if (status != XST_SUCCESS) {
 		print("Error opening file. The program will stop\r\n");
 		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_FILE_ERROR_STATE);
 		return XST_FAILURE;
@@ -175,14 +429,36 @@ int main(){
 	 */
 	for (i=0; i < NUM_ROWS_DATA; i ++){
 		for (j=0; j < NUM_COLUMNS_DATA; j ++){
-			fscanf (beats_file, "%lf ", &datas[j][i]);
+#if INPUT_READER == INPUT_READER_STDIO
+			if (fscanf(beats_stream, "%lf", &datas[j][i]) != 1) {
+				read_error = 1;
+			}
+#else
+			if (!file_scan_double(&beats_file, &datas[j][i])) {
+				beats_file.error = 1;
+			}
+#endif
 		}
 	}
-	if(ferror(beats_file)){
+
+	/*
+	 * Close file
+	 */
+#if INPUT_READER == INPUT_READER_STDIO
+	fclose(beats_stream);
+	status = read_error ? XST_FAILURE : XST_SUCCESS;
+#else
+	status = file_scan_close(&beats_file);
+#endif
+#if FILE_SYSTEM_STATS
+	mfs_print_stats();
+#endif
+	if (status != XST_SUCCESS) {
 		print("Error reading file. The program will stop\r\n");
 		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_FILE_ERROR_STATE);
 		return XST_FAILURE;
 	}
+	BOOT_TRACE_MARK(BOOT_TRACE_RECORD_LOAD);
 
 	/*
 	 * Data processing.
@@ -209,36 +485,31 @@ int main(){
 				NUM_ROWS_RESULT,
 				NUM_COLUMNS_BEAT);
 
+		/*
+		 * Without the UART interrupt the TX buffer only drains when it
+		 * is polled: top up the UART FIFO right before and after the
+		 * network, so it keeps sending while the network runs.
+		 */
+		uart_tx_poll();
 		RNA35b(inputs, outputs);
+		uart_tx_poll();
 
 		/*
-		 * Analyze the ANN output data. Find & save the max value in the ANN's
-		 * output data array and its index.
+		 * Analyze the ANN output data. The beat classification depends on the
+		 * max value index in the ANN's output data array. After decoding the
+		 * beat type, queue it for UART.
 		 */
 		for (j=0; j<NUM_COLUMNS_BEAT; j++){
-			for (i=0, max_value=0.0, max_value_pos=0; i < NUM_ROWS_RESULT; i ++){
-				if (outputs->data[i] > max_value){
-					max_value = outputs->data[i];
-					max_value_pos = i;
-				}
-			}
+			max_value_pos = beat_class_decode(&outputs->data[j * NUM_ROWS_RESULT]);
+			send_class(max_value_pos,
+					outputs->data[j * NUM_ROWS_RESULT + max_value_pos]);
+		}
 
-			/*
-			 * The beat classification depends on the max value index in
-			 * the ANN's output data array. After decoding the beat type, send it
-			 * through UART.
-			 */
-			if (max_value_pos == 0){
-				print(" N Normal Beat\r\n");
-			} else if (max_value_pos == 1){
-				print("S Supraventricular Ectopic Beat\r\n");
-			} else if (max_value_pos == 2){
-				print("V Ventricular Ectopic Beat\r\n");
-			} else if (max_value_pos == 3){
-				print("F Fusion Beat\r\n");
-			}  else if(max_value_pos == 4){
-				print("S Unknown Beat\r\n");}
+#if BOOT_TRACE
+		if (input_processed == 0) {
+			BOOT_TRACE_MARK(BOOT_TRACE_FIRST_BEAT);
 		}
+#endif
 
 		/*
 		 * Increase processed data counter.
@@ -253,14 +524,12 @@ int main(){
 	}
 
 	/*
-	 * Close file
+	 * Wait until every classification has left the TX buffer.
 	 */
-	status = fclose(beats_file);
-	if (status!=0) {
-		print("Error closing file. The program will stop\r\n");
-		XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_FILE_ERROR_STATE);
-		return XST_FAILURE;
-	}
+#if RESULT_FORMAT == RESULT_FORMAT_BINARY
+	result_encoder_flush(&result_encoder);
+#endif
+	uart_tx_flush();
 
 	/*
 	 * free all dynamic memory
@@ -283,7 +552,12 @@ int main(){
 	/*
 	 * Final
 	 */
+#if BOOT_TRACE
+	boot_trace_print();
+#endif
 	print("The program has finished successfully\r\n");
 	XGpio_DiscreteWrite(&led,LED_CHANNEL,LED_SUCCESS_STATE);
 	return XST_SUCCESS;
+#endif
+#endif
 }
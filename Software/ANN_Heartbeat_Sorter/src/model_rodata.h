@@ -0,0 +1,31 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Placement of the constant tables of the network (weights, biases and
+ * input mapping of RNA35b.c) in their own .model_rodata section. With
+ * lscript.ld the section is part of .rodata and is loaded to DDR with the
+ * rest of the application. With lscript_xip.ld it is linked at the top of
+ * the flash (0x89F00000), where it is read in place: it is programmed to
+ * flash on its own, and the bootloader does not copy it (BL_XIP in
+ * bootloader/src/blconfig.h). See lscript_xip.ld for what each costs.
+ *
+ * @file model_rodata.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef MODEL_RODATA_H
+#define MODEL_RODATA_H
+
+#ifdef __GNUC__
+#define MODEL_RODATA	__attribute__((section(".model_rodata")))
+#else
+#define MODEL_RODATA
+#endif
+
+#endif /* MODEL_RODATA_H */
@@ -0,0 +1,140 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Encoder of the compact binary result protocol.
+ *
+ * @file result_proto.c
+ *
+ * @version %G%
+ *
+ */
+
+#include "result_proto.h"
+
+unsigned short result_crc16(const unsigned char *data, unsigned int len){
+	unsigned short crc = 0xFFFF;
+	int i;
+
+	while (len-- > 0) {
+		crc ^= (unsigned short)(*data++ << 8);
+		for (i=0; i < 8; i++){
+			crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021)
+			                     : (unsigned short)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/*
+ * Start a new frame whose first beat is the next one.
+ */
+static void result_frame_open(result_encoder_t *enc){
+	enc->frame_beats = 0;
+	enc->payload_len = 0;
+}
+
+/*
+ * Close the open run into the payload.
+ */
+static void result_run_close(result_encoder_t *enc){
+	unsigned char *payload = &enc->frame[RESULT_HEADER_SIZE];
+
+	if (enc->run_len == 0) {
+		return;
+	}
+	payload[enc->payload_len++] = RESULT_RUN_BYTE(enc->run_class, enc->run_len);
+	if (enc->flags & RESULT_FLAG_CONFIDENCE) {
+		payload[enc->payload_len++] = (unsigned char) enc->run_conf;
+	}
+	enc->run_class = -1;
+	enc->run_len = 0;
+}
+
+void result_encoder_init(result_encoder_t *enc, result_write_fn write,
+		unsigned int flags, unsigned int max_beats){
+	enc->write = write;
+	enc->flags = flags;
+	enc->max_beats = max_beats ? max_beats : 1;
+	enc->frame_seq = 0;
+	enc->beat_seq = 0;
+	enc->run_class = -1;
+	enc->run_len = 0;
+	enc->run_conf = 0;
+	result_frame_open(enc);
+}
+
+void result_encoder_flush(result_encoder_t *enc){
+	unsigned char *f = enc->frame;
+	unsigned long first_beat = enc->beat_seq - enc->frame_beats;
+	unsigned short crc;
+	unsigned int len;
+
+	result_run_close(enc);
+	if (enc->frame_beats == 0) {
+		return;
+	}
+	f[0] = RESULT_FRAME_SYNC;
+	f[1] = (unsigned char) enc->flags;
+	f[2] = (unsigned char) enc->frame_seq;
+	f[3] = (unsigned char)(enc->frame_seq >> 8);
+	f[4] = (unsigned char) first_beat;
+	f[5] = (unsigned char)(first_beat >> 8);
+	f[6] = (unsigned char)(first_beat >> 16);
+	f[7] = (unsigned char)(first_beat >> 24);
+	f[8] = (unsigned char) enc->payload_len;
+	len = RESULT_HEADER_SIZE + enc->payload_len;
+	crc = result_crc16(&f[1], len - 1);
+	f[len++] = (unsigned char)(crc >> 8);
+	f[len++] = (unsigned char) crc;
+
+	enc->write((const char *) f, len);
+	enc->frame_seq++;
+	result_frame_open(enc);
+}
+
+void result_encoder_set_seq(result_encoder_t *enc, unsigned long beat_seq){
+	if (beat_seq != enc->beat_seq) {
+		result_encoder_flush(enc);
+		enc->beat_seq = beat_seq;
+	}
+}
+
+void result_encoder_put(result_encoder_t *enc, int beat_class, double confidence){
+	unsigned int run_size = (enc->flags & RESULT_FLAG_CONFIDENCE) ? 2 : 1;
+	unsigned int conf;
+
+	if (confidence <= 0.0) {
+		conf = 0;
+	} else if (confidence >= 1.0) {
+		conf = 255;
+	} else {
+		conf = (unsigned int)(confidence * 255.0 + 0.5);
+	}
+
+	if (beat_class == enc->run_class && enc->run_len < RESULT_RUN_MAX) {
+		enc->run_len++;
+		if (conf < enc->run_conf) {
+			enc->run_conf = conf;
+		}
+	} else {
+		result_run_close(enc);
+		/*
+		 * The new run must fit in the payload next to the closed ones.
+		 */
+		if (enc->payload_len + run_size > RESULT_PAYLOAD_MAX) {
+			result_encoder_flush(enc);
+		}
+		enc->run_class = beat_class;
+		enc->run_len = 1;
+		enc->run_conf = conf;
+	}
+	enc->frame_beats++;
+	enc->beat_seq++;
+	if (enc->frame_beats >= enc->max_beats) {
+		result_encoder_flush(enc);
+	}
+}
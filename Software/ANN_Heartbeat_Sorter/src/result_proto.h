@@ -0,0 +1,106 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Compact binary result protocol. Instead of one text line per beat, the
+ * beat classes are sent as run-length coded frames:
+ *
+ *   offset  size  field
+ *   0       1     RESULT_FRAME_SYNC
+ *   1       1     flags (RESULT_FLAG_*)
+ *   2       2     frame sequence number, little endian
+ *   4       4     sequence number of the first beat in the frame, l.e.
+ *   8       1     payload length in bytes
+ *   9       n     payload: one run byte per run of equal classes, each
+ *                 followed by a confidence byte if RESULT_FLAG_CONFIDENCE
+ *   9+n     2     CRC-16/CCITT (poly 0x1021, init 0xFFFF) of bytes 1..8+n,
+ *                 big endian
+ *
+ * Run byte: class code (0..4, see beat_class.h) in the 3 high bits and the
+ * run length minus one (1..32 beats) in the 5 low bits. Confidence byte:
+ * the lowest winning ANN output of the run, quantized to 0..255.
+ *
+ * @file result_proto.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef RESULT_PROTO_H
+#define RESULT_PROTO_H
+
+#define RESULT_FRAME_SYNC       0xC5
+#define RESULT_FLAG_CONFIDENCE  0x01
+
+#define RESULT_HEADER_SIZE      9
+#define RESULT_CRC_SIZE         2
+#define RESULT_PAYLOAD_MAX      254
+#define RESULT_FRAME_MAX        (RESULT_HEADER_SIZE + RESULT_PAYLOAD_MAX + RESULT_CRC_SIZE)
+
+#define RESULT_RUN_MAX          32
+#define RESULT_RUN_BYTE(cls, len)   ((unsigned char)(((cls) << 5) | ((len) - 1)))
+#define RESULT_RUN_CLASS(b)     (((b) >> 5) & 0x07)
+#define RESULT_RUN_LENGTH(b)    (((b) & 0x1F) + 1)
+
+/*
+ * Output function the encoder sends each finished frame to.
+ */
+typedef unsigned int (*result_write_fn)(const char *data, unsigned int len);
+
+typedef struct {
+	result_write_fn write;
+	unsigned int flags;
+	unsigned int max_beats;         /* beats per frame before it is sent */
+	unsigned short frame_seq;       /* sequence number of the next frame */
+	unsigned long beat_seq;         /* sequence number of the next beat */
+	unsigned int frame_beats;       /* beats in the current frame */
+	unsigned int payload_len;
+	int run_class;                  /* class of the open run, -1 if none */
+	unsigned int run_len;
+	unsigned int run_conf;
+	unsigned char frame[RESULT_FRAME_MAX];
+} result_encoder_t;
+
+/**
+ * Initialize an encoder.
+ * @function    result_encoder_init()
+ *
+ * @param       enc         encoder
+ * @param       write       where finished frames are written
+ * @param       flags       RESULT_FLAG_* options
+ * @param       max_beats   a frame is sent at least every max_beats beats
+ */
+void result_encoder_init(result_encoder_t *enc, result_write_fn write,
+		unsigned int flags, unsigned int max_beats);
+
+/**
+ * Add the classification of the next beat.
+ * @function    result_encoder_put()
+ *
+ * @param       enc         encoder
+ * @param       beat_class  class code, 0..BEAT_NUM_CLASSES-1
+ * @param       confidence  ANN output of the winning class, 0.0..1.0
+ */
+void result_encoder_put(result_encoder_t *enc, int beat_class, double confidence);
+
+/**
+ * Set the sequence number of the next beat, for beats that arrive with
+ * their own numbers. The current frame is sent first if the number does
+ * not follow on from it.
+ */
+void result_encoder_set_seq(result_encoder_t *enc, unsigned long beat_seq);
+
+/**
+ * Send the current frame, if it holds any beat.
+ */
+void result_encoder_flush(result_encoder_t *enc);
+
+/**
+ * CRC-16/CCITT used by the frames.
+ */
+unsigned short result_crc16(const unsigned char *data, unsigned int len);
+
+#endif /* RESULT_PROTO_H */
@@ -0,0 +1,202 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Buffered UART input through an RX ring buffer.
+ *
+ * The free part of the ring after "head" is lent to the UART Lite driver
+ * with XUartLite_Recv(), one contiguous run at a time ("armed" bytes). The
+ * receive handler is only called when the whole run has arrived, so the
+ * reader also counts the bytes the driver has already stored in the run
+ * (RequestedBytes - RemainingBytes) and does not wait for it to fill up.
+ * The receive handler is the only writer of "head" and "armed" and the
+ * main loop is the only writer of "tail".
+ *
+ * @file uart_rx.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <string.h>
+#include <xparameters.h>
+#include <xstatus.h>
+#include "uart_rx.h"
+
+#if defined(__MICROBLAZE__) && XPAR_MICROBLAZE_0_USE_INTERRUPT
+#include <mb_interface.h>
+#define UART_RX_INTERRUPTS      1
+#define UART_RX_LOCK()          microblaze_disable_interrupts()
+#define UART_RX_UNLOCK()        microblaze_enable_interrupts()
+#else
+#define UART_RX_INTERRUPTS      0
+#define UART_RX_LOCK()
+#define UART_RX_UNLOCK()
+#endif
+
+#define UART_RX_MASK            (UART_RX_BUFFER_SIZE - 1)
+
+#if (UART_RX_BUFFER_SIZE & UART_RX_MASK) != 0
+#error "UART_RX_BUFFER_SIZE must be a power of two"
+#endif
+
+static struct {
+	XUartLite *uart;
+	volatile unsigned int head;         /* end of the completed runs */
+	volatile unsigned int tail;         /* next byte to read */
+	volatile unsigned int armed;        /* bytes lent to the driver at head */
+	uart_rx_stats_t stats;
+	u8 buffer[UART_RX_BUFFER_SIZE];
+} rx;
+
+/*
+ * Lend the next contiguous free run of the ring to the driver. Called with
+ * the UART interrupt masked or from the receive handler.
+ */
+static void uart_rx_start(void){
+	unsigned int pos, n, got;
+
+	while (rx.armed == 0) {
+		pos = rx.head & UART_RX_MASK;
+		n = UART_RX_BUFFER_SIZE - (rx.head - rx.tail);
+		if (n == 0) {
+			/*
+			 * Left in the FIFO until the reader makes room.
+			 */
+			rx.stats.ring_full++;
+			return;
+		}
+		if (n > UART_RX_BUFFER_SIZE - pos) {
+			n = UART_RX_BUFFER_SIZE - pos;
+		}
+		rx.armed = n;
+		got = XUartLite_Recv(rx.uart, &rx.buffer[pos], n);
+		if (got < n) {
+			return;
+		}
+		/*
+		 * The FIFO already held the whole run. The driver does not call
+		 * the handler for it, so account for it here.
+		 */
+		rx.head += n;
+		rx.stats.bytes_received += n;
+		rx.armed = 0;
+	}
+}
+
+/*
+ * UART Lite receive handler: the armed run is full.
+ */
+static void uart_rx_recv_handler(void *CallBackRef, unsigned int ByteCount){
+	(void) CallBackRef;
+	(void) ByteCount;
+	/*
+	 * The driver also calls the handler when data arrives with no run
+	 * armed, repeating the count of the last run.
+	 */
+	if (rx.armed == 0) {
+		return;
+	}
+	rx.head += rx.armed;
+	rx.stats.bytes_received += rx.armed;
+	rx.armed = 0;
+	uart_rx_start();
+}
+
+/*
+ * Bytes stored so far: completed runs plus the filled part of the armed
+ * one.
+ */
+static unsigned int uart_rx_received(void){
+	unsigned int received;
+
+	UART_RX_LOCK();
+	received = rx.head;
+	if (rx.armed != 0) {
+		received += rx.uart->ReceiveBuffer.RequestedBytes -
+				rx.uart->ReceiveBuffer.RemainingBytes;
+	}
+	UART_RX_UNLOCK();
+	return received;
+}
+
+int uart_rx_init(XUartLite *uart){
+	if (uart == NULL) {
+		return XST_FAILURE;
+	}
+	rx.uart = uart;
+	rx.head = 0;
+	rx.tail = 0;
+	rx.armed = 0;
+	memset(&rx.stats, 0, sizeof(rx.stats));
+
+	XUartLite_SetRecvHandler(uart, uart_rx_recv_handler, &rx);
+	XUartLite_EnableInterrupt(uart);
+	UART_RX_LOCK();
+	uart_rx_start();
+	UART_RX_UNLOCK();
+#if UART_RX_INTERRUPTS
+	/*
+	 * As in uart_tx.c, the UART interrupt is taken to be wired straight
+	 * to the MicroBlaze; with an xps_intc use XIntc_Connect() instead.
+	 */
+	microblaze_register_handler((XInterruptHandler)XUartLite_InterruptHandler, uart);
+	microblaze_enable_interrupts();
+#endif
+	return XST_SUCCESS;
+}
+
+void uart_rx_poll(void){
+#if !UART_RX_INTERRUPTS
+	XUartLite_InterruptHandler(rx.uart);
+#endif
+}
+
+unsigned int uart_rx_read(char *data, unsigned int len){
+	unsigned int avail, pos, n;
+
+	uart_rx_poll();
+	avail = uart_rx_received() - rx.tail;
+	if (avail > rx.stats.high_water) {
+		rx.stats.high_water = avail;
+	}
+	if (len > avail) {
+		len = avail;
+	}
+
+	/*
+	 * Copy out in at most two pieces, then release the room.
+	 */
+	pos = rx.tail & UART_RX_MASK;
+	n = len;
+	if (n > UART_RX_BUFFER_SIZE - pos) {
+		n = UART_RX_BUFFER_SIZE - pos;
+	}
+	memcpy(data, &rx.buffer[pos], n);
+	memcpy(data + n, &rx.buffer[0], len - n);
+	rx.tail += len;
+	rx.stats.bytes_read += len;
+
+	UART_RX_LOCK();
+	if (rx.armed == 0) {
+		uart_rx_start();
+	}
+	UART_RX_UNLOCK();
+	return len;
+}
+
+unsigned int uart_rx_available(void){
+	uart_rx_poll();
+	return uart_rx_received() - rx.tail;
+}
+
+void uart_rx_get_stats(uart_rx_stats_t *stats){
+	*stats = rx.stats;
+}
+
+void uart_rx_clear_stats(void){
+	memset(&rx.stats, 0, sizeof(rx.stats));
+}
@@ -0,0 +1,80 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Buffered UART input. The UART Lite receive handler moves incoming bytes
+ * from the 16 byte RX FIFO into an RX ring buffer, where the main loop
+ * reads them at its own pace. If the UART interrupt is not wired to the
+ * processor (XPAR_MICROBLAZE_0_USE_INTERRUPT == 0) the handler is run from
+ * uart_rx_poll(), which every read calls first; the FIFO must then be
+ * polled at least every 16 character times or bytes are lost (counted by
+ * the driver as receive overruns).
+ *
+ * @file uart_rx.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <xuartlite.h>
+
+/*
+ * RX ring buffer size in bytes. Must be a power of two.
+ */
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE     1024
+#endif
+
+/*
+ * RX ring buffer statistics.
+ */
+typedef struct {
+	u32 bytes_received;     /* bytes moved from the FIFO to the ring */
+	u32 bytes_read;         /* bytes taken by uart_rx_read() */
+	u32 ring_full;          /* times the ring had no room for the FIFO */
+	u32 high_water;         /* max bytes ever waiting in the ring */
+} uart_rx_stats_t;
+
+/**
+ * Attach the RX ring buffer to an initialized UART Lite instance and
+ * start receiving.
+ * @function    uart_rx_init()
+ *
+ * @param       uart        UART Lite instance, already initialized
+ *
+ * @return      XST_SUCCESS or XST_FAILURE on bad arguments
+ */
+int uart_rx_init(XUartLite *uart);
+
+/**
+ * Take received bytes from the ring buffer without waiting.
+ * @function    uart_rx_read()
+ *
+ * @param       data        where the bytes are copied
+ * @param       len         max number of bytes
+ *
+ * @return      number of bytes copied, 0 if none has arrived
+ */
+unsigned int uart_rx_read(char *data, unsigned int len);
+
+/**
+ * Service the UART when its interrupt is not connected. Does nothing when
+ * the UART runs on interrupts.
+ */
+void uart_rx_poll(void);
+
+/**
+ * Number of bytes waiting in the ring buffer.
+ */
+unsigned int uart_rx_available(void);
+
+void uart_rx_get_stats(uart_rx_stats_t *stats);
+void uart_rx_clear_stats(void);
+
+#endif /* UART_RX_H */
@@ -0,0 +1,178 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Non-blocking UART output through a TX ring buffer.
+ *
+ * The main loop is the only writer of "head" and the send handler is the
+ * only writer of "tail". The bytes in [tail, tail + in_flight) are owned by
+ * the UART Lite driver until it reports them sent.
+ *
+ * @file uart_tx.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <string.h>
+#include <xparameters.h>
+#include <xstatus.h>
+#include "uart_tx.h"
+
+#if defined(__MICROBLAZE__) && XPAR_MICROBLAZE_0_USE_INTERRUPT
+#include <mb_interface.h>
+#define UART_TX_INTERRUPTS      1
+#define UART_TX_LOCK()          microblaze_disable_interrupts()
+#define UART_TX_UNLOCK()        microblaze_enable_interrupts()
+#else
+#define UART_TX_INTERRUPTS      0
+#define UART_TX_LOCK()
+#define UART_TX_UNLOCK()
+#endif
+
+#define UART_TX_MASK            (UART_TX_BUFFER_SIZE - 1)
+
+#if (UART_TX_BUFFER_SIZE & UART_TX_MASK) != 0
+#error "UART_TX_BUFFER_SIZE must be a power of two"
+#endif
+
+static struct {
+	XUartLite *uart;
+	int policy;
+	volatile unsigned int head;         /* next byte to write */
+	volatile unsigned int tail;         /* next byte to send */
+	volatile unsigned int in_flight;    /* bytes owned by the driver */
+	uart_tx_stats_t stats;
+	u8 buffer[UART_TX_BUFFER_SIZE];
+} tx;
+
+/*
+ * Hand the next contiguous run of queued bytes to the driver. Called with
+ * the UART interrupt masked or from the send handler.
+ */
+static void uart_tx_start(void){
+	unsigned int pos = tx.tail & UART_TX_MASK;
+	unsigned int n = tx.head - tx.tail;
+
+	if (n == 0) {
+		return;
+	}
+	if (n > UART_TX_BUFFER_SIZE - pos) {
+		n = UART_TX_BUFFER_SIZE - pos;
+	}
+	tx.in_flight = n;
+	XUartLite_Send(tx.uart, &tx.buffer[pos], n);
+}
+
+/*
+ * UART Lite send handler: the previous run has left the buffer.
+ */
+static void uart_tx_send_handler(void *CallBackRef, unsigned int ByteCount){
+	(void) CallBackRef;
+	tx.tail += ByteCount;
+	tx.stats.bytes_sent += ByteCount;
+	tx.in_flight = 0;
+	uart_tx_start();
+}
+
+int uart_tx_init(XUartLite *uart, int policy){
+	if (uart == NULL || (policy != UART_TX_DROP && policy != UART_TX_BLOCK)) {
+		return XST_FAILURE;
+	}
+	tx.uart = uart;
+	tx.policy = policy;
+	tx.head = 0;
+	tx.tail = 0;
+	tx.in_flight = 0;
+	memset(&tx.stats, 0, sizeof(tx.stats));
+
+	XUartLite_SetSendHandler(uart, uart_tx_send_handler, &tx);
+	XUartLite_EnableInterrupt(uart);
+#if UART_TX_INTERRUPTS
+	/*
+	 * The UART interrupt is taken to be wired straight to the interrupt
+	 * input of the MicroBlaze, as system.mhs has no xps_intc. With an
+	 * interrupt controller, register XUartLite_InterruptHandler with
+	 * XIntc_Connect() instead.
+	 */
+	microblaze_register_handler((XInterruptHandler)XUartLite_InterruptHandler, uart);
+	microblaze_enable_interrupts();
+#endif
+	return XST_SUCCESS;
+}
+
+void uart_tx_poll(void){
+#if !UART_TX_INTERRUPTS
+	XUartLite_InterruptHandler(tx.uart);
+#endif
+}
+
+unsigned int uart_tx_write(const char *data, unsigned int len){
+	unsigned int used, pos, n;
+
+	uart_tx_poll();
+	used = tx.head - tx.tail;
+	if (len > UART_TX_BUFFER_SIZE - used) {
+		if (tx.policy == UART_TX_BLOCK && len <= UART_TX_BUFFER_SIZE) {
+			tx.stats.writes_blocked++;
+			do {
+				uart_tx_poll();
+				used = tx.head - tx.tail;
+			} while (len > UART_TX_BUFFER_SIZE - used);
+		} else {
+			tx.stats.bytes_dropped += len;
+			tx.stats.writes_dropped++;
+			return 0;
+		}
+	}
+
+	/*
+	 * Copy in at most two pieces, then publish the new head.
+	 */
+	pos = tx.head & UART_TX_MASK;
+	n = len;
+	if (n > UART_TX_BUFFER_SIZE - pos) {
+		n = UART_TX_BUFFER_SIZE - pos;
+	}
+	memcpy(&tx.buffer[pos], data, n);
+	memcpy(&tx.buffer[0], data + n, len - n);
+	tx.head += len;
+
+	tx.stats.bytes_queued += len;
+	used += len;
+	if (used > tx.stats.high_water) {
+		tx.stats.high_water = used;
+	}
+
+	UART_TX_LOCK();
+	if (tx.in_flight == 0) {
+		uart_tx_start();
+	}
+	UART_TX_UNLOCK();
+	return len;
+}
+
+unsigned int uart_tx_print(const char *str){
+	return uart_tx_write(str, strlen(str));
+}
+
+void uart_tx_flush(void){
+	while (tx.head != tx.tail) {
+		uart_tx_poll();
+	}
+}
+
+unsigned int uart_tx_pending(void){
+	return tx.head - tx.tail;
+}
+
+void uart_tx_get_stats(uart_tx_stats_t *stats){
+	*stats = tx.stats;
+}
+
+void uart_tx_clear_stats(void){
+	memset(&tx.stats, 0, sizeof(tx.stats));
+}
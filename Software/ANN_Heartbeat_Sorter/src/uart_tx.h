@@ -0,0 +1,102 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Non-blocking UART output. Writers copy their bytes into a TX ring buffer
+ * and return; the UART Lite send handler moves the ring contents to the
+ * UART FIFO from interrupt context. If the UART interrupt is not wired to
+ * the processor (XPAR_MICROBLAZE_0_USE_INTERRUPT == 0) the same handler is
+ * run from uart_tx_poll(), which every write calls first. On this board it
+ * is not wired, so long computations such as inference call uart_tx_poll()
+ * before and after them to keep the UART FIFO fed.
+ *
+ * @file uart_tx.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef UART_TX_H
+#define UART_TX_H
+
+#include <xuartlite.h>
+
+/*
+ * TX ring buffer size in bytes. Must be a power of two.
+ */
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE     1024
+#endif
+
+/*
+ * Overflow policies: what uart_tx_write() does when the bytes do not fit
+ * in the ring buffer.
+ * UART_TX_DROP    the whole write is discarded and counted in the stats.
+ * UART_TX_BLOCK   the caller waits until there is room. Writes larger than
+ *                 the ring buffer are still dropped.
+ */
+#define UART_TX_DROP            0
+#define UART_TX_BLOCK           1
+
+/*
+ * TX ring buffer statistics.
+ */
+typedef struct {
+	u32 bytes_queued;       /* bytes accepted by uart_tx_write() */
+	u32 bytes_sent;         /* bytes handed over to the UART FIFO */
+	u32 bytes_dropped;      /* bytes discarded by the UART_TX_DROP policy */
+	u32 writes_dropped;     /* writes discarded by the UART_TX_DROP policy */
+	u32 writes_blocked;     /* writes that had to wait for room */
+	u32 high_water;         /* max bytes ever waiting in the buffer */
+} uart_tx_stats_t;
+
+/**
+ * Attach the TX ring buffer to an initialized UART Lite instance.
+ * @function    uart_tx_init()
+ *
+ * @param       uart        UART Lite instance, already initialized
+ * @param       policy      UART_TX_DROP or UART_TX_BLOCK
+ *
+ * @return      XST_SUCCESS or XST_FAILURE on bad arguments
+ */
+int uart_tx_init(XUartLite *uart, int policy);
+
+/**
+ * Queue bytes for transmission without waiting for the UART.
+ * @function    uart_tx_write()
+ *
+ * @param       data        bytes to send
+ * @param       len         number of bytes
+ *
+ * @return      len if queued, 0 if dropped
+ */
+unsigned int uart_tx_write(const char *data, unsigned int len);
+
+/**
+ * Queue a NUL terminated string. Same as uart_tx_write().
+ */
+unsigned int uart_tx_print(const char *str);
+
+/**
+ * Service the UART when its interrupt is not connected. Does nothing when
+ * the UART runs on interrupts.
+ */
+void uart_tx_poll(void);
+
+/**
+ * Wait until every queued byte has been handed to the UART FIFO.
+ */
+void uart_tx_flush(void);
+
+/**
+ * Number of bytes waiting in the ring buffer.
+ */
+unsigned int uart_tx_pending(void);
+
+void uart_tx_get_stats(uart_tx_stats_t *stats);
+void uart_tx_clear_stats(void);
+
+#endif /* UART_TX_H */
@@ -0,0 +1,308 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host sender for UART ingestion (INPUT_SOURCE_UART in main.c). Reads
+ * beat records, sends each beat as a beat frame (src/beat_rx.h) to the
+ * board's serial port, or to the pty of ingest_sim, and reads back the
+ * result frames (src/result_proto.h). Prints the classes like the text
+ * result format and measures the end-to-end throughput and the latency
+ * of every beat, from the moment its frame is handed to the port to the
+ * moment its class is back. The latency therefore includes the line time
+ * of the beat frame and of the result frame.
+ *
+ * Build (from this directory):
+ *   gcc -O2 -I../src beat_send.c ../src/beat_rx.c ../src/result_proto.c
+ *       ../src/beat_class.c -o beat_send
+ *
+ * Usage:
+ *   beat_send [-b baud] [-w window] [-n beats] [-B] [-t timeout] device record...
+ *
+ *   -b  serial port speed when device is a tty (default 9600)
+ *   -w  beats sent ahead of their results (default 1). The board polls
+ *       its UART, so it loses input received during inference unless the
+ *       window is small enough for its 16 byte FIFO; 1 is always safe.
+ *   -n  beats per record (default 2600), layout as read by main.c
+ *   -B  records hold one beat (28 values) per line
+ *   -t  seconds without an answer before giving up (default 5)
+ *
+ * @file beat_send.c
+ *
+ * @version %G%
+ *
+ */
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "beat_class.h"
+#include "beat_rx.h"
+#include "result_proto.h"
+
+#define DEFAULT_BAUD            9600
+#define DEFAULT_RECORD_BEATS    2600
+#define DEFAULT_TIMEOUT         5
+
+static double *beats;           /* BEAT_NUM_FEATURES values per beat */
+static size_t num_beats, cap_beats;
+
+static int *classes;            /* -1 until the result arrives */
+static uint64_t *sent_ns;
+static uint64_t *done_ns;
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double *new_beat(void){
+	if (num_beats == cap_beats) {
+		cap_beats = cap_beats ? 2 * cap_beats : 4096;
+		beats = (double *) realloc(beats, cap_beats * BEAT_NUM_FEATURES * sizeof(double));
+	}
+	return &beats[num_beats++ * BEAT_NUM_FEATURES];
+}
+
+/*
+ * Read a record: BEAT_NUM_FEATURES rows of record_beats values (main.c
+ * layout) or one beat per line.
+ */
+static int load_record(const char *name, int record_beats, int beat_major){
+	size_t first = num_beats;
+	FILE *fp = fopen(name, "r");
+	int i, j, ok = 1;
+
+	if (fp == NULL) {
+		perror(name);
+		return 0;
+	}
+	if (beat_major) {
+		double v[BEAT_NUM_FEATURES];
+		for (;;) {
+			for (i=0; i < BEAT_NUM_FEATURES; i++){
+				if (fscanf(fp, "%lf", &v[i]) != 1) {
+					break;
+				}
+			}
+			if (i < BEAT_NUM_FEATURES) {
+				ok = (i == 0);
+				break;
+			}
+			memcpy(new_beat(), v, sizeof(v));
+		}
+	} else {
+		for (j=0; j < record_beats; j++){
+			new_beat();
+		}
+		for (i=0; i < BEAT_NUM_FEATURES && ok; i++){
+			for (j=0; j < record_beats; j++){
+				if (fscanf(fp, "%lf ", &beats[(first + j) * BEAT_NUM_FEATURES + i]) != 1) {
+					ok = 0;
+					break;
+				}
+			}
+		}
+	}
+	fclose(fp);
+	if (!ok) {
+		fprintf(stderr, "%s: short record\n", name);
+	}
+	return ok;
+}
+
+static int open_device(const char *name, unsigned long baud){
+	static const struct { unsigned long baud; speed_t speed; } speeds[] = {
+		{ 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+		{ 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 }
+	};
+	struct termios tio;
+	unsigned int i;
+	int fd;
+
+	fd = open(name, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(name);
+		exit(1);
+	}
+	if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		for (i=0; i < sizeof(speeds) / sizeof(speeds[0]); i++){
+			if (speeds[i].baud == baud) {
+				cfsetispeed(&tio, speeds[i].speed);
+				cfsetospeed(&tio, speeds[i].speed);
+			}
+		}
+		tcsetattr(fd, TCSANOW, &tio);
+		tcflush(fd, TCIOFLUSH);
+	}
+	return fd;
+}
+
+/*
+ * Incremental result frame decoder.
+ */
+static unsigned char rbuf[4 * RESULT_FRAME_MAX];
+static size_t rlen;
+static unsigned long results, crc_errors;
+
+static void take_results(uint64_t t){
+	size_t pos = 0;
+
+	while (rlen - pos >= RESULT_HEADER_SIZE + RESULT_CRC_SIZE) {
+		const unsigned char *f = &rbuf[pos];
+		unsigned int payload = f[8], i, run_size;
+		int n;
+		unsigned long beat;
+
+		if (f[0] != RESULT_FRAME_SYNC) {
+			pos++;
+			continue;
+		}
+		if (rlen - pos < RESULT_HEADER_SIZE + payload + RESULT_CRC_SIZE) {
+			break;
+		}
+		if (((f[RESULT_HEADER_SIZE + payload] << 8) | f[RESULT_HEADER_SIZE + payload + 1]) !=
+				result_crc16(&f[1], RESULT_HEADER_SIZE - 1 + payload)) {
+			crc_errors++;
+			pos++;
+			continue;
+		}
+		beat = (unsigned long) f[4] | ((unsigned long) f[5] << 8) |
+				((unsigned long) f[6] << 16) | ((unsigned long) f[7] << 24);
+		run_size = (f[1] & RESULT_FLAG_CONFIDENCE) ? 2 : 1;
+		for (i=0; i + run_size <= payload; i += run_size){
+			unsigned char run = f[RESULT_HEADER_SIZE + i];
+			for (n=0; n < RESULT_RUN_LENGTH(run); n++, beat++){
+				if (beat < num_beats && classes[beat] < 0) {
+					classes[beat] = RESULT_RUN_CLASS(run);
+					done_ns[beat] = t;
+					results++;
+				}
+			}
+		}
+		pos += RESULT_HEADER_SIZE + payload + RESULT_CRC_SIZE;
+	}
+	memmove(rbuf, &rbuf[pos], rlen - pos);
+	rlen -= pos;
+}
+
+int main(int argc, char *argv[]){
+	unsigned long baud = DEFAULT_BAUD, window = 1, timeout = DEFAULT_TIMEOUT;
+	int record_beats = DEFAULT_RECORD_BEATS, beat_major = 0, opt, fd;
+	unsigned char frame[BEAT_FRAME_SIZE];
+	size_t next = 0, i;
+	uint64_t start, last_answer, lat, lat_min = UINT64_MAX, lat_max = 0;
+	double lat_sum = 0.0;
+
+	while ((opt = getopt(argc, argv, "b:w:n:Bt:")) != -1) {
+		switch (opt) {
+		case 'b':
+			baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			window = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			record_beats = atoi(optarg);
+			break;
+		case 'B':
+			beat_major = 1;
+			break;
+		case 't':
+			timeout = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			optind = argc;
+		}
+	}
+	if (argc - optind < 2 || window == 0 || record_beats <= 0) {
+		fprintf(stderr, "usage: %s [-b baud] [-w window] [-n beats] [-B] [-t timeout]"
+				" device record...\n", argv[0]);
+		return 1;
+	}
+	for (opt=optind + 1; opt < argc; opt++){
+		if (!load_record(argv[opt], record_beats, beat_major)) {
+			return 1;
+		}
+	}
+	classes = (int *) malloc(num_beats * sizeof(int));
+	sent_ns = (uint64_t *) calloc(num_beats, sizeof(uint64_t));
+	done_ns = (uint64_t *) calloc(num_beats, sizeof(uint64_t));
+	for (i=0; i < num_beats; i++){
+		classes[i] = -1;
+	}
+
+	fd = open_device(argv[optind], baud);
+	start = last_answer = now_ns();
+	while (results < num_beats) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		uint64_t t;
+		ssize_t got;
+
+		/*
+		 * Keep "window" beats without a result on their way.
+		 */
+		while (next < num_beats && next - results < window) {
+			beat_frame_encode(frame, next, &beats[next * BEAT_NUM_FEATURES]);
+			sent_ns[next] = now_ns();
+			if (write(fd, frame, sizeof(frame)) != (ssize_t) sizeof(frame)) {
+				perror("write");
+				return 1;
+			}
+			next++;
+		}
+
+		if (poll(&pfd, 1, 100) > 0) {
+			got = read(fd, &rbuf[rlen], sizeof(rbuf) - rlen);
+			if (got > 0) {
+				unsigned long before = results;
+				rlen += got;
+				t = now_ns();
+				take_results(t);
+				if (results != before) {
+					last_answer = t;
+				}
+			}
+		}
+		if (now_ns() - last_answer > timeout * 1000000000ULL) {
+			fprintf(stderr, "no answer for %lu s, giving up\n", timeout);
+			break;
+		}
+	}
+
+	for (i=0; i < num_beats; i++){
+		if (classes[i] < 0) {
+			continue;
+		}
+		fputs(beat_class_text[classes[i]], stdout);
+		lat = done_ns[i] - sent_ns[i];
+		lat_sum += lat;
+		if (lat < lat_min) {
+			lat_min = lat;
+		}
+		if (lat > lat_max) {
+			lat_max = lat;
+		}
+	}
+	fprintf(stderr, "%lu of %lu beats classified in %.2f s: %.2f beats/s,"
+			" %lu bad result frames\n", results, (unsigned long) num_beats,
+			(now_ns() - start) / 1e9, results / ((now_ns() - start) / 1e9), crc_errors);
+	if (results > 0) {
+		fprintf(stderr, "latency: min %.1f ms, avg %.1f ms, max %.1f ms\n",
+				lat_min / 1e6, lat_sum / results / 1e6, lat_max / 1e6);
+	}
+	return results == num_beats ? 0 : 2;
+}
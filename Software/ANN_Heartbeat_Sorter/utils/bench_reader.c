@@ -0,0 +1,216 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host benchmark of the readers of the beat file load in main.c: the in
+ * place scanner (INPUT_READER_SCAN, src/file_scan.c) and fscanf on a stdio
+ * stream over MFS (INPUT_READER_STDIO, mfs_fopen) with buffers of several
+ * sizes, unbuffered as the slowest case. The file is loaded from a RAM file
+ * system the way main.c loads it, NUM_ROWS_DATA x NUM_COLUMNS_DATA values,
+ * and the time of a load and the values read are compared. Seeks of a
+ * stream to its end and back are checked first.
+ *
+ * Build (from this directory):
+ *   M=../../standalone_bsp/microblaze_0/libsrc/xilmfs_v1_00_a/src
+ *   gcc -O2 -I../src -I../../standalone_bsp/microblaze_0/include
+ *       bench_reader.c ../src/file_scan.c $M/mfs_filesys.c $M/mfs_stdio.c
+ *       -o bench_reader
+ *
+ * Usage:
+ *   bench_reader [beat_file]
+ *
+ * Without a file, a record of synthetic values in the format of the
+ * feature files is used.
+ *
+ * @file bench_reader.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "xstatus.h"
+#include "xilmfs.h"
+#include "mfs_stdio.h"
+#include "file_scan.h"
+
+#define NUM_COLUMNS_DATA        2600
+#define NUM_ROWS_DATA           28
+#define NUM_VALUES              (NUM_COLUMNS_DATA * NUM_ROWS_DATA)
+#define INPUT_DIR               "file_data"
+
+/*
+ * Loads timed for each reader.
+ */
+#define LOADS                   20
+
+static double values[NUM_VALUES];
+static double reference[NUM_VALUES];
+
+/*
+ * Load the record with the in place scanner, as main.c does.
+ */
+static int load_scan(void){
+	file_scan_t beats_file;
+	int i;
+
+	if (file_scan_open(&beats_file, INPUT_DIR) != XST_SUCCESS) {
+		return XST_FAILURE;
+	}
+	for (i=0; i < NUM_VALUES; i++){
+		if (!file_scan_double(&beats_file, &values[i])) {
+			beats_file.error = 1;
+		}
+	}
+	return file_scan_close(&beats_file);
+}
+
+/*
+ * Load the record with fscanf on an MFS stream with a buffer of buffer_size
+ * bytes: 0 for the buffer of mfs_fopen, -1 for none.
+ */
+static int load_stdio(int buffer_size){
+	static char buffer[65536];
+	FILE *beats_stream;
+	int i, error = 0;
+
+	beats_stream = mfs_fopen(INPUT_DIR, "r");
+	if (beats_stream == NULL) {
+		return XST_FAILURE;
+	}
+	if (buffer_size < 0) {
+		setvbuf(beats_stream, NULL, _IONBF, 0);
+	} else if (buffer_size > 0) {
+		setvbuf(beats_stream, buffer, _IOFBF, buffer_size);
+	}
+	for (i=0; i < NUM_VALUES; i++){
+		if (fscanf(beats_stream, "%lf", &values[i]) != 1) {
+			error = 1;
+		}
+	}
+	fclose(beats_stream);
+	return error ? XST_FAILURE : XST_SUCCESS;
+}
+
+/*
+ * Time LOADS loads with a reader, and check the values.
+ */
+static int bench(const char *name, int buffer_size, long file_size){
+	clock_t start;
+	double secs;
+	int i, status = XST_SUCCESS;
+
+	start = clock();
+	for (i=0; i < LOADS && status == XST_SUCCESS; i++){
+		memset(values, 0, sizeof(values));
+		status = (buffer_size == -2) ? load_scan() : load_stdio(buffer_size);
+	}
+	secs = (double) (clock() - start) / CLOCKS_PER_SEC / LOADS;
+	if (status != XST_SUCCESS || memcmp(values, reference, sizeof(values)) != 0) {
+		printf("%-28s values read are wrong\n", name);
+		return XST_FAILURE;
+	}
+	printf("%-28s %9.2f ms %9.1f MB/s\n", name, secs * 1e3, file_size / secs / 1e6);
+	return XST_SUCCESS;
+}
+
+/*
+ * Seek an MFS stream to the end of the record, which is larger than the
+ * stream buffer, and back from it.
+ */
+static int check_seek(const char *text, long file_size){
+	FILE *beats_stream;
+	int error = 0;
+
+	beats_stream = mfs_fopen(INPUT_DIR, "r");
+	if (beats_stream == NULL) {
+		return XST_FAILURE;
+	}
+	if (fgetc(beats_stream) != (unsigned char) text[0]
+	    || fseek(beats_stream, 0, SEEK_END) != 0
+	    || ftell(beats_stream) != file_size
+	    || fgetc(beats_stream) != EOF) {
+		printf("fseek to the end of the stream is wrong\n");
+		error = 1;
+	}
+	if (fseek(beats_stream, -1, SEEK_END) != 0
+	    || ftell(beats_stream) != file_size - 1
+	    || fgetc(beats_stream) != (unsigned char) text[file_size - 1]
+	    || fgetc(beats_stream) != EOF) {
+		printf("fseek back from the end of the stream is wrong\n");
+		error = 1;
+	}
+	if (fseek(beats_stream, file_size / 2, SEEK_SET) != 0
+	    || fgetc(beats_stream) != (unsigned char) text[file_size / 2]
+	    || fseek(beats_stream, file_size - file_size / 2 - 1, SEEK_CUR) != 0
+	    || ftell(beats_stream) != file_size
+	    || fgetc(beats_stream) != EOF
+	    || fseek(beats_stream, 1, SEEK_END) == 0) {
+		printf("fseek from the middle of the stream is wrong\n");
+		error = 1;
+	}
+	fclose(beats_stream);
+	return error ? XST_FAILURE : XST_SUCCESS;
+}
+
+int main(int argc, char *argv[]){
+	struct mfs_file_block *fs;
+	char *text;
+	long size = 0;
+	int blocks, fd, i, status = XST_SUCCESS;
+	char name[32];
+	static const int sizes[] = { 128, 1024, 16384 };
+
+	text = malloc(NUM_VALUES * 24 + 1);
+	if (argc > 1) {
+		FILE *f = fopen(argv[1], "rb");
+		if (f == NULL || text == NULL) {
+			perror(argv[1]);
+			return 1;
+		}
+		size = fread(text, 1, NUM_VALUES * 24, f);
+		fclose(f);
+	} else {
+		srand(1);
+		for (i=0; i < NUM_VALUES; i++){
+			size += sprintf(&text[size], "%.5f%s", (rand() % 200000 - 100000) / 1e5,
+					(i % NUM_COLUMNS_DATA == NUM_COLUMNS_DATA - 1) ? "\n" : " ");
+		}
+	}
+
+	/*
+	 * The record in a RAM file system, and the values it holds.
+	 */
+	blocks = size / MFS_BLOCK_DATA_SIZE + 16;
+	fs = malloc(blocks * sizeof(struct mfs_file_block));
+	mfs_init_fs(blocks * sizeof(struct mfs_file_block), (char *) fs, MFSINIT_NEW);
+	fd = mfs_file_open(INPUT_DIR, MFS_MODE_CREATE);
+	mfs_file_write(fd, text, size);
+	mfs_file_close(fd);
+	if (load_scan() != XST_SUCCESS) {
+		printf("%s does not hold %d values\n", argc > 1 ? argv[1] : "the record", NUM_VALUES);
+		return 1;
+	}
+	memcpy(reference, values, sizeof(values));
+
+	if (check_seek(text, size) != XST_SUCCESS) {
+		return 1;
+	}
+
+	printf("loading %d values, %ld bytes\n", NUM_VALUES, size);
+	status |= bench("file_scan", -2, size);
+	status |= bench("fscanf, unbuffered", -1, size);
+	for (i=0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++){
+		sprintf(name, "fscanf, %d byte buffer", sizes[i]);
+		status |= bench(name, sizes[i], size);
+	}
+	sprintf(name, "fscanf, mfs_fopen (%d)", MFS_STDIO_BUFFER_SIZE);
+	status |= bench(name, 0, size);
+	return status == XST_SUCCESS ? 0 : 1;
+}
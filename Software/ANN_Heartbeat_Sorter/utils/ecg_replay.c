@@ -0,0 +1,377 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host driver of the streaming feature extractor (src/ecg_features.c).
+ * Pushes raw ECG samples through the extractor and the RNA35b network,
+ * one sample at a time as the board would, and prints the class of every
+ * beat found. It measures the cost per sample, and validates the result
+ * against offline data:
+ *
+ *   -r  an offline feature file of the same record (one beat of 28
+ *       values per line): per-feature deviation, in percent of the
+ *       feature's training range, and agreement of the classes;
+ *   -R  the reference R peak positions (one sample index per line, e.g.
+ *       the beat annotations of an MIT-BIH record): detection sensitivity
+ *       and positive predictivity within 150 ms.
+ *
+ * Without an input file (-s) a synthetic ECG with known R peaks is
+ * generated, including premature and wide beats, baseline wander and
+ * noise.
+ *
+ * Build (from this directory):
+ *   gcc -O2 -I../src ecg_replay.c ../src/ecg_features.c ../src/beat_class.c
+ *       ../src/RNA35b*.c ../src/rt*.c -o ecg_replay -lm
+ *
+ * Usage:
+ *   ecg_replay [options] ecg.txt
+ *   ecg_replay [options] -s seconds
+ *
+ *   -c  column of the samples in ecg.txt (default 0); other columns,
+ *       such as a leading sample number, are ignored
+ *   -p  samples are in mV rather than ADC units
+ *   -z  ADC value of 0 mV (default 1024)
+ *   -g  ADC units per mV (default 200)
+ *   -o  write the feature vectors to this file, one beat per line
+ *   -r  offline feature file to compare with
+ *   -R  reference R peak positions
+ *
+ * @file ecg_replay.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "RNA35b.h"
+#include "RNA35b_emxAPI.h"
+#include "RNA35b_initialize.h"
+#include "beat_class.h"
+#include "ecg_features.h"
+
+#define DEFAULT_ADC_ZERO        1024
+#define DEFAULT_UNITS_PER_MV    200.0
+#define MATCH_WINDOW            54      /* 150 ms */
+
+/*
+ * Growing arrays.
+ */
+typedef struct {
+	void *data;
+	size_t len;
+	size_t cap;
+	size_t size;
+} vec_t;
+
+static void *vec_push(vec_t *v){
+	if (v->len == v->cap) {
+		v->cap = v->cap ? 2 * v->cap : 1024;
+		v->data = realloc(v->data, v->cap * v->size);
+	}
+	return (char *) v->data + v->len++ * v->size;
+}
+
+static vec_t samples = { NULL, 0, 0, sizeof(int) };
+static vec_t truth = { NULL, 0, 0, sizeof(unsigned long) };
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double frand(void){
+	return (double) rand() / RAND_MAX;
+}
+
+static double gauss(double t, double mu, double sigma){
+	return exp(-0.5 * (t - mu) * (t - mu) / (sigma * sigma));
+}
+
+/*
+ * Synthetic ECG: a sum of Gaussian waves per beat. One beat in eight is
+ * premature and one in twelve is wide with no P wave.
+ */
+static void synthesize(double seconds, int adc_zero, double units_per_mv){
+	size_t n = (size_t)(seconds * ECG_SAMPLE_RATE), i;
+	double *ecg = (double *) calloc(n, sizeof(double));
+	double r = 0.5 * ECG_SAMPLE_RATE, rr = 0.8 * ECG_SAMPLE_RATE;
+	long beat = 0, a, b, j;
+
+	srand(7);
+	while (r < n - ECG_SAMPLE_RATE) {
+		int wide = (beat % 12 == 11);
+		double s = wide ? 3.0 : 1.0;
+
+		*(unsigned long *) vec_push(&truth) = (unsigned long)(r + 0.5);
+		a = (long) r - ECG_SAMPLE_RATE / 2;
+		b = (long) r + ECG_SAMPLE_RATE / 2;
+		for (j=a; j < b; j++){
+			double t = j;
+			double v = 0.0;
+			if (!wide) {
+				v += 0.15 * gauss(t, r - 0.2 * ECG_SAMPLE_RATE, 0.025 * ECG_SAMPLE_RATE);
+			}
+			v += -0.12 * gauss(t, r - 0.025 * s * ECG_SAMPLE_RATE, 0.008 * s * ECG_SAMPLE_RATE);
+			v += (wide ? 1.6 : 1.2) * gauss(t, r, 0.010 * s * ECG_SAMPLE_RATE);
+			v += -0.25 * gauss(t, r + 0.03 * s * ECG_SAMPLE_RATE, 0.010 * s * ECG_SAMPLE_RATE);
+			v += (wide ? -0.5 : 0.3) * gauss(t, r + 0.28 * ECG_SAMPLE_RATE, 0.05 * ECG_SAMPLE_RATE);
+			if (j >= 0 && (size_t) j < n) {
+				ecg[j] += v;
+			}
+		}
+		beat++;
+		rr += 0.05 * ECG_SAMPLE_RATE * (frand() - 0.5);
+		if (rr < 0.6 * ECG_SAMPLE_RATE || rr > 1.2 * ECG_SAMPLE_RATE) {
+			rr = 0.8 * ECG_SAMPLE_RATE;
+		}
+		r += (beat % 8 == 7) ? 0.65 * rr : rr;
+	}
+	for (i=0; i < n; i++){
+		double v = ecg[i] + 0.1 * sin(2.0 * M_PI * 0.3 * i / ECG_SAMPLE_RATE) +
+				0.02 * (frand() - 0.5);
+		*(int *) vec_push(&samples) = adc_zero + (int) lround(v * units_per_mv);
+	}
+	free(ecg);
+}
+
+static void load_samples(const char *name, int column, int physical,
+		int adc_zero, double units_per_mv){
+	char line[512];
+	FILE *fp = fopen(name, "r");
+
+	if (fp == NULL) {
+		perror(name);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *p = line, *end;
+		double v = 0.0;
+		int c;
+
+		for (c=0; c <= column; c++){
+			v = strtod(p, &end);
+			if (end == p) {
+				break;
+			}
+			p = end;
+		}
+		if (c <= column) {
+			continue;       /* header or short line */
+		}
+		*(int *) vec_push(&samples) = physical ?
+				adc_zero + (int) lround(v * units_per_mv) : (int) lround(v);
+	}
+	fclose(fp);
+}
+
+static void load_positions(const char *name){
+	FILE *fp = fopen(name, "r");
+	unsigned long r;
+
+	if (fp == NULL) {
+		perror(name);
+		exit(1);
+	}
+	while (fscanf(fp, "%lu", &r) == 1) {
+		*(unsigned long *) vec_push(&truth) = r;
+	}
+	fclose(fp);
+}
+
+static int classify(double *features){
+	double result[BEAT_NUM_CLASSES];
+	emxArray_real_T *in = emxCreateWrapper_real_T(features, BEAT_NUM_FEATURES, 1);
+	emxArray_real_T *out = emxCreateWrapper_real_T(result, BEAT_NUM_CLASSES, 1);
+	int c;
+
+	RNA35b(in, out);
+	c = beat_class_decode(result);
+	emxDestroyArray_real_T(in);
+	emxDestroyArray_real_T(out);
+	return c;
+}
+
+static void compare_features(const char *name, const vec_t *feats, const vec_t *classes){
+	double ref[BEAT_NUM_FEATURES], dev[BEAT_NUM_FEATURES] = { 0.0 };
+	double min, max;
+	size_t n = 0, agree = 0;
+	FILE *fp = fopen(name, "r");
+	int k;
+
+	if (fp == NULL) {
+		perror(name);
+		exit(1);
+	}
+	for (;;) {
+		for (k=0; k < BEAT_NUM_FEATURES; k++){
+			if (fscanf(fp, "%lf", &ref[k]) != 1) {
+				break;
+			}
+		}
+		if (k < BEAT_NUM_FEATURES || n >= feats->len) {
+			break;
+		}
+		for (k=0; k < BEAT_NUM_FEATURES; k++){
+			dev[k] += fabs(((double *) feats->data)[n * BEAT_NUM_FEATURES + k] - ref[k]);
+		}
+		agree += classify(ref) == ((int *) classes->data)[n];
+		n++;
+	}
+	fclose(fp);
+	if (n == 0) {
+		fprintf(stderr, "%s: no beats to compare\n", name);
+		return;
+	}
+	fprintf(stderr, "offline features: %lu beats compared (%lu extracted)\n",
+			(unsigned long) n, (unsigned long) feats->len);
+	fprintf(stderr, "mean deviation in %% of the training range:\n");
+	for (k=0; k < BEAT_NUM_FEATURES; k++){
+		ecg_feature_range(k, &min, &max);
+		fprintf(stderr, "  %2d:%5.1f", k, 100.0 * dev[k] / n / (max - min));
+		if (k % 7 == 6) {
+			fputc('\n', stderr);
+		}
+	}
+	fprintf(stderr, "class agreement: %.1f%%\n", 100.0 * agree / n);
+}
+
+static void compare_positions(const vec_t *found){
+	const unsigned long *ref = (const unsigned long *) truth.data;
+	const unsigned long *got = (const unsigned long *) found->data;
+	size_t i = 0, j = 0, tp = 0;
+
+	/*
+	 * Both lists are sorted: walk them together.
+	 */
+	while (i < truth.len && j < found->len) {
+		if (got[j] + MATCH_WINDOW < ref[i]) {
+			j++;
+		} else if (ref[i] + MATCH_WINDOW < got[j]) {
+			i++;
+		} else {
+			tp++;
+			i++;
+			j++;
+		}
+	}
+	/*
+	 * The extractor never reports the first detected beat (no pre-RR) nor
+	 * the last one (no post-RR); leave them out of the reference too.
+	 */
+	fprintf(stderr, "detection: %lu reference beats, %lu found, sensitivity %.2f%%,"
+			" positive predictivity %.2f%%\n", (unsigned long) truth.len,
+			(unsigned long) found->len,
+			truth.len > 2 ? 100.0 * tp / (truth.len - 2) : 0.0,
+			found->len ? 100.0 * tp / found->len : 0.0);
+}
+
+int main(int argc, char *argv[]){
+	static ecg_features_t ef;
+	vec_t feats = { NULL, 0, 0, BEAT_NUM_FEATURES * sizeof(double) };
+	vec_t classes = { NULL, 0, 0, sizeof(int) };
+	vec_t found = { NULL, 0, 0, sizeof(unsigned long) };
+	int column = 0, physical = 0, adc_zero = DEFAULT_ADC_ZERO, opt;
+	double units_per_mv = DEFAULT_UNITS_PER_MV, seconds = 0.0;
+	const char *out_name = NULL, *ref_name = NULL, *pos_name = NULL;
+	double features[BEAT_NUM_FEATURES];
+	uint64_t t0, t1, extract_ns = 0, classify_ns = 0, max_sample_ns = 0;
+	unsigned long r;
+	size_t i;
+	int k;
+	ecg_features_stats_t st;
+	FILE *out = NULL;
+
+	while ((opt = getopt(argc, argv, "c:pz:g:o:r:R:s:")) != -1) {
+		switch (opt) {
+		case 'c': column = atoi(optarg); break;
+		case 'p': physical = 1; break;
+		case 'z': adc_zero = atoi(optarg); break;
+		case 'g': units_per_mv = atof(optarg); break;
+		case 'o': out_name = optarg; break;
+		case 'r': ref_name = optarg; break;
+		case 'R': pos_name = optarg; break;
+		case 's': seconds = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-c col] [-p] [-z zero] [-g units] [-o out]"
+					" [-r features] [-R positions] ecg.txt | -s seconds\n", argv[0]);
+			return 1;
+		}
+	}
+	if (seconds > 0.0) {
+		synthesize(seconds, adc_zero, units_per_mv);
+	} else if (optind < argc) {
+		load_samples(argv[optind], column, physical, adc_zero, units_per_mv);
+		if (pos_name != NULL) {
+			load_positions(pos_name);
+		}
+	} else {
+		fprintf(stderr, "no input\n");
+		return 1;
+	}
+	if (out_name != NULL && (out = fopen(out_name, "w")) == NULL) {
+		perror(out_name);
+		return 1;
+	}
+
+	RNA35b_initialize();
+	ecg_features_init(&ef, adc_zero, units_per_mv);
+	for (i=0; i < samples.len; i++){
+		int beat;
+
+		t0 = now_ns();
+		beat = ecg_features_put(&ef, ((int *) samples.data)[i], features, &r);
+		t1 = now_ns();
+		extract_ns += t1 - t0;
+		if (t1 - t0 > max_sample_ns) {
+			max_sample_ns = t1 - t0;
+		}
+		if (!beat) {
+			continue;
+		}
+		*(unsigned long *) vec_push(&found) = r;
+		memcpy(vec_push(&feats), features, sizeof(features));
+		t0 = now_ns();
+		*(int *) vec_push(&classes) = classify(features);
+		classify_ns += now_ns() - t0;
+		fputs(beat_class_text[((int *) classes.data)[classes.len - 1]], stdout);
+		if (out != NULL) {
+			for (k=0; k < BEAT_NUM_FEATURES; k++){
+				fprintf(out, "%s%.5f", k ? " " : "", features[k]);
+			}
+			fputc('\n', out);
+		}
+	}
+	if (out != NULL) {
+		fclose(out);
+	}
+
+	ecg_features_get_stats(&ef, &st);
+	fprintf(stderr, "%lu samples (%.1f s), %lu beats, %lu detections (%lu by search-back),"
+			" %lu dropped, %lu features clamped\n", (unsigned long) samples.len,
+			(double) samples.len / ECG_SAMPLE_RATE, st.beats, st.detections,
+			st.searchbacks, st.dropped, st.clamped);
+	fprintf(stderr, "extraction: %.0f ns per sample on average, %.0f ns worst sample;"
+			" classification: %.0f ns per beat\n",
+			samples.len ? (double) extract_ns / samples.len : 0.0,
+			(double) max_sample_ns, st.beats ? (double) classify_ns / st.beats : 0.0);
+	fprintf(stderr, "real time budget at %d Hz: %.0f ns per sample\n",
+			ECG_SAMPLE_RATE, 1e9 / ECG_SAMPLE_RATE);
+	if (truth.len > 0) {
+		compare_positions(&found);
+	}
+	if (ref_name != NULL) {
+		compare_features(ref_name, &feats, &classes);
+	}
+	return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Board stand-in for UART ingestion. Runs the board's ingestion code
+ * (ingest.c, uart_rx.c, uart_tx.c over the UART Lite driver) on the
+ * simulated UART Lite, whose serial line is connected to a pseudo
+ * terminal. Host tools such as beat_send talk to the pty as they would to
+ * the board's serial port.
+ *
+ * The line runs in real time at the given baud rate, and the processor is
+ * polled like the board without interrupts: while the simulated inference
+ * runs (-d) nothing empties the 16 byte RX FIFO, so a host that does not
+ * wait for the results overruns it as the real board would.
+ *
+ * Build (from this directory):
+ *   U=../../standalone_bsp/microblaze_0/libsrc/uartlite_v2_01_a/src
+ *   gcc -O2 -Isim -I../src -I../../standalone_bsp/microblaze_0/include -I$U
+ *       ingest_sim.c uartlite_sim.c ../src/uart_rx.c ../src/uart_tx.c
+ *       ../src/beat_rx.c ../src/ingest.c ../src/result_proto.c
+ *       ../src/beat_class.c ../src/RNA35b*.c ../src/rt*.c
+ *       $U/xuartlite.c $U/xuartlite_intr.c $U/xuartlite_l.c $U/xuartlite_stats.c
+ *       -o ingest_sim -lm
+ *
+ * Usage:
+ *   ingest_sim [-b baud] [-d usec] [-f flags]
+ *
+ *   -b  line speed (default 9600)
+ *   -d  inference time of one beat on the board, in microseconds
+ *       (default 0)
+ *   -f  RESULT_FLAG_* options of the result frames (default 1)
+ *
+ * The pty name is printed on stdout. Counters are printed on stderr every
+ * few seconds while beats arrive.
+ *
+ * @file ingest_sim.c
+ *
+ * @version %G%
+ *
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "xuartlite.h"
+#include "RNA35b_initialize.h"
+#include "ingest.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "uartlite_sim.h"
+
+#define DEFAULT_BAUD            9600
+#define UART_BITS_PER_BYTE      10
+/*
+ * Ticks per character: large enough that the bus accesses of the polling
+ * loop do not speed up the line noticeably.
+ */
+#define CHARS_PERIOD            100000
+#define REPORT_PERIOD_NS        5000000000ULL
+
+static XUartLite uart;
+static XUartLite_Config uart_config = { 0, UARTLITE_SIM_BASEADDR, DEFAULT_BAUD, 0, 0, 8 };
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int open_pty(void){
+	struct termios tio;
+	int fd, slave;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+		perror("pty");
+		exit(1);
+	}
+	/*
+	 * Raw mode on the slave side, which stays open so that the master
+	 * does not see a hangup between clients.
+	 */
+	slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+	if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+		perror(ptsname(fd));
+		exit(1);
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	printf("%s\n", ptsname(fd));
+	fflush(stdout);
+	return fd;
+}
+
+int main(int argc, char *argv[]){
+	static u8 line_in[4096];
+	unsigned long baud = DEFAULT_BAUD, delay_us = 0;
+	unsigned int flags = 1;
+	uint64_t start, last_report, ns_per_char;
+	size_t out_sent = 0;
+	beat_rx_stats_t st;
+	unsigned long beats = 0, reported = 0;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "b:d:f:")) != -1) {
+		switch (opt) {
+		case 'b':
+			baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			delay_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			flags = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-b baud] [-d usec] [-f flags]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (baud == 0) {
+		return 1;
+	}
+	ns_per_char = 1000000000ULL * UART_BITS_PER_BYTE / baud;
+
+	RNA35b_initialize();
+	uartlite_sim_reset(CHARS_PERIOD);
+	uart_config.BaudRate = baud;
+	XUartLite_CfgInitialize(&uart, &uart_config, UARTLITE_SIM_BASEADDR);
+	uart_tx_init(&uart, UART_TX_BLOCK);
+	uart_rx_init(&uart);
+	ingest_init(flags);
+
+	fd = open_pty();
+	start = last_report = now_ns();
+	for (;;) {
+		uint64_t t = now_ns();
+		unsigned long due = (unsigned long)((t - start) * CHARS_PERIOD / ns_per_char);
+		int n;
+
+		/*
+		 * Bring the line up to the wall clock. The board would have been
+		 * polling all along, so do that every character time; a late
+		 * wake-up of this process must not look like a busy board.
+		 */
+		while (due > uartlite_sim.ticks) {
+			unsigned long step = due - uartlite_sim.ticks;
+			uartlite_sim_run(step < CHARS_PERIOD ? step : CHARS_PERIOD);
+			uart_rx_poll();
+		}
+		if (uartlite_sim.line_in_pos == uartlite_sim.line_in_len) {
+			ssize_t got = read(fd, line_in, sizeof(line_in));
+			if (got > 0) {
+				uartlite_sim_feed(line_in, got);
+			} else if (got < 0 && errno != EAGAIN && errno != EIO) {
+				perror("read");
+				return 1;
+			}
+		}
+
+		n = ingest_poll();
+		if (n > 0 && delay_us > 0) {
+			struct timespec d = { 0, 0 };
+			uint64_t ns = (uint64_t) delay_us * 1000 * n;
+			d.tv_sec = ns / 1000000000ULL;
+			d.tv_nsec = ns % 1000000000ULL;
+			nanosleep(&d, NULL);
+			/*
+			 * No polling during inference: the line fills the FIFO.
+			 */
+			t = now_ns();
+			due = (unsigned long)((t - start) * CHARS_PERIOD / ns_per_char);
+			if (due > uartlite_sim.ticks) {
+				uartlite_sim_run(due - uartlite_sim.ticks);
+			}
+		}
+		beats += n;
+
+		while (out_sent < uartlite_sim.line_out_len) {
+			ssize_t w = write(fd, uartlite_sim.line_out + out_sent,
+					uartlite_sim.line_out_len - out_sent);
+			if (w <= 0) {
+				break;
+			}
+			out_sent += w;
+		}
+
+		if (t - last_report >= REPORT_PERIOD_NS && beats != reported) {
+			ingest_get_stats(&st);
+			fprintf(stderr, "%lu beats, %lu CRC errors, %lu lost, %lu bytes skipped,"
+					" %lu RX overruns\n", beats, st.crc_errors, st.lost_beats,
+					st.bytes_skipped, uartlite_sim.rx_overruns);
+			reported = beats;
+			last_report = t;
+		}
+
+		/*
+		 * Idle until the next character time.
+		 */
+		if (n == 0) {
+			struct timespec d = { 0, (long)(ns_per_char / 4) };
+			nanosleep(&d, NULL);
+		}
+	}
+	return 0;
+}
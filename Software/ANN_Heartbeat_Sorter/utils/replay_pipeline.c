@@ -0,0 +1,504 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host replay tool. Classifies beat record files with the same RNA35b
+ * network that runs on the Microblaze, using three pipelined stages:
+ *
+ *   parse  ->  inference  ->  output
+ *
+ * Each stage runs in its own thread. Stages exchange batches of beats
+ * through bounded single-producer/single-consumer lock-free queues, and
+ * the emptied batches go back from the output stage to the parse stage
+ * through a third queue. The batch pool is the only memory in flight, so
+ * a slow stage makes the stages before it wait (backpressure) instead of
+ * growing any buffer. Throughput is bounded by the slowest stage.
+ *
+ * Build (from this directory):
+ *   gcc -O2 -std=gnu11 -I../src replay_pipeline.c ../src/beat_class.c
+ *       ../src/RNA35b*.c ../src/rt*.c -o replay_pipeline -lpthread -lm
+ *
+ * Usage:
+ *   replay_pipeline [-S] [-B] [-n beats] [-b batch] [-q depth]
+ *                   [-o outfile] record [record...]
+ *
+ *   -S  run the three stages serially in one thread, as main.c does
+ *   -B  record files hold one beat (28 values) per line; by default they
+ *       hold 28 rows of "beats" values, the layout read by main.c
+ *   -n  beats per record for the default layout (default 2600)
+ *   -b  beats per batch (default 32)
+ *   -q  batches in flight, a power of two (default 8)
+ *   -o  write the classification to outfile instead of stdout
+ *
+ * Per-stage counters are printed to stderr when the replay ends.
+ *
+ * @file replay_pipeline.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "RNA35b.h"
+#include "RNA35b_emxAPI.h"
+#include "RNA35b_initialize.h"
+#include "beat_class.h"
+#include "spsc_queue.h"
+
+#define DEFAULT_RECORD_BEATS    2600
+#define DEFAULT_BATCH_BEATS     32
+#define DEFAULT_QUEUE_DEPTH     8
+
+/*
+ * A batch of consecutive beats of one record. A batch with count == 0 is
+ * the end-of-stream marker.
+ */
+typedef struct {
+	int record;
+	int first_beat;
+	int count;
+	double *in;             /* BEAT_NUM_FEATURES x count, column major */
+	double *out;            /* BEAT_NUM_CLASSES x count, column major */
+	unsigned char *cls;     /* decoded class of each beat */
+} beat_batch_t;
+
+/*
+ * Utilization counters of one stage. Times in nanoseconds.
+ */
+typedef struct {
+	const char *name;
+	uint64_t batches;
+	uint64_t beats;
+	uint64_t busy_ns;       /* doing the stage's own work */
+	uint64_t wait_in_ns;    /* waiting for a batch from upstream */
+	uint64_t wait_out_ns;   /* waiting for room downstream */
+	uint64_t waits_in;
+	uint64_t waits_out;
+} stage_stats_t;
+
+/*
+ * Parse stage state.
+ */
+typedef struct {
+	char **files;
+	int num_files;
+	int beat_major;
+	int record_beats;
+	int file_index;
+	FILE *fp;
+	double *record;         /* one record in the default layout */
+	int record_len;         /* beats in "record" */
+	int record_pos;         /* next beat to hand out from "record" */
+} parser_t;
+
+static int batch_beats = DEFAULT_BATCH_BEATS;
+static int queue_depth = DEFAULT_QUEUE_DEPTH;
+static FILE *out_fp;
+static parser_t parser;
+
+static spsc_queue_t q_free, q_parsed, q_classified;
+static stage_stats_t st_parse = { .name = "parse" };
+static stage_stats_t st_infer = { .name = "inference" };
+static stage_stats_t st_output = { .name = "output" };
+
+static uint64_t now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Blocking queue helpers. A full or empty queue is polled with
+ * sched_yield(); the time spent there is charged to the stage as wait.
+ */
+static void queue_put(spsc_queue_t *q, beat_batch_t *b, stage_stats_t *st){
+	uint64_t t0;
+
+	if (spsc_queue_push(q, b)) {
+		return;
+	}
+	t0 = now_ns();
+	st->waits_out++;
+	while (!spsc_queue_push(q, b)) {
+		sched_yield();
+	}
+	st->wait_out_ns += now_ns() - t0;
+}
+
+static beat_batch_t *queue_get(spsc_queue_t *q, stage_stats_t *st, int upstream){
+	beat_batch_t *b;
+	uint64_t t0;
+
+	if ((b = spsc_queue_pop(q)) != NULL) {
+		return b;
+	}
+	t0 = now_ns();
+	while ((b = spsc_queue_pop(q)) == NULL) {
+		sched_yield();
+	}
+	/*
+	 * The parse stage gets empty batches back from the output stage; a
+	 * wait there means every batch is in flight, i.e. backpressure.
+	 */
+	if (upstream) {
+		st->waits_in++;
+		st->wait_in_ns += now_ns() - t0;
+	} else {
+		st->waits_out++;
+		st->wait_out_ns += now_ns() - t0;
+	}
+	return b;
+}
+
+/**
+ * Load the next record of the default layout: BEAT_NUM_FEATURES rows of
+ * record_beats values, exactly as main.c reads it.
+ * @return      1 on success, 0 at end of input
+ */
+static int parser_load_record(parser_t *p){
+	int i, j;
+
+	while (p->file_index < p->num_files) {
+		p->fp = fopen(p->files[p->file_index], "r");
+		if (p->fp == NULL) {
+			fprintf(stderr, "Cannot open %s\n", p->files[p->file_index]);
+			p->file_index++;
+			continue;
+		}
+		for (i=0; i < BEAT_NUM_FEATURES; i++){
+			for (j=0; j < p->record_beats; j++){
+				if (fscanf(p->fp, "%lf ", &p->record[j * BEAT_NUM_FEATURES + i]) != 1) {
+					break;
+				}
+			}
+			if (j < p->record_beats) {
+				break;
+			}
+		}
+		fclose(p->fp);
+		p->fp = NULL;
+		if (i < BEAT_NUM_FEATURES) {
+			fprintf(stderr, "Short record %s\n", p->files[p->file_index]);
+			p->file_index++;
+			continue;
+		}
+		p->record_len = p->record_beats;
+		p->record_pos = 0;
+		p->file_index++;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Fill a batch with the next beats of the input.
+ * @return      number of beats placed in the batch, 0 at end of input
+ */
+static int parser_fill(parser_t *p, beat_batch_t *b){
+	int n, k;
+
+	b->count = 0;
+	if (p->beat_major) {
+		while (b->count == 0) {
+			if (p->fp == NULL) {
+				if (p->file_index >= p->num_files) {
+					return 0;
+				}
+				p->fp = fopen(p->files[p->file_index++], "r");
+				p->record_pos = 0;
+				if (p->fp == NULL) {
+					fprintf(stderr, "Cannot open %s\n", p->files[p->file_index - 1]);
+					continue;
+				}
+			}
+			b->record = p->file_index - 1;
+			b->first_beat = p->record_pos;
+			while (b->count < batch_beats) {
+				double *beat = &b->in[b->count * BEAT_NUM_FEATURES];
+				for (k=0; k < BEAT_NUM_FEATURES; k++){
+					if (fscanf(p->fp, "%lf", &beat[k]) != 1) {
+						break;
+					}
+				}
+				if (k < BEAT_NUM_FEATURES) {
+					fclose(p->fp);
+					p->fp = NULL;
+					break;
+				}
+				b->count++;
+				p->record_pos++;
+			}
+		}
+		return b->count;
+	}
+
+	if (p->record_pos >= p->record_len && !parser_load_record(p)) {
+		return 0;
+	}
+	n = p->record_len - p->record_pos;
+	if (n > batch_beats) {
+		n = batch_beats;
+	}
+	b->record = p->file_index - 1;
+	b->first_beat = p->record_pos;
+	memcpy(b->in, &p->record[p->record_pos * BEAT_NUM_FEATURES],
+			n * BEAT_NUM_FEATURES * sizeof(double));
+	p->record_pos += n;
+	b->count = n;
+	return n;
+}
+
+/**
+ * Run the network over every beat of a batch and decode the classes.
+ * All the beats of the batch go through RNA35b in one call.
+ */
+static void infer_batch(beat_batch_t *b){
+	emxArray_real_T *inputs, *outputs;
+	int j;
+
+	inputs = emxCreateWrapper_real_T(b->in, BEAT_NUM_FEATURES, b->count);
+	outputs = emxCreateWrapper_real_T(b->out, BEAT_NUM_CLASSES, b->count);
+	RNA35b(inputs, outputs);
+	for (j=0; j < b->count; j++){
+		b->cls[j] = (unsigned char) beat_class_decode(&outputs->data[j * BEAT_NUM_CLASSES]);
+	}
+	emxDestroyArray_real_T(inputs);
+	emxDestroyArray_real_T(outputs);
+}
+
+static void output_batch(beat_batch_t *b){
+	int j;
+
+	for (j=0; j < b->count; j++){
+		fputs(beat_class_text[b->cls[j]], out_fp);
+	}
+}
+
+static void *parse_stage(void *arg){
+	beat_batch_t *b;
+	uint64_t t0;
+	int n;
+
+	(void) arg;
+	do {
+		b = queue_get(&q_free, &st_parse, 0);
+		t0 = now_ns();
+		n = parser_fill(&parser, b);
+		st_parse.busy_ns += now_ns() - t0;
+		if (n != 0) {
+			st_parse.batches++;
+			st_parse.beats += n;
+		}
+		queue_put(&q_parsed, b, &st_parse);
+	} while (n != 0);
+	return NULL;
+}
+
+static void *infer_stage(void *arg){
+	beat_batch_t *b;
+	uint64_t t0;
+	int n;
+
+	(void) arg;
+	do {
+		b = queue_get(&q_parsed, &st_infer, 1);
+		n = b->count;
+		if (n != 0) {
+			t0 = now_ns();
+			infer_batch(b);
+			st_infer.busy_ns += now_ns() - t0;
+			st_infer.batches++;
+			st_infer.beats += n;
+		}
+		queue_put(&q_classified, b, &st_infer);
+	} while (n != 0);
+	return NULL;
+}
+
+static void *output_stage(void *arg){
+	beat_batch_t *b;
+	uint64_t t0;
+	int n;
+
+	(void) arg;
+	do {
+		b = queue_get(&q_classified, &st_output, 1);
+		n = b->count;
+		if (n != 0) {
+			t0 = now_ns();
+			output_batch(b);
+			st_output.busy_ns += now_ns() - t0;
+			st_output.batches++;
+			st_output.beats += n;
+		}
+		queue_put(&q_free, b, &st_output);
+	} while (n != 0);
+	fflush(out_fp);
+	return NULL;
+}
+
+/*
+ * Reference run: the three stages one after the other in this thread.
+ */
+static void run_serial(beat_batch_t *b){
+	uint64_t t0;
+	int n;
+
+	for (;;) {
+		t0 = now_ns();
+		n = parser_fill(&parser, b);
+		st_parse.busy_ns += now_ns() - t0;
+		if (n == 0) {
+			break;
+		}
+		st_parse.batches++;
+		st_parse.beats += n;
+
+		t0 = now_ns();
+		infer_batch(b);
+		st_infer.busy_ns += now_ns() - t0;
+		st_infer.batches++;
+		st_infer.beats += n;
+
+		t0 = now_ns();
+		output_batch(b);
+		st_output.busy_ns += now_ns() - t0;
+		st_output.batches++;
+		st_output.beats += n;
+	}
+	fflush(out_fp);
+}
+
+static void print_stage(const stage_stats_t *st, uint64_t wall_ns){
+	fprintf(stderr, "%-10s %8llu %8llu %6.1f%% %10.3f %8llu %10.3f %8llu\n",
+			st->name,
+			(unsigned long long) st->batches,
+			(unsigned long long) st->beats,
+			wall_ns ? 100.0 * (double) st->busy_ns / (double) wall_ns : 0.0,
+			(double) st->wait_in_ns / 1e6,
+			(unsigned long long) st->waits_in,
+			(double) st->wait_out_ns / 1e6,
+			(unsigned long long) st->waits_out);
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-S] [-B] [-n beats] [-b batch] [-q depth] "
+			"[-o outfile] record [record...]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+	pthread_t th_parse, th_infer, th_output;
+	beat_batch_t *pool;
+	uint64_t t0, wall_ns;
+	int serial = 0;
+	int opt, i;
+
+	out_fp = stdout;
+	parser.record_beats = DEFAULT_RECORD_BEATS;
+	while ((opt = getopt(argc, argv, "SBn:b:q:o:")) != -1) {
+		switch (opt) {
+		case 'S':
+			serial = 1;
+			break;
+		case 'B':
+			parser.beat_major = 1;
+			break;
+		case 'n':
+			parser.record_beats = atoi(optarg);
+			break;
+		case 'b':
+			batch_beats = atoi(optarg);
+			break;
+		case 'q':
+			queue_depth = atoi(optarg);
+			break;
+		case 'o':
+			out_fp = fopen(optarg, "w");
+			if (out_fp == NULL) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc || batch_beats <= 0 || parser.record_beats <= 0) {
+		usage(argv[0]);
+	}
+	parser.files = &argv[optind];
+	parser.num_files = argc - optind;
+	if (!parser.beat_major) {
+		parser.record = (double *) malloc(parser.record_beats *
+				BEAT_NUM_FEATURES * sizeof(double));
+	}
+
+	if (spsc_queue_init(&q_free, queue_depth) != 0 ||
+			spsc_queue_init(&q_parsed, queue_depth) != 0 ||
+			spsc_queue_init(&q_classified, queue_depth) != 0) {
+		fprintf(stderr, "Queue depth must be a power of two >= 2\n");
+		return 1;
+	}
+
+	/*
+	 * The batch pool: every batch starts out empty in q_free.
+	 */
+	pool = (beat_batch_t *) calloc(queue_depth, sizeof(beat_batch_t));
+	for (i=0; i < queue_depth; i++){
+		pool[i].in = (double *) malloc(batch_beats * BEAT_NUM_FEATURES * sizeof(double));
+		pool[i].out = (double *) malloc(batch_beats * BEAT_NUM_CLASSES * sizeof(double));
+		pool[i].cls = (unsigned char *) malloc(batch_beats);
+		spsc_queue_push(&q_free, &pool[i]);
+	}
+
+	RNA35b_initialize();
+
+	t0 = now_ns();
+	if (serial) {
+		run_serial(&pool[0]);
+	} else {
+		pthread_create(&th_parse, NULL, parse_stage, NULL);
+		pthread_create(&th_infer, NULL, infer_stage, NULL);
+		pthread_create(&th_output, NULL, output_stage, NULL);
+		pthread_join(th_parse, NULL);
+		pthread_join(th_infer, NULL);
+		pthread_join(th_output, NULL);
+	}
+	wall_ns = now_ns() - t0;
+
+	fprintf(stderr, "%s: %llu beats in %.3f ms, %.0f beats/s\n",
+			serial ? "serial" : "pipelined",
+			(unsigned long long) st_output.beats, (double) wall_ns / 1e6,
+			wall_ns ? (double) st_output.beats * 1e9 / (double) wall_ns : 0.0);
+	fprintf(stderr, "%-10s %8s %8s %7s %10s %8s %10s %8s\n", "stage", "batches",
+			"beats", "busy", "wait_in_ms", "waits", "wait_out_ms", "waits");
+	print_stage(&st_parse, wall_ns);
+	print_stage(&st_infer, wall_ns);
+	print_stage(&st_output, wall_ns);
+
+	for (i=0; i < queue_depth; i++){
+		free(pool[i].in);
+		free(pool[i].out);
+		free(pool[i].cls);
+	}
+	free(pool);
+	free(parser.record);
+	spsc_queue_destroy(&q_free);
+	spsc_queue_destroy(&q_parsed);
+	spsc_queue_destroy(&q_classified);
+	if (out_fp != stdout) {
+		fclose(out_fp);
+	}
+	return 0;
+}
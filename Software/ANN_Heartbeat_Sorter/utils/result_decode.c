@@ -0,0 +1,323 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host decoder of the binary result protocol (see src/result_proto.h).
+ *
+ * Build (from this directory):
+ *   gcc -O2 -I../src result_decode.c ../src/result_proto.c ../src/beat_class.c
+ *       -o result_decode
+ *
+ * Usage:
+ *   result_decode [-v] capture.bin
+ *       Decode a UART capture of binary frames and print the same text
+ *       lines that RESULT_FORMAT_TEXT would have sent. -v adds the beat
+ *       sequence number and the run confidence. Bad CRCs, lost frames and
+ *       garbage between frames are reported on stderr.
+ *
+ *   result_decode -t [-b baud] [-n beats] [-f flags] results.txt
+ *       Throughput comparison: read a text result stream (as sent by the
+ *       board or written by replay_pipeline), encode it with the board's
+ *       encoder, check that it decodes back to the same classes and report
+ *       the bytes and the UART time of both formats.
+ *
+ * @file result_decode.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "beat_class.h"
+#include "result_proto.h"
+
+/*
+ * Bits on the line per byte: start + 8 data + stop.
+ */
+#define UART_BITS_PER_BYTE      10
+#define DEFAULT_BAUD            9600
+#define DEFAULT_FRAME_BEATS     64
+
+typedef struct {
+	unsigned long frames;
+	unsigned long beats;
+	unsigned long crc_errors;
+	unsigned long lost_frames;
+	unsigned long skipped_bytes;
+} decode_stats_t;
+
+/*
+ * Callback for every decoded run.
+ */
+typedef void (*run_fn)(void *ref, unsigned long first_beat, int cls,
+		unsigned int len, int conf);
+
+/**
+ * Decode every frame found in a byte stream.
+ */
+static void decode_stream(const unsigned char *buf, size_t len,
+		run_fn on_run, void *ref, decode_stats_t *st){
+	size_t pos = 0;
+	unsigned short expected_seq = 0;
+	int have_seq = 0;
+
+	memset(st, 0, sizeof(*st));
+	while (pos < len) {
+		const unsigned char *f = &buf[pos];
+		unsigned int payload_len, i, run_size;
+		unsigned short seq, crc;
+		unsigned long beat;
+
+		if (f[0] != RESULT_FRAME_SYNC || len - pos < RESULT_HEADER_SIZE + RESULT_CRC_SIZE) {
+			pos++;
+			st->skipped_bytes++;
+			continue;
+		}
+		payload_len = f[8];
+		if (len - pos < RESULT_HEADER_SIZE + payload_len + RESULT_CRC_SIZE) {
+			pos++;
+			st->skipped_bytes++;
+			continue;
+		}
+		crc = (unsigned short)((f[RESULT_HEADER_SIZE + payload_len] << 8) |
+				f[RESULT_HEADER_SIZE + payload_len + 1]);
+		if (crc != result_crc16(&f[1], RESULT_HEADER_SIZE - 1 + payload_len)) {
+			/*
+			 * Not a frame, or a damaged one: resynchronize on the next
+			 * sync byte.
+			 */
+			st->crc_errors++;
+			pos++;
+			continue;
+		}
+
+		seq = (unsigned short)(f[2] | (f[3] << 8));
+		if (have_seq && seq != expected_seq) {
+			st->lost_frames += (unsigned short)(seq - expected_seq);
+		}
+		expected_seq = (unsigned short)(seq + 1);
+		have_seq = 1;
+
+		beat = (unsigned long) f[4] | ((unsigned long) f[5] << 8) |
+				((unsigned long) f[6] << 16) | ((unsigned long) f[7] << 24);
+		run_size = (f[1] & RESULT_FLAG_CONFIDENCE) ? 2 : 1;
+		for (i=0; i + run_size <= payload_len; i += run_size){
+			unsigned char run = f[RESULT_HEADER_SIZE + i];
+			int conf = run_size == 2 ? f[RESULT_HEADER_SIZE + i + 1] : -1;
+
+			on_run(ref, beat, RESULT_RUN_CLASS(run), RESULT_RUN_LENGTH(run), conf);
+			beat += RESULT_RUN_LENGTH(run);
+			st->beats += RESULT_RUN_LENGTH(run);
+		}
+		st->frames++;
+		pos += RESULT_HEADER_SIZE + payload_len + RESULT_CRC_SIZE;
+	}
+}
+
+static unsigned char *read_file(const char *name, size_t *len){
+	FILE *fp = fopen(name, "rb");
+	unsigned char *buf = NULL;
+	size_t cap = 0, n;
+
+	*len = 0;
+	if (fp == NULL) {
+		perror(name);
+		exit(1);
+	}
+	do {
+		if (*len == cap) {
+			cap = cap ? 2 * cap : 65536;
+			buf = (unsigned char *) realloc(buf, cap);
+		}
+		n = fread(buf + *len, 1, cap - *len, fp);
+		*len += n;
+	} while (n > 0);
+	fclose(fp);
+	return buf;
+}
+
+/*
+ * Decode mode.
+ */
+static int verbose;
+
+static void print_run(void *ref, unsigned long first_beat, int cls,
+		unsigned int len, int conf){
+	unsigned int i;
+
+	(void) ref;
+	for (i=0; i < len; i++){
+		if (cls >= BEAT_NUM_CLASSES) {
+			printf("? Invalid class %d\r\n", cls);
+		} else if (verbose) {
+			printf("%8lu %3d %s", first_beat + i, conf, beat_class_text[cls]);
+		} else {
+			fputs(beat_class_text[cls], stdout);
+		}
+	}
+}
+
+/*
+ * Comparison mode: the classes read from text and the encoded bytes.
+ */
+static unsigned char *classes;
+static size_t num_classes;
+static unsigned char *encoded;
+static size_t encoded_len, encoded_cap;
+
+static unsigned int collect(const char *data, unsigned int len){
+	if (encoded_len + len > encoded_cap) {
+		encoded_cap = 2 * (encoded_len + len);
+		encoded = (unsigned char *) realloc(encoded, encoded_cap);
+	}
+	memcpy(encoded + encoded_len, data, len);
+	encoded_len += len;
+	return len;
+}
+
+static void check_run(void *ref, unsigned long first_beat, int cls,
+		unsigned int len, int conf){
+	unsigned long *mismatches = (unsigned long *) ref;
+	unsigned int i;
+
+	(void) conf;
+	for (i=0; i < len; i++){
+		if (first_beat + i >= num_classes || classes[first_beat + i] != cls) {
+			(*mismatches)++;
+		}
+	}
+}
+
+static int compare(const char *name, unsigned long baud, unsigned int frame_beats,
+		unsigned int flags){
+	static result_encoder_t enc;
+	decode_stats_t st;
+	unsigned long mismatches = 0;
+	size_t text_len = 0, cap = 0;
+	char line[128];
+	FILE *fp;
+	int c;
+
+	fp = fopen(name, "r");
+	if (fp == NULL) {
+		perror(name);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		size_t n = strlen(line);
+		/*
+		 * Compare without the line ending, which the capture may have
+		 * changed.
+		 */
+		while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) {
+			line[--n] = '\0';
+		}
+		for (c=0; c < BEAT_NUM_CLASSES; c++){
+			if (strncmp(line, beat_class_text[c], n) == 0 &&
+					strlen(beat_class_text[c]) == n + 2) {
+				break;
+			}
+		}
+		if (c == BEAT_NUM_CLASSES) {
+			continue;
+		}
+		if (num_classes == cap) {
+			cap = cap ? 2 * cap : 4096;
+			classes = (unsigned char *) realloc(classes, cap);
+		}
+		classes[num_classes++] = (unsigned char) c;
+		text_len += strlen(beat_class_text[c]);
+	}
+	fclose(fp);
+	if (num_classes == 0) {
+		fprintf(stderr, "%s: no beat lines\n", name);
+		return 1;
+	}
+
+	result_encoder_init(&enc, collect, flags, frame_beats);
+	for (c=0; (size_t) c < num_classes; c++){
+		result_encoder_put(&enc, classes[c], 1.0);
+	}
+	result_encoder_flush(&enc);
+
+	decode_stream(encoded, encoded_len, check_run, &mismatches, &st);
+
+	printf("beats:          %lu\n", (unsigned long) num_classes);
+	printf("text:           %lu bytes, %.2f bytes/beat, %.2f s at %lu baud\n",
+			(unsigned long) text_len, (double) text_len / num_classes,
+			(double) text_len * UART_BITS_PER_BYTE / baud, baud);
+	printf("binary:         %lu bytes, %.2f bytes/beat, %.2f s at %lu baud"
+			" (%lu frames)\n",
+			(unsigned long) encoded_len, (double) encoded_len / num_classes,
+			(double) encoded_len * UART_BITS_PER_BYTE / baud, baud, st.frames);
+	printf("ratio:          %.1fx fewer bytes\n", (double) text_len / encoded_len);
+	printf("beats/s:        text %.1f, binary %.1f\n",
+			(double) baud / UART_BITS_PER_BYTE * num_classes / text_len,
+			(double) baud / UART_BITS_PER_BYTE * num_classes / encoded_len);
+	if (st.beats != num_classes || mismatches != 0 || st.crc_errors != 0) {
+		printf("round trip:     FAILED (%lu beats decoded, %lu mismatches)\n",
+				st.beats, mismatches);
+		return 1;
+	}
+	printf("round trip:     OK\n");
+	return 0;
+}
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [-v] capture.bin\n"
+			"       %s -t [-b baud] [-n beats] [-f flags] results.txt\n",
+			prog, prog);
+	exit(1);
+}
+
+int main(int argc, char *argv[]){
+	unsigned long baud = DEFAULT_BAUD;
+	unsigned int frame_beats = DEFAULT_FRAME_BEATS;
+	unsigned int flags = RESULT_FLAG_CONFIDENCE;
+	decode_stats_t st;
+	unsigned char *buf;
+	size_t len;
+	int text = 0, opt;
+
+	while ((opt = getopt(argc, argv, "vtb:n:f:")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 't':
+			text = 1;
+			break;
+		case 'b':
+			baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			frame_beats = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			flags = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || baud == 0) {
+		usage(argv[0]);
+	}
+	if (text) {
+		return compare(argv[optind], baud, frame_beats, flags);
+	}
+
+	buf = read_file(argv[optind], &len);
+	decode_stream(buf, len, print_run, NULL, &st);
+	fprintf(stderr, "%lu frames, %lu beats, %lu CRC errors, %lu lost frames,"
+			" %lu bytes skipped\n", st.frames, st.beats, st.crc_errors,
+			st.lost_frames, st.skipped_bytes);
+	free(buf);
+	return st.crc_errors || st.lost_frames ? 2 : 0;
+}
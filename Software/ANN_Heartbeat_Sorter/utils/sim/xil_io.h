@@ -0,0 +1,29 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host replacement for the BSP's xil_io.h. Put this directory before the
+ * BSP include directory so that the unmodified Xilinx drivers access the
+ * simulated devices instead of dereferencing bus addresses.
+ *
+ * @file xil_io.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef XIL_IO_H
+#define XIL_IO_H
+
+#include "xil_types.h"
+
+u32 sim_bus_read(u32 Addr);
+void sim_bus_write(u32 Addr, u32 Value);
+
+#define Xil_In32(Addr)          sim_bus_read((u32)(Addr))
+#define Xil_Out32(Addr, Value)  sim_bus_write((u32)(Addr), (u32)(Value))
+
+#endif /* XIL_IO_H */
@@ -0,0 +1,100 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Bounded single-producer/single-consumer lock-free queue of pointers for
+ * the host tools. Only one thread may push and only one thread may pop.
+ * The producer owns "tail", the consumer owns "head"; each side reads the
+ * other index with acquire semantics and publishes its own with release
+ * semantics, so no lock is ever taken.
+ *
+ * @file spsc_queue.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/*
+ * Keep each index on its own cache line so producer and consumer do not
+ * invalidate each other's line on every operation.
+ */
+#define SPSC_CACHE_LINE         64
+
+typedef struct {
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t head;   /* next slot to pop */
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t tail;   /* next slot to push */
+	_Alignas(SPSC_CACHE_LINE) size_t mask;          /* capacity - 1 */
+	void **slots;
+} spsc_queue_t;
+
+/**
+ * Initialize a queue.
+ * @function    spsc_queue_init()
+ *
+ * @param       q           queue to initialize
+ * @param       capacity    number of slots, must be a power of two
+ *
+ * @return      0 on success, -1 on bad capacity or no memory
+ */
+static inline int spsc_queue_init(spsc_queue_t *q, size_t capacity){
+	if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+		return -1;
+	}
+	q->slots = (void **) calloc(capacity, sizeof(void *));
+	if (q->slots == NULL) {
+		return -1;
+	}
+	q->mask = capacity - 1;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	return 0;
+}
+
+static inline void spsc_queue_destroy(spsc_queue_t *q){
+	free(q->slots);
+	q->slots = NULL;
+}
+
+/**
+ * Push an item. Producer side only.
+ * @return      1 if the item was queued, 0 if the queue is full
+ */
+static inline int spsc_queue_push(spsc_queue_t *q, void *item){
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+	if (tail - head > q->mask) {
+		return 0;
+	}
+	q->slots[tail & q->mask] = item;
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+	return 1;
+}
+
+/**
+ * Pop an item. Consumer side only.
+ * @return      the oldest item, or NULL if the queue is empty
+ */
+static inline void *spsc_queue_pop(spsc_queue_t *q){
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+	void *item;
+
+	if (head == tail) {
+		return NULL;
+	}
+	item = q->slots[head & q->mask];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return item;
+}
+
+#endif /* SPSC_QUEUE_H */
@@ -0,0 +1,194 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host test of the in place number scanner (file_scan.c) and of the MFS
+ * extent mapping it relies on (mfs_file_map, mfs_file_get_extents). Files
+ * are written to a RAM file system so that numbers fall across block
+ * boundaries at every possible position.
+ *
+ * Build (from this directory):
+ *   M=../../standalone_bsp/microblaze_0/libsrc/xilmfs_v1_00_a/src
+ *   gcc -I../src -I../../standalone_bsp/microblaze_0/include
+ *       test_file_scan.c ../src/file_scan.c $M/mfs_filesys.c -o test_file_scan
+ *
+ * @file test_file_scan.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xstatus.h"
+#include "xilmfs.h"
+#include "file_scan.h"
+
+#define FS_BLOCKS               64
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static struct mfs_file_block fs[FS_BLOCKS];
+static char text[8 * MFS_BLOCK_DATA_SIZE];
+
+static void make_file(const char *name, const char *data, int len){
+	int fd;
+
+	mfs_delete_file((char *) name);
+	fd = mfs_file_open(name, MFS_MODE_CREATE);
+	CHECK(fd >= 0);
+	CHECK(mfs_file_write(fd, data, len) == 1);
+	mfs_file_close(fd);
+}
+
+/*
+ * The extents of a file, walked or listed, are the file.
+ */
+static void test_extents(void){
+	struct mfs_extent extents[8];
+	const char *data;
+	int i, fd, len, pos, n;
+
+	for (i=0; i < (int) sizeof(text); i++){
+		text[i] = (char) ('a' + i % 23);
+	}
+	len = 3 * MFS_BLOCK_DATA_SIZE + 17;
+	make_file("ext", text, len);
+
+	fd = mfs_file_open("ext", MFS_MODE_READ);
+	CHECK(mfs_file_get_extents(fd, extents, 8) == 4);
+	CHECK(mfs_file_get_extents(fd, extents, 2) == 4);
+	pos = 0;
+	while ((n = mfs_file_map(fd, &data)) > 0) {
+		CHECK(n <= MFS_BLOCK_DATA_SIZE);
+		CHECK(memcmp(data, &text[pos], n) == 0);
+		pos += n;
+	}
+	CHECK(n == 0);
+	CHECK(pos == len);
+	CHECK(mfs_file_get_extents(fd, extents, 8) == 0);
+	mfs_file_close(fd);
+
+	/*
+	 * From the middle of the file, after mfs_file_read.
+	 */
+	fd = mfs_file_open("ext", MFS_MODE_READ);
+	CHECK(mfs_file_read(fd, text + sizeof(text) - 700, 700) == 700);
+	CHECK(mfs_file_get_extents(fd, extents, 8) == 3);
+	CHECK(extents[0].length == 2 * MFS_BLOCK_DATA_SIZE - 700);
+	CHECK(memcmp(extents[0].data, &text[700], extents[0].length) == 0);
+	CHECK(extents[2].length == 17);
+	CHECK(mfs_file_map(fd, &data) == extents[0].length);
+	CHECK(data == extents[0].data);
+	mfs_file_close(fd);
+
+	/*
+	 * A file in one block is a single pointer.
+	 */
+	make_file("small", text, 100);
+	fd = mfs_file_open("small", MFS_MODE_READ);
+	CHECK(mfs_file_get_extents(fd, extents, 1) == 1);
+	CHECK(extents[0].length == 100);
+	CHECK(memcmp(extents[0].data, text, 100) == 0);
+	mfs_file_close(fd);
+
+	CHECK(mfs_file_map(fd, &data) == -1);
+	fd = mfs_file_open(".", MFS_MODE_READ);
+	CHECK(mfs_file_map(fd, &data) == -1);
+	mfs_file_close(fd);
+}
+
+/*
+ * Numbers are read whatever block boundary they straddle.
+ */
+static void test_numbers(void){
+	file_scan_t scan;
+	double v;
+	int shift, i, len, count, n;
+
+	for (shift=0; shift < 24; shift++){
+		len = 0;
+		for (i=0; i < shift; i++){
+			text[len++] = ' ';
+		}
+		count = 0;
+		while (len < 3 * MFS_BLOCK_DATA_SIZE) {
+			len += sprintf(&text[len], "%.15g%s", -1.0 + count * 0.123456789,
+					(count % 7 == 6) ? "\r\n" : " ");
+			count++;
+		}
+		len--;                  /* no white space after the last number */
+		make_file("num", text, len);
+
+		CHECK(file_scan_open(&scan, "num") == XST_SUCCESS);
+		for (n=0; file_scan_double(&scan, &v); n++){
+			char expect[32];
+			double e;
+			sprintf(expect, "%.15g", -1.0 + n * 0.123456789);
+			e = strtod(expect, NULL);
+			CHECK(v == e);
+		}
+		CHECK(n == count);
+		CHECK(file_scan_close(&scan) == XST_SUCCESS);
+	}
+}
+
+static void test_integers_and_errors(void){
+	static const char ints[] = "1024 1023\n-5\t7 ";
+	static const char bad[] = "1.5 2.5 x3 4";
+	file_scan_t scan;
+	double v;
+	int k;
+
+	make_file("ints", ints, strlen(ints));
+	CHECK(file_scan_open(&scan, "ints") == XST_SUCCESS);
+	CHECK(file_scan_int(&scan, &k) && k == 1024);
+	CHECK(file_scan_int(&scan, &k) && k == 1023);
+	CHECK(file_scan_int(&scan, &k) && k == -5);
+	CHECK(file_scan_int(&scan, &k) && k == 7);
+	CHECK(!file_scan_int(&scan, &k));
+	CHECK(file_scan_close(&scan) == XST_SUCCESS);
+
+	make_file("bad", bad, strlen(bad));
+	CHECK(file_scan_open(&scan, "bad") == XST_SUCCESS);
+	CHECK(file_scan_double(&scan, &v) && v == 1.5);
+	CHECK(file_scan_double(&scan, &v) && v == 2.5);
+	CHECK(!file_scan_double(&scan, &v));
+	CHECK(file_scan_close(&scan) == XST_FAILURE);
+
+	/*
+	 * A token longer than FILE_SCAN_TOKEN_SIZE across a block boundary.
+	 */
+	memset(text, '7', 2 * MFS_BLOCK_DATA_SIZE);
+	make_file("long", text, 2 * MFS_BLOCK_DATA_SIZE);
+	CHECK(file_scan_open(&scan, "long") == XST_SUCCESS);
+	CHECK(!file_scan_double(&scan, &v));
+	CHECK(file_scan_close(&scan) == XST_FAILURE);
+
+	CHECK(file_scan_open(&scan, "missing") == XST_FAILURE);
+}
+
+int main(void){
+	mfs_init_fs(sizeof(fs), (char *) fs, MFSINIT_NEW);
+	test_extents();
+	test_numbers();
+	test_integers_and_errors();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
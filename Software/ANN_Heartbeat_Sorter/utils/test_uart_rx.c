@@ -0,0 +1,339 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host test of UART ingestion: the RX ring buffer (uart_rx.c), the beat
+ * frame parser (beat_rx.c) and the live classifier (ingest.c), running
+ * over the real UART Lite driver and the simulated UART Lite registers.
+ * Also measures the latency and throughput of the link in character
+ * times.
+ *
+ * Build (from this directory):
+ *   U=../../standalone_bsp/microblaze_0/libsrc/uartlite_v2_01_a/src
+ *   gcc -Isim -I../src -I../../standalone_bsp/microblaze_0/include -I$U
+ *       test_uart_rx.c uartlite_sim.c ../src/uart_rx.c ../src/uart_tx.c
+ *       ../src/beat_rx.c ../src/ingest.c ../src/result_proto.c
+ *       ../src/beat_class.c ../src/RNA35b*.c ../src/rt*.c
+ *       $U/xuartlite.c $U/xuartlite_intr.c $U/xuartlite_l.c $U/xuartlite_stats.c
+ *       -o test_uart_rx -lm
+ *
+ * @file test_uart_rx.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xuartlite.h"
+#include "RNA35b.h"
+#include "RNA35b_emxAPI.h"
+#include "RNA35b_initialize.h"
+#include "beat_class.h"
+#include "beat_rx.h"
+#include "ingest.h"
+#include "result_proto.h"
+#include "uart_rx.h"
+#include "uart_tx.h"
+#include "uartlite_sim.h"
+
+/*
+ * Line speed of the model: ticks per character.
+ */
+#define CHARS_PERIOD            50
+#define NUM_BEATS               200
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static XUartLite uart;
+static XUartLite_Config uart_config = { 0, UARTLITE_SIM_BASEADDR, 9600, 0, 0, 8 };
+
+static double beats[NUM_BEATS][BEAT_NUM_FEATURES];
+static int expected[NUM_BEATS];
+
+static void setup(void){
+	uartlite_sim_reset(CHARS_PERIOD);
+	XUartLite_CfgInitialize(&uart, &uart_config, UARTLITE_SIM_BASEADDR);
+	uart_tx_init(&uart, UART_TX_BLOCK);
+	uart_rx_init(&uart);
+}
+
+/*
+ * Random beats in the range of the network inputs, and their classes as
+ * the network gives them once the features are rounded to single
+ * precision like on the link.
+ */
+static void make_beats(void){
+	double result[BEAT_NUM_CLASSES];
+	emxArray_real_T *in, *out;
+	int i, k;
+
+	srand(1);
+	for (i=0; i < NUM_BEATS; i++){
+		for (k=0; k < BEAT_NUM_FEATURES; k++){
+			beats[i][k] = (float)(4.0 * rand() / RAND_MAX - 2.0);
+		}
+		in = emxCreateWrapper_real_T(beats[i], BEAT_NUM_FEATURES, 1);
+		out = emxCreateWrapper_real_T(result, BEAT_NUM_CLASSES, 1);
+		RNA35b(in, out);
+		expected[i] = beat_class_decode(result);
+		emxDestroyArray_real_T(in);
+		emxDestroyArray_real_T(out);
+	}
+}
+
+static void test_ring_order_and_wrap(void){
+	static u8 line[5 * UART_RX_BUFFER_SIZE];
+	static char got[sizeof(line)];
+	uart_rx_stats_t stats;
+	size_t len = 0;
+	unsigned int i;
+
+	setup();
+	for (i=0; i < sizeof(line); i++){
+		line[i] = (u8)(i * 7 + (i >> 8));
+	}
+	uartlite_sim_feed(line, sizeof(line));
+	/*
+	 * Read in odd sizes while the line runs.
+	 */
+	for (i=0; len < sizeof(line) && i < 100 * sizeof(line) * CHARS_PERIOD; i++){
+		len += uart_rx_read(&got[len], 1 + i % 37);
+	}
+	CHECK(len == sizeof(line));
+	CHECK(memcmp(got, line, sizeof(line)) == 0);
+	uart_rx_get_stats(&stats);
+	CHECK(stats.bytes_read == sizeof(line));
+	CHECK(uartlite_sim.rx_overruns == 0);
+}
+
+static void test_partial_run_visible(void){
+	static const u8 line[10] = "0123456789";
+	char got[16];
+
+	setup();
+	uartlite_sim_feed(line, sizeof(line));
+	uartlite_sim_run(CHARS_PERIOD * (sizeof(line) + 1));
+	/*
+	 * Far less than a run of the ring, yet readable at once.
+	 */
+	CHECK(uart_rx_available() == sizeof(line));
+	CHECK(uart_rx_read(got, sizeof(got)) == sizeof(line));
+	CHECK(memcmp(got, line, sizeof(line)) == 0);
+}
+
+static void test_ring_full(void){
+	static u8 line[UART_RX_BUFFER_SIZE + 8];
+	static char got[sizeof(line)];
+	uart_rx_stats_t stats;
+	unsigned int len;
+
+	setup();
+	memset(line, 'x', sizeof(line));
+	line[sizeof(line) - 1] = 'y';
+	uartlite_sim_feed(line, sizeof(line));
+	/*
+	 * Nobody reads: the ring fills up and the rest waits in the FIFO.
+	 */
+	while (uartlite_sim.line_in_pos < sizeof(line)) {
+		uart_rx_poll();
+	}
+	uart_rx_poll();
+	uart_rx_get_stats(&stats);
+	CHECK(stats.ring_full > 0);
+	CHECK(uart_rx_available() == UART_RX_BUFFER_SIZE);
+	len = 0;
+	while (len < sizeof(line)) {
+		len += uart_rx_read(&got[len], sizeof(line) - len);
+	}
+	CHECK(got[sizeof(line) - 1] == 'y');
+	CHECK(uartlite_sim.rx_overruns == 0);
+}
+
+static void test_frame_parser(void){
+	unsigned char frame[BEAT_FRAME_SIZE];
+	unsigned char stream[4 * BEAT_FRAME_SIZE + 3];
+	beat_rx_t rx;
+	size_t len = 0, i;
+	int got = 0, k;
+
+	/*
+	 * Garbage, a corrupted frame, a good one, a frame with a sync byte in
+	 * its payload right after a lone sync byte, and a skipped number.
+	 */
+	stream[len++] = 0x00;
+	stream[len++] = BEAT_FRAME_SYNC;
+	beat_frame_encode(frame, 0, beats[0]);
+	frame[20] ^= 0x10;
+	memcpy(&stream[len], frame, BEAT_FRAME_SIZE);
+	len += BEAT_FRAME_SIZE;
+	beat_frame_encode(frame, 1, beats[1]);
+	memcpy(&stream[len], frame, BEAT_FRAME_SIZE);
+	len += BEAT_FRAME_SIZE;
+	stream[len++] = BEAT_FRAME_SYNC;
+	beat_frame_encode(frame, 2, beats[2]);
+	memcpy(&stream[len], frame, BEAT_FRAME_SIZE);
+	len += BEAT_FRAME_SIZE;
+	beat_frame_encode(frame, 5, beats[5]);
+	memcpy(&stream[len], frame, BEAT_FRAME_SIZE);
+	len += BEAT_FRAME_SIZE;
+
+	beat_rx_init(&rx);
+	for (i=0; i < len; i++){
+		if (beat_rx_put(&rx, stream[i])) {
+			static const unsigned long seqs[] = { 1, 2, 5 };
+			CHECK(got < 3 && rx.seq == seqs[got]);
+			for (k=0; k < BEAT_NUM_FEATURES; k++){
+				CHECK(rx.features[k] == beats[rx.seq][k]);
+			}
+			got++;
+		}
+	}
+	CHECK(got == 3);
+	CHECK(rx.stats.frames == 3);
+	CHECK(rx.stats.crc_errors == 1);
+	CHECK(rx.stats.lost_beats == 2);
+}
+
+/*
+ * Decode the result frames sent so far into classes[].
+ */
+static int decode_results(int *classes, int max){
+	const u8 *f = uartlite_sim.line_out;
+	size_t pos = 0, len = uartlite_sim.line_out_len;
+	int beats = 0;
+
+	while (pos + RESULT_HEADER_SIZE <= len) {
+		unsigned int payload = f[pos + 8], i, run_size;
+		unsigned long beat;
+
+		if (f[pos] != RESULT_FRAME_SYNC ||
+				pos + RESULT_HEADER_SIZE + payload + RESULT_CRC_SIZE > len) {
+			break;
+		}
+		beat = f[pos + 4] | (f[pos + 5] << 8);
+		run_size = (f[pos + 1] & RESULT_FLAG_CONFIDENCE) ? 2 : 1;
+		for (i=0; i < payload; i += run_size){
+			u8 run = f[pos + RESULT_HEADER_SIZE + i];
+			int n;
+			for (n=0; n < RESULT_RUN_LENGTH(run) && beat < (unsigned long) max; n++){
+				classes[beat++] = RESULT_RUN_CLASS(run);
+				beats++;
+			}
+		}
+		pos += RESULT_HEADER_SIZE + payload + RESULT_CRC_SIZE;
+	}
+	return beats;
+}
+
+/*
+ * One beat at a time: the host sends the next beat when the class of the
+ * previous one has arrived. Latency is from the last byte of the beat
+ * frame on the line to the last byte of its result frame.
+ */
+static void test_ingest_latency(void){
+	static u8 frames[NUM_BEATS][BEAT_FRAME_SIZE];
+	int classes[NUM_BEATS];
+	unsigned long sent_at, total = 0, worst = 0, start;
+	int i;
+
+	setup();
+	ingest_init(RESULT_FLAG_CONFIDENCE);
+	start = uartlite_sim.ticks;
+	for (i=0; i < NUM_BEATS; i++){
+		beat_frame_encode(frames[i], i, beats[i]);
+		uartlite_sim_feed(frames[i], BEAT_FRAME_SIZE);
+		while (uartlite_sim.line_in_pos < BEAT_FRAME_SIZE) {
+			uartlite_sim_run(1);
+			ingest_poll();
+		}
+		sent_at = uartlite_sim.ticks;
+		while (decode_results(classes, NUM_BEATS) <= i) {
+			uartlite_sim_run(1);
+			ingest_poll();
+		}
+		total += uartlite_sim.ticks - sent_at;
+		if (uartlite_sim.ticks - sent_at > worst) {
+			worst = uartlite_sim.ticks - sent_at;
+		}
+	}
+	for (i=0; i < NUM_BEATS; i++){
+		CHECK(classes[i] == expected[i]);
+	}
+	/*
+	 * The answer to a lone beat is one result frame of a single run.
+	 */
+	CHECK(worst / CHARS_PERIOD <= RESULT_HEADER_SIZE + 2 + RESULT_CRC_SIZE + 2);
+	printf("stop-and-wait: latency %.1f char times (max %.1f), %.2f beats per 1000 char times\n",
+			(double) total / NUM_BEATS / CHARS_PERIOD, (double) worst / CHARS_PERIOD,
+			1000.0 * NUM_BEATS * CHARS_PERIOD / (uartlite_sim.ticks - start));
+}
+
+/*
+ * All the beats back to back: the link runs at the speed of the line.
+ */
+static void test_ingest_stream(void){
+	static u8 stream[NUM_BEATS * BEAT_FRAME_SIZE];
+	int classes[NUM_BEATS];
+	beat_rx_stats_t stats;
+	unsigned long start;
+	int i, done = 0;
+
+	setup();
+	ingest_init(RESULT_FLAG_CONFIDENCE);
+	for (i=0; i < NUM_BEATS; i++){
+		beat_frame_encode(&stream[i * BEAT_FRAME_SIZE], i, beats[i]);
+	}
+	uartlite_sim_feed(stream, sizeof(stream));
+	start = uartlite_sim.ticks;
+	while (done < NUM_BEATS && uartlite_sim.ticks - start < 2 * sizeof(stream) * CHARS_PERIOD) {
+		uartlite_sim_run(1);
+		done += ingest_poll();
+	}
+	while (decode_results(classes, NUM_BEATS) < NUM_BEATS &&
+			uartlite_sim.ticks - start < 3 * sizeof(stream) * CHARS_PERIOD) {
+		uartlite_sim_run(1);
+		ingest_poll();
+	}
+	ingest_get_stats(&stats);
+	CHECK(done == NUM_BEATS);
+	CHECK(stats.frames == NUM_BEATS && stats.crc_errors == 0);
+	CHECK(decode_results(classes, NUM_BEATS) == NUM_BEATS);
+	for (i=0; i < NUM_BEATS; i++){
+		CHECK(classes[i] == expected[i]);
+	}
+	CHECK(uartlite_sim.rx_overruns == 0);
+	printf("streaming:     %.2f beats per 1000 char times (line limit %.2f)\n",
+			1000.0 * NUM_BEATS * CHARS_PERIOD / (uartlite_sim.ticks - start),
+			1000.0 / BEAT_FRAME_SIZE);
+}
+
+int main(void){
+	RNA35b_initialize();
+	make_beats();
+	test_ring_order_and_wrap();
+	test_partial_run_visible();
+	test_ring_full();
+	test_frame_parser();
+	test_ingest_latency();
+	test_ingest_stream();
+	uartlite_sim_free();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
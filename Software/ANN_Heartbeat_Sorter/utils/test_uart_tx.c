@@ -0,0 +1,172 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host test of the UART TX ring buffer (uart_tx.c) running over the real
+ * UART Lite driver and the simulated UART Lite registers.
+ *
+ * Build (from this directory):
+ *   U=../../standalone_bsp/microblaze_0/libsrc/uartlite_v2_01_a/src
+ *   gcc -Isim -I../src -I../../standalone_bsp/microblaze_0/include -I$U
+ *       test_uart_tx.c uartlite_sim.c ../src/uart_tx.c
+ *       $U/xuartlite.c $U/xuartlite_intr.c $U/xuartlite_l.c $U/xuartlite_stats.c
+ *       -o test_uart_tx
+ *
+ * @file test_uart_tx.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "xuartlite.h"
+#include "xuartlite_l.h"
+#include "uart_tx.h"
+#include "uartlite_sim.h"
+
+/*
+ * Line speed of the model: bus accesses per character.
+ */
+#define CHARS_PERIOD            50
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static XUartLite uart;
+static XUartLite_Config uart_config = { 0, UARTLITE_SIM_BASEADDR, 9600, 0, 0, 8 };
+
+static const char beat_line[] = "S Supraventricular Ectopic Beat\r\n";
+
+static void setup(int policy){
+	uartlite_sim_reset(CHARS_PERIOD);
+	XUartLite_CfgInitialize(&uart, &uart_config, UARTLITE_SIM_BASEADDR);
+	uart_tx_init(&uart, policy);
+}
+
+/*
+ * Let the line run, taking the UART interrupts as the processor would.
+ */
+static void drain(void){
+	while (uart_tx_pending() != 0 || uartlite_sim.tx_count != 0) {
+		uartlite_sim_run(1);
+		if (uartlite_sim_take_irq()) {
+			XUartLite_InterruptHandler(&uart);
+		}
+	}
+}
+
+static void test_order_and_wrap(void){
+	char expected[8 * UART_TX_BUFFER_SIZE];
+	size_t len = 0;
+	int i;
+
+	setup(UART_TX_BLOCK);
+	for (i=0; len + sizeof(beat_line) < sizeof(expected); i++){
+		CHECK(uart_tx_print(beat_line) == strlen(beat_line));
+		memcpy(&expected[len], beat_line, strlen(beat_line));
+		len += strlen(beat_line);
+	}
+	drain();
+	CHECK(uartlite_sim.line_out_len == len);
+	CHECK(memcmp(uartlite_sim.line_out, expected, len) == 0);
+	CHECK(uartlite_sim.tx_dropped == 0);
+}
+
+static void test_write_does_not_wait(void){
+	unsigned long accesses;
+
+	setup(UART_TX_DROP);
+	accesses = uartlite_sim.accesses;
+	uart_tx_print(beat_line);
+	/*
+	 * Queueing a beat touches the UART a few times to fill its FIFO, far
+	 * less than the time it takes to send the line.
+	 */
+	CHECK(uartlite_sim.accesses - accesses < strlen(beat_line) * CHARS_PERIOD / 4);
+	printf("queued write:  %lu bus accesses per beat line\n",
+			uartlite_sim.accesses - accesses);
+
+	uartlite_sim_reset(CHARS_PERIOD);
+	XUartLite_CfgInitialize(&uart, &uart_config, UARTLITE_SIM_BASEADDR);
+	accesses = uartlite_sim.accesses;
+	{
+		const char *p = beat_line;
+		while (*p) {
+			XUartLite_SendByte(UARTLITE_SIM_BASEADDR, *p++);
+		}
+	}
+	printf("polled print:  %lu bus accesses per beat line\n",
+			uartlite_sim.accesses - accesses);
+}
+
+static void test_drop_policy(void){
+	uart_tx_stats_t stats;
+	unsigned int queued = 0, dropped = 0;
+	int i;
+
+	setup(UART_TX_DROP);
+	/*
+	 * No time passes on the line: the buffer fills and the rest is dropped
+	 * whole, never split.
+	 */
+	for (i=0; i < 2 * UART_TX_BUFFER_SIZE / (int) strlen(beat_line); i++){
+		if (uart_tx_print(beat_line) != 0) {
+			queued++;
+		} else {
+			dropped++;
+		}
+	}
+	uart_tx_get_stats(&stats);
+	CHECK(dropped > 0);
+	CHECK(stats.writes_dropped == dropped);
+	CHECK(stats.bytes_dropped == dropped * strlen(beat_line));
+	CHECK(stats.bytes_queued == queued * strlen(beat_line));
+	CHECK(stats.high_water <= UART_TX_BUFFER_SIZE);
+	drain();
+	uart_tx_get_stats(&stats);
+	CHECK(stats.bytes_sent == stats.bytes_queued);
+	CHECK(uartlite_sim.line_out_len == queued * strlen(beat_line));
+	CHECK(uart_tx_write(beat_line, UART_TX_BUFFER_SIZE + 1) == 0);
+}
+
+static void test_block_policy(void){
+	uart_tx_stats_t stats;
+	int i, beats = 4 * UART_TX_BUFFER_SIZE / (int) strlen(beat_line);
+
+	setup(UART_TX_BLOCK);
+	for (i=0; i < beats; i++){
+		CHECK(uart_tx_print(beat_line) == strlen(beat_line));
+	}
+	uart_tx_flush();
+	drain();
+	uart_tx_get_stats(&stats);
+	CHECK(stats.writes_blocked > 0);
+	CHECK(stats.writes_dropped == 0);
+	CHECK(stats.bytes_sent == beats * strlen(beat_line));
+	CHECK(uartlite_sim.line_out_len == beats * strlen(beat_line));
+}
+
+int main(void){
+	test_order_and_wrap();
+	test_write_does_not_wait();
+	test_drop_policy();
+	test_block_policy();
+	uartlite_sim_free();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
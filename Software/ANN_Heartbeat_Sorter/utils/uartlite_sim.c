@@ -0,0 +1,186 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Register model of the UART Lite for host tests.
+ *
+ * @file uartlite_sim.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xuartlite_l.h"
+#include "uartlite_sim.h"
+
+uartlite_sim_t uartlite_sim;
+
+/*
+ * The drivers' assertions end up here.
+ */
+unsigned int Xil_AssertStatus;
+
+void Xil_Assert(const char *File, int Line){
+	fprintf(stderr, "Assertion failed: %s:%d\n", File, Line);
+	abort();
+}
+
+void uartlite_sim_reset(unsigned int chars_period){
+	free(uartlite_sim.line_out);
+	memset(&uartlite_sim, 0, sizeof(uartlite_sim));
+	uartlite_sim.chars_period = chars_period ? chars_period : 1;
+}
+
+void uartlite_sim_free(void){
+	free(uartlite_sim.line_out);
+	uartlite_sim.line_out = NULL;
+	uartlite_sim.line_out_len = 0;
+	uartlite_sim.line_out_cap = 0;
+}
+
+void uartlite_sim_feed(const u8 *data, size_t len){
+	uartlite_sim.line_in = data;
+	uartlite_sim.line_in_len = len;
+	uartlite_sim.line_in_pos = 0;
+}
+
+int uartlite_sim_take_irq(void){
+	int irq = uartlite_sim.irq;
+	uartlite_sim.irq = 0;
+	return irq;
+}
+
+static void sim_raise_irq(void){
+	if (uartlite_sim.control & XUL_CR_ENABLE_INTR) {
+		uartlite_sim.irq = 1;
+	}
+}
+
+/*
+ * One character time: shift a byte out of the TX FIFO and one into the
+ * RX FIFO. The UART Lite interrupts when the TX FIFO becomes empty and
+ * while the RX FIFO holds data.
+ */
+static void sim_char_time(void){
+	uartlite_sim_t *u = &uartlite_sim;
+
+	if (u->tx_count > 0) {
+		if (u->line_out_len == u->line_out_cap) {
+			u->line_out_cap = u->line_out_cap ? 2 * u->line_out_cap : 256;
+			u->line_out = (u8 *) realloc(u->line_out, u->line_out_cap);
+		}
+		u->line_out[u->line_out_len++] = u->tx_fifo[0];
+		memmove(&u->tx_fifo[0], &u->tx_fifo[1], --u->tx_count);
+		if (u->tx_count == 0) {
+			sim_raise_irq();
+		}
+	}
+	if (u->line_in_pos < u->line_in_len) {
+		if (u->rx_count == UARTLITE_SIM_FIFO_SIZE) {
+			u->overrun = 1;
+			u->rx_overruns++;
+		} else {
+			u->rx_fifo[(u->rx_head + u->rx_count) % UARTLITE_SIM_FIFO_SIZE] =
+					u->line_in[u->line_in_pos];
+			u->rx_count++;
+		}
+		u->line_in_pos++;
+	}
+	if (u->rx_count > 0) {
+		sim_raise_irq();
+	}
+}
+
+void uartlite_sim_run(unsigned long ticks){
+	unsigned long to_char;
+
+	/*
+	 * Jump from one character time to the next.
+	 */
+	while (ticks > 0) {
+		to_char = uartlite_sim.chars_period -
+				uartlite_sim.ticks % uartlite_sim.chars_period;
+		if (to_char > ticks) {
+			uartlite_sim.ticks += ticks;
+			break;
+		}
+		uartlite_sim.ticks += to_char;
+		ticks -= to_char;
+		sim_char_time();
+	}
+}
+
+u32 sim_bus_read(u32 Addr){
+	uartlite_sim_t *u = &uartlite_sim;
+	u32 value = 0;
+
+	u->accesses++;
+	uartlite_sim_run(1);
+	switch (Addr - UARTLITE_SIM_BASEADDR) {
+	case XUL_RX_FIFO_OFFSET:
+		if (u->rx_count > 0) {
+			value = u->rx_fifo[u->rx_head];
+			u->rx_head = (u->rx_head + 1) % UARTLITE_SIM_FIFO_SIZE;
+			u->rx_count--;
+		}
+		break;
+	case XUL_STATUS_REG_OFFSET:
+		if (u->rx_count > 0) {
+			value |= XUL_SR_RX_FIFO_VALID_DATA;
+		}
+		if (u->rx_count == UARTLITE_SIM_FIFO_SIZE) {
+			value |= XUL_SR_RX_FIFO_FULL;
+		}
+		if (u->tx_count == 0) {
+			value |= XUL_SR_TX_FIFO_EMPTY;
+		}
+		if (u->tx_count == UARTLITE_SIM_FIFO_SIZE) {
+			value |= XUL_SR_TX_FIFO_FULL;
+		}
+		if (u->control & XUL_CR_ENABLE_INTR) {
+			value |= XUL_SR_INTR_ENABLED;
+		}
+		if (u->overrun) {
+			value |= XUL_SR_OVERRUN_ERROR;
+			u->overrun = 0;
+		}
+		break;
+	default:
+		break;
+	}
+	return value;
+}
+
+void sim_bus_write(u32 Addr, u32 Value){
+	uartlite_sim_t *u = &uartlite_sim;
+
+	u->accesses++;
+	uartlite_sim_run(1);
+	switch (Addr - UARTLITE_SIM_BASEADDR) {
+	case XUL_TX_FIFO_OFFSET:
+		if (u->tx_count < UARTLITE_SIM_FIFO_SIZE) {
+			u->tx_fifo[u->tx_count++] = (u8) Value;
+		} else {
+			u->tx_dropped++;
+		}
+		break;
+	case XUL_CONTROL_REG_OFFSET:
+		if (Value & XUL_CR_FIFO_TX_RESET) {
+			u->tx_count = 0;
+		}
+		if (Value & XUL_CR_FIFO_RX_RESET) {
+			u->rx_count = 0;
+			u->rx_head = 0;
+		}
+		u->control = Value & XUL_CR_ENABLE_INTR;
+		break;
+	default:
+		break;
+	}
+}
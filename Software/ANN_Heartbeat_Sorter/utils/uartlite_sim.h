@@ -0,0 +1,78 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Register model of the UART Lite for host tests: 16 byte RX and TX FIFOs,
+ * status and control registers, and a serial line that moves one character
+ * each "chars_period" bus accesses (or uartlite_sim_run() calls). The real
+ * uartlite_v2_01_a driver runs on top of it through sim/xil_io.h.
+ *
+ * @file uartlite_sim.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef UARTLITE_SIM_H
+#define UARTLITE_SIM_H
+
+#include <stddef.h>
+#include "xil_types.h"
+
+#define UARTLITE_SIM_BASEADDR   0x84000000
+#define UARTLITE_SIM_FIFO_SIZE  16
+
+typedef struct {
+	u8 tx_fifo[UARTLITE_SIM_FIFO_SIZE];
+	int tx_count;
+	u8 rx_fifo[UARTLITE_SIM_FIFO_SIZE];
+	int rx_head;
+	int rx_count;
+	u32 control;
+	int overrun;
+	int irq;                        /* interrupt raised, not yet taken */
+	unsigned long accesses;         /* bus accesses so far */
+	unsigned long ticks;            /* line time so far */
+	unsigned int chars_period;      /* ticks per character on the line */
+	unsigned long tx_dropped;       /* TX FIFO writes while full */
+	unsigned long rx_overruns;      /* bytes lost on a full RX FIFO */
+	/* bytes that left the TX FIFO */
+	u8 *line_out;
+	size_t line_out_len;
+	size_t line_out_cap;
+	/* bytes waiting to arrive to the RX FIFO */
+	const u8 *line_in;
+	size_t line_in_len;
+	size_t line_in_pos;
+} uartlite_sim_t;
+
+extern uartlite_sim_t uartlite_sim;
+
+/**
+ * Reset the model. Each bus access and each uartlite_sim_run() tick
+ * advances the line; a character moves every chars_period ticks.
+ */
+void uartlite_sim_reset(unsigned int chars_period);
+
+/**
+ * Advance the line by a number of ticks without any bus access, as when
+ * the processor is busy with something else.
+ */
+void uartlite_sim_run(unsigned long ticks);
+
+/**
+ * Feed bytes to the receive side of the line.
+ */
+void uartlite_sim_feed(const u8 *data, size_t len);
+
+/**
+ * Return and clear the interrupt request.
+ */
+int uartlite_sim_take_irq(void);
+
+void uartlite_sim_free(void);
+
+#endif /* UARTLITE_SIM_H */
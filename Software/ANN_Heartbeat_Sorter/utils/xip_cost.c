@@ -0,0 +1,189 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Boot time saved and inference time lost by leaving the network tables
+ * in flash (src/lscript_xip.ld) instead of loading them to DDR
+ * (src/lscript.ld). The size of the .model_rodata section is read from an
+ * ELF file, the MicroBlaze application or just RNA35b.o built for the
+ * host, and set against the access times of the memories of the board:
+ *
+ *   boot        the bootloader no longer reads the tables from flash, as
+ *               SREC text or as the bytes of a binary image, nor writes
+ *               them to DDR
+ *   inference   RNA35b() reads every double of the tables once per beat,
+ *               with two 32 bit reads, each of four 8 bit flash accesses
+ *               instead of one DDR access (there is no data cache)
+ *
+ * The access times are estimates from the EMC and MPMC settings of
+ * system.mhs; -f and -d take measured ones.
+ *
+ * Build (from this directory):
+ *   gcc -O2 xip_cost.c -o xip_cost
+ *
+ * Usage:
+ *   xip_cost [-f flash_ns] [-d ddr_ns] [-r beats_per_min] executable.elf|RNA35b.o
+ *       flash_ns is the time of an 8 bit flash access, ddr_ns that of a
+ *       32 bit uncached DDR access, beats_per_min the heart rate for the
+ *       share of each second lost to flash reads.
+ *
+ * @file xip_cost.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * An 8 bit access of the flash: TAVDV 110 ns plus the EMC and bus cycles
+ * at 50 MHz. An uncached 32 bit read or write of the DDR through the MPMC.
+ */
+#define FLASH_NS_PER_BYTE       150.0
+#define DDR_NS_PER_WORD         240.0
+#define DEFAULT_BEATS_PER_MIN   200.0
+
+/* Data bytes per S3 record in an SREC made by objcopy, and the text of a
+   record besides its data: type, count, address, checksum and CR LF */
+#define SREC_RECORD_BYTES       16
+#define SREC_RECORD_OVERHEAD    16
+
+#define MAX_INPUT_BYTES         (16 * 1024 * 1024)
+
+/*
+ * Field of the given size of an ELF file in its byte order.
+ */
+static unsigned long elf_field (const unsigned char *p, int size, int big)
+{
+	unsigned long v = 0;
+	int i;
+
+	for (i = 0; i < size; i++)
+		v |= (unsigned long)p[big ? i : size - 1 - i] << (8 * (size - 1 - i));
+	return v;
+}
+
+/*
+ * Sizes of the .model_rodata section and of all the sections loaded from
+ * the file (code and initialized data) of a 32 or 64 bit ELF file.
+ * Returns -1 if it is not one.
+ */
+static int section_sizes (const unsigned char *file, long len,
+		unsigned long *model, unsigned long *loaded)
+{
+	int wide, big;
+	unsigned long shoff, shentsize, shnum, shstrndx, strtab, i;
+	const unsigned char *sh;
+
+	if (len < 64 || memcmp (file, "\177ELF", 4) != 0)
+		return -1;
+	wide = file[4] == 2;
+	big = file[5] == 2;
+	shoff = elf_field (file + (wide ? 40 : 32), wide ? 8 : 4, big);
+	shentsize = elf_field (file + (wide ? 58 : 46), 2, big);
+	shnum = elf_field (file + (wide ? 60 : 48), 2, big);
+	shstrndx = elf_field (file + (wide ? 62 : 50), 2, big);
+	if (shoff + shnum * shentsize > (unsigned long)len || shstrndx >= shnum)
+		return -1;
+
+	sh = file + shoff + shstrndx * shentsize;
+	strtab = elf_field (sh + (wide ? 24 : 16), wide ? 8 : 4, big);
+	*model = *loaded = 0;
+	for (i = 0; i < shnum; i++) {
+		unsigned long name, type, flags, size;
+
+		sh = file + shoff + i * shentsize;
+		name = elf_field (sh, 4, big);
+		type = elf_field (sh + 4, 4, big);
+		flags = elf_field (sh + 8, wide ? 8 : 4, big);
+		size = elf_field (sh + (wide ? 32 : 20), wide ? 8 : 4, big);
+		if (strtab + name >= (unsigned long)len)
+			return -1;
+		if (strcmp ((const char *)file + strtab + name, ".model_rodata") == 0)
+			*model += size;
+		/* SHF_ALLOC, and not SHT_NOBITS (.bss) */
+		if ((flags & 2) && type != 8)
+			*loaded += size;
+	}
+	return 0;
+}
+
+static void usage (void)
+{
+	fprintf (stderr, "usage: xip_cost [-f flash_ns] [-d ddr_ns] [-r beats_per_min] "
+			"executable.elf|RNA35b.o\n");
+	exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+	double flash_ns = FLASH_NS_PER_BYTE, ddr_ns = DDR_NS_PER_WORD;
+	double rate = DEFAULT_BEATS_PER_MIN;
+	double copy_ns, srec_ns, binary_ns, beat_ns;
+	unsigned long model, loaded, doubles, records, srec_text;
+	const char *input = NULL;
+	char label[40];
+	unsigned char *file;
+	long len;
+	int a;
+	FILE *f;
+
+	for (a = 1; a < argc; a++) {
+		if (strcmp (argv[a], "-f") == 0 && a + 1 < argc)
+			flash_ns = atof (argv[++a]);
+		else if (strcmp (argv[a], "-d") == 0 && a + 1 < argc)
+			ddr_ns = atof (argv[++a]);
+		else if (strcmp (argv[a], "-r") == 0 && a + 1 < argc)
+			rate = atof (argv[++a]);
+		else if (argv[a][0] != '-' && input == NULL)
+			input = argv[a];
+		else
+			usage ();
+	}
+	if (input == NULL)
+		usage ();
+
+	file = malloc (MAX_INPUT_BYTES);
+	f = fopen (input, "rb");
+	if (file == NULL || f == NULL) {
+		perror (input);
+		return 1;
+	}
+	len = (long)fread (file, 1, MAX_INPUT_BYTES, f);
+	fclose (f);
+	if (section_sizes (file, len, &model, &loaded) != 0) {
+		fprintf (stderr, "%s: not an ELF file\n", input);
+		return 1;
+	}
+	if (model == 0) {
+		fprintf (stderr, "%s: no .model_rodata section\n", input);
+		return 1;
+	}
+
+	doubles = model / sizeof(double);
+	records = (model + SREC_RECORD_BYTES - 1) / SREC_RECORD_BYTES;
+	srec_text = 2 * model + records * SREC_RECORD_OVERHEAD;
+	copy_ns = (model + 3) / 4 * ddr_ns;
+	srec_ns = srec_text * flash_ns + copy_ns;
+	binary_ns = model * flash_ns + copy_ns;
+	beat_ns = doubles * (2 * 4 * flash_ns - 2 * ddr_ns);
+
+	printf (".model_rodata: %lu bytes, %lu doubles (%.1f%% of the %lu bytes loaded)\n",
+			model, doubles, 100.0 * model / loaded, loaded);
+	printf ("flash %.0f ns per byte, DDR %.0f ns per word\n\n", flash_ns, ddr_ns);
+	printf ("boot saved           bytes read     ms\n");
+	printf ("  SREC            %12lu  %7.2f\n", srec_text, srec_ns / 1e6);
+	printf ("  binary image    %12lu  %7.2f\n", model, binary_ns / 1e6);
+	printf ("inference cost\n");
+	printf ("  %-30s %7.2f  (%.0f ns more per double)\n", "per beat",
+			beat_ns / 1e6, beat_ns / doubles);
+	snprintf (label, sizeof(label), "per second at %.0f beats/min", rate);
+	printf ("  %-30s %7.2f  (%.2f%% of the time)\n",
+			label, beat_ns * rate / 60 / 1e6, beat_ns * rate / 60 / 1e7);
+	return 0;
+}
@@ -43,9 +43,16 @@
 #define CMD_FAST_PROGRAM_SET      0x20
 #define CMD_FAST_PROGRAM_RESET    0x90
 #define CMD_FAST_PROGRAM          0xA0
+#define CMD_WRITE_BUFFER          0x25
+#define CMD_BUFFER_CONFIRM        0x29
+#define CMD_ERASE_SUSPEND         0xB0
+#define CMD_ERASE_RESUME          0x30
 
 #define DQ7FLAG                   0x80
 #define DQ5FLAG                   0x20
+#define DQ1FLAG                   0x02
+
+#define MAX_BUFFER_WORDS          256                   /* The word count of a buffer write is one byte */
 
 /* #define AMD_FAST_PROGRAM  */                 /* Disabled. Atmel has a different fast program sequence. Until then, we disable it to ensure correctness */
 
@@ -58,6 +65,17 @@ static void     AMD_rst_dev ();
 static int8_t   AMD_erase_dev ();
 static int8_t   AMD_blk_erase_dev (uint32_t blkaddr);
 static int8_t   AMD_prog_dev (uint32_t dstoffset, uint8_t *srcaddr, uint32_t nbytes);
+#ifdef FW_CFG_PROG
+static int8_t   AMD_prog_buf (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes);
+#endif
+#ifdef FW_CFG_ERASE
+static int8_t   AMD_blk_erase_start (uint32_t blkaddr);
+static int8_t   AMD_erase_poll (uint8_t wait);
+#endif
+#if defined (FW_CFG_ERASE) && defined (FW_CFG_PROG)
+static void     AMD_erase_suspend ();
+static void     AMD_erase_resume ();
+#endif
 extern void     fl_write (uint32_t addr, uint32_t data);
 extern uint32_t fl_read  (uint32_t addr);
 extern uint32_t fl_form_cmd (uint8_t);
@@ -78,16 +96,28 @@ target_ops_t AMD_ops = {
     NULL,
 #endif
 #ifdef FW_CFG_PROG
-    AMD_prog_dev
+    AMD_prog_dev,
+#else
+    NULL,
+#endif
+#if defined (FW_CFG_ERASE) && defined (FW_CFG_PROG)
+    AMD_blk_erase_start,
+    AMD_erase_poll
 #else
+    NULL,
     NULL
 #endif
 };
 
-uint32_t dq7flag, dq5flag;
+uint32_t dq7flag, dq5flag, dq1flag;
 uint32_t unlockaddr_1, unlockaddr_2;
 static uint8_t  addr_step;
 static uint8_t  addr_shift;
+static uint32_t wbufsiz;                                                /* Bytes of the bus per buffer write, 0 if none */
+static uint8_t  erase_busy;
+#ifdef FW_CFG_ERASE
+static uint32_t erase_blkaddr;                                          /* Block of the erase started by AMD_blk_erase_start */
+#endif
 
 /*==============================================================================*/
 /* Function definitions                                                         */
@@ -96,8 +126,14 @@ static void AMD_init_dev_params (dev_info_t *devinfo)
 {
     dq7flag = fl_form_cmd (DQ7FLAG);
     dq5flag = fl_form_cmd (DQ5FLAG);
+    dq1flag = fl_form_cmd (DQ1FLAG);
     addr_step = devinfo->addr_step;
     addr_shift = devinfo->addr_shift;
+    wbufsiz = 0;                                                        /* CFI gives log2 of the buffer bytes of one part */
+    if (devinfo->cfiqry.max_write_buf_siz && 
+        (devinfo->num_parts << devinfo->cfiqry.max_write_buf_siz) <= MAX_BUFFER_WORDS * addr_step)
+        wbufsiz = devinfo->num_parts << devinfo->cfiqry.max_write_buf_siz;
+    erase_busy = 0;
     if ((devinfo->part_mode) == PART_MODE_08) {
         unlockaddr_1 = ADDR_AAA;
         unlockaddr_2 = ADDR_555;
@@ -152,8 +188,16 @@ static int8_t AMD_erase_dev ()
  */
 static int8_t AMD_blk_erase_dev (uint32_t blkaddr)
 {
-    uint32_t data;
+    AMD_blk_erase_start (blkaddr);
+    return AMD_erase_poll (1);
+}
 
+/*
+ *      Start the erase of a block and return, for the caller to go on with 
+ *      other work. AMD_erase_poll finishes it.
+ */
+static int8_t AMD_blk_erase_start (uint32_t blkaddr)
+{
     fl_cmdwrite (unlockaddr_1, CMD_AA);
     fl_cmdwrite (unlockaddr_2, CMD_55);
     fl_cmdwrite (unlockaddr_1, CMD_ERASE);
@@ -161,13 +205,33 @@ static int8_t AMD_blk_erase_dev (uint32_t blkaddr)
     fl_cmdwrite (unlockaddr_2, CMD_55);
     fl_cmdwrite (blkaddr, CMD_AUTO_BLOCK_ERASE);
 
-    blkaddr = (blkaddr << addr_shift);                                  /* Convert absolute block address, into logical address that can be fed to EMC */
+    erase_blkaddr = blkaddr;
+    erase_busy = 1;
+    return 0;
+}
+
+/*
+ *      Check on the erase started by AMD_blk_erase_start, or wait for it.
+ *      Returns ERR_FLASH_BUSY if it is still going and we did not wait.
+ */
+static int8_t AMD_erase_poll (uint8_t wait)
+{
+    uint32_t data, blkaddr;
+
+    if (!erase_busy)
+        return 0;
+
+    blkaddr = (erase_blkaddr << addr_shift);                            /* Convert absolute block address, into logical address that can be fed to EMC */
 
     data = fl_read (blkaddr);                                           /* Check for errors and timeouts */
-    while (((data & dq7flag) != dq7flag) && 
+    while (wait && ((data & dq7flag) != dq7flag) && 
            ((data & dq5flag) != dq5flag)) 
         data = fl_read (blkaddr);
 
+    if (((data & dq7flag) != dq7flag) && ((data & dq5flag) != dq5flag))
+        return ERR_FLASH_BUSY;
+
+    erase_busy = 0;
     data = fl_read (blkaddr);
     if ((data & dq7flag) == dq7flag)
         return 0;
@@ -186,19 +250,38 @@ static int8_t AMD_blk_erase_dev (uint32_t blkaddr)
 #ifdef FW_CFG_PROG
 static int8_t AMD_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
 {
-    uint32_t data, fldata;
+    uint32_t data, fldata, n;
     uint32_t *srcp32, *srcp16, *srcp8;
     int8_t err = 0;
 
+#ifdef FW_CFG_ERASE
+    if (erase_busy)                                                     /* An erase ahead of us, in another block */
+        AMD_erase_suspend ();
+#endif
+
+    if ((nbytes % addr_step))
+        nbytes += (addr_step - (nbytes % addr_step));                   /* Align to address boundary */
+
+    if (wbufsiz) {
+        while (nbytes) {
+            n = wbufsiz - (offset & (wbufsiz - 1));                     /* Up to the end of this write buffer */
+            if (n > nbytes)
+                n = nbytes;
+            if ((err = AMD_prog_buf (offset, srcaddr, n)))
+                break;
+            offset += n;
+            nbytes -= n;
+            srcaddr = (uint8_t*)(srcaddr + n);
+        }
+        nbytes = 0;
+    }
+
 #ifdef AMD_FAST_PROGRAM                                                 /* Fast program setup */
     fl_cmdwrite (unlockaddr_1, CMD_AA);
     fl_cmdwrite (unlockaddr_2, CMD_55);
     fl_cmdwrite (unlockaddr_1, CMD_FAST_PROGRAM_SET);
 #endif
 
-    if ((nbytes % addr_step))
-        nbytes += (addr_step - (nbytes % addr_step));                   /* Align to address boundary */
-
     while (nbytes) {
         data = mem_read (srcaddr);                                      /* Read FLASH_BUS_WIDTH amount of data from memory and store in data */
         
@@ -220,8 +303,10 @@ static int8_t AMD_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
         if ((fldata & dq7flag) != (data &dq7flag)) {
             if ((fldata & dq5flag) == dq5flag) {
                 fldata = fl_read (offset);
-                if ((fldata & dq7flag) != (data & dq7flag))
-                    return ERR_FLASH_TIMEOUT;
+                if ((fldata & dq7flag) != (data & dq7flag)) {
+                    err = ERR_FLASH_TIMEOUT;
+                    break;
+                }
             }
         }
 
@@ -233,8 +318,71 @@ static int8_t AMD_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
 #ifdef AMD_FAST_PROGRAM
     fl_cmdwrite (0, CMD_FAST_PROGRAM_RESET);                            /* Reset Fast-Program Mode */
     fl_cmdwrite (0, CMD_READ_RESET);            
+#endif
+#ifdef FW_CFG_ERASE
+    if (erase_busy)
+        AMD_erase_resume ();
 #endif
     return err;
 }
+
+/*
+ *      Program nbytes from offset, all within one write buffer, with a single
+ *      Write to Buffer sequence: one unlock, one command, then only the data.
+ *      Polling is done at the last address written.
+ */
+static int8_t AMD_prog_buf (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
+{
+    uint32_t data, fldata, sa;
+
+    sa = offset >> addr_shift;                                          /* Any address within the sector will do */
+    fl_cmdwrite (unlockaddr_1, CMD_AA);
+    fl_cmdwrite (unlockaddr_2, CMD_55);
+    fl_cmdwrite (sa, CMD_WRITE_BUFFER);
+    fl_cmdwrite (sa, (nbytes / addr_step) - 1);                         /* Word count - 1, to every part */
+
+    for (;;) {
+        data = mem_read (srcaddr);
+        fl_write (offset, data);
+        if ((nbytes -= addr_step) == 0)
+            break;
+        offset += addr_step;
+        srcaddr = (uint8_t*)(srcaddr + addr_step);
+    }
+    fl_cmdwrite (sa, CMD_BUFFER_CONFIRM);
+
+    fldata = fl_read (offset);                                          /* Check for errors, timeouts and aborts */
+    while (((fldata & dq7flag) != (data & dq7flag)) && 
+           ((fldata & dq5flag) != dq5flag) &&
+           ((fldata & dq1flag) != dq1flag))
+        fldata = fl_read (offset);
+
+    fldata = fl_read (offset);
+    if ((fldata & dq7flag) != (data & dq7flag)) {
+        fl_cmdwrite (unlockaddr_1, CMD_AA);                             /* Write to Buffer Abort Reset */
+        fl_cmdwrite (unlockaddr_2, CMD_55);
+        fl_cmdwrite (unlockaddr_1, CMD_READ_RESET);
+        return ((fldata & dq5flag) == dq5flag) ? ERR_FLASH_TIMEOUT : ERR_FLASH_PROG;
+    }
+    return 0;
+}
+
+#ifdef FW_CFG_ERASE
+/*
+ *      Suspend the erase started by AMD_blk_erase_start, to program other
+ *      blocks. DQ7 of the block reads 1 once it is suspended (or done).
+ */
+static void AMD_erase_suspend ()
+{
+    fl_cmdwrite (erase_blkaddr, CMD_ERASE_SUSPEND);
+    while ((fl_read (erase_blkaddr << addr_shift) & dq7flag) != dq7flag)
+        ;
+}
+
+static void AMD_erase_resume ()
+{
+    fl_cmdwrite (erase_blkaddr, CMD_ERASE_RESUME);
+}
+#endif  /* FW_CFG_ERASE */
 #endif  /* FW_CFG_PROG */
 #endif  /* (FW_CFG_DEV_OPERATE) && (FW_SUPPORT_AMD) */
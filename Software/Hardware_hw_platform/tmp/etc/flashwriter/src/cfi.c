@@ -244,6 +244,22 @@ int8_t cfi_init (uint32_t ba, uint8_t bw)
             ;
     }
 
+    /*
+     * Can blocks be programmed while an erase is suspended ? Intel: bit 1
+     * (erase suspend) of the optional features at P+5 and bit 0 (program
+     * after erase suspend) at P+9. AMD: 2 (read/write) in the erase suspend 
+     * field at P+6.
+     */
+    devinfo.erase_suspend = 0;
+    if (devinfo.cfiqry.pri_addr) {
+        if (devinfo.cfiqry.pri_vendor_id == 1) 
+            devinfo.erase_suspend = 
+                ((fl_read ((devinfo.cfiqry.pri_addr + 5) << cfi_shift) & fl_form_cmd (0x02)) == fl_form_cmd (0x02)) &&
+                ((fl_read ((devinfo.cfiqry.pri_addr + 9) << cfi_shift) & fl_form_cmd (0x01)) == fl_form_cmd (0x01));
+        else if (devinfo.cfiqry.pri_vendor_id == 2)
+            devinfo.erase_suspend = (fl_read ((devinfo.cfiqry.pri_addr + 6) << cfi_shift) == fl_form_cmd (0x02));
+    }
+
 #if 0
     /* 
      * For Intel, find out some more about block lock/unlock support
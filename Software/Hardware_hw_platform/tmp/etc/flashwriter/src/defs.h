@@ -22,7 +22,9 @@
 #ifndef _FS_DEFS_H
 #define _FS_DEFS_H
 
+#ifndef FW_HOST_SIM                             /* utils/flash_sim.c gives the profile on the command line */
 #include "config.h"
+#endif
 
 /* Debug message macro */
 
@@ -78,4 +80,14 @@
 
 #endif  /* FW_MODE_CFIQRY */
 
+/* 
+ * FW_CFG_ERASE_AHEAD: block erase commands only start erasing, and the blocks
+ * are erased one at a time ahead of the program commands (tg_erase_ahead in 
+ * flash.c). Needs a profile that both erases and programs. The host must end 
+ * with CMD_RST_DEV or CMD_EXIT, which erase whatever was not programmed.
+ */
+#if defined (FW_CFG_ERASE_AHEAD) && !(defined (FW_CFG_ERASE) && defined (FW_CFG_PROG))
+    #undef FW_CFG_ERASE_AHEAD
+#endif
+
 #endif
@@ -34,6 +34,7 @@
 #define ERR_FLASH_PROG          10              /* The flash programming operation errored out                  */
 #define ERR_FLASH_LOCK          11              /* The flash operation ran into a lock error                    */
 #define ERR_FLASH_VOLTAGE       12              /* The flash part ran into a voltage error                      */
+#define ERR_FLASH_BUSY          13              /* A started erase has not finished yet                         */
 
 
 #endif /* FS_ERRORS_H */
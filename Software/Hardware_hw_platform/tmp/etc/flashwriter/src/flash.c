@@ -50,6 +50,8 @@ void    tg_rst_dev ();
 int8_t  tg_erase_dev ();
 int8_t  tg_blk_erase_dev (uint32_t addr, uint32_t nbytes);
 int8_t  tg_prog_dev (uint32_t dstoffset, uint8_t *srcaddr, uint32_t nbytes);
+int8_t  tg_erase_ahead (uint32_t addr, uint32_t nbytes);
+int8_t  tg_erase_flush ();
 int8_t  fl_cfg_rw_mode ();
 int8_t  fl_cfg_cmd_interleave (uint32_t layout);
 
@@ -89,6 +91,13 @@ static cmd_set_t cmdsets[7] = { {0, "No vendor" },
 target_ops_t *the_target;
 #endif
 
+#ifdef FW_CFG_ERASE_AHEAD
+/* Blocks that tg_erase_ahead still has to erase, as offsets in bytes within each part */
+static uint32_t ahead_next, ahead_end;
+static uint32_t ahead_blkoff, ahead_blkend;                             /* The block being erased, while ahead_busy */
+static uint8_t  ahead_busy;
+#endif
+
 /*==============================================================================*/
 /* Function definitions                                                         */
 /*==============================================================================*/
@@ -256,9 +265,153 @@ int8_t tg_blk_erase_dev (uint32_t addr, uint32_t nbytes)
 }
 #endif /* FW_CFG_ERASE */
 
+#ifdef FW_CFG_ERASE_AHEAD
+/*
+ *  fl_find_blk -- Offset and size of the block that holds byte 'off' of each part
+ */
+static int8_t fl_find_blk (uint32_t off, uint32_t *blkoff, uint32_t *blksiz)
+{
+    uint32_t i;
+    uint32_t start, end;
+
+    start = 0;
+    for (i = 0; i < devinfo.flgeo.tot_regions; i++) {
+        end = start + devinfo.flgeo.region[i].nblks * devinfo.flgeo.region[i].blksiz;
+        if (off < end) {
+            *blksiz = devinfo.flgeo.region[i].blksiz;
+            *blkoff = start + ((off - start) / *blksiz) * *blksiz;
+            return 0;
+        }
+        start = end;
+    }
+    return ERR_FLASH_BLK_ERASE;
+}
+
+/*
+ *  ahead_kick -- If no erase is going on, start the one of the next block to erase
+ */
+static int8_t ahead_kick ()
+{
+    int8_t   status;
+    uint32_t siz;
+
+    if (ahead_busy) {
+        if ((status = (*the_target->erasepoll) (0)) == ERR_FLASH_BUSY)
+            return 0;
+        ahead_busy = 0;
+        if (status)
+            return status;
+    }
+    if (ahead_next >= ahead_end)
+        return 0;
+
+    if (fl_find_blk (ahead_next, &ahead_blkoff, &siz))
+        return ERR_FLASH_BLK_ERASE;
+    ahead_blkend = ahead_blkoff + siz;
+    ahead_next = ahead_blkend;
+    if ((status = (*the_target->blkerasestart) (ahead_blkoff >> BYTE_OFFSET_FACTOR (devinfo.part_mode))))
+        return status;
+    ahead_busy = 1;
+    return 0;
+}
+
+/*
+ *  ahead_wait -- Wait for the erase going on, if any
+ */
+static int8_t ahead_wait ()
+{
+    if (!ahead_busy)
+        return 0;
+    ahead_busy = 0;
+    return (*the_target->erasepoll) (1);
+}
+
+/*
+ *  tg_erase_ahead -- Erase the blocks that tg_blk_erase_dev would, but one at a time
+ *  ahead of programming: only the erase of the first block is started here. 
+ *  Each tg_prog_dev then starts the erase of the next block before it returns, 
+ *  so it runs while the host loads more data, and suspends it if it is still 
+ *  going when the next data comes. tg_erase_flush erases what was not programmed.
+ */
+int8_t tg_erase_ahead (uint32_t addr, uint32_t nbytes)
+{
+    int8_t   status;
+    uint32_t low, high, siz;
+
+    if (!the_target || !the_target->blkerasestart || !the_target->erasepoll)
+        return tg_blk_erase_dev (addr, nbytes);
+
+    if ((status = tg_erase_flush ()))
+        return status;
+                                                                                /* Offsets in terms of bytes within each part, as tg_blk_erase_dev */
+    low  = (addr >> devinfo.addr_shift) << BYTE_OFFSET_FACTOR (devinfo.part_mode);
+    high = low + nbytes / devinfo.num_parts;
+
+    if (fl_find_blk (low, &ahead_next, &siz))
+        return ERR_FLASH_BLK_ERASE;
+    ahead_end = ahead_next + siz;
+    if (high > ahead_end) {                                                     /* Up to the block where high falls */
+        if (fl_find_blk (high - 1, &ahead_end, &siz))
+            return ERR_FLASH_BLK_ERASE;
+        ahead_end += siz;
+    }
+    return ahead_kick ();
+}
+
+/*
+ *  tg_erase_flush -- Finish the erases left by tg_erase_ahead
+ */
+int8_t tg_erase_flush ()
+{
+    int8_t status;
+
+    while (ahead_busy || ahead_next < ahead_end) {
+        if ((status = ahead_wait ()) || (status = ahead_kick ())) {
+            ahead_next = ahead_end;
+            return status;
+        }
+    }
+    return 0;
+}
+
+/*
+ *  ahead_prog -- Before programming bytes [low, high) of each part: make sure
+ *  their blocks are erased, and that an erase still going on elsewhere can be
+ *  suspended.
+ */
+static int8_t ahead_prog (uint32_t low, uint32_t high)
+{
+    int8_t status;
+
+    for (;;) {
+        if (ahead_busy && ((ahead_blkoff < high && ahead_blkend > low) || !devinfo.erase_suspend)) {
+            if ((status = ahead_wait ()))
+                return status;
+        } else if (ahead_next < ahead_end && ahead_next < high) {               /* One erase at a time, in order */
+            if ((status = ahead_wait ()) || (status = ahead_kick ()))
+                return status;
+        } else
+            return 0;
+    }
+}
+#endif /* FW_CFG_ERASE_AHEAD */
+
 #ifdef FW_CFG_PROG
 int8_t tg_prog_dev (uint32_t dstoffset, uint8_t *srcaddr, uint32_t nbytes)
 {
+#ifdef FW_CFG_ERASE_AHEAD
+    int8_t   status;
+    uint32_t low;
+
+    if (the_target && the_target->progdev && (ahead_busy || ahead_next < ahead_end)) {
+        low = (dstoffset >> devinfo.addr_shift) << BYTE_OFFSET_FACTOR (devinfo.part_mode);
+        if ((status = ahead_prog (low, low + (nbytes + devinfo.num_parts - 1) / devinfo.num_parts)))
+            return status;
+        if ((status = (*the_target->progdev) (dstoffset, srcaddr, nbytes)))
+            return status;
+        return ahead_kick ();                                                   /* The next block erases while the host loads data */
+    }
+#endif
      if (the_target && the_target->progdev)
         return (*the_target->progdev) (dstoffset, srcaddr, nbytes);
     else
@@ -337,7 +490,9 @@ uint32_t mem_read (uint8_t *srcaddr)
 
 /*
  * Flash low-level interface specifics follow                                   
+ * (host builds with FW_HOST_SIM get them from the simulator in utils/flash_sim.c)
  */
+#ifndef FW_HOST_SIM
 
 uint32_t fl_read_08 (uint32_t addr)
 {
@@ -374,6 +529,7 @@ void fl_write_32 (uint32_t addr, uint32_t data)
 {
     *FLASHP_32 (addr & ALIGN32) = data;
 }
+#endif  /* FW_HOST_SIM */
 
 /*      form_cmd_16_2 
  *      Form a command word for part configuration PART_LAYOUT_16_X_X_2
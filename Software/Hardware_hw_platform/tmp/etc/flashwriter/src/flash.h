@@ -122,6 +122,8 @@ typedef void    (*rst_blk_t      )(uint32_t blkaddr);
 typedef int8_t  (*erase_dev_t    )(void);
 typedef int8_t  (*blk_erase_dev_t)(uint32_t);
 typedef int8_t  (*prog_dev_t     )(uint32_t, uint8_t*, uint32_t);
+typedef int8_t  (*blk_erase_start_t)(uint32_t);
+typedef int8_t  (*erase_poll_t   )(uint8_t wait);
 
 typedef struct target_ops_s {
     init_dev_params_t   initdev;                /* Pointers to interface routines       */
@@ -130,6 +132,8 @@ typedef struct target_ops_s {
     erase_dev_t         erasedev;               /*  .  */
     blk_erase_dev_t     blkerasedev;            /*  .  */
     prog_dev_t          progdev;                /*  .  */
+    blk_erase_start_t   blkerasestart;          /* Start a block erase, without waiting */
+    erase_poll_t        erasepoll;              /* Check on, or wait for, that erase    */
 } target_ops_t;
 
 typedef struct region_info_s {
@@ -156,6 +160,7 @@ typedef struct dev_info_s {
     cfi_qry_t           cfiqry;
     flash_geometry_t    flgeo;
     target_ops_t       *devops;
+    uint8_t             erase_suspend;          /* Blocks can be programmed while an erase is suspended */
 #if 0
     uint32_t            ext_qry_optional_features;   /* Only for Intel */
 #endif
@@ -48,10 +48,15 @@
  *  FW_SUPPORT_INTEL      
  *
  *
+ *  Buffered programming is used when the CFI query reports a write buffer.
+ *  With FW_CFG_ERASE_AHEAD (refer defs.h) block erases overlap the loading 
+ *  of data by the host. utils/flash_sim.c runs both against a CFI flash 
+ *  simulated in RAM.
+ *
  *  Unsupported features:
  *      - Flash layouts - PART_LAYOUT_16_16_08_2, PART_LAYOUT_32_32_16_2, PART_LAYOUT_16_16_08_4, PART_LAYOUT_32_32_16_2, PART_LAYOUT_32_32_08_4 (refer flash.h)
  *      - Mitsubishi algorithms
- *      - Fast/buffered programming
+ *      - Fast programming (AMD unlock bypass)
  *      - Block unlocking/locking/protection for AMD algorithms
  */ 
 
@@ -148,8 +153,9 @@ static char *errmap[] = {
     "The flash erase operation errored out !",                                  /* ERR_FLASH_ERASE              */
     "The flash block erase operation errored out !",                            /* ERR_FLASH_BLK_ERASE          */
     "The flash programming operation errored out !",                            /* ERR_FLASH_PROG               */
-    "The flash operation ran into a lock error !"                               /* ERR_FLASH_LOCK               */
-    "The flash part ran into a voltage error !"                                 /* ERR_FLASH_VOLTAGE            */
+    "The flash operation ran into a lock error !",                              /* ERR_FLASH_LOCK               */
+    "The flash part ran into a voltage error !",                                /* ERR_FLASH_VOLTAGE            */
+    "The flash is still erasing a block !"                                      /* ERR_FLASH_BUSY               */
 };
 
 /* Mailbox access macros */
@@ -191,6 +197,8 @@ extern void     tg_rst_dev ();
 extern int8_t   tg_erase_dev ();
 extern int8_t   tg_blk_erase_dev (uint32_t addr, uint32_t nbytes);
 extern int8_t   tg_prog_dev (uint32_t prog_addr, uint8_t *data_addr, uint32_t data_count);
+extern int8_t   tg_erase_ahead (uint32_t addr, uint32_t nbytes);
+extern int8_t   tg_erase_flush ();
 extern int8_t   cfi_init (uint32_t ba, uint8_t bw);
 extern uint32_t cfi_qry_part_layout ();
 extern dev_info_t devinfo;
@@ -291,6 +299,13 @@ int flashwriter_sm ()
             case CMD_RST_DEV:
                 DPRINTF ("Flashwriter: CMD_RST_DEV...");
                 put_writer_status (STATUS_BUSY);
+#ifdef FW_CFG_ERASE_AHEAD
+                if ((ret = tg_erase_flush ())) {
+                    put_writer_status (STATUS_ERR);
+                    put_writer_param (ERR_CODE_PARAM, ret);
+                    break;
+                }
+#endif
                 tg_rst_dev ();
                 put_writer_status (STATUS_SUCCESS);
                 break;
@@ -299,6 +314,9 @@ int flashwriter_sm ()
             case CMD_ERASE_DEV:
                 DPRINTF ("Flashwriter: CMD_ERASE_DEV...");
                 put_writer_status (STATUS_BUSY);
+#ifdef FW_CFG_ERASE_AHEAD
+                tg_erase_flush ();                                      /* No erase may still be going on */
+#endif
                 if ((ret = tg_erase_dev ()) == 0)
                     put_writer_status (STATUS_SUCCESS);
                 else {
@@ -309,8 +327,13 @@ int flashwriter_sm ()
             case CMD_BLK_ERASE_DEV:
                 DPRINTF ("Flashwriter: CMD_BLK_ERASE_DEV...");
                 put_writer_status (STATUS_BUSY);
+#ifdef FW_CFG_ERASE_AHEAD
+                if ((ret = tg_erase_ahead (get_host_param (ADDR_PARAM),
+                                           get_host_param (NBYTES_PARAM))) == 0)
+#else
                 if ((ret = tg_blk_erase_dev (get_host_param (ADDR_PARAM),
                                              get_host_param (NBYTES_PARAM))) == 0)
+#endif
                     put_writer_status (STATUS_SUCCESS);
                 else {
                     put_writer_status (STATUS_ERR);
@@ -353,6 +376,9 @@ int flashwriter_sm ()
 
             case CMD_EXIT:
                 DPRINTF ("Flashwriter: CMD_EXIT...Done\r\n");
+#ifdef FW_CFG_ERASE_AHEAD
+                tg_erase_flush ();
+#endif
                 put_writer_status (STATUS_EXIT);
             case CMD_NONE:
                 put_writer_status (STATUS_IDLE);
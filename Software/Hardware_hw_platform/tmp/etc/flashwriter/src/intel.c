@@ -38,6 +38,7 @@
 #define INTEL_READ_IDCODES       0x90
 #define INTEL_READ_QUERY         0x98
 #define INTEL_READ_ARRAY         0xff
+#define INTEL_WRITE_BUFFER       0xe8
 
 #define INTEL_SET_LOCK_BIT       0x01
 #define INTEL_CLEAR_LOCK_BITS    0xd0
@@ -63,6 +64,8 @@
 
 #define INTEL_OPTIONAL_FEATURES_LEGACY_UNLOCK_MASK 0x8
 
+#define INTEL_MAX_BUFFER_WORDS   256                    /* The word count of a buffer write is one byte */
+
 #define BLKADDR_TO_ADDR(blkaddr)    (blkaddr << devinf->addr_shift)
 #define ADDR_TO_BLKADDR(addr)       (addr >> devinf->addr_shift)
 
@@ -75,6 +78,17 @@ static void     intel_rst_blk (uint32_t blkaddr);
 static int8_t   intel_erase_dev ();
 static int8_t   intel_blk_erase_dev (uint32_t blkaddr);
 static int8_t   intel_prog_dev (uint32_t dstoffset, uint8_t *srcaddr, uint32_t nbytes);
+#ifdef FW_CFG_PROG
+static int8_t   intel_prog_buf (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes);
+#endif
+#ifdef FW_CFG_ERASE
+static int8_t   intel_blk_erase_start (uint32_t blkaddr);
+static int8_t   intel_erase_poll (uint8_t wait);
+#endif
+#if defined (FW_CFG_ERASE) && defined (FW_CFG_PROG)
+static void     intel_erase_suspend ();
+static void     intel_erase_resume ();
+#endif
 
 static uint8_t  intel_lock_block (uint32_t blkaddr);
 static uint8_t  intel_unlock_block (uint32_t blkaddr);
@@ -103,8 +117,15 @@ target_ops_t Intel_ops = {
     NULL,
 #endif
 #ifdef FW_CFG_PROG
-    intel_prog_dev
+    intel_prog_dev,
 #else
+    NULL,
+#endif
+#if defined (FW_CFG_ERASE) && defined (FW_CFG_PROG)
+    intel_blk_erase_start,
+    intel_erase_poll
+#else
+    NULL,
     NULL
 #endif
 };
@@ -113,6 +134,12 @@ static uint32_t  sr7flag, sr6flag, sr5flag, sr4flag, sr3flag, sr2flag, sr1flag;
 static dev_info_t *devinf;
 static uint8_t addr_step;
 static uint8_t addr_shift;
+static uint32_t wbufsiz;                                                /* Bytes of the bus per buffer write, 0 if none */
+static uint8_t  erase_busy;
+#ifdef FW_CFG_ERASE
+static uint32_t erase_blkaddr;                                          /* Block of the erase started by intel_blk_erase_start */
+static uint8_t  erase_suspended;
+#endif
 
 
 /*==============================================================================*/
@@ -130,6 +157,11 @@ static void intel_init_dev_params (dev_info_t *devinfo)
     sr2flag = fl_form_cmd (INTEL_PROGRAM_SUSPEND);
     sr1flag = fl_form_cmd (INTEL_LOCKBIT_ERRORS);
     devinf = devinfo;
+    wbufsiz = 0;                                                                        /* CFI gives log2 of the buffer bytes of one part */
+    if (devinfo->cfiqry.max_write_buf_siz && 
+        (devinfo->num_parts << devinfo->cfiqry.max_write_buf_siz) <= INTEL_MAX_BUFFER_WORDS * addr_step)
+        wbufsiz = devinfo->num_parts << devinfo->cfiqry.max_write_buf_siz;
+    erase_busy = 0;
 }
 
 static void intel_rst_dev ()
@@ -182,7 +214,19 @@ static int8_t intel_erase_dev ()
  */
 static int8_t intel_blk_erase_dev (uint32_t blkaddr)
 {
-    uint32_t data;
+    uint8_t  status;
+
+    if ((status = intel_blk_erase_start (blkaddr)))
+        return status;
+    return intel_erase_poll (1);
+}
+
+/*
+ *      Start the erase of a block and return, for the caller to go on with 
+ *      other work. intel_erase_poll finishes it.
+ */
+static int8_t intel_blk_erase_start (uint32_t blkaddr)
+{
     uint8_t  status;
 
 #ifndef NO_INTEL_UNLOCK_BLOCKS
@@ -195,13 +239,34 @@ static int8_t intel_blk_erase_dev (uint32_t blkaddr)
     fl_cmdwrite (blkaddr, INTEL_CONFIRM);
     intel_status_delay ();
 
-    data = fl_read (BLKADDR_TO_ADDR (blkaddr));
-    while ((data & sr7flag) != sr7flag) 
-        data = fl_read (BLKADDR_TO_ADDR (blkaddr));
+    erase_blkaddr = blkaddr;
+    erase_busy = 1;
+    erase_suspended = 0;
+    return 0;
+}
+
+/*
+ *      Check on the erase started by intel_blk_erase_start, or wait for it.
+ *      Returns ERR_FLASH_BUSY if it is still going and we did not wait.
+ */
+static int8_t intel_erase_poll (uint8_t wait)
+{
+    uint32_t data;
+    uint8_t  status;
+
+    if (!erase_busy)
+        return 0;
+
+    fl_cmdwrite (erase_blkaddr, INTEL_READ_STATUS);                     /* Programming may have left the part in read array mode */
+    data = fl_read (BLKADDR_TO_ADDR (erase_blkaddr));
+    while (wait && (data & sr7flag) != sr7flag) 
+        data = fl_read (BLKADDR_TO_ADDR (erase_blkaddr));
+    if ((data & sr7flag) != sr7flag)
+        return ERR_FLASH_BUSY;
     
-    status = 0;
-    status = intel_status_check (blkaddr);
-    intel_rst_blk (blkaddr);
+    erase_busy = 0;
+    status = intel_status_check (erase_blkaddr);
+    intel_rst_blk (erase_blkaddr);
     return status;
 }
 #endif  /* FW_CFG_ERASE */
@@ -209,17 +274,33 @@ static int8_t intel_blk_erase_dev (uint32_t blkaddr)
 #ifdef FW_CFG_PROG
 static int8_t intel_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
 {
-    uint32_t data, fldata;
+    uint32_t data, n;
     uint32_t *srcp32, *srcp16, *srcp8;
     int8_t err = 0;
     uint8_t status;
 
+#ifdef FW_CFG_ERASE
+    if (erase_busy)                                                     /* An erase ahead of us, in another block */
+        intel_erase_suspend ();
+#endif
+
     intel_rst_blk (ADDR_TO_BLKADDR (offset));
 
     if ((nbytes % addr_step))
         nbytes += (addr_step - (nbytes % addr_step));                   /* Align to address boundary */
 
-    while (nbytes) {
+    while (nbytes && wbufsiz) {
+        n = wbufsiz - (offset & (wbufsiz - 1));                         /* Up to the end of this write buffer */
+        if (n > nbytes)
+            n = nbytes;
+        if ((err = intel_prog_buf (offset, srcaddr, n)))
+            break;
+        offset += n;
+        nbytes -= n;
+        srcaddr = (uint8_t*)(srcaddr + n);
+    }
+
+    while (nbytes && !err) {
         data = mem_read (srcaddr);                                      /* Read FLASH_BUS_WIDTH amount of data from memory and store in data */
         fl_cmdwrite (offset >> addr_shift, INTEL_PROGRAM_WORD);         /* Adjust offset, since we are using cmdwrite which expects command addresses */
         fl_write (offset, data);
@@ -231,7 +312,8 @@ static int8_t intel_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes
 
         if ((status = intel_status_check (ADDR_TO_BLKADDR (offset)))) {
             intel_rst_blk (ADDR_TO_BLKADDR (offset));
-            return status;
+            err = status;
+            break;
         }
 
         offset += addr_step;                                            /* Update pointers */
@@ -239,8 +321,74 @@ static int8_t intel_prog_dev (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes
         srcaddr = (uint8_t*)(srcaddr + addr_step);     
     }
 
+#ifdef FW_CFG_ERASE
+    if (erase_suspended)
+        intel_erase_resume ();
+#endif
+    return err;
+}
+
+/*
+ *      Program nbytes from offset, all within one write buffer, with a single
+ *      Write to Buffer command: the buffer is loaded, then programmed at once.
+ */
+static int8_t intel_prog_buf (uint32_t offset, uint8_t *srcaddr, uint32_t nbytes)
+{
+    uint32_t data, blkaddr;
+    uint8_t status;
+
+    blkaddr = ADDR_TO_BLKADDR (offset);
+    do {                                                                /* The extended status tells when a buffer is free */
+        fl_cmdwrite (blkaddr, INTEL_WRITE_BUFFER);
+        intel_status_delay ();
+    } while ((fl_read (offset) & sr7flag) != sr7flag);
+
+    fl_cmdwrite (blkaddr, (nbytes / addr_step) - 1);                    /* Word count - 1, to every part */
+    while (nbytes) {
+        data = mem_read (srcaddr);
+        fl_write (offset, data);
+        offset += addr_step;
+        nbytes -= addr_step;
+        srcaddr = (uint8_t*)(srcaddr + addr_step);
+    }
+    fl_cmdwrite (blkaddr, INTEL_CONFIRM);
+    intel_status_delay ();
+
+    data = fl_read (BLKADDR_TO_ADDR (blkaddr));
+    while ((data & sr7flag) != sr7flag) 
+        data = fl_read (BLKADDR_TO_ADDR (blkaddr));
+
+    if ((status = intel_status_check (blkaddr))) {
+        intel_rst_blk (blkaddr);
+        return status;
+    }
     return 0;
 }
+
+#ifdef FW_CFG_ERASE
+/*
+ *      Suspend the erase started by intel_blk_erase_start, to program other
+ *      blocks. If it had already finished, there is nothing to resume.
+ */
+static void intel_erase_suspend ()
+{
+    uint32_t data;
+
+    fl_cmdwrite (erase_blkaddr, INTEL_SUSPEND);
+    intel_status_delay ();
+    data = fl_read (BLKADDR_TO_ADDR (erase_blkaddr));
+    while ((data & sr7flag) != sr7flag) 
+        data = fl_read (BLKADDR_TO_ADDR (erase_blkaddr));
+    erase_suspended = ((data & sr6flag) == sr6flag);
+}
+
+static void intel_erase_resume ()
+{
+    fl_cmdwrite (erase_blkaddr, INTEL_RESUME);
+    intel_status_delay ();
+    erase_suspended = 0;
+}
+#endif  /* FW_CFG_ERASE */
 #endif  /* FW_CFG_PROG */
 
 static uint32_t intel_read_status (uint32_t blkaddr)
@@ -0,0 +1,735 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * RAM-backed CFI flash simulator for the flashwriter, and a benchmark of
+ * its programming throughput. The flashwriter sources (../src) are built
+ * for the host with FW_HOST_SIM, which takes the flash accesses of flash.c
+ * to the model here: a 16 MB part with 128 KB blocks, with the CFI query
+ * table, the command state machine and the timing of an Intel 28F128J3
+ * (the part of the board) or of an AMD style S29GL128N. The model keeps
+ * its own clock, moved by each bus access and by the host loading the
+ * data buffer of the flashwriter between program commands, as XMD does.
+ *
+ * An image is erased and programmed the way XMD drives the flashwriter:
+ *
+ *   word        one program command per bus word (the write buffer of the
+ *               CFI query is hidden)
+ *   buffer      write buffer programming
+ *   ahead       write buffer programming with FW_CFG_ERASE_AHEAD: each
+ *               block is erased while the host loads data, suspended
+ *               while other blocks are programmed
+ *
+ * and the contents of the part are checked: the image, erased bytes in
+ * the rest of the blocks erased, the old contents outside them. Commands
+ * the part would reject (a program while it is busy, a program of bits
+ * that are not erased, a block being erased, a bad buffer sequence) are
+ * counted, and any of them fails the test. Two more runs with erase ahead
+ * check that tg_erase_flush erases the blocks left unprogrammed, and that
+ * erases are suspended when the data buffers are smaller than a block.
+ *
+ * Build (from this directory; cfi.c takes the CFI fields as big endian
+ * unless __LITTLE_ENDIAN__ is defined):
+ *   gcc -std=c99 -O2 -DFW_HOST_SIM -DFW_CFG_ERASE_AHEAD -D__LITTLE_ENDIAN__
+ *       -I../src flash_sim.c ../src/flash.c ../src/cfi.c ../src/amd.c
+ *       ../src/intel.c -o flash_sim
+ *
+ * Usage:
+ *   flash_sim [-d intel|amd] [-w 8|16] [-b log2_buffer_bytes] [-S]
+ *             [-n bytes] [-o offset] [-j host_kbytes_per_s] [-m membuf_bytes]
+ *       -b 0 gives a part without a write buffer, -S one without erase
+ *       suspend. Both parts are run unless -d picks one.
+ *
+ * @file flash_sim.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "portab.h"
+#include "flash.h"
+#include "errors.h"
+#include "defs.h"
+
+#define FLASH_BASEADDR      0x89000000
+#define PART_SIZE_LOG2      24
+#define PART_SIZE           (1UL << PART_SIZE_LOG2)
+#define BLOCK_SIZE          0x20000UL
+#define MEMBUF_BYTES        249482              /* MEMBUF_SIZ of src/config.h */
+#define HOST_KBYTES_PER_S   200.0               /* XMD loading the data buffer over JTAG */
+#define ACCESS_NS           150.0               /* An access of the flash through the EMC */
+#define MAX_BUF_WORDS       256
+
+#define DEFAULT_OFFSET      0x60006UL           /* Not aligned to a write buffer */
+#define DEFAULT_BYTES       300001UL
+
+/* Modes of the part */
+#define MODE_ARRAY          0
+#define MODE_STATUS         1
+#define MODE_QUERY          2
+
+/* Command sequences under way */
+#define SEQ_NONE            0
+#define SEQ_PROG            1
+#define SEQ_ERASE           2
+#define SEQ_LOCK            3
+#define SEQ_WB_COUNT        4
+#define SEQ_WB_DATA         5
+#define SEQ_WB_CONFIRM      6
+
+/* Flashwriter entry points */
+int8_t   cfi_init (uint32_t ba, uint8_t bw);
+int8_t   tg_init_dev ();
+void     tg_rst_dev ();
+int8_t   tg_blk_erase_dev (uint32_t addr, uint32_t nbytes);
+int8_t   tg_prog_dev (uint32_t dstoffset, uint8_t *srcaddr, uint32_t nbytes);
+int8_t   tg_erase_ahead (uint32_t addr, uint32_t nbytes);
+int8_t   tg_erase_flush ();
+extern dev_info_t devinfo;
+
+/*
+ * Typical times of the data sheets, in ns. The clear of the lock bits is
+ * the J3 one, done by intel.c before each block erase.
+ */
+typedef struct {
+    const char *name;
+    int         amd;
+    int         buf_log2;                       /* CFI 0x2A */
+    double      word_ns, buf_ns, erase_ns, unlock_ns, suspend_ns;
+} part_t;
+
+static const part_t parts[] = {
+    { "intel", 0, 5, 210e3, 218e3, 1.0e9, 0.5e9, 26e3 },
+    { "amd",   1, 6,  60e3, 240e3, 0.5e9, 0.0,   20e3 },
+};
+
+static struct {
+    const part_t *part;
+    uint8_t      *mem;
+    int           width;                        /* Bytes of a device word */
+    unsigned long bufbytes;                     /* Write buffer, 0 if none */
+    int           suspend;                      /* Erase suspend in the CFI table */
+    uint8_t       cfi[0x50];                    /* Query table, by device word */
+    int           mode, seq, cycle, erase_setup;
+    uint8_t       status;
+    int           locked;
+    double        busy_end;                     /* A program, lock clear or suspend */
+    int           erasing, erase_suspended;
+    unsigned long erase_blk;
+    double        erase_end, erase_left;
+    unsigned long wb_blk, wb_base;
+    int           wb_count, wb_n;
+    unsigned long wb_addr[MAX_BUF_WORDS];
+    uint32_t      wb_data[MAX_BUF_WORDS];
+    unsigned long last_addr;                    /* Of the last program, for AMD polling */
+    uint32_t      last_data;
+    double        last_busy_read;
+    int           toggle;
+    unsigned long words, buffers, erases, suspends, violations;
+} dev;
+
+static double now;                              /* Simulated time, ns */
+
+static void violation (const char *what, unsigned long addr)
+{
+    if (dev.violations++ < 5)
+        printf ("  %s: %s at 0x%06lX\n", dev.part->name, what, addr);
+}
+
+/*
+ * The part as found on the board: old contents, every block locked.
+ */
+static void dev_reset (const part_t *part, int width, int buf_log2, int suspend)
+{
+    unsigned long i;
+    uint8_t *c = dev.cfi;
+    uint8_t *mem = dev.mem;
+
+    memset (&dev, 0, sizeof(dev));
+    dev.mem = mem;
+    dev.part = part;
+    dev.width = width;
+    dev.bufbytes = buf_log2 ? 1UL << buf_log2 : 0;
+    dev.suspend = suspend;
+    dev.locked = !part->amd;
+    dev.last_busy_read = -1e18;
+    srand (7);
+    for (i = 0; i < PART_SIZE; i++)
+        dev.mem[i] = (uint8_t)rand ();
+
+    c[0x10] = 'Q'; c[0x11] = 'R'; c[0x12] = 'Y';
+    c[0x13] = part->amd ? 2 : 1;                /* Primary command set, and its table */
+    c[0x15] = 0x31;
+    c[0x1B] = 0x27; c[0x1C] = 0x36;
+    c[0x1F] = 8;                                /* Timeouts, log2 of us and ms */
+    c[0x20] = buf_log2 ? 8 : 0;
+    c[0x21] = 10;
+    c[0x23] = 4; c[0x24] = buf_log2 ? 4 : 0; c[0x25] = 4;
+    c[0x27] = PART_SIZE_LOG2;
+    c[0x28] = 2;                                /* x8/x16 */
+    c[0x2A] = (uint8_t)buf_log2;
+    c[0x2C] = 1;                                /* One erase region */
+    c[0x2D] = (uint8_t)(PART_SIZE / BLOCK_SIZE - 1);
+    c[0x2E] = (uint8_t)((PART_SIZE / BLOCK_SIZE - 1) >> 8);
+    c[0x2F] = (uint8_t)(BLOCK_SIZE / 256);
+    c[0x30] = (uint8_t)(BLOCK_SIZE / 256 >> 8);
+    c[0x31] = 'P'; c[0x32] = 'R'; c[0x33] = 'I';
+    c[0x34] = '1'; c[0x35] = part->amd ? '3' : '1';
+    if (part->amd) {
+        c[0x37] = suspend ? 2 : 0;              /* Erase suspend: read/write */
+    } else {
+        c[0x36] = suspend ? 0x0A : 0x08;        /* Erase suspend, legacy lock */
+        c[0x3A] = suspend ? 1 : 0;              /* Program after erase suspend */
+    }
+}
+
+static void dev_update (void)
+{
+    if (dev.erasing && !dev.erase_suspended && now >= dev.erase_end)
+        dev.erasing = 0;
+}
+
+static int erase_running (void)
+{
+    dev_update ();
+    return dev.erasing && !dev.erase_suspended;
+}
+
+static int dev_busy (void)
+{
+    return now < dev.busy_end || erase_running ();
+}
+
+/*
+ * A status read of a busy part. The first tells the time as it is; a
+ * second one in a row is a polling loop, which is let run to the end.
+ */
+static void busy_read (void)
+{
+    if (now - dev.last_busy_read <= 2 * ACCESS_NS) {
+        if (now < dev.busy_end)
+            now = dev.busy_end;
+        else if (erase_running ())
+            now = dev.erase_end;
+        dev_update ();
+    }
+    dev.last_busy_read = now;
+}
+
+static uint32_t get_word (unsigned long a)
+{
+    uint16_t w;
+
+    if (dev.width == 1)
+        return dev.mem[a];
+    memcpy (&w, dev.mem + a, 2);
+    return w;
+}
+
+static void program_word (unsigned long a, uint32_t data)
+{
+    uint32_t old = get_word (a);
+    uint16_t w;
+
+    if (a / BLOCK_SIZE == dev.erase_blk && dev.erasing)
+        violation ("program of the block being erased", a);
+    else if (dev.locked)
+        violation ("program of a locked block", a);
+    else if ((old & data) != data)
+        violation ("program of bits that are not erased", a);
+    if (dev.width == 1) {
+        dev.mem[a] &= (uint8_t)data;
+    } else {
+        w = (uint16_t)(old & data);
+        memcpy (dev.mem + a, &w, 2);
+    }
+    dev.last_addr = a;
+    dev.last_data = data;
+}
+
+static void start_erase (unsigned long a)
+{
+    if (dev.erasing) {
+        violation ("erase while another one is suspended", a);
+        return;
+    }
+    if (dev.locked) {
+        violation ("erase of a locked block", a);
+        dev.status |= 0x22;
+        return;
+    }
+    dev.erase_blk = a / BLOCK_SIZE;
+    memset (dev.mem + dev.erase_blk * BLOCK_SIZE, 0xFF, BLOCK_SIZE);
+    dev.erasing = 1;
+    dev.erase_suspended = 0;
+    dev.erase_end = now + dev.part->erase_ns;
+    dev.erases++;
+}
+
+static void suspend_erase (void)
+{
+    dev.erase_left = dev.erase_end - now;
+    dev.erase_suspended = 1;
+    dev.busy_end = now + dev.part->suspend_ns;
+    dev.suspends++;
+}
+
+static void resume_erase (void)
+{
+    dev.erase_end = now + dev.erase_left;
+    dev.erase_suspended = 0;
+}
+
+/*
+ * Data words of a buffer write: all in one aligned buffer of one block.
+ */
+static void buffer_data (unsigned long a, uint32_t data)
+{
+    if (dev.wb_n == 0)
+        dev.wb_base = a & ~(dev.bufbytes - 1);
+    if ((a & ~(dev.bufbytes - 1)) != dev.wb_base || a / BLOCK_SIZE != dev.wb_blk)
+        violation ("buffer data outside the buffer", a);
+    dev.wb_addr[dev.wb_n] = a;
+    dev.wb_data[dev.wb_n] = data;
+    if (++dev.wb_n == dev.wb_count)
+        dev.seq = SEQ_WB_CONFIRM;
+}
+
+static void buffer_count (unsigned long a, uint32_t data)
+{
+    dev.wb_count = (int)(data & 0xFF) + 1;
+    dev.wb_n = 0;
+    dev.seq = SEQ_WB_DATA;
+    if ((unsigned long)dev.wb_count * dev.width > dev.bufbytes || a / BLOCK_SIZE != dev.wb_blk) {
+        violation ("bad buffer word count", a);
+        dev.seq = SEQ_NONE;
+    }
+}
+
+static void buffer_program (void)
+{
+    int i;
+
+    for (i = 0; i < dev.wb_n; i++)
+        program_word (dev.wb_addr[i], dev.wb_data[i]);
+    dev.busy_end = now + dev.part->buf_ns;
+    dev.buffers++;
+}
+
+static void intel_write (unsigned long a, uint32_t data)
+{
+    uint8_t cmd = (uint8_t)data;
+
+    switch (dev.seq) {
+    case SEQ_PROG:
+        program_word (a, data);
+        dev.busy_end = now + dev.part->word_ns;
+        dev.words++;
+        dev.seq = SEQ_NONE;
+        return;
+    case SEQ_ERASE:
+        if (cmd == 0xD0)
+            start_erase (a);
+        else {
+            violation ("bad erase confirm", a);
+            dev.status |= 0x30;
+        }
+        dev.seq = SEQ_NONE;
+        return;
+    case SEQ_LOCK:
+        if (cmd == 0xD0) {                      /* The J3 clears them all */
+            dev.locked = 0;
+            dev.busy_end = now + dev.part->unlock_ns;
+        } else if (cmd == 0x01)
+            dev.locked = 1;
+        dev.seq = SEQ_NONE;
+        return;
+    case SEQ_WB_COUNT:
+        buffer_count (a, data);
+        return;
+    case SEQ_WB_DATA:
+        buffer_data (a, data);
+        return;
+    case SEQ_WB_CONFIRM:
+        if (cmd == 0xD0)
+            buffer_program ();
+        else {
+            violation ("bad buffer confirm", a);
+            dev.status |= 0x30;
+        }
+        dev.seq = SEQ_NONE;
+        return;
+    }
+
+    if (dev_busy ()) {
+        if (cmd == 0x70)
+            dev.mode = MODE_STATUS;
+        else if (cmd == 0xB0 && now >= dev.busy_end)
+            suspend_erase ();
+        else
+            violation ("command while busy", a);
+        return;
+    }
+
+    dev.mode = MODE_STATUS;
+    switch (cmd) {
+    case 0xFF: dev.mode = MODE_ARRAY; break;
+    case 0x98: dev.mode = MODE_QUERY; break;
+    case 0x70: break;
+    case 0x50: dev.status &= ~0x3A; break;
+    case 0x40:
+    case 0x10: dev.seq = SEQ_PROG; break;
+    case 0x20: dev.seq = SEQ_ERASE; break;
+    case 0x60: dev.seq = SEQ_LOCK; break;
+    case 0xE8:
+        if (dev.bufbytes == 0)
+            violation ("buffer write without a buffer", a);
+        else {
+            dev.wb_blk = a / BLOCK_SIZE;
+            dev.seq = SEQ_WB_COUNT;
+        }
+        break;
+    case 0xB0: break;                           /* Nothing to suspend */
+    case 0xD0:
+        if (dev.erasing && dev.erase_suspended)
+            resume_erase ();
+        else {
+            violation ("resume without a suspended erase", a);
+            dev.status |= 0x30;
+        }
+        break;
+    default:
+        violation ("unknown command", a);
+    }
+}
+
+static uint32_t intel_read (unsigned long a)
+{
+    uint8_t sr;
+
+    if (dev.mode == MODE_QUERY)
+        return a / dev.width < sizeof(dev.cfi) ? dev.cfi[a / dev.width] : 0;
+    if (dev.mode == MODE_ARRAY && !dev_busy ())
+        return get_word (a);
+    if (dev_busy ()) {
+        busy_read ();
+        return dev.status;                      /* SR7 clear */
+    }
+    sr = dev.status | 0x80;
+    if (dev.erasing && dev.erase_suspended)
+        sr |= 0x40;
+    return sr;
+}
+
+static void amd_write (unsigned long a, uint32_t data)
+{
+    uint8_t cmd = (uint8_t)data;
+    unsigned long w = (a / dev.width) & 0xFFF;
+    unsigned long u1 = dev.width == 1 ? 0xAAA : 0x555;
+    unsigned long u2 = dev.width == 1 ? 0x555 : 0x2AA;
+
+    if (now < dev.busy_end) {
+        violation ("write while busy", a);
+        return;
+    }
+    if (erase_running ()) {
+        if (cmd == 0xB0)
+            suspend_erase ();
+        else
+            violation ("write while erasing", a);
+        return;
+    }
+
+    switch (dev.seq) {
+    case SEQ_PROG:
+        program_word (a, data);
+        dev.busy_end = now + dev.part->word_ns;
+        dev.words++;
+        dev.seq = SEQ_NONE;
+        return;
+    case SEQ_WB_COUNT:
+        buffer_count (a, data);
+        return;
+    case SEQ_WB_DATA:
+        buffer_data (a, data);
+        return;
+    case SEQ_WB_CONFIRM:
+        if (cmd == 0x29 && a / BLOCK_SIZE == dev.wb_blk)
+            buffer_program ();
+        else
+            violation ("buffer write aborted", a);
+        dev.seq = SEQ_NONE;
+        return;
+    }
+
+    if (dev.cycle == 0) {
+        if (cmd == 0xAA && w == u1)
+            dev.cycle = 1;
+        else if (cmd == 0xF0 || cmd == 0xFF)
+            dev.mode = MODE_ARRAY;
+        else if (cmd == 0x98 && w == 0x55)
+            dev.mode = MODE_QUERY;
+        else if (cmd == 0x30 && dev.erasing && dev.erase_suspended)
+            resume_erase ();
+        else if (cmd != 0x30 && cmd != 0xB0)    /* Resume or suspend of nothing: ignored */
+            violation ("unknown command", a);
+        return;
+    }
+    if (dev.cycle == 1) {
+        dev.cycle = cmd == 0x55 && w == u2 ? 2 : 0;
+        if (dev.cycle == 0)
+            violation ("bad unlock cycle", a);
+        return;
+    }
+
+    dev.cycle = 0;
+    if (dev.erase_setup) {
+        dev.erase_setup = 0;
+        if (cmd == 0x30)
+            start_erase (a);
+        else
+            violation ("bad erase command", a);
+        return;
+    }
+    switch (cmd) {
+    case 0xA0: dev.seq = SEQ_PROG; break;
+    case 0x80: dev.erase_setup = 1; break;
+    case 0xF0: dev.mode = MODE_ARRAY; break;
+    case 0x25:
+        if (dev.bufbytes == 0)
+            violation ("buffer write without a buffer", a);
+        else {
+            dev.wb_blk = a / BLOCK_SIZE;
+            dev.seq = SEQ_WB_COUNT;
+        }
+        break;
+    default:
+        violation ("unknown command", a);
+    }
+}
+
+/*
+ * Data polling: DQ7 is the complement of the data being programmed, 0
+ * while erasing and 1 in the block of a suspended erase; DQ6 toggles.
+ */
+static uint32_t amd_read (unsigned long a)
+{
+    dev.toggle ^= 0x40;
+    if (dev.mode == MODE_QUERY)
+        return a / dev.width < sizeof(dev.cfi) ? dev.cfi[a / dev.width] : 0;
+    if (now < dev.busy_end && !dev.erase_suspended) {
+        busy_read ();
+        return (~dev.last_data & 0x80) | dev.toggle;
+    }
+    if (now < dev.busy_end || erase_running ()) {
+        busy_read ();
+        return dev.toggle;
+    }
+    if (dev.erasing && a / BLOCK_SIZE == dev.erase_blk)
+        return 0x80;
+    return get_word (a);
+}
+
+static uint32_t sim_read (uint32_t addr)
+{
+    now += ACCESS_NS;
+    return dev.part->amd ? amd_read (addr) : intel_read (addr);
+}
+
+static void sim_write (uint32_t addr, uint32_t data)
+{
+    now += ACCESS_NS;
+    dev.last_busy_read = -1e18;
+    if (dev.part->amd)
+        amd_write (addr, data);
+    else
+        intel_write (addr, data);
+}
+
+/* The low-level accesses of flash.c */
+uint32_t fl_read_08 (uint32_t addr)                 { return sim_read (addr) & 0xFF; }
+uint32_t fl_read_16 (uint32_t addr)                 { return sim_read (addr & ~1U) & 0xFFFF; }
+uint32_t fl_read_32 (uint32_t addr)                 { return sim_read (addr & ~3U); }
+void     fl_write_08 (uint32_t addr, uint32_t data) { sim_write (addr, data & 0xFF); }
+void     fl_write_16 (uint32_t addr, uint32_t data) { sim_write (addr & ~1U, data & 0xFFFF); }
+void     fl_write_32 (uint32_t addr, uint32_t data) { sim_write (addr & ~3U, data); }
+
+#define RUN_WORD    0
+#define RUN_BUFFER  1
+#define RUN_AHEAD   2
+
+static const char *run_names[] = { "word at a time", "write buffer", "buffer + erase ahead" };
+
+typedef struct {
+    double total_s, host_s;
+    int    ok;
+} result_t;
+
+/*
+ * Erase erase_n bytes and program the image of n bytes at off, in data
+ * buffers of membuf bytes loaded by the host at kbps, then check the part.
+ */
+static result_t run (int how, const uint8_t *image, unsigned long off, unsigned long n,
+                     unsigned long erase_n, unsigned long membuf, double kbps, const uint8_t *old)
+{
+    result_t r;
+    unsigned long done, chunk, i, first, last;
+    double start, host_ns = 0;
+    int8_t ret;
+    uint8_t expect;
+
+    r.ok = 0;
+    if ((ret = cfi_init (FLASH_BASEADDR, (uint8_t)(dev.width * 8)))) {
+        printf ("  cfi_init: error %d\n", ret);
+        return r;
+    }
+    if (how == RUN_WORD)
+        devinfo.cfiqry.max_write_buf_siz = 0;
+    if ((ret = tg_init_dev ())) {
+        printf ("  tg_init_dev: error %d\n", ret);
+        return r;
+    }
+    tg_rst_dev ();
+
+    start = now;
+    ret = how == RUN_AHEAD ? tg_erase_ahead (off, erase_n) : tg_blk_erase_dev (off, erase_n);
+    for (done = 0; ret == 0 && done < n; done += chunk) {
+        chunk = n - done < membuf ? n - done : membuf;
+        now += chunk * 1e9 / (kbps * 1024);     /* XMD loads the data buffer */
+        host_ns += chunk * 1e9 / (kbps * 1024);
+        ret = tg_prog_dev (off + done, (uint8_t *)image + done, chunk);
+    }
+    if (ret == 0 && how == RUN_AHEAD)
+        ret = tg_erase_flush ();                /* CMD_RST_DEV */
+    tg_rst_dev ();
+    r.total_s = (now - start) / 1e9;
+    r.host_s = host_ns / 1e9;
+    if (ret) {
+        printf ("  %s: error %d\n", run_names[how], ret);
+        return r;
+    }
+
+    first = off / BLOCK_SIZE * BLOCK_SIZE;
+    last = ((off + erase_n - 1) / BLOCK_SIZE + 1) * BLOCK_SIZE;
+    for (i = 0; i < PART_SIZE; i++) {
+        if (i >= off && i < off + n)
+            expect = image[i - off];
+        else if (i >= first && i < last)
+            expect = 0xFF;
+        else
+            expect = old[i];
+        if (dev.mem[i] != expect) {
+            printf ("  %s: byte 0x%06lX is 0x%02X, not 0x%02X\n", run_names[how], i, dev.mem[i], expect);
+            return r;
+        }
+    }
+    r.ok = dev.violations == 0;
+    return r;
+}
+
+static void usage (void)
+{
+    fprintf (stderr, "usage: flash_sim [-d intel|amd] [-w 8|16] [-b log2_buffer_bytes] [-S]\n"
+             "                 [-n bytes] [-o offset] [-j host_kbytes_per_s] [-m membuf_bytes]\n");
+    exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+    const char *only = NULL;
+    int width = 1, buf_log2 = -1, suspend = 1, failed = 0, a, how;
+    unsigned long off = DEFAULT_OFFSET, n = DEFAULT_BYTES, membuf = MEMBUF_BYTES, i;
+    double kbps = HOST_KBYTES_PER_S;
+    uint8_t *image, *old;
+    unsigned p;
+    result_t r;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp (argv[a], "-d") == 0 && a + 1 < argc)
+            only = argv[++a];
+        else if (strcmp (argv[a], "-w") == 0 && a + 1 < argc)
+            width = atoi (argv[++a]) / 8;
+        else if (strcmp (argv[a], "-b") == 0 && a + 1 < argc)
+            buf_log2 = atoi (argv[++a]);
+        else if (strcmp (argv[a], "-S") == 0)
+            suspend = 0;
+        else if (strcmp (argv[a], "-n") == 0 && a + 1 < argc)
+            n = strtoul (argv[++a], NULL, 0);
+        else if (strcmp (argv[a], "-o") == 0 && a + 1 < argc)
+            off = strtoul (argv[++a], NULL, 0);
+        else if (strcmp (argv[a], "-j") == 0 && a + 1 < argc)
+            kbps = atof (argv[++a]);
+        else if (strcmp (argv[a], "-m") == 0 && a + 1 < argc)
+            membuf = strtoul (argv[++a], NULL, 0);
+        else
+            usage ();
+    }
+    if ((width != 1 && width != 2) || n == 0 || off % width || off + n > PART_SIZE
+        || membuf == 0 || membuf % width || kbps <= 0 || buf_log2 > 8 || (buf_log2 > 0 && (1 << buf_log2) < width))
+        usage ();
+
+    dev.mem = malloc (PART_SIZE);
+    old = malloc (PART_SIZE);
+    image = malloc (n + 4);
+    if (dev.mem == NULL || old == NULL || image == NULL)
+        return 1;
+    srand (1);
+    for (i = 0; i < n; i++)
+        image[i] = (uint8_t)rand ();
+    memset (image + n, 0xFF, 4);                /* Rounded up to a bus word */
+
+    for (p = 0; p < sizeof(parts) / sizeof(parts[0]); p++) {
+        const part_t *part = &parts[p];
+        int b = buf_log2 < 0 ? part->buf_log2 : buf_log2;
+
+        if (only && strcmp (only, part->name) != 0)
+            continue;
+        printf ("%s: %d bit bus, %s write buffer, erase suspend %s\n", part->name, width * 8,
+                b ? (b == 5 ? "32 byte" : b == 6 ? "64 byte" : "a") : "no", suspend ? "yes" : "no");
+        printf ("%lu bytes at 0x%06lX, data buffers of %lu bytes loaded at %.0f KB/s\n",
+                n, off, membuf, kbps);
+        printf ("%-22s %9s %9s %9s %8s %8s %8s %6s %8s\n", "", "total s", "host s", "flash s",
+                "KB/s", "words", "buffers", "erases", "suspends");
+        for (how = RUN_WORD; how <= RUN_AHEAD; how++) {
+            dev_reset (part, width, b, suspend);
+            memcpy (old, dev.mem, PART_SIZE);
+            now = 0;
+            r = run (how, image, off, n, n, membuf, kbps, old);
+            printf ("%-22s %9.2f %9.2f %9.2f %8.1f %8lu %8lu %6lu %8lu%s\n", run_names[how],
+                    r.total_s, r.host_s, r.total_s - r.host_s, n / 1024.0 / r.total_s,
+                    dev.words, dev.buffers, dev.erases, dev.suspends, r.ok ? "" : "  FAILED");
+            failed |= !r.ok;
+        }
+
+        /* More erased than programmed: the rest is erased by tg_erase_flush */
+        dev_reset (part, width, b, suspend);
+        memcpy (old, dev.mem, PART_SIZE);
+        now = 0;
+        r = run (RUN_AHEAD, image, 3 * BLOCK_SIZE + 0x100, 100, 3 * BLOCK_SIZE - 0x100, membuf, kbps, old);
+        if (!r.ok || dev.erases != 3) {
+            printf ("erase ahead of a range not all programmed: FAILED\n");
+            failed = 1;
+        }
+
+        /* Data buffers smaller than a block: the next erase is suspended */
+        dev_reset (part, width, b, suspend);
+        memcpy (old, dev.mem, PART_SIZE);
+        now = 0;
+        r = run (RUN_AHEAD, image, off, n, n, BLOCK_SIZE / 4, kbps, old);
+        if (!r.ok || (suspend && dev.suspends == 0)) {
+            printf ("erase ahead with suspends: FAILED\n");
+            failed = 1;
+        }
+        printf ("\n");
+    }
+    if (failed)
+        return 1;
+    printf ("all tests passed\n");
+    return 0;
+}
@@ -12,3 +12,59 @@
 #warning "Please provide the correct address value for the definition FLASH_IMAGE_BASEADDR." 
 #define FLASH_IMAGE_BASEADDR  0x89060000
 
+/* The image at FLASH_IMAGE_BASEADDR is a binary boot image made by
+   utils/mkbootimg, or an SREC file. Define as 0 to copy the segments of
+   a binary image without checking their CRC, at the speed of the flash */
+#define BLIMAGE_VERIFY_CRC  1
+
+/* Define as 0 to leave out the decompressor of LZ compressed segments
+   (mkbootimg -z), for a smaller bootloader */
+#define BLIMAGE_LZ          1
+
+/* Define as 1 to copy the decoded SREC data to RAM with the LocalLink DMA
+   driver (lldma) instead of memcpy, so that the copy of each chunk
+   overlaps the decoding of the next one. This needs an SDMA port of the
+   MPMC with its TX LocalLink looped back to RX. The SDMA only reaches the
+   memory of the MPMC, so the chunks and descriptors are kept in DDR at
+   BL_DMA_STAGING_ADDR, which must be outside of the image */
+#define BL_COPY_DMA         0
+#if BL_COPY_DMA
+#define BL_DMA_BASEADDR     XPAR_MPMC_0_SDMA_CTRL_BASEADDR
+#define BL_DMA_STAGING_ADDR 0x8FFE0000
+#endif
+
+/* Load addresses from BL_XIP_BASEADDR to BL_XIP_HIGHADDR are in flash and
+   are read there in place by the application: the .model_rodata section
+   of the ANN application linked with its lscript_xip.ld. That data is
+   programmed to flash on its own, so the records and segments of the image
+   for these addresses are skipped instead of being copied. Define BL_XIP
+   as 0 to load every record */
+#define BL_XIP              1
+#if BL_XIP
+#define BL_XIP_BASEADDR     0x89F00000
+#define BL_XIP_HIGHADDR     0x89FFFFFF
+#define BL_IS_XIP(addr)     ((addr) >= BL_XIP_BASEADDR && (addr) <= BL_XIP_HIGHADDR)
+#else
+#define BL_IS_XIP(addr)     0
+#endif
+
+/* Define as 1 to record the boot time trace of boot_trace.h, which the
+   application prints. Needs an xps_timer at BOOT_TRACE_TIMER_BASEADDR */
+#define BOOT_TRACE          0
+
+/* Define as 1 for the bootloader to take an image sent over the UART by
+   utils/blsend before booting from flash (see blupload.h). It waits
+   BL_UPLOAD_WAIT_POLLS polls of the UART (about 0.1 s) for the host to
+   call, and loads the image straight to RAM, between BL_UPLOAD_LOWADDR
+   and BL_UPLOAD_HIGHADDR. Asked to, it then programs it to flash at
+   FLASH_IMAGE_BASEADDR as a binary boot image of BL_UPLOAD_MAX_SEGMENTS
+   segments at most, in BL_UPLOAD_FLASH_SIZE bytes (up to the file system
+   image of the application), with the Intel command set of the flash and
+   its blocks of BL_FLASH_BLOCK_SIZE bytes */
+#define BL_UPLOAD               0
+#define BL_UPLOAD_WAIT_POLLS    500000
+#define BL_UPLOAD_LOWADDR       0x8C000000
+#define BL_UPLOAD_HIGHADDR      0x8FFFFEFF
+#define BL_UPLOAD_MAX_SEGMENTS  16
+#define BL_UPLOAD_FLASH_SIZE    0x00090000
+#define BL_FLASH_BLOCK_SIZE     0x00020000
@@ -0,0 +1,278 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+#include <string.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "errors.h"
+#include "srec.h"
+#include "blcopy.h"
+#include "boot_trace.h"
+
+/* Host tests run the DMA path on the software stand-in of utils/lldma_sim.h */
+#ifdef BL_HOST_TEST
+#undef BL_COPY_DMA
+#define BL_COPY_DMA         1
+#include "lldma_sim.h"
+#define BL_DMA_ADDR(p)      (p)
+#elif BL_COPY_DMA
+#include "xparameters.h"
+#include "xlldma.h"
+#include "xil_cache.h"
+#define BL_DMA_ADDR(p)      ((u32)(p))
+#endif
+
+extern int srec_line;
+
+#if BL_COPY_DMA
+/* Decoded data is gathered in chunks, one being decoded while the others
+   are copied; each copy takes a descriptor of each ring */
+#define BLCOPY_BUFFERS      4
+#define BLCOPY_CHUNK_BYTES  4096
+#define BLCOPY_RING_BDS     BLCOPY_BUFFERS
+#define BLCOPY_RING_BYTES   XLlDma_BdRingMemCalc (XLLDMA_BD_MINIMUM_ALIGNMENT, BLCOPY_RING_BDS)
+
+#ifdef BL_HOST_TEST
+static uint8_t staging_mem[BLCOPY_BUFFERS * BLCOPY_CHUNK_BYTES + 2 * 1024 + XLLDMA_BD_MINIMUM_ALIGNMENT];
+#define staging             staging_mem
+#else
+#define staging             ((uint8_t *)BL_DMA_STAGING_ADDR)
+#endif
+
+static XLlDma dma;
+static uint32_t queued, completed;
+static uint8_t dma_error;
+#else
+/* Each record is copied as soon as it is decoded, as it always was */
+#define BLCOPY_BUFFERS      1
+#define BLCOPY_CHUNK_BYTES  SREC_DATA_MAX_BYTES
+
+static uint8_t staging[BLCOPY_CHUNK_BYTES];
+#endif
+
+#if BL_COPY_DMA
+/*
+ * Set up the descriptor rings of both channels after the data buffers.
+ * Returns 0 or LD_MEM_WRITE_ERROR.
+ */
+uint8_t blcopy_init (void)
+{
+    XLlDma_Bd template;
+    XLlDma_BdRing *ring;
+    uint8_t *bd_mem;
+    int i;
+
+    bd_mem = staging + BLCOPY_BUFFERS * BLCOPY_CHUNK_BYTES;
+    bd_mem += (XLLDMA_BD_MINIMUM_ALIGNMENT - (unsigned long)bd_mem % XLLDMA_BD_MINIMUM_ALIGNMENT)
+              % XLLDMA_BD_MINIMUM_ALIGNMENT;
+    XLlDma_Initialize (&dma, BL_DMA_BASEADDR);
+    for (i = 0; i < 2; i++) {
+        ring = i == 0 ? &XLlDma_GetTxRing (&dma) : &XLlDma_GetRxRing (&dma);
+        if (XLlDma_BdRingCreate (ring, BL_DMA_ADDR (bd_mem), BL_DMA_ADDR (bd_mem),
+                                 XLLDMA_BD_MINIMUM_ALIGNMENT, BLCOPY_RING_BDS) != XST_SUCCESS)
+            return LD_MEM_WRITE_ERROR;
+        XLlDma_BdClear (&template);
+        if (XLlDma_BdRingClone (ring, &template) != XST_SUCCESS ||
+            XLlDma_BdRingStart (ring) != XST_SUCCESS)
+            return LD_MEM_WRITE_ERROR;
+        bd_mem += BLCOPY_RING_BYTES;
+    }
+    queued = completed = 0;
+    dma_error = 0;
+    return 0;
+}
+
+/*
+ * Hand back the descriptors of the copies the engine has finished, and
+ * invalidate the cache over the RAM they wrote.
+ */
+static void reclaim (void)
+{
+    XLlDma_BdRing *rx = &XLlDma_GetRxRing (&dma), *tx = &XLlDma_GetTxRing (&dma);
+    XLlDma_Bd *bd_set, *bd;
+    unsigned n, i;
+
+    n = XLlDma_BdRingFromHw (rx, XLLDMA_ALL_BDS, &bd_set);
+    for (i = 0, bd = bd_set; i < n; i++, bd = XLlDma_BdRingNext (rx, bd)) {
+        if (XLlDma_BdGetStsCtrl (bd) & XLLDMA_BD_STSCTRL_ERROR_MASK)
+            dma_error = LD_MEM_WRITE_ERROR;
+        Xil_DCacheInvalidateRange (XLlDma_BdGetBufAddr (bd), XLlDma_BdGetLength (bd));
+    }
+    if (n > 0)
+        XLlDma_BdRingFree (rx, n, bd_set);
+    completed += n;
+
+    n = XLlDma_BdRingFromHw (tx, XLLDMA_ALL_BDS, &bd_set);
+    for (i = 0, bd = bd_set; i < n; i++, bd = XLlDma_BdRingNext (tx, bd)) {
+        if (XLlDma_BdGetStsCtrl (bd) & XLLDMA_BD_STSCTRL_ERROR_MASK)
+            dma_error = LD_MEM_WRITE_ERROR;
+    }
+    if (n > 0)
+        XLlDma_BdRingFree (tx, n, bd_set);
+}
+
+/*
+ * Wait until no more than pending copies are in flight.
+ * Returns 0, or LD_MEM_WRITE_ERROR if the engine failed a copy.
+ */
+uint8_t blcopy_wait (uint32_t pending)
+{
+    while (queued - completed > pending && !dma_error)
+        reclaim ();
+    return dma_error;
+}
+
+/*
+ * Queue a copy of len bytes from src to dst: the receive descriptor is
+ * given to the engine first, so that it is ready when the data comes
+ * back on the looped LocalLink.
+ * Returns 0 or LD_MEM_WRITE_ERROR.
+ */
+uint8_t blcopy_queue (uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    XLlDma_BdRing *rx = &XLlDma_GetRxRing (&dma), *tx = &XLlDma_GetTxRing (&dma);
+    XLlDma_Bd *bd;
+
+    if (blcopy_wait (BLCOPY_RING_BDS - 1) != 0)
+        return LD_MEM_WRITE_ERROR;
+
+    /* The CPU wrote the chunk; the engine reads it from memory */
+    Xil_DCacheFlushRange (BL_DMA_ADDR (src), len);
+
+    if (XLlDma_BdRingAlloc (rx, 1, &bd) != XST_SUCCESS)
+        return LD_MEM_WRITE_ERROR;
+    XLlDma_BdSetBufAddr (bd, BL_DMA_ADDR (dst));
+    XLlDma_BdSetLength (bd, len);
+    XLlDma_BdSetStsCtrl (bd, XLLDMA_BD_STSCTRL_SOP_MASK | XLLDMA_BD_STSCTRL_EOP_MASK);
+    if (XLlDma_BdRingToHw (rx, 1, bd) != XST_SUCCESS)
+        return LD_MEM_WRITE_ERROR;
+
+    if (XLlDma_BdRingAlloc (tx, 1, &bd) != XST_SUCCESS)
+        return LD_MEM_WRITE_ERROR;
+    XLlDma_BdSetBufAddr (bd, BL_DMA_ADDR (src));
+    XLlDma_BdSetLength (bd, len);
+    XLlDma_BdSetStsCtrl (bd, XLLDMA_BD_STSCTRL_SOP_MASK | XLLDMA_BD_STSCTRL_EOP_MASK);
+    if (XLlDma_BdRingToHw (tx, 1, bd) != XST_SUCCESS)
+        return LD_MEM_WRITE_ERROR;
+
+    queued++;
+    return 0;
+}
+#else
+uint8_t blcopy_init (void)
+{
+    return 0;
+}
+
+uint8_t blcopy_wait (uint32_t pending)
+{
+    (void)pending;
+    return 0;
+}
+
+uint8_t blcopy_queue (uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+    memcpy (dst, src, len);
+    return 0;
+}
+#endif
+
+static uint8_t *chunk;
+static uint32_t buffer;
+
+/*
+ * Queue the copy of the len bytes of the current chunk to addr, and move
+ * on to the next buffer once its last copy is done.
+ */
+static uint8_t next_chunk (uint8_t *addr, uint32_t len)
+{
+    uint8_t ret;
+#if BOOT_TRACE
+    unsigned long trace_start;
+#endif
+
+    BOOT_TRACE_BEGIN (trace_start);
+    if ((ret = blcopy_queue (BL_TARGET_ADDR ((uint32_t)(unsigned long)addr), chunk, len)) != 0)
+        return ret;
+    buffer = (buffer + 1) % BLCOPY_BUFFERS;
+    chunk = staging + buffer * BLCOPY_CHUNK_BYTES;
+    ret = blcopy_wait (BLCOPY_BUFFERS - 1);
+    BOOT_TRACE_END (BOOT_TRACE_COPY, trace_start);
+    return ret;
+}
+
+/*
+ * Load an SREC image from flbuf. The data of consecutive records is
+ * decoded straight into a chunk, and each chunk is queued to be copied to
+ * RAM while the next one is decoded into another buffer. Records for the
+ * XIP window of flash (BL_IS_XIP) are skipped. All the copies are done
+ * when it returns.
+ * Returns 0 with *entry set to the entry point, or the error.
+ */
+uint8_t blcopy_load_srec (uint8_t *flbuf, uint32_t *entry, void (*progress) (uint32_t))
+{
+    srec_info_t info;
+    uint8_t *addr = 0;
+    uint32_t len = 0;
+    uint8_t ret;
+#if BOOT_TRACE
+    unsigned long trace_start;
+#endif
+
+    buffer = 0;
+    chunk = staging;
+    while (1) {
+        if (len + SREC_DATA_MAX_BYTES > BLCOPY_CHUNK_BYTES) {
+            if ((ret = next_chunk (addr, len)) != 0)
+                return ret;
+            len = 0;
+        }
+
+        info.sr_data = chunk + len;
+        BOOT_TRACE_BEGIN (trace_start);
+        if ((ret = decode_srec_line (flbuf, &info)) != 0)
+            return ret;
+        BOOT_TRACE_END (BOOT_TRACE_SREC_DECODE, trace_start);
+        flbuf = info.next;
+        if (progress)
+            progress (srec_line);
+
+        switch (info.type) {
+            case SREC_TYPE_1:
+            case SREC_TYPE_2:
+            case SREC_TYPE_3:
+                /* Already in flash: the next record is decoded over it */
+                if (BL_IS_XIP ((uint32_t)(unsigned long)info.addr))
+                    break;
+                if (len > 0 && info.addr != addr + len) {
+                    /* Decoded after a chunk it does not follow: it starts the next one */
+                    if ((ret = next_chunk (addr, len)) != 0)
+                        return ret;
+                    memmove (chunk, info.sr_data, info.dlen);
+                    len = 0;
+                }
+                if (len == 0)
+                    addr = info.addr;
+                len += info.dlen;
+                break;
+            case SREC_TYPE_7:
+            case SREC_TYPE_8:
+            case SREC_TYPE_9:
+                if (len > 0 && (ret = next_chunk (addr, len)) != 0)
+                    return ret;
+                *entry = (uint32_t)(unsigned long)info.addr;
+                BOOT_TRACE_BEGIN (trace_start);
+                ret = blcopy_wait (0);
+                BOOT_TRACE_END (BOOT_TRACE_COPY, trace_start);
+                return ret;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+#include "blconfig.h"
+#include "portab.h"
+#include "errors.h"
+#include "blflash.h"
+
+/* Host tests program the flash stand-in of utils/blsend.c */
+#ifdef BL_HOST_TEST
+#undef BL_UPLOAD
+#define BL_UPLOAD               1
+uint8_t bl_host_flash_in (uint32_t addr);
+void bl_host_flash_out (uint32_t addr, uint8_t value);
+#define FLASH_IN(addr)          bl_host_flash_in (addr)
+#define FLASH_OUT(addr, value)  bl_host_flash_out (addr, value)
+#else
+#define FLASH_IN(addr)          (*(volatile uint8_t *)(addr))
+#define FLASH_OUT(addr, value)  (*(volatile uint8_t *)(addr) = (value))
+#endif
+
+#if BL_UPLOAD
+
+/* Intel command set, as in the flashwriter */
+#define INTEL_BLOCK_ERASE       0x20
+#define INTEL_PROGRAM           0x40
+#define INTEL_CLEAR_STATUS      0x50
+#define INTEL_LOCK_SETUP        0x60
+#define INTEL_READ_STATUS       0x70
+#define INTEL_CONFIRM           0xD0
+#define INTEL_READ_ARRAY        0xFF
+
+/* Status register: ready, and the erase, program, voltage and lock errors */
+#define INTEL_STATUS_READY      0x80
+#define INTEL_STATUS_ERRORS     0x3A
+
+/*
+ * Wait for the operation started at addr to end, and go back to reading
+ * the array.
+ */
+static uint8_t wait_ready (uint32_t addr)
+{
+    uint8_t status;
+
+    FLASH_OUT (addr, INTEL_READ_STATUS);
+    while (!((status = FLASH_IN (addr)) & INTEL_STATUS_READY))
+        ;
+    if (status & INTEL_STATUS_ERRORS)
+        FLASH_OUT (addr, INTEL_CLEAR_STATUS);
+    FLASH_OUT (addr, INTEL_READ_ARRAY);
+    return (status & INTEL_STATUS_ERRORS) ? FLASH_ERROR : 0;
+}
+
+/*
+ * Unlock and erase the blocks holding len bytes from addr.
+ */
+uint8_t blflash_erase (uint32_t addr, uint32_t len)
+{
+    uint32_t block;
+    uint8_t ret;
+
+    for (block = addr & ~(BL_FLASH_BLOCK_SIZE - 1); block < addr + len; block += BL_FLASH_BLOCK_SIZE) {
+        FLASH_OUT (block, INTEL_CLEAR_STATUS);
+        FLASH_OUT (block, INTEL_LOCK_SETUP);
+        FLASH_OUT (block, INTEL_CONFIRM);
+        if ((ret = wait_ready (block)) != 0)
+            return ret;
+        FLASH_OUT (block, INTEL_BLOCK_ERASE);
+        FLASH_OUT (block, INTEL_CONFIRM);
+        if ((ret = wait_ready (block)) != 0)
+            return ret;
+    }
+    return 0;
+}
+
+/*
+ * Program len bytes of src to the erased flash at addr, a byte at a time,
+ * reading each one back.
+ */
+uint8_t blflash_program (uint32_t addr, const uint8_t *src, uint32_t len)
+{
+    uint8_t ret;
+
+    for (; len > 0; len--, addr++, src++) {
+        FLASH_OUT (addr, INTEL_PROGRAM);
+        FLASH_OUT (addr, *src);
+        if ((ret = wait_ready (addr)) != 0)
+            return ret;
+        if (FLASH_IN (addr) != *src)
+            return FLASH_ERROR;
+    }
+    return 0;
+}
+
+#endif /* BL_UPLOAD */
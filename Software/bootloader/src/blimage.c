@@ -0,0 +1,213 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+#include <string.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "blimage.h"
+#include "errors.h"
+
+/* CRC-32 of each value of a nybble; a table of 16 words instead of 256
+   keeps the bootloader small, for two lookups per byte */
+static const uint32_t crc_nybble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+#define CRC_BYTE(crc, b) \
+    do { \
+        (crc) ^= (b); \
+        (crc) = ((crc) >> 4) ^ crc_nybble[(crc) & 15]; \
+        (crc) = ((crc) >> 4) ^ crc_nybble[(crc) & 15]; \
+    } while (0)
+
+/* Byte i (0 to 3) in memory order of a word */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define WORD_BYTE(w, i)  ((uint8_t)((w) >> (8 * (i))))
+#else
+#define WORD_BYTE(w, i)  ((uint8_t)((w) >> (24 - 8 * (i))))
+#endif
+
+/*
+ * Continue the CRC-32 crc (0 to start) over len bytes of buf.
+ */
+uint32_t blimage_crc32 (uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+        CRC_BYTE (crc, *buf++);
+    return ~crc;
+}
+
+/*
+ * Copy len bytes of a segment from flash to dst, a word at a time when
+ * dst is word aligned (src always is), and return their CRC-32, computed
+ * from the words as they are copied.
+ */
+static uint32_t copy_segment (uint8_t *dst, const uint32_t *src, uint32_t len)
+{
+    const uint8_t *srcb;
+    uint32_t crc = ~0U, w;
+
+    if (((unsigned long)dst & 3) == 0) {
+        for (; len >= 4; len -= 4) {
+            w = *src++;
+            *(uint32_t *)dst = w;
+            dst += 4;
+#if BLIMAGE_VERIFY_CRC
+            CRC_BYTE (crc, WORD_BYTE (w, 0));
+            CRC_BYTE (crc, WORD_BYTE (w, 1));
+            CRC_BYTE (crc, WORD_BYTE (w, 2));
+            CRC_BYTE (crc, WORD_BYTE (w, 3));
+#endif
+        }
+    }
+    for (srcb = (const uint8_t *)src; len > 0; len--) {
+        *dst = *srcb++;
+#if BLIMAGE_VERIFY_CRC
+        CRC_BYTE (crc, *dst);
+#endif
+        dst++;
+    }
+    return ~crc;
+}
+
+#if BLIMAGE_LZ
+/*
+ * Decompress the stored bytes at src of an LZ compressed segment (see
+ * blimage.h) to the length bytes at dst. Returns 0, or BLIMAGE_LZ_ERROR if
+ * they do not decompress to exactly length bytes; nothing is written
+ * outside dst.
+ */
+uint8_t blimage_lz_decompress (uint8_t *dst, const uint8_t *src, uint32_t stored, uint32_t length)
+{
+    const uint8_t *end = src + stored;
+    const uint8_t *match;
+    uint8_t *out = dst;
+    uint32_t n, offset, room = length;
+    uint8_t token, b;
+
+    while (src < end) {
+        token = *src++;
+        n = token >> 4;
+        if (n == 15) {
+            do {
+                if (src == end)
+                    return BLIMAGE_LZ_ERROR;
+                b = *src++;
+                n += b;
+            } while (b == 255);
+        }
+        if (n > (uint32_t)(end - src) || n > room)
+            return BLIMAGE_LZ_ERROR;
+        memcpy (out, src, n);
+        out += n;
+        src += n;
+        room -= n;
+        if (src == end)
+            break;
+
+        if (end - src < 2)
+            return BLIMAGE_LZ_ERROR;
+        offset = src[0] | ((uint32_t)src[1] << 8);
+        src += 2;
+        n = token & 15;
+        if (n == 15) {
+            do {
+                if (src == end)
+                    return BLIMAGE_LZ_ERROR;
+                b = *src++;
+                n += b;
+            } while (b == 255);
+        }
+        n += 4;
+        if (offset == 0 || offset > (uint32_t)(out - dst) || n > room)
+            return BLIMAGE_LZ_ERROR;
+        room -= n;
+        /* Byte by byte: the match may overlap the bytes it writes */
+        for (match = out - offset; n > 0; n--)
+            *out++ = *match++;
+    }
+    return room == 0 ? 0 : BLIMAGE_LZ_ERROR;
+}
+#endif
+
+/*
+ * Whether image starts with the header of a binary boot image.
+ */
+int blimage_check (const uint8_t *image)
+{
+    return ((const blimage_header_t *)image)->magic == BLIMAGE_MAGIC;
+}
+
+/*
+ * Copy the segments of the binary boot image at image to their load
+ * addresses, decompressing those that are LZ compressed, checking the CRC
+ * of the header and segment table and, with BLIMAGE_VERIFY_CRC, that of
+ * each segment as loaded. Segments for the XIP window of flash
+ * (BL_IS_XIP) are skipped.
+ * Returns 0 with *entry set to the entry point, or the error.
+ */
+uint8_t blimage_load (const uint8_t *image, uint32_t *entry)
+{
+    const blimage_header_t *header = (const blimage_header_t *)image;
+    const blimage_segment_t *segment = (const blimage_segment_t *)(header + 1);
+    const uint32_t *payload;
+    blimage_header_t check;
+    uint32_t num_segments = header->num_segments;
+    uint32_t crc, i;
+    uint8_t *dst;
+
+    if (header->magic != BLIMAGE_MAGIC || num_segments > BLIMAGE_MAX_SEGMENTS)
+        return BLIMAGE_HEADER_ERROR;
+    check = *header;
+    check.header_crc = 0;
+    crc = blimage_crc32 (0, (const uint8_t *)&check, sizeof(check));
+    crc = blimage_crc32 (crc, (const uint8_t *)segment, num_segments * sizeof(*segment));
+    if (crc != header->header_crc)
+        return BLIMAGE_HEADER_ERROR;
+
+    payload = (const uint32_t *)(segment + num_segments);
+    for (i = 0; i < num_segments; i++) {
+        dst = BL_TARGET_ADDR (segment[i].addr);
+        if (segment[i].stored > segment[i].length)
+            return BLIMAGE_HEADER_ERROR;
+        if (BL_IS_XIP (segment[i].addr)) {
+            /* Programmed to flash at its address, and read there in place */
+            payload += (segment[i].stored + 3) / 4;
+            continue;
+        }
+        if (segment[i].stored < segment[i].length) {
+#if BLIMAGE_LZ
+            if (blimage_lz_decompress (dst, (const uint8_t *)payload, segment[i].stored,
+                                       segment[i].length) != 0)
+                return BLIMAGE_LZ_ERROR;
+#if BLIMAGE_VERIFY_CRC
+            crc = blimage_crc32 (0, dst, segment[i].length);
+#endif
+#else
+            return BLIMAGE_LZ_ERROR;
+#endif
+        } else {
+            crc = copy_segment (dst, payload, segment[i].length);
+        }
+#if BLIMAGE_VERIFY_CRC
+        if (crc != segment[i].crc)
+            return BLIMAGE_CRC_ERROR;
+#endif
+        payload += (segment[i].stored + 3) / 4;
+    }
+
+    *entry = header->entry;
+    return 0;
+}
@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+/* Note: This file depends on the following files having been included prior to self being included.
+   1. portab.h
+*/
+
+#ifndef BL_BLIMAGE_H
+#define BL_BLIMAGE_H
+
+/*
+ * Binary boot image, made from an ELF or SREC file by utils/mkbootimg:
+ *
+ *   header         blimage_header_t
+ *   segment table  num_segments x blimage_segment_t
+ *   payload        the stored bytes of each segment in turn, each padded
+ *                  with zeros to a multiple of 4 bytes
+ *
+ * All fields are 32 bit words in the byte order of the processor (big
+ * endian on MicroBlaze), so that the loader reads them as they are.
+ * The CRCs are CRC-32 (as in zlib and Ethernet); header_crc covers the
+ * header, with header_crc as 0, and the segment table.
+ *
+ * A segment stored in fewer bytes than its length is LZ compressed, in
+ * sequences of a token byte (literal count in the high nybble, match
+ * length - 4 in the low one, 15 meaning that bytes follow, added up to the
+ * first that is not 255), the literals, and the match as a 16 bit little
+ * endian offset back into the bytes already written, then its extra length
+ * bytes; the last sequence has only literals. It is decompressed straight
+ * to the load address, matches being copied from what has already been
+ * written there, so the loader needs no window or buffer of its own.
+ */
+
+#define BLIMAGE_MAGIC           0x424C494D  /* "BLIM" */
+#define BLIMAGE_MAX_SEGMENTS    32
+
+typedef struct blimage_header_s {
+    uint32_t  magic;
+    uint32_t  entry;          /* Address the loader jumps to */
+    uint32_t  num_segments;
+    uint32_t  header_crc;
+} blimage_header_t;
+
+typedef struct blimage_segment_s {
+    uint32_t  addr;           /* Load address */
+    uint32_t  length;         /* Bytes loaded */
+    uint32_t  stored;         /* Bytes in the payload, without the padding */
+    uint32_t  crc;            /* CRC-32 of the bytes loaded */
+} blimage_segment_t;
+
+int       blimage_check (const uint8_t *image);
+uint8_t   blimage_load (const uint8_t *image, uint32_t *entry);
+uint32_t  blimage_crc32 (uint32_t crc, const uint8_t *buf, uint32_t len);
+uint8_t   blimage_lz_decompress (uint8_t *dst, const uint8_t *src, uint32_t stored, uint32_t length);
+
+#endif /* BL_BLIMAGE_H */
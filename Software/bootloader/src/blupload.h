@@ -0,0 +1,74 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+/* Note: This file depends on the following files having been included prior to self being included.
+   1. portab.h
+*/
+
+#ifndef BL_BLUPLOAD_H
+#define BL_BLUPLOAD_H
+
+/*
+ * Image upload over the UART (BL_UPLOAD), from utils/blsend.
+ *
+ * The host sends frames of
+ *
+ *   0      1   BLUP_SYNC
+ *   1      1   type: BLUP_HELLO, BLUP_DATA or BLUP_END
+ *   2      1   sequence number
+ *   3      2   payload length n, big endian
+ *   5      n   payload
+ *   5+n    4   CRC-32 (blimage_crc32) of bytes 1 to 4+n, big endian
+ *
+ * HELLO has no payload. DATA has the load address, big endian, and up to
+ * BLUP_MAX_DATA bytes to load there. END has the entry point and the
+ * flags, both big endian: with BLUP_COMMIT, the image is also programmed
+ * to flash as a binary boot image (blimage.h) before it is run.
+ *
+ * The bootloader replies with BLUP_SYNC, a type, a value and the
+ * complement of type ^ value:
+ *
+ *   BLUP_ACK     the sequence number of the last frame taken; all the
+ *                frames before it have been taken too
+ *   BLUP_NAK     the sequence number it expects, after a frame that was
+ *                corrupted or out of order; sent once until that frame comes
+ *   BLUP_STATUS  after END, 0 or the error (errors.h) of the upload
+ *
+ * Sequence numbers count up from that of HELLO, modulo 256. The host sends
+ * up to BLUP_WINDOW frames past the last one acknowledged, and goes back
+ * to the first one not acknowledged on a NAK, or when no ACK comes in
+ * time (go-back-N). Each frame is checked before any of it is written to
+ * RAM, so a bad frame leaves nothing behind, and one sent again only
+ * writes the same bytes again.
+ */
+
+#define BLUP_SYNC               0xB5
+#define BLUP_HELLO              'H'
+#define BLUP_DATA               'D'
+#define BLUP_END                'E'
+#define BLUP_ACK                'A'
+#define BLUP_NAK                'N'
+#define BLUP_STATUS             'S'
+
+#define BLUP_COMMIT             0x00000001
+
+#define BLUP_MAX_DATA           256
+#define BLUP_MAX_PAYLOAD        (4 + BLUP_MAX_DATA)
+#define BLUP_HEADER_BYTES       5
+#define BLUP_CRC_BYTES          4
+#define BLUP_REPLY_BYTES        4
+#define BLUP_WINDOW             8
+
+int       blupload_requested (void);
+uint8_t   blupload_load (uint32_t *entry);
+
+#endif /* BL_BLUPLOAD_H */
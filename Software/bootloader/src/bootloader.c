@@ -37,6 +37,10 @@
 #include "portab.h"
 #include "errors.h"
 #include "srec.h"
+#include "blimage.h"
+#include "blcopy.h"
+#include "blupload.h"
+#include "boot_trace.h"
 
 /* Defines */
 #define CR       13
@@ -47,7 +51,10 @@
 /* Declarations */
 static void display_progress (uint32_t lines);
 static uint8_t load_exec ();
-static uint8_t flash_get_srec_line (uint8_t *buf);
+static uint8_t load_blimage ();
+#if BL_UPLOAD
+static uint8_t load_upload ();
+#endif
 extern void init_stdout();
 
 extern int srec_line;
@@ -63,10 +70,6 @@ extern void outbyte(char c);
 #endif
 
 /* Data structures */
-static srec_info_t srinfo;
-static uint8_t sr_buf[SREC_MAX_BYTES];
-static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
-
 static uint8_t *flbuf;
 
 #ifdef VERBOSE
@@ -75,7 +78,12 @@ static int8_t *errors[] = {
     "Error while copying executable image into RAM",
     "Error while reading an SREC line from flash",
     "SREC line is corrupted",
-    "SREC has invalid checksum."
+    "SREC has invalid checksum.",
+    "Boot image header is corrupted",
+    "Boot image segment has invalid CRC",
+    "Boot image segment does not decompress",
+    "Image upload over the UART failed",
+    "Error while programming flash"
 };
 #endif
 
@@ -92,22 +100,32 @@ int main()
 {
     uint8_t ret;
 
+    BOOT_TRACE_START ();
     init_stdout();
 
 #ifdef VERBOSE    
     print ("\r\nSREC Bootloader\r\n");
-    print ("Loading SREC image from flash @ address: ");    
+    print ("Loading image from flash @ address: ");    
     putnum (FLASH_IMAGE_BASEADDR);
     print ("\r\n");        
 #endif
 
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_INIT);
     flbuf = (uint8_t*)FLASH_IMAGE_BASEADDR;
-    ret = load_exec ();
+#if BL_UPLOAD
+    if (blupload_requested ())
+        ret = load_upload ();
+    else
+#endif
+    if (blimage_check (flbuf))
+        ret = load_blimage ();
+    else
+        ret = load_exec ();
 
     /* If we reach here, we are in error */
     
 #ifdef VERBOSE
-    if (ret > LD_SREC_LINE_ERROR) {
+    if (ret > LD_SREC_LINE_ERROR && ret <= SREC_CKSUM_ERROR) {
         print ("ERROR in SREC line: ");
         putnum (srec_line);
         print (errors[ret]);    
@@ -134,40 +152,22 @@ static void display_progress (uint32_t count)
 static uint8_t load_exec ()
 {
     uint8_t ret;
+    uint32_t entry;
     void (*laddr)();
-    int8_t done = 0;
-    
-    srinfo.sr_data = sr_data_buf;
-    
-    while (!done) {
-        if ((ret = flash_get_srec_line (sr_buf)) != 0) 
-            return ret;
 
-        if ((ret = decode_srec_line (sr_buf, &srinfo)) != 0)
-            return ret;
-        
+    /* Records are decoded in place in flash, and copied to RAM a chunk
+       at a time, by DMA with BL_COPY_DMA */
+    if ((ret = blcopy_init ()) != 0)
+        return ret;
 #ifdef VERBOSE
-        display_progress (srec_line);
-#endif
-        switch (srinfo.type) {
-            case SREC_TYPE_0:
-                break;
-            case SREC_TYPE_1:
-            case SREC_TYPE_2:
-            case SREC_TYPE_3:
-                memcpy ((void*)srinfo.addr, (void*)srinfo.sr_data, srinfo.dlen);
-                break;
-            case SREC_TYPE_5:
-                break;
-            case SREC_TYPE_7:
-            case SREC_TYPE_8:
-            case SREC_TYPE_9:
-                laddr = (void (*)())srinfo.addr;
-                done = 1;
-                ret = 0;
-                break;
-        }
-    }
+    ret = blcopy_load_srec (flbuf, &entry, display_progress);
+#else
+    ret = blcopy_load_srec (flbuf, &entry, 0);
+#endif
+    if (ret != 0)
+        return ret;
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_LOAD);
+    laddr = (void (*)())entry;
 
 #ifdef VERBOSE
     print ("\r\nExecuting program starting at address: ");
@@ -175,33 +175,43 @@ static uint8_t load_exec ()
     print ("\r\n");
 #endif
 
-    (*laddr)();                 
-  
+    (*laddr)();
+
     /* We will be dead at this point */
     return 0;
 }
 
-
-static uint8_t flash_get_srec_line (uint8_t *buf)
+/* Binary boot image made by utils/mkbootimg: each segment is copied
+   straight from flash to its load address, with no per record decoding */
+static uint8_t load_blimage ()
 {
-    uint8_t c;
-    int count = 0;
-
-    while (1) {
-        c  = *flbuf++;
-        if (c == 0xD) {   
-            /* Eat up the 0xA too */
-            c = *flbuf++; 
-            return 0;
-        }
-        
-        *buf++ = c;
-        count++;
-        if (count > SREC_MAX_BYTES) 
-            return LD_SREC_LINE_ERROR;
-    }
+    uint8_t ret;
+    uint32_t entry;
+    void (*laddr)();
+#if BOOT_TRACE
+    unsigned long trace_start;
+#endif
+
+    BOOT_TRACE_BEGIN (trace_start);
+    if ((ret = blimage_load (flbuf, &entry)) != 0)
+        return ret;
+    BOOT_TRACE_END (BOOT_TRACE_COPY, trace_start);
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_LOAD);
+    laddr = (void (*)())entry;
+
+#ifdef VERBOSE
+    print ("\r\nExecuting program starting at address: ");
+    putnum ((uint32_t)laddr);
+    print ("\r\n");
+#endif
+
+    (*laddr)();
+
+    /* We will be dead at this point */
+    return 0;
 }
 
+
 #ifdef __PPC__
 
 #include <unistd.h>
@@ -213,3 +223,30 @@ void exit (int ret)
     _exit (ret);
 }
 #endif
+
+#if BL_UPLOAD
+/* Image sent over the UART by utils/blsend: each frame is loaded straight
+   to RAM, and the image is programmed to flash if the host asked for it */
+static uint8_t load_upload ()
+{
+    uint8_t ret;
+    uint32_t entry;
+    void (*laddr)();
+
+    if ((ret = blupload_load (&entry)) != 0)
+        return ret;
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_LOAD);
+    laddr = (void (*)())entry;
+
+#ifdef VERBOSE
+    print ("\r\nExecuting program starting at address: ");
+    putnum ((uint32_t)laddr);
+    print ("\r\n");
+#endif
+
+    (*laddr)();
+
+    /* We will be dead at this point */
+    return 0;
+}
+#endif
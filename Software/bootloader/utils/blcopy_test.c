@@ -0,0 +1,295 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host test of the DMA overlapped SREC load of the bootloader
+ * (src/blcopy.c), built against the software stand-in of the LocalLink DMA
+ * driver (lldma_sim.c). An SREC is loaded the way the bootloader loads it
+ * with BL_COPY_DMA, and the memory image and entry point are compared with
+ * those of a plain decode and memcpy of each record. The stand-in only
+ * moves data when the loader polls it, so a chunk buffer reused before its
+ * copy is done shows up as wrong data; it also checks the cache flushes
+ * and invalidations, and a failed copy must be reported. The copies, the
+ * chunks in flight and the time of both loads are printed.
+ *
+ * Build (from this directory; -std=c99 keeps the system headers from
+ * redefining the types of src/portab.h):
+ *   gcc -std=c99 -O2 -DBL_HOST_TEST -I../src -I. blcopy_test.c lldma_sim.c
+ *       ../src/blcopy.c ../src/srec.c -o blcopy_test
+ *
+ * Usage:
+ *   blcopy_test [image.srec]
+ *
+ * Without a file, an image of three segments at 0x8C000000 is made up,
+ * with a record out of order and records of several lengths, and a fourth
+ * segment in the XIP window of flash that must not be copied.
+ *
+ * @file blcopy_test.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "srec.h"
+#include "errors.h"
+#include "blcopy.h"
+#include "lldma_sim.h"
+
+#define MAX_IMAGE_BYTES     (16 * 1024 * 1024)
+#define MADE_UP_BASEADDR    0x8C000000
+#define BENCH_SECONDS       0.5
+
+extern int srec_line;
+
+static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
+
+/* Memory the loads write to, standing for [host_base, host_base + host_size) */
+static uint8_t *host_memory;
+static unsigned long host_base, host_size;
+static unsigned long progress_calls;
+
+uint8_t *bl_host_addr (uint32_t addr)
+{
+    if (addr < host_base || addr >= host_base + host_size) {
+        printf ("load address 0x%08lX is outside the image\n", (unsigned long)addr);
+        exit (1);
+    }
+    return host_memory + (addr - host_base);
+}
+
+static void progress (uint32_t lines)
+{
+    (void)lines;
+    progress_calls++;
+}
+
+/*
+ * Append one record of the given type to text.
+ */
+static long put_record (char *text, int type, unsigned long addr, const uint8_t *data, int dlen)
+{
+    int alen = (type == 0 || type == 1 || type == 9) ? 2 : (type == 2 || type == 8) ? 3 : 4;
+    int count = alen + dlen + 1;
+    uint8_t cksum = (uint8_t)count;
+    long n;
+    int i;
+
+    n = sprintf (text, "S%d%02X", type, count);
+    for (i = alen - 1; i >= 0; i--) {
+        n += sprintf (text + n, "%02X", (unsigned)((addr >> (8 * i)) & 0xFF));
+        cksum += (uint8_t)(addr >> (8 * i));
+    }
+    for (i = 0; i < dlen; i++) {
+        n += sprintf (text + n, "%02X", data[i]);
+        cksum += data[i];
+    }
+    n += sprintf (text + n, "%02X\r\n", (uint8_t)~cksum);
+    return n;
+}
+
+/*
+ * Append the records of a segment of len bytes at addr, of lengths from
+ * 1 to SREC_DATA_MAX_BYTES, with the second record moved to the end.
+ */
+static long put_segment (char *text, unsigned long addr, unsigned long len)
+{
+    unsigned long off = 0, second = 0, second_len = 0;
+    uint8_t data[SREC_DATA_MAX_BYTES];
+    long n = 0;
+    int dlen, i, rec = 0;
+
+    while (off < len) {
+        dlen = 1 + rand () % SREC_DATA_MAX_BYTES;
+        if (rec % 7 != 6)
+            dlen = 16;
+        if ((unsigned long)dlen > len - off)
+            dlen = (int)(len - off);
+        for (i = 0; i < dlen; i++)
+            data[i] = (uint8_t)(rand () >> 7);
+        if (rec == 1) {
+            second = off;
+            second_len = (unsigned long)dlen;
+            memcpy (sr_data_buf, data, dlen);
+        } else {
+            n += put_record (text + n, 3, addr + off, data, dlen);
+        }
+        off += dlen;
+        rec++;
+    }
+    if (second_len > 0)
+        n += put_record (text + n, 3, addr + second, sr_data_buf, (int)second_len);
+    return n;
+}
+
+/*
+ * The reference: decode each record and copy it, as load_exec() did.
+ */
+static int plain_load (uint8_t *flbuf, uint32_t *entry)
+{
+    srec_info_t info;
+    int ret;
+
+    info.sr_data = sr_data_buf;
+    while (1) {
+        if ((ret = decode_srec_line (flbuf, &info)) != 0)
+            return ret;
+        flbuf = info.next;
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3) {
+            if (!BL_IS_XIP ((uint32_t)(unsigned long)info.addr))
+                memcpy (bl_host_addr ((uint32_t)(unsigned long)info.addr), info.sr_data, info.dlen);
+        } else if (info.type >= SREC_TYPE_7) {
+            *entry = (uint32_t)(unsigned long)info.addr;
+            return 0;
+        }
+    }
+}
+
+static int dma_load (uint8_t *srec, uint32_t *entry)
+{
+    int ret;
+
+    lldma_sim_reset ();
+    if ((ret = blcopy_init ()) != 0)
+        return ret;
+    return blcopy_load_srec (srec, entry, progress);
+}
+
+static double load_time (int dma, uint8_t *srec)
+{
+    clock_t start = clock ();
+    uint32_t entry;
+    double secs;
+    int loads = 0;
+
+    do {
+        if (dma)
+            dma_load (srec, &entry);
+        else
+            plain_load (srec, &entry);
+        loads++;
+        secs = (double)(clock () - start) / CLOCKS_PER_SEC;
+    } while (secs < BENCH_SECONDS);
+    return secs / loads;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t *srec_words;
+    uint8_t *srec, *expected, *p;
+    uint32_t entry_plain = 0, entry_dma = 0;
+    unsigned long end = 0, lines = 0;
+    long len = 0;
+    double plain_secs, dma_secs;
+    int ret, failed = 0;
+    srec_info_t info;
+
+    /* Word aligned, like the image in flash */
+    srec_words = malloc (MAX_IMAGE_BYTES * 3 + 16);
+    srec = (uint8_t *)srec_words;
+    if (srec == NULL)
+        return 1;
+
+    if (argc > 1) {
+        FILE *f = fopen (argv[1], "rb");
+
+        if (f == NULL) {
+            perror (argv[1]);
+            return 1;
+        }
+        len = (long)fread (srec, 1, MAX_IMAGE_BYTES * 3, f);
+        fclose (f);
+    } else {
+        uint8_t header[] = "blcopy_test";
+
+        srand (1);
+        len = put_record ((char *)srec, 0, 0, header, sizeof(header) - 1);
+        len += put_segment ((char *)srec + len, MADE_UP_BASEADDR, 200000);
+        len += put_segment ((char *)srec + len, MADE_UP_BASEADDR + 0x40000, 4097);
+        len += put_segment ((char *)srec + len, MADE_UP_BASEADDR + 0x30001, 50001);
+#if BL_XIP
+        len += put_segment ((char *)srec + len, BL_XIP_BASEADDR, 10000);
+#endif
+        len += put_record ((char *)srec + len, 7, MADE_UP_BASEADDR, NULL, 0);
+    }
+    srec[len] = '\0';
+
+    /* Extent of the memory image; a copy to the XIP window is outside of it */
+    host_base = ~0UL;
+    info.sr_data = sr_data_buf;
+    for (p = srec; p < srec + len && decode_srec_line (p, &info) == 0; p = info.next) {
+        lines++;
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3
+            && !BL_IS_XIP ((uint32_t)(unsigned long)info.addr)) {
+            if ((unsigned long)info.addr < host_base)
+                host_base = (unsigned long)info.addr;
+            if ((unsigned long)info.addr + info.dlen > end)
+                end = (unsigned long)info.addr + info.dlen;
+        }
+        if (info.type >= SREC_TYPE_7)
+            break;
+    }
+    if (end == 0 || p >= srec + len) {
+        printf ("no image, or no S7-S9 record, at line %d\n", srec_line);
+        return 1;
+    }
+    host_size = end - host_base;
+
+    host_memory = calloc (host_size, 1);
+    if ((ret = plain_load (srec, &entry_plain)) != 0) {
+        printf ("decoding failed with error %d\n", ret);
+        return 1;
+    }
+    expected = host_memory;
+
+    host_memory = calloc (host_size, 1);
+    progress_calls = 0;
+    ret = dma_load (srec, &entry_dma);
+    if (ret != 0 || entry_dma != entry_plain || memcmp (host_memory, expected, host_size) != 0) {
+        printf ("the DMA load (error %d) differs from the plain one\n", ret);
+        failed = 1;
+    }
+    if (progress_calls != lines) {
+        printf ("progress was reported %lu times for %lu records\n", progress_calls, lines);
+        failed = 1;
+    }
+    if (lldma_sim_stats.unflushed != 0 || lldma_sim_pending_invalidates () != 0) {
+        printf ("%lu copies of unflushed sources, %lu destinations not invalidated\n",
+                lldma_sim_stats.unflushed, lldma_sim_pending_invalidates ());
+        failed = 1;
+    }
+    if (lldma_sim_stats.mismatched != 0) {
+        printf ("%lu copies with TX and RX of different lengths\n", lldma_sim_stats.mismatched);
+        failed = 1;
+    }
+    printf ("%lu records, %lu bytes in %lu DMA copies of %.0f bytes on average, "
+            "%lu in flight at most\n", lines, lldma_sim_stats.bytes, lldma_sim_stats.copies,
+            (double)lldma_sim_stats.bytes / lldma_sim_stats.copies, lldma_sim_stats.max_in_flight);
+
+    /* A copy the engine fails */
+    lldma_sim_stats.fail_copy = 2;
+    ret = dma_load (srec, &entry_dma);
+    lldma_sim_stats.fail_copy = 0;
+    if (ret != LD_MEM_WRITE_ERROR && lldma_sim_stats.copies >= 2) {
+        printf ("a failed copy was not reported (%d)\n", ret);
+        failed = 1;
+    }
+    if (failed)
+        return 1;
+
+    plain_secs = load_time (0, srec);
+    dma_secs = load_time (1, srec);
+    printf ("load                      ms\n");
+    printf ("decode and memcpy  %9.3f\n", plain_secs * 1e3);
+    printf ("queued DMA copies  %9.3f  (the stand-in copies on the CPU)\n", dma_secs * 1e3);
+    printf ("all tests passed\n");
+    return 0;
+}
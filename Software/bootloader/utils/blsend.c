@@ -0,0 +1,917 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host side of the image upload of the bootloader (BL_UPLOAD, see
+ * src/blupload.h): sends an application SREC over the serial port in
+ * framed, CRC checked pieces of up to BLUP_MAX_DATA bytes, BLUP_WINDOW
+ * frames ahead of the acknowledgements, going back to the first frame
+ * not acknowledged on a NAK or a timeout. The bootloader writes each
+ * frame straight to its load address; with -c it then programs the image
+ * to flash as a binary boot image, so later boots need no host.
+ *
+ * With -s, the upload is run on the host against the code of the
+ * bootloader (src/blupload.c, blflash.c, blimage.c) on a stand-in of the
+ * UART Lite (16 byte FIFOs, characters paced at the baud rate, polls of
+ * SIM_POLL_NS) and of the Intel StrataFlash (command set, lock bits and
+ * typical times of the 28F128J3). -l corrupts bytes on the line, both
+ * ways. Checks that the RAM image and entry point are those of the SREC,
+ * that a committed image boots to the same with src/blimage.c and that
+ * nothing past BL_UPLOAD_FLASH_SIZE was touched, and prints the time of
+ * the upload and of the commit, and what was sent again. The time the
+ * bootloader takes to check and copy a frame is not counted; the RX FIFO
+ * holds 16 characters, 1.4 ms at 115200 baud, much more than that.
+ *
+ * Build (from this directory; -std=c99 keeps the system headers from
+ * redefining the types of src/portab.h):
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=200112L -O2 -DBL_HOST_TEST -I../src
+ *       blsend.c ../src/blupload.c ../src/blflash.c ../src/blimage.c
+ *       ../src/srec.c -o blsend
+ *
+ * Usage:
+ *   blsend [-b baud] [-c] -p /dev/ttyS0 app.srec
+ *       Start it, then reset the board: the bootloader, built with
+ *       BL_UPLOAD, waits about 0.1 s for the HELLO frames of the host.
+ *   blsend -s [-b baud] [-c] [-l error_rate] [-r seed] app.srec
+ *       Simulated upload; error_rate is the probability that a byte on
+ *       the line is corrupted.
+ *
+ * The baud rate must be that of the UART Lite, fixed in the hardware
+ * (C_BAUDRATE of RS232_DCE in system.mhs, 9600). Records in the XIP window
+ * of src/blconfig.h are not sent: they are programmed to flash on their own.
+ *
+ * @file blsend.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "srec.h"
+#include "errors.h"
+#include "blimage.h"
+#include "blupload.h"
+
+#define MAX_INPUT_BYTES     (48 * 1024 * 1024)
+#define MAX_CHUNKS          4096
+#define DEFAULT_BAUD        9600
+
+/* The host gives up after this long without an acknowledgement, or
+   without the status of the upload, which comes after the commit */
+#define GIVE_UP_NS          60e9
+
+/* UART Lite registers and status bits, as in src/blupload.c */
+#define UART_RX_FIFO        0x0
+#define UART_TX_FIFO        0x4
+#define UART_STATUS         0x8
+#define UART_RX_VALID       0x01
+#define UART_RX_FULL        0x02
+#define UART_TX_FULL        0x08
+#define UART_FIFO_BYTES     16
+
+/* A UART Lite register access of MicroBlaze at 50 MHz, with the loop */
+#define SIM_POLL_NS         200.0
+
+/* 28F128J3: 16 MB in blocks of 128 KB, from FLASH_BASEADDR */
+#define FLASH_BASEADDR      0x89000000
+#define FLASH_BYTES         (16 * 1024 * 1024)
+#define FLASH_BLOCKS        (FLASH_BYTES / BL_FLASH_BLOCK_SIZE)
+#define FLASH_ERASE_NS      1.0e9
+#define FLASH_PROGRAM_NS    210e3
+#define FLASH_UNLOCK_NS     0.5e9
+
+extern int srec_line;
+
+typedef struct chunk_s {
+    unsigned long addr;
+    unsigned long length;
+    uint8_t *data;
+} chunk_t;
+
+typedef struct frame_s {
+    uint8_t bytes[BLUP_HEADER_BYTES + BLUP_MAX_PAYLOAD + BLUP_CRC_BYTES];
+    int len;
+} frame_t;
+
+static chunk_t chunks[MAX_CHUNKS];
+static int num_chunks;
+static unsigned long entry_point;
+static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
+
+static frame_t hello, *frames;
+static int num_frames;
+
+/* Memory the upload writes to, standing for [host_base, host_base + host_size) */
+static uint8_t *host_memory;
+static unsigned long host_base, host_size;
+
+enum { SEND_HELLO, SEND_FRAMES, WAIT_STATUS, SEND_DONE, SEND_FAILED };
+
+/* The sender: frames [base, next) are sent and not acknowledged yet */
+static struct {
+    int state;
+    int base, next, max_sent;
+    double char_ns, timeout_ns, hello_ns;
+    double start, last_hello, last_progress, last_ack, rewound_until;
+    uint8_t reply[BLUP_REPLY_BYTES];
+    int reply_len;
+    int status;
+    unsigned long sent, resent, naks, timeouts, bytes;
+    void (*write) (const uint8_t *buf, int len);
+} snd;
+
+/* The UART Lite, and the line from the host to it */
+static struct {
+    double now;
+    double line_next, tx_next;
+    double error_rate;
+    uint8_t *line;
+    unsigned long line_head, line_tail, line_size;
+    uint8_t rx[UART_FIFO_BYTES], tx[UART_FIFO_BYTES];
+    int rx_head, rx_count, tx_head, tx_count;
+    int host;
+    unsigned long overruns, corrupted;
+} uart;
+
+enum { FLASH_ARRAY, FLASH_STATUS, FLASH_PROGRAM, FLASH_ERASE, FLASH_LOCK };
+
+/* The flash */
+static struct {
+    uint8_t *mem;
+    int mode;
+    uint8_t status;
+    double busy_until, busy_ns;
+    uint8_t locked[FLASH_BLOCKS];
+    unsigned long erases, programmed, unlocks, bad_commands;
+} flash;
+
+uint8_t *bl_host_addr (uint32_t addr)
+{
+    if (addr < host_base || addr >= host_base + host_size) {
+        printf ("load address 0x%08lX is outside the image\n", (unsigned long)addr);
+        exit (1);
+    }
+    return host_memory + (addr - host_base);
+}
+
+static double now_ns (void)
+{
+    struct timespec t;
+
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/*
+ * The SREC, as chunks of adjacent records.
+ */
+static int add_chunk (unsigned long addr, const uint8_t *data, unsigned long length)
+{
+    chunk_t *last = num_chunks > 0 ? &chunks[num_chunks - 1] : NULL;
+
+    if (length == 0)
+        return 0;
+    if (last != NULL && last->addr + last->length == addr) {
+        last->data = realloc (last->data, last->length + length);
+        if (last->data == NULL)
+            return -1;
+        memcpy (last->data + last->length, data, length);
+        last->length += length;
+        return 0;
+    }
+    if (num_chunks == MAX_CHUNKS)
+        return -1;
+    last = &chunks[num_chunks++];
+    last->addr = addr;
+    last->length = length;
+    last->data = malloc (length);
+    if (last->data == NULL)
+        return -1;
+    memcpy (last->data, data, length);
+    return 0;
+}
+
+static int compare_chunks (const void *a, const void *b)
+{
+    const chunk_t *ca = (const chunk_t *)a, *cb = (const chunk_t *)b;
+
+    return ca->addr < cb->addr ? -1 : ca->addr > cb->addr;
+}
+
+/*
+ * Sort the chunks by address and merge those that touch, so that the
+ * bootloader sees as few segments as there are sections.
+ * Returns -1 if two of them overlap.
+ */
+static int merge_chunks (void)
+{
+    int i, n = 0;
+
+    qsort (chunks, num_chunks, sizeof(chunk_t), compare_chunks);
+    for (i = 0; i < num_chunks; i++) {
+        if (n > 0 && chunks[n - 1].addr + chunks[n - 1].length > chunks[i].addr)
+            return -1;
+        if (n > 0 && chunks[n - 1].addr + chunks[n - 1].length == chunks[i].addr) {
+            chunk_t *last = &chunks[n - 1];
+            last->data = realloc (last->data, last->length + chunks[i].length);
+            if (last->data == NULL)
+                return -1;
+            memcpy (last->data + last->length, chunks[i].data, chunks[i].length);
+            last->length += chunks[i].length;
+            free (chunks[i].data);
+        } else {
+            chunks[n++] = chunks[i];
+        }
+    }
+    num_chunks = n;
+    return 0;
+}
+
+static unsigned long data_bytes (void)
+{
+    unsigned long n = 0;
+    int i;
+
+    for (i = 0; i < num_chunks; i++)
+        n += chunks[i].length;
+    return n;
+}
+
+static int read_srec (uint8_t *file, long len)
+{
+    srec_info_t info;
+    uint8_t *p;
+    int ret, xip = 0;
+
+    info.sr_data = sr_data_buf;
+    for (p = file; p < file + len; p = info.next) {
+        if ((ret = decode_srec_line (p, &info)) != 0) {
+            printf ("SREC line %d: error %d\n", srec_line, ret);
+            return -1;
+        }
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3) {
+            if (BL_IS_XIP ((uint32_t)(unsigned long)info.addr))
+                xip += info.dlen;
+            else if (add_chunk ((unsigned long)info.addr, info.sr_data, info.dlen) != 0)
+                return -1;
+        } else if (info.type >= SREC_TYPE_7) {
+            entry_point = (unsigned long)info.addr;
+            if (xip > 0)
+                printf ("%d bytes in the XIP window of flash are not sent\n", xip);
+            return 0;
+        }
+    }
+    printf ("no S7-S9 record\n");
+    return -1;
+}
+
+static void put_be32 (uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void make_frame (frame_t *frame, uint8_t type, uint8_t seq, const uint8_t *payload, int len)
+{
+    uint8_t *p = frame->bytes;
+
+    p[0] = BLUP_SYNC;
+    p[1] = type;
+    p[2] = seq;
+    p[3] = (uint8_t)(len >> 8);
+    p[4] = (uint8_t)len;
+    memcpy (p + BLUP_HEADER_BYTES, payload, len);
+    put_be32 (p + BLUP_HEADER_BYTES + len, blimage_crc32 (0, p + 1, BLUP_HEADER_BYTES - 1 + len));
+    frame->len = BLUP_HEADER_BYTES + len + BLUP_CRC_BYTES;
+}
+
+/*
+ * HELLO with sequence number 0, the DATA frames of each chunk, then END;
+ * frame i has sequence number i + 1.
+ */
+static void make_frames (int commit)
+{
+    uint8_t payload[BLUP_MAX_PAYLOAD];
+    unsigned long off, n;
+    int i, count = 1;
+
+    for (i = 0; i < num_chunks; i++)
+        count += (int)((chunks[i].length + BLUP_MAX_DATA - 1) / BLUP_MAX_DATA);
+    frames = malloc (count * sizeof(frame_t));
+    make_frame (&hello, BLUP_HELLO, 0, NULL, 0);
+    for (i = 0; i < num_chunks; i++) {
+        for (off = 0; off < chunks[i].length; off += n) {
+            n = chunks[i].length - off;
+            if (n > BLUP_MAX_DATA)
+                n = BLUP_MAX_DATA;
+            put_be32 (payload, (uint32_t)(chunks[i].addr + off));
+            memcpy (payload + 4, chunks[i].data + off, n);
+            make_frame (&frames[num_frames], BLUP_DATA, (uint8_t)(num_frames + 1), payload, (int)(4 + n));
+            num_frames++;
+        }
+    }
+    put_be32 (payload, (uint32_t)entry_point);
+    put_be32 (payload + 4, commit ? BLUP_COMMIT : 0);
+    make_frame (&frames[num_frames], BLUP_END, (uint8_t)(num_frames + 1), payload, 8);
+    num_frames++;
+}
+
+#define FRAME_SEQ(i)        ((uint8_t)((i) + 1))
+
+static void sender_start (double baud, void (*write) (const uint8_t *buf, int len))
+{
+    memset (&snd, 0, sizeof(snd));
+    snd.char_ns = 10 * 1e9 / baud;
+    /* A window of the longest frames on the line, then the ACK */
+    snd.timeout_ns = ((BLUP_WINDOW + 1) * sizeof(frames[0].bytes) + BLUP_REPLY_BYTES) * snd.char_ns + 100e6;
+    snd.hello_ns = 2 * (hello.len + BLUP_REPLY_BYTES) * snd.char_ns + 10e6;
+    snd.last_hello = -snd.hello_ns;
+    snd.write = write;
+}
+
+static void handle_reply (uint8_t type, uint8_t value, double now)
+{
+    int i, j;
+
+    if (type == BLUP_ACK && snd.state == SEND_HELLO && value == 0) {
+        snd.state = SEND_FRAMES;
+        snd.start = snd.last_progress = snd.last_ack = now;
+    } else if (type == BLUP_ACK && snd.state == SEND_FRAMES) {
+        for (i = snd.base; i < snd.next; i++) {
+            if (FRAME_SEQ (i) == value) {
+                snd.base = i + 1;
+                snd.last_progress = snd.last_ack = now;
+                if (snd.base == num_frames)
+                    snd.state = WAIT_STATUS;
+                break;
+            }
+        }
+    } else if (type == BLUP_NAK && snd.state == SEND_FRAMES) {
+        snd.naks++;
+        for (i = snd.base; i < snd.next && FRAME_SEQ (i) != value; i++)
+            ;
+        /* Once gone back to a frame, NAKs of the frames sent before it
+           was sent again are not for it */
+        if (i == snd.next || (i == snd.base && now < snd.rewound_until))
+            return;
+        snd.rewound_until = now;
+        for (j = i; j < snd.next; j++)
+            snd.rewound_until += frames[j].len * snd.char_ns;
+        snd.base = snd.next = i;
+        snd.last_progress = snd.last_ack = now;
+    } else if (type == BLUP_STATUS && (snd.state == SEND_FRAMES || snd.state == WAIT_STATUS)) {
+        snd.status = value;
+        snd.state = SEND_DONE;
+        snd.last_progress = now;
+    }
+}
+
+/*
+ * A byte from the bootloader. Anything but a whole reply, such as what the
+ * bootloader prints before it listens, is skipped.
+ */
+static void sender_receive (uint8_t c, double now)
+{
+    int i;
+
+    if (snd.reply_len == 0 && c != BLUP_SYNC)
+        return;
+    snd.reply[snd.reply_len++] = c;
+    if (snd.reply_len < BLUP_REPLY_BYTES)
+        return;
+    if (snd.reply[3] == (uint8_t)~(snd.reply[1] ^ snd.reply[2])) {
+        snd.reply_len = 0;
+        handle_reply (snd.reply[1], snd.reply[2], now);
+        return;
+    }
+    /* Start again from the next sync byte */
+    for (i = 1; i < BLUP_REPLY_BYTES && snd.reply[i] != BLUP_SYNC; i++)
+        ;
+    memmove (snd.reply, snd.reply + i, BLUP_REPLY_BYTES - i);
+    snd.reply_len = BLUP_REPLY_BYTES - i;
+}
+
+static void sender_step (double now)
+{
+    switch (snd.state) {
+    case SEND_HELLO:
+        if (now - snd.last_hello >= snd.hello_ns) {
+            snd.write (hello.bytes, hello.len);
+            snd.last_hello = now;
+        }
+        break;
+    case SEND_FRAMES:
+        while (snd.next < num_frames && snd.next < snd.base + BLUP_WINDOW) {
+            snd.write (frames[snd.next].bytes, frames[snd.next].len);
+            if (snd.next < snd.max_sent)
+                snd.resent++;
+            else
+                snd.max_sent = snd.next + 1;
+            snd.sent++;
+            snd.bytes += frames[snd.next].len;
+            snd.next++;
+        }
+        if (now - snd.last_progress > snd.timeout_ns) {
+            snd.timeouts++;
+            snd.next = snd.base;
+            snd.last_progress = now;
+        }
+        if (now - snd.last_ack > GIVE_UP_NS)
+            snd.state = SEND_FAILED;
+        break;
+    case WAIT_STATUS:
+        if (now - snd.last_progress > GIVE_UP_NS)
+            snd.state = SEND_FAILED;
+        break;
+    }
+}
+
+/*
+ * The UART Lite of the board: bytes of the host reach the RX FIFO a
+ * character time apart, and are lost when it is full; replies leave the
+ * TX FIFO at the same pace.
+ */
+static uint8_t line_byte (uint8_t c)
+{
+    if (uart.error_rate > 0 && rand () < uart.error_rate * RAND_MAX) {
+        uart.corrupted++;
+        return (uint8_t)(c ^ (1 << (rand () % 8)));
+    }
+    return c;
+}
+
+static void sim_write (const uint8_t *buf, int len)
+{
+    if (uart.line_head == uart.line_tail)
+        uart.line_next = uart.now + snd.char_ns;
+    while (len-- > 0) {
+        uart.line[uart.line_tail % uart.line_size] = *buf++;
+        uart.line_tail++;
+    }
+}
+
+static void sim_advance (void)
+{
+    while (uart.line_head != uart.line_tail && uart.line_next <= uart.now) {
+        uint8_t c = line_byte (uart.line[uart.line_head % uart.line_size]);
+
+        uart.line_head++;
+        if (uart.rx_count == UART_FIFO_BYTES) {
+            uart.overruns++;
+        } else {
+            uart.rx[(uart.rx_head + uart.rx_count) % UART_FIFO_BYTES] = c;
+            uart.rx_count++;
+        }
+        uart.line_next += snd.char_ns;
+    }
+    while (uart.tx_count > 0 && uart.tx_next <= uart.now) {
+        uint8_t c = line_byte (uart.tx[uart.tx_head]);
+
+        uart.tx_head = (uart.tx_head + 1) % UART_FIFO_BYTES;
+        uart.tx_count--;
+        uart.tx_next += snd.char_ns;
+        if (uart.host)
+            sender_receive (c, uart.now);
+    }
+    if (uart.host)
+        sender_step (uart.now);
+    if (snd.state == SEND_FAILED) {
+        printf ("the host gave up at %.3f s: frame %d of %d not acknowledged\n",
+                uart.now / 1e9, snd.base, num_frames);
+        exit (1);
+    }
+}
+
+uint32_t bl_host_uart_in (uint32_t reg)
+{
+    uint32_t value = 0;
+
+    uart.now += SIM_POLL_NS;
+    sim_advance ();
+    if (reg == UART_STATUS) {
+        value = (uart.rx_count > 0 ? UART_RX_VALID : 0) | (uart.rx_count == UART_FIFO_BYTES ? UART_RX_FULL : 0)
+                | (uart.tx_count == UART_FIFO_BYTES ? UART_TX_FULL : 0);
+    } else if (reg == UART_RX_FIFO && uart.rx_count > 0) {
+        value = uart.rx[uart.rx_head];
+        uart.rx_head = (uart.rx_head + 1) % UART_FIFO_BYTES;
+        uart.rx_count--;
+    }
+    return value;
+}
+
+void bl_host_uart_out (uint32_t reg, uint32_t value)
+{
+    uart.now += SIM_POLL_NS;
+    sim_advance ();
+    if (reg != UART_TX_FIFO || uart.tx_count == UART_FIFO_BYTES)
+        return;
+    if (uart.tx_count == 0)
+        uart.tx_next = uart.now + snd.char_ns;
+    uart.tx[(uart.tx_head + uart.tx_count) % UART_FIFO_BYTES] = (uint8_t)value;
+    uart.tx_count++;
+}
+
+/*
+ * The StrataFlash: after a program, erase or lock command it reads as its
+ * status until it is given INTEL_READ_ARRAY (0xFF). A busy device is
+ * waited for by moving the clock to the end of the operation.
+ */
+static uint32_t flash_offset (uint32_t addr)
+{
+    if (addr < FLASH_BASEADDR || addr >= FLASH_BASEADDR + FLASH_BYTES) {
+        printf ("flash access at 0x%08lX, outside of the flash\n", (unsigned long)addr);
+        exit (1);
+    }
+    return addr - FLASH_BASEADDR;
+}
+
+uint8_t bl_host_flash_in (uint32_t addr)
+{
+    uint32_t off = flash_offset (addr);
+
+    uart.now += SIM_POLL_NS;
+    if (uart.now < flash.busy_until)
+        uart.now = flash.busy_until;
+    sim_advance ();
+    if (flash.mode == FLASH_ARRAY)
+        return flash.mem[off];
+    return flash.status | 0x80;
+}
+
+void bl_host_flash_out (uint32_t addr, uint8_t value)
+{
+    uint32_t off = flash_offset (addr), block = off / BL_FLASH_BLOCK_SIZE;
+
+    uart.now += SIM_POLL_NS;
+    if (uart.now < flash.busy_until) {
+        /* Only the status can be read while the device is busy */
+        if (value == 0x70)
+            flash.mode = FLASH_STATUS;
+        else
+            flash.bad_commands++;
+        return;
+    }
+    switch (flash.mode) {
+    case FLASH_PROGRAM:
+        flash.mode = FLASH_STATUS;
+        if (flash.locked[block]) {
+            flash.status |= 0x12;
+            return;
+        }
+        flash.mem[off] &= value;
+        flash.programmed++;
+        flash.busy_until = uart.now + FLASH_PROGRAM_NS;
+        flash.busy_ns += FLASH_PROGRAM_NS;
+        return;
+    case FLASH_ERASE:
+        flash.mode = FLASH_STATUS;
+        if (value != 0xD0) {
+            flash.status |= 0x30;
+        } else if (flash.locked[block]) {
+            flash.status |= 0x22;
+        } else {
+            memset (flash.mem + block * BL_FLASH_BLOCK_SIZE, 0xFF, BL_FLASH_BLOCK_SIZE);
+            flash.erases++;
+            flash.busy_until = uart.now + FLASH_ERASE_NS;
+            flash.busy_ns += FLASH_ERASE_NS;
+        }
+        return;
+    case FLASH_LOCK:
+        flash.mode = FLASH_STATUS;
+        if (value == 0xD0) {
+            /* J3: clears the lock bits of all the blocks */
+            memset (flash.locked, 0, sizeof(flash.locked));
+            flash.unlocks++;
+            flash.busy_until = uart.now + FLASH_UNLOCK_NS;
+            flash.busy_ns += FLASH_UNLOCK_NS;
+        } else if (value == 0x01) {
+            flash.locked[block] = 1;
+        } else {
+            flash.status |= 0x30;
+        }
+        return;
+    }
+    switch (value) {
+    case 0xFF:
+        flash.mode = FLASH_ARRAY;
+        break;
+    case 0x70:
+        flash.mode = FLASH_STATUS;
+        break;
+    case 0x50:
+        flash.status = 0;
+        break;
+    case 0x40:
+    case 0x10:
+        flash.mode = FLASH_PROGRAM;
+        break;
+    case 0x20:
+        flash.mode = FLASH_ERASE;
+        break;
+    case 0x60:
+        flash.mode = FLASH_LOCK;
+        break;
+    default:
+        flash.bad_commands++;
+        break;
+    }
+}
+
+/*
+ * Empty FIFOs and line, for another run of the bootloader.
+ */
+static void uart_reset (void)
+{
+    uart.line_head = uart.line_tail = 0;
+    uart.rx_count = uart.tx_count = 0;
+    uart.now = 0;
+    uart.overruns = uart.corrupted = 0;
+}
+
+/*
+ * Upload on the stand-ins, running the code of the bootloader.
+ */
+static int simulate (double baud, int commit, double error_rate)
+{
+    uint8_t *expected, *old_flash;
+    uint32_t entry = 0, off;
+    unsigned long i;
+    double wait_ns, upload_ns;
+    int ret, failed = 0;
+
+    memset (&uart, 0, sizeof(uart));
+    uart.line_size = 1 << 20;
+    uart.line = malloc (uart.line_size);
+    flash.mem = malloc (FLASH_BYTES);
+    old_flash = malloc (FLASH_BYTES);
+    expected = calloc (host_size, 1);
+    host_memory = calloc (host_size, 1);
+    if (uart.line == NULL || flash.mem == NULL || old_flash == NULL || expected == NULL || host_memory == NULL)
+        return 1;
+    for (i = 0; i < (unsigned long)num_chunks; i++)
+        memcpy (expected + (chunks[i].addr - host_base), chunks[i].data, chunks[i].length);
+    /* An old image in flash, and locked blocks, as after the flashwriter */
+    for (i = 0; i < FLASH_BYTES; i++)
+        flash.mem[i] = (uint8_t)(i * 7 + (i >> 9));
+    memcpy (old_flash, flash.mem, FLASH_BYTES);
+    memset (flash.locked, 1, sizeof(flash.locked));
+
+    /* No host: the bootloader goes on to boot from flash */
+    sender_start (baud, sim_write);
+    if (blupload_requested ()) {
+        printf ("the bootloader took an upload with no host\n");
+        return 1;
+    }
+    wait_ns = uart.now;
+
+    /* The host sends HELLO until the bootloader answers */
+    uart_reset ();
+    uart.host = 1;
+    uart.error_rate = error_rate;
+    sender_start (baud, sim_write);
+    if (!blupload_requested ()) {
+        printf ("the bootloader did not hear the host\n");
+        return 1;
+    }
+    ret = blupload_load (&entry);
+    /* Until the status reaches the host */
+    while (snd.state != SEND_DONE)
+        bl_host_uart_in (UART_STATUS);
+    upload_ns = uart.now - flash.busy_ns;
+
+    if (ret != 0 || snd.status != 0) {
+        printf ("the upload failed with error %d, the host was told %d\n", ret, snd.status);
+        failed = 1;
+    }
+    if (entry != entry_point || memcmp (host_memory, expected, host_size) != 0) {
+        printf ("the RAM image or entry point differ from those of the SREC\n");
+        failed = 1;
+    }
+    if (flash.bad_commands != 0) {
+        printf ("%lu flash commands out of place\n", flash.bad_commands);
+        failed = 1;
+    }
+    for (off = 0; off < FLASH_BYTES; off++) {
+        uint32_t addr = FLASH_BASEADDR + off;
+
+        if (flash.mem[off] != old_flash[off]
+            && (!commit || addr < FLASH_IMAGE_BASEADDR || addr >= FLASH_IMAGE_BASEADDR + BL_UPLOAD_FLASH_SIZE)) {
+            printf ("flash changed at 0x%08lX\n", (unsigned long)addr);
+            failed = 1;
+            break;
+        }
+    }
+    if (commit) {
+        /* Boot the committed image, as the bootloader will */
+        const uint8_t *image = flash.mem + (FLASH_IMAGE_BASEADDR - FLASH_BASEADDR);
+        uint32_t boot_entry = 0;
+
+        memset (host_memory, 0, host_size);
+        if (!blimage_check (image) || (ret = blimage_load (image, &boot_entry)) != 0
+            || boot_entry != entry_point || memcmp (host_memory, expected, host_size) != 0) {
+            printf ("the image in flash does not boot to the image of the SREC (error %d)\n", ret);
+            failed = 1;
+        }
+    }
+
+    printf ("%d frames (%d bytes of data at most), %lu bytes of data, %lu on the line (%.0f%%)\n",
+            num_frames, BLUP_MAX_DATA, data_bytes (), snd.bytes, 100.0 * data_bytes () / snd.bytes);
+    printf ("%lu frames sent again, %lu NAKs, %lu timeouts; %lu bytes corrupted, %lu lost to overruns\n",
+            snd.resent, snd.naks, snd.timeouts, uart.corrupted, uart.overruns);
+    printf ("without a host the bootloader waits %.1f ms\n", wait_ns / 1e6);
+    printf ("upload at %.0f baud    %8.2f s  (%.0f bytes/s)\n", baud, upload_ns / 1e9,
+            data_bytes () / (upload_ns / 1e9));
+    if (commit)
+        printf ("commit to flash      %8.2f s  (%lu blocks erased, %lu bytes programmed)\n",
+                flash.busy_ns / 1e9, flash.erases, flash.programmed);
+    if (failed)
+        return 1;
+    printf ("all tests passed\n");
+    return 0;
+}
+
+/*
+ * The serial port, raw, at the baud rate of the UART Lite.
+ */
+static int port = -1;
+
+static void port_write (const uint8_t *buf, int len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write (port, buf, len)) < 0) {
+            perror ("write");
+            exit (1);
+        }
+        buf += n;
+        len -= (int)n;
+    }
+}
+
+static int open_port (const char *device, long baud)
+{
+    static const struct { long baud; speed_t speed; } speeds[] = {
+        { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+        { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 }
+    };
+    struct termios t;
+    unsigned i;
+
+    for (i = 0; i < sizeof(speeds) / sizeof(speeds[0]) && speeds[i].baud != baud; i++)
+        ;
+    if (i == sizeof(speeds) / sizeof(speeds[0])) {
+        printf ("unsupported baud rate %ld\n", baud);
+        return -1;
+    }
+    if ((port = open (device, O_RDWR | O_NOCTTY)) < 0 || tcgetattr (port, &t) != 0) {
+        perror (device);
+        return -1;
+    }
+    /* 8N1, no flow control, no processing of the bytes */
+    t.c_iflag = 0;
+    t.c_oflag = 0;
+    t.c_lflag = 0;
+    t.c_cflag = CS8 | CREAD | CLOCAL;
+    t.c_cc[VMIN] = 0;
+    t.c_cc[VTIME] = 0;
+    cfsetispeed (&t, speeds[i].speed);
+    cfsetospeed (&t, speeds[i].speed);
+    if (tcsetattr (port, TCSANOW, &t) != 0) {
+        perror (device);
+        return -1;
+    }
+    tcflush (port, TCIOFLUSH);
+    return 0;
+}
+
+static int upload (const char *device, long baud)
+{
+    struct timespec pause = { 0, 1000000 };
+    uint8_t buf[64];
+    ssize_t n, i;
+
+    if (open_port (device, baud) != 0)
+        return 1;
+    sender_start ((double)baud, port_write);
+    printf ("waiting for the bootloader: reset the board\n");
+    while (snd.state != SEND_DONE && snd.state != SEND_FAILED) {
+        while ((n = read (port, buf, sizeof(buf))) > 0) {
+            for (i = 0; i < n; i++)
+                sender_receive (buf[i], now_ns ());
+        }
+        sender_step (now_ns ());
+        nanosleep (&pause, NULL);
+    }
+    if (snd.state == SEND_FAILED) {
+        printf ("no answer from the bootloader, at frame %d of %d\n", snd.base, num_frames);
+        return 1;
+    }
+    printf ("%lu bytes in %.2f s, %lu frames sent again; ", data_bytes (),
+            (now_ns () - snd.start) / 1e9, snd.resent);
+    if (snd.status != 0) {
+        printf ("the bootloader failed with error %d\n", snd.status);
+        return 1;
+    }
+    printf ("the bootloader is running it\n");
+    return 0;
+}
+
+static void usage (void)
+{
+    printf ("usage: blsend [-b baud] [-c] -p device app.srec\n"
+            "       blsend -s [-b baud] [-c] [-l error_rate] [-r seed] app.srec\n");
+    exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+    const char *device = NULL, *input = NULL;
+    double error_rate = 0;
+    long baud = DEFAULT_BAUD, len;
+    int sim = 0, commit = 0, a;
+    unsigned seed = 1;
+    unsigned long end = 0;
+    uint8_t *file;
+    FILE *f;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp (argv[a], "-p") == 0 && a + 1 < argc)
+            device = argv[++a];
+        else if (strcmp (argv[a], "-b") == 0 && a + 1 < argc)
+            baud = atol (argv[++a]);
+        else if (strcmp (argv[a], "-l") == 0 && a + 1 < argc)
+            error_rate = atof (argv[++a]);
+        else if (strcmp (argv[a], "-r") == 0 && a + 1 < argc)
+            seed = (unsigned)atol (argv[++a]);
+        else if (strcmp (argv[a], "-s") == 0)
+            sim = 1;
+        else if (strcmp (argv[a], "-c") == 0)
+            commit = 1;
+        else if (argv[a][0] != '-' && input == NULL)
+            input = argv[a];
+        else
+            usage ();
+    }
+    if (input == NULL || baud <= 0 || sim == (device != NULL))
+        usage ();
+
+    file = malloc (MAX_INPUT_BYTES + 1);
+    f = fopen (input, "rb");
+    if (file == NULL || f == NULL) {
+        perror (input);
+        return 1;
+    }
+    len = (long)fread (file, 1, MAX_INPUT_BYTES, f);
+    fclose (f);
+    file[len] = '\0';
+    if (read_srec (file, len) != 0)
+        return 1;
+    if (merge_chunks () != 0) {
+        printf ("%s: overlapping records\n", input);
+        return 1;
+    }
+    if (num_chunks == 0) {
+        printf ("%s: nothing to load outside of the XIP window\n", input);
+        return 1;
+    }
+    if (commit && num_chunks > BL_UPLOAD_MAX_SEGMENTS) {
+        printf ("%s: %d segments, more than the %d of a commit\n", input, num_chunks, BL_UPLOAD_MAX_SEGMENTS);
+        return 1;
+    }
+
+    /* Extent of the memory image */
+    host_base = ~0UL;
+    for (a = 0; a < num_chunks; a++) {
+        if (chunks[a].addr < BL_UPLOAD_LOWADDR || chunks[a].addr + chunks[a].length - 1 > BL_UPLOAD_HIGHADDR) {
+            printf ("%s: 0x%08lX is outside of the RAM the bootloader loads\n", input, chunks[a].addr);
+            return 1;
+        }
+        if (chunks[a].addr < host_base)
+            host_base = chunks[a].addr;
+        if (chunks[a].addr + chunks[a].length > end)
+            end = chunks[a].addr + chunks[a].length;
+    }
+    host_size = end - host_base;
+    make_frames (commit);
+    printf ("%s: %lu bytes in %d segments, entry 0x%08lX\n", input, data_bytes (), num_chunks, entry_point);
+
+    if (sim) {
+        srand (seed);
+        return simulate ((double)baud, commit, error_rate);
+    }
+    return upload (device, baud);
+}
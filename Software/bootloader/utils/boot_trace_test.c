@@ -0,0 +1,233 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host test of the boot time trace of src/boot_trace.h, on a stand-in
+ * clock of 50 MHz ticks from the host monotonic clock. An SREC is loaded
+ * the way the bootloader loads it (src/blcopy.c on lldma_sim.c) with the
+ * trace on, then the phases of main() of the application are stood in for,
+ * and the trace is printed with the code of the application
+ * (ANN_Heartbeat_Sorter/src/boot_trace.c). Checks that the marks are in
+ * order, that the decode and copy totals fit in the load, that the trace
+ * of the bootloader is kept by the application and printed only once, and
+ * that without it the application starts a trace of its own.
+ *
+ * Build (from this directory; -std=c99 keeps the system headers from
+ * redefining the types of src/portab.h):
+ *   gcc -std=c99 -D_POSIX_C_SOURCE=199309L -O2 -DBL_HOST_TEST -DBOOT_TRACE_HOST
+ *       -I../src -I. boot_trace_test.c lldma_sim.c ../src/blcopy.c ../src/srec.c
+ *       ../../ANN_Heartbeat_Sorter/src/boot_trace.c -o boot_trace_test
+ *
+ * Usage:
+ *   boot_trace_test [image.srec]
+ *
+ * Without a file, an image of 256 KB at 0x8C000000 is made up.
+ *
+ * @file boot_trace_test.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "srec.h"
+#include "errors.h"
+#include "blcopy.h"
+#include "boot_trace.h"
+
+#define MAX_IMAGE_BYTES     (16 * 1024 * 1024)
+#define MADE_UP_BASEADDR    0x8C000000
+#define MADE_UP_BYTES       (256 * 1024)
+
+boot_trace_t boot_trace_host;
+
+static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
+static uint8_t *host_memory;
+static unsigned long host_base, host_size;
+
+uint8_t *bl_host_addr (uint32_t addr)
+{
+    if (addr < host_base || addr >= host_base + host_size) {
+        printf ("load address 0x%08lX is outside the image\n", (unsigned long)addr);
+        exit (1);
+    }
+    return host_memory + (addr - host_base);
+}
+
+/*
+ * The stand-in of the xps_timer: ticks of 20 ns, from the first call.
+ */
+unsigned long boot_trace_host_ticks (void)
+{
+    static struct timespec start;
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    if (start.tv_sec == 0 && start.tv_nsec == 0)
+        start = now;
+    return (unsigned long)((now.tv_sec - start.tv_sec) * 1000000000.0
+                           + (now.tv_nsec - start.tv_nsec)) / (1000 / BOOT_TRACE_TICKS_PER_US);
+}
+
+/*
+ * A phase of main() that takes about us microseconds.
+ */
+static void busy (unsigned long us)
+{
+    unsigned long end = boot_trace_host_ticks () + us * BOOT_TRACE_TICKS_PER_US;
+
+    while (boot_trace_host_ticks () < end)
+        ;
+}
+
+static long put_record (char *text, int type, unsigned long addr, const uint8_t *data, int dlen)
+{
+    int count = 4 + dlen + 1;
+    uint8_t cksum = (uint8_t)count;
+    long n;
+    int i;
+
+    n = sprintf (text, "S%d%02X", type, count);
+    for (i = 3; i >= 0; i--) {
+        n += sprintf (text + n, "%02X", (unsigned)((addr >> (8 * i)) & 0xFF));
+        cksum += (uint8_t)(addr >> (8 * i));
+    }
+    for (i = 0; i < dlen; i++) {
+        n += sprintf (text + n, "%02X", data[i]);
+        cksum += data[i];
+    }
+    n += sprintf (text + n, "%02X\r\n", (uint8_t)~cksum);
+    return n;
+}
+
+int main (int argc, char *argv[])
+{
+    uint8_t *srec, data[16];
+    unsigned long end = 0, mark, last;
+    uint32_t entry;
+    long len = 0;
+    int i, ret, failed = 0;
+    srec_info_t info;
+    uint8_t *p;
+
+    srec = malloc (MAX_IMAGE_BYTES * 3 + 16);
+    if (srec == NULL)
+        return 1;
+    if (argc > 1) {
+        FILE *f = fopen (argv[1], "rb");
+
+        if (f == NULL) {
+            perror (argv[1]);
+            return 1;
+        }
+        len = (long)fread (srec, 1, MAX_IMAGE_BYTES * 3, f);
+        fclose (f);
+    } else {
+        unsigned long off;
+
+        srand (1);
+        for (off = 0; off < MADE_UP_BYTES; off += sizeof(data)) {
+            for (i = 0; i < (int)sizeof(data); i++)
+                data[i] = (uint8_t)rand ();
+            len += put_record ((char *)srec + len, 3, MADE_UP_BASEADDR + off, data, sizeof(data));
+        }
+        len += put_record ((char *)srec + len, 7, MADE_UP_BASEADDR, NULL, 0);
+    }
+    srec[len] = '\0';
+
+    /* Extent of the memory image */
+    host_base = ~0UL;
+    info.sr_data = sr_data_buf;
+    for (p = srec; p < srec + len && decode_srec_line (p, &info) == 0; p = info.next) {
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3
+            && !BL_IS_XIP ((uint32_t)(unsigned long)info.addr)) {
+            if ((unsigned long)info.addr < host_base)
+                host_base = (unsigned long)info.addr;
+            if ((unsigned long)info.addr + info.dlen > end)
+                end = (unsigned long)info.addr + info.dlen;
+        }
+        if (info.type >= SREC_TYPE_7)
+            break;
+    }
+    if (end == 0 || p >= srec + len) {
+        printf ("no image, or no S7-S9 record\n");
+        return 1;
+    }
+    host_size = end - host_base;
+    host_memory = calloc (host_size, 1);
+
+    /* The bootloader: main() and load_exec() */
+    memset (&boot_trace_host, 0xA5, sizeof(boot_trace_host));
+    BOOT_TRACE_START ();
+    busy (100);
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_INIT);
+    if ((ret = blcopy_init ()) != 0 || (ret = blcopy_load_srec (srec, &entry, 0)) != 0) {
+        printf ("the load failed with error %d\n", ret);
+        return 1;
+    }
+    BOOT_TRACE_MARK (BOOT_TRACE_BL_LOAD);
+
+    /* The application: main() up to the first classification */
+    busy (50);
+    boot_trace_app_start ();
+    busy (20);
+    BOOT_TRACE_MARK (BOOT_TRACE_DRIVERS);
+    busy (20);
+    BOOT_TRACE_MARK (BOOT_TRACE_UART_SELFTEST);
+    busy (20);
+    BOOT_TRACE_MARK (BOOT_TRACE_MFS_INIT);
+    busy (200);
+    BOOT_TRACE_MARK (BOOT_TRACE_RECORD_LOAD);
+    busy (20);
+    BOOT_TRACE_MARK (BOOT_TRACE_FIRST_BEAT);
+
+    if (boot_trace_host.recorded != (1UL << BOOT_TRACE_EVENTS) - 1) {
+        printf ("events recorded 0x%03lX, not all of them\n", boot_trace_host.recorded);
+        failed = 1;
+    }
+    for (i = 0, last = 0; i < BOOT_TRACE_EVENTS; i++) {
+        if (BOOT_TRACE_TOTALS & (1UL << i))
+            continue;
+        mark = boot_trace_host.ticks[i];
+        if (mark < last) {
+            printf ("mark %d is before the one before it\n", i);
+            failed = 1;
+        }
+        last = mark;
+    }
+    if (boot_trace_host.ticks[BOOT_TRACE_SREC_DECODE] == 0
+        || boot_trace_host.ticks[BOOT_TRACE_SREC_DECODE] + boot_trace_host.ticks[BOOT_TRACE_COPY]
+           > boot_trace_host.ticks[BOOT_TRACE_BL_LOAD] - boot_trace_host.ticks[BOOT_TRACE_BL_INIT]) {
+        printf ("the decode and copy totals do not fit in the load\n");
+        failed = 1;
+    }
+
+    if (boot_trace_print () != BOOT_TRACE_EVENTS) {
+        printf ("the trace was not printed whole\n");
+        failed = 1;
+    }
+    if (boot_trace_print () != 0) {
+        printf ("the trace was printed twice\n");
+        failed = 1;
+    }
+
+    /* An application started without the trace of the bootloader */
+    busy (10);
+    boot_trace_app_start ();
+    if (boot_trace_host.recorded != (1UL << BOOT_TRACE_APP_START)) {
+        printf ("the application kept a stale trace\n");
+        failed = 1;
+    }
+    if (failed)
+        return 1;
+    printf ("all tests passed\n");
+    return 0;
+}
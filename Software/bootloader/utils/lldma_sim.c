@@ -0,0 +1,225 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Software stand-in of the LocalLink DMA driver for host tests of the
+ * bootloader; see lldma_sim.h.
+ *
+ * @file lldma_sim.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "portab.h"
+#include "lldma_sim.h"
+
+#define MAX_RANGES  64
+
+typedef struct {
+    const uint8_t *addr;
+    unsigned len;
+} range_t;
+
+lldma_sim_stats_t lldma_sim_stats;
+
+static XLlDma *engine;
+static range_t flushed[MAX_RANGES], written[MAX_RANGES];
+static int num_flushed, num_written;
+
+/*
+ * Ring of a channel, in ring order: descriptors done and handed back
+ * (post), done by the engine (done), with the engine (hw), allocated
+ * (pre) and free.
+ */
+static unsigned post_head (XLlDma_BdRing *r)
+{
+    return (r->first_done + r->count - r->post_cnt) % r->count;
+}
+
+void lldma_sim_reset (void)
+{
+    unsigned long fail_copy = lldma_sim_stats.fail_copy;
+
+    memset (&lldma_sim_stats, 0, sizeof(lldma_sim_stats));
+    lldma_sim_stats.fail_copy = fail_copy;
+    num_flushed = num_written = 0;
+}
+
+unsigned long lldma_sim_pending_invalidates (void)
+{
+    return (unsigned long)num_written;
+}
+
+void XLlDma_Initialize (XLlDma *InstancePtr, unsigned long BaseAddress)
+{
+    (void)BaseAddress;
+    memset (InstancePtr, 0, sizeof(*InstancePtr));
+    engine = InstancePtr;
+}
+
+int XLlDma_BdRingCreate (XLlDma_BdRing *RingPtr, uint8_t *PhysAddr, uint8_t *VirtAddr,
+                         unsigned Alignment, unsigned BdCount)
+{
+    (void)PhysAddr;
+    if (BdCount == 0 || (unsigned long)VirtAddr % Alignment != 0)
+        return XST_FAILURE;
+    memset (RingPtr, 0, sizeof(*RingPtr));
+    RingPtr->bds = (XLlDma_Bd *)VirtAddr;
+    RingPtr->count = BdCount;
+    RingPtr->free_cnt = BdCount;
+    return XST_SUCCESS;
+}
+
+int XLlDma_BdRingClone (XLlDma_BdRing *RingPtr, XLlDma_Bd *SrcBdPtr)
+{
+    unsigned i;
+
+    if (RingPtr->free_cnt != RingPtr->count)
+        return XST_FAILURE;
+    for (i = 0; i < RingPtr->count; i++)
+        RingPtr->bds[i] = *SrcBdPtr;
+    return XST_SUCCESS;
+}
+
+int XLlDma_BdRingStart (XLlDma_BdRing *RingPtr)
+{
+    RingPtr->started = 1;
+    return XST_SUCCESS;
+}
+
+int XLlDma_BdRingAlloc (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd **BdSetPtr)
+{
+    if (NumBd > RingPtr->free_cnt)
+        return XST_FAILURE;
+    *BdSetPtr = &RingPtr->bds[RingPtr->first_free];
+    RingPtr->first_free = (RingPtr->first_free + NumBd) % RingPtr->count;
+    RingPtr->free_cnt -= NumBd;
+    RingPtr->pre_cnt += NumBd;
+    return XST_SUCCESS;
+}
+
+static int covered (const range_t *ranges, int n, const uint8_t *addr, unsigned len)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (addr >= ranges[i].addr && addr + len <= ranges[i].addr + ranges[i].len)
+            return 1;
+    return 0;
+}
+
+int XLlDma_BdRingToHw (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd *BdSetPtr)
+{
+    unsigned first_pre = (RingPtr->first_free + RingPtr->count - RingPtr->pre_cnt) % RingPtr->count;
+    XLlDma_Bd *bd = BdSetPtr;
+    unsigned i, in_flight;
+
+    if (!RingPtr->started || NumBd > RingPtr->pre_cnt || BdSetPtr != &RingPtr->bds[first_pre])
+        return XST_FAILURE;
+    for (i = 0; i < NumBd; i++, bd = XLlDma_BdRingNext (RingPtr, bd)) {
+        bd->stsctrl &= ~(XLLDMA_BD_STSCTRL_COMPLETED_MASK | XLLDMA_BD_STSCTRL_ERROR_MASK);
+        if (RingPtr == &engine->TxBdRing && !covered (flushed, num_flushed, bd->buf, bd->length))
+            lldma_sim_stats.unflushed++;
+    }
+    if (RingPtr == &engine->TxBdRing)
+        num_flushed = 0;
+    RingPtr->pre_cnt -= NumBd;
+    RingPtr->hw_cnt += NumBd;
+    in_flight = engine->RxBdRing.hw_cnt;
+    if (in_flight > lldma_sim_stats.max_in_flight)
+        lldma_sim_stats.max_in_flight = in_flight;
+    return XST_SUCCESS;
+}
+
+/*
+ * The engine moves the data of the oldest TX descriptor to the buffer of
+ * the oldest RX one, if both have been given to it.
+ */
+static void engine_step (void)
+{
+    XLlDma_BdRing *tx = &engine->TxBdRing, *rx = &engine->RxBdRing;
+    XLlDma_Bd *txbd, *rxbd;
+
+    if (tx->hw_cnt == 0 || rx->hw_cnt == 0)
+        return;
+    txbd = &tx->bds[tx->first_hw];
+    rxbd = &rx->bds[rx->first_hw];
+    lldma_sim_stats.copies++;
+    if (txbd->length != rxbd->length) {
+        lldma_sim_stats.mismatched++;
+        txbd->stsctrl |= XLLDMA_BD_STSCTRL_ERROR_MASK;
+        rxbd->stsctrl |= XLLDMA_BD_STSCTRL_ERROR_MASK;
+    } else if (lldma_sim_stats.copies == lldma_sim_stats.fail_copy) {
+        txbd->stsctrl |= XLLDMA_BD_STSCTRL_ERROR_MASK;
+        rxbd->stsctrl |= XLLDMA_BD_STSCTRL_ERROR_MASK;
+    } else {
+        memcpy (rxbd->buf, txbd->buf, rxbd->length);
+        lldma_sim_stats.bytes += rxbd->length;
+        if (num_written < MAX_RANGES) {
+            written[num_written].addr = rxbd->buf;
+            written[num_written].len = rxbd->length;
+            num_written++;
+        }
+    }
+    txbd->stsctrl |= XLLDMA_BD_STSCTRL_COMPLETED_MASK;
+    rxbd->stsctrl |= XLLDMA_BD_STSCTRL_COMPLETED_MASK;
+    tx->first_hw = (tx->first_hw + 1) % tx->count;
+    rx->first_hw = (rx->first_hw + 1) % rx->count;
+    tx->hw_cnt--;
+    rx->hw_cnt--;
+    tx->done_cnt++;
+    rx->done_cnt++;
+}
+
+unsigned XLlDma_BdRingFromHw (XLlDma_BdRing *RingPtr, unsigned BdLimit, XLlDma_Bd **BdSetPtr)
+{
+    unsigned n;
+
+    lldma_sim_stats.polls++;
+    engine_step ();
+    n = RingPtr->done_cnt < BdLimit ? RingPtr->done_cnt : BdLimit;
+    if (n == 0) {
+        lldma_sim_stats.idle_polls++;
+        return 0;
+    }
+    *BdSetPtr = &RingPtr->bds[RingPtr->first_done];
+    RingPtr->first_done = (RingPtr->first_done + n) % RingPtr->count;
+    RingPtr->done_cnt -= n;
+    RingPtr->post_cnt += n;
+    return n;
+}
+
+int XLlDma_BdRingFree (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd *BdSetPtr)
+{
+    if (NumBd > RingPtr->post_cnt || BdSetPtr != &RingPtr->bds[post_head (RingPtr)])
+        return XST_FAILURE;
+    RingPtr->post_cnt -= NumBd;
+    RingPtr->free_cnt += NumBd;
+    return XST_SUCCESS;
+}
+
+void Xil_DCacheFlushRange (const uint8_t *Addr, unsigned Len)
+{
+    if (num_flushed < MAX_RANGES) {
+        flushed[num_flushed].addr = Addr;
+        flushed[num_flushed].len = Len;
+        num_flushed++;
+    }
+}
+
+void Xil_DCacheInvalidateRange (const uint8_t *Addr, unsigned Len)
+{
+    int i;
+
+    for (i = 0; i < num_written; i++) {
+        if (written[i].addr >= Addr && written[i].addr + written[i].len <= Addr + Len) {
+            written[i--] = written[--num_written];
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Software stand-in of the LocalLink DMA driver (lldma_v2_00_a) and of
+ * the cache calls of xil_cache.h, with which src/blcopy.c is built on the
+ * host (BL_HOST_TEST). It models an MPMC SDMA engine with its TX LocalLink
+ * looped back to RX: descriptors go through the states of the real driver
+ * (free, allocated, given to the engine, done), and a copy happens only
+ * when the engine gets to it, reading its source at that time, so a loader
+ * that reuses a buffer before its copy is done loads wrong data. The engine
+ * moves one copy each time the done descriptors of a ring are asked for.
+ * It also checks that each source was flushed from the cache before it was
+ * given to the engine, and that each destination was invalidated after.
+ *
+ * Buffer addresses are host pointers instead of 32 bit bus addresses.
+ *
+ * @file lldma_sim.h
+ *
+ * @version %G%
+ *
+ */
+
+#ifndef LLDMA_SIM_H
+#define LLDMA_SIM_H
+
+#define XST_SUCCESS                       0
+#define XST_FAILURE                       1
+
+#define XLLDMA_ALL_BDS                    0xFFFFFFFF
+#define XLLDMA_BD_MINIMUM_ALIGNMENT       0x40
+
+#define XLLDMA_BD_STSCTRL_ERROR_MASK      0x80000000
+#define XLLDMA_BD_STSCTRL_COMPLETED_MASK  0x10000000
+#define XLLDMA_BD_STSCTRL_SOP_MASK        0x08000000
+#define XLLDMA_BD_STSCTRL_EOP_MASK        0x04000000
+#define XLLDMA_BD_STSCTRL_MASK            0xFF000000
+
+#define BL_DMA_BASEADDR                   0
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t length;
+    uint32_t stsctrl;
+} XLlDma_Bd;
+
+typedef struct {
+    XLlDma_Bd *bds;
+    unsigned count;
+    unsigned first_free, first_hw, first_done;
+    unsigned free_cnt, pre_cnt, hw_cnt, done_cnt, post_cnt;
+    int started;
+} XLlDma_BdRing;
+
+typedef struct {
+    XLlDma_BdRing TxBdRing;
+    XLlDma_BdRing RxBdRing;
+} XLlDma;
+
+/* What the simulation saw, for the tests */
+typedef struct {
+    unsigned long copies;           /* Done by the engine */
+    unsigned long bytes;
+    unsigned long polls;            /* FromHw calls */
+    unsigned long idle_polls;       /* FromHw calls with nothing done */
+    unsigned long max_in_flight;    /* Copies given to the engine and not done */
+    unsigned long unflushed;        /* Sources given to the engine without a flush */
+    unsigned long mismatched;       /* TX and RX descriptors of different lengths */
+    unsigned long fail_copy;        /* Number of the copy to fail, 0 for none */
+} lldma_sim_stats_t;
+
+extern lldma_sim_stats_t lldma_sim_stats;
+
+void lldma_sim_reset (void);
+unsigned long lldma_sim_pending_invalidates (void);
+
+#define XLlDma_GetTxRing(InstancePtr)   ((InstancePtr)->TxBdRing)
+#define XLlDma_GetRxRing(InstancePtr)   ((InstancePtr)->RxBdRing)
+
+#define XLlDma_BdClear(BdPtr)           memset ((BdPtr), 0, sizeof(XLlDma_Bd))
+#define XLlDma_BdSetBufAddr(BdPtr, Addr) ((BdPtr)->buf = (uint8_t *)(Addr))
+#define XLlDma_BdGetBufAddr(BdPtr)      ((BdPtr)->buf)
+#define XLlDma_BdSetLength(BdPtr, Len)  ((BdPtr)->length = (Len))
+#define XLlDma_BdGetLength(BdPtr)       ((BdPtr)->length)
+#define XLlDma_BdSetStsCtrl(BdPtr, Data) ((BdPtr)->stsctrl = (Data) & XLLDMA_BD_STSCTRL_MASK)
+#define XLlDma_BdGetStsCtrl(BdPtr)      ((BdPtr)->stsctrl)
+
+#define XLlDma_BdRingMemCalc(Alignment, NumBd) \
+    (((NumBd) * sizeof(XLlDma_Bd) + (Alignment) - 1) / (Alignment) * (Alignment))
+#define XLlDma_BdRingNext(RingPtr, BdPtr) \
+    ((BdPtr) + 1 == (RingPtr)->bds + (RingPtr)->count ? (RingPtr)->bds : (BdPtr) + 1)
+
+void XLlDma_Initialize (XLlDma *InstancePtr, unsigned long BaseAddress);
+int XLlDma_BdRingCreate (XLlDma_BdRing *RingPtr, uint8_t *PhysAddr, uint8_t *VirtAddr,
+                         unsigned Alignment, unsigned BdCount);
+int XLlDma_BdRingClone (XLlDma_BdRing *RingPtr, XLlDma_Bd *SrcBdPtr);
+int XLlDma_BdRingStart (XLlDma_BdRing *RingPtr);
+int XLlDma_BdRingAlloc (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd **BdSetPtr);
+int XLlDma_BdRingToHw (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd *BdSetPtr);
+unsigned XLlDma_BdRingFromHw (XLlDma_BdRing *RingPtr, unsigned BdLimit, XLlDma_Bd **BdSetPtr);
+int XLlDma_BdRingFree (XLlDma_BdRing *RingPtr, unsigned NumBd, XLlDma_Bd *BdSetPtr);
+
+void Xil_DCacheFlushRange (const uint8_t *Addr, unsigned Len);
+void Xil_DCacheInvalidateRange (const uint8_t *Addr, unsigned Len);
+
+#endif /* LLDMA_SIM_H */
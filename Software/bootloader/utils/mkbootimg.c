@@ -0,0 +1,663 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host tool that makes the binary boot image of src/blimage.h from an
+ * application ELF or SREC file: a header with the entry point, a table of
+ * segments (load address, length and CRC-32) and the raw bytes of each
+ * segment, which the bootloader copies straight from flash to its load
+ * address instead of decoding text records. Adjacent pieces of the input
+ * are merged into one segment, so an SREC becomes a segment per section.
+ * With -z, each segment is LZ compressed (greedy matching with a hash of
+ * the next 4 bytes) unless that does not make it smaller, and the ratio of
+ * each and of the whole payload is printed.
+ *
+ * With -t, the image is also booted on the host with src/blimage.c, the
+ * memory image and entry point are compared with those of the input, and
+ * the time of a boot from the binary image, and the speed at which its
+ * segments are loaded (decompressed, with -z), are printed next to those
+ * of a plain copy of the bytes, what a loader of uncompressed segments
+ * built with BLIMAGE_VERIFY_CRC 0 does, and, for an SREC input, of the SREC
+ * boot decode of src/srec.c. Set against the bytes each reads from flash,
+ * this gives the trade-off between flash bandwidth and decompression.
+ *
+ * Build (from this directory; -std=c99 keeps the system headers from
+ * redefining the types of src/portab.h):
+ *   gcc -std=c99 -O2 -DBL_HOST_TEST -I../src mkbootimg.c ../src/blimage.c
+ *       ../src/srec.c -o mkbootimg
+ *
+ * Usage:
+ *   mkbootimg [-o image.bin] [-e big|little] [-z] [-t] [-v] app.elf|app.srec
+ *
+ * The image is written in big endian byte order, that of MicroBlaze,
+ * unless -e little is given. It is programmed to flash at
+ * FLASH_IMAGE_BASEADDR in place of the SREC; the bootloader tells them
+ * apart by the magic number at the start of the image. Segments in the
+ * XIP window of src/blconfig.h (the .model_rodata section of an ANN
+ * application linked with lscript_xip.ld) are left out of the image: they
+ * are programmed to flash at their own address.
+ *
+ * @file mkbootimg.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "srec.h"
+#include "blimage.h"
+#include "errors.h"
+
+#define MAX_INPUT_BYTES     (48 * 1024 * 1024)
+#define MAX_CHUNKS          65536
+#define BENCH_SECONDS       0.5
+#define LZ_HASH_BITS        16
+#define LZ_MIN_MATCH        4
+#define LZ_MAX_OFFSET       65535
+
+extern int srec_line;
+
+/*
+ * A piece of the application at a load address, as read from the input;
+ * adjacent pieces are merged into the segments of the image.
+ */
+typedef struct chunk_s {
+    unsigned long addr;
+    unsigned long length;
+    uint8_t *data;
+    unsigned long stored;       /* Bytes in the image, LZ compressed if fewer */
+    uint8_t *stored_data;
+} chunk_t;
+
+static chunk_t chunks[MAX_CHUNKS];
+static int num_chunks;
+static unsigned long entry_point;
+
+static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
+
+/* Memory the host boot writes to, standing for [host_base, host_base + host_size) */
+static uint8_t *host_memory;
+static unsigned long host_base, host_size;
+
+uint8_t *bl_host_addr (uint32_t addr)
+{
+    if (addr < host_base || addr >= host_base + host_size) {
+        printf ("load address 0x%08lX is outside the image\n", (unsigned long)addr);
+        exit (1);
+    }
+    return host_memory + (addr - host_base);
+}
+
+/*
+ * Add length bytes at addr, appending them to the last chunk when they
+ * follow it, as consecutive SREC records do.
+ */
+static int add_chunk (unsigned long addr, const uint8_t *data, unsigned long length)
+{
+    chunk_t *last = num_chunks > 0 ? &chunks[num_chunks - 1] : NULL;
+
+    if (length == 0)
+        return 0;
+    if (last != NULL && last->addr + last->length == addr) {
+        last->data = realloc (last->data, last->length + length);
+        if (last->data == NULL)
+            return -1;
+        memcpy (last->data + last->length, data, length);
+        last->length += length;
+        return 0;
+    }
+    if (num_chunks == MAX_CHUNKS)
+        return -1;
+    last = &chunks[num_chunks++];
+    last->addr = addr;
+    last->length = length;
+    last->data = malloc (length);
+    if (last->data == NULL)
+        return -1;
+    memcpy (last->data, data, length);
+    return 0;
+}
+
+static int compare_chunks (const void *a, const void *b)
+{
+    const chunk_t *ca = (const chunk_t *)a, *cb = (const chunk_t *)b;
+
+    return ca->addr < cb->addr ? -1 : ca->addr > cb->addr;
+}
+
+/*
+ * Sort the chunks by address and merge those that touch.
+ * Returns -1 if two of them overlap.
+ */
+static int merge_chunks (void)
+{
+    int i, n = 0;
+
+    qsort (chunks, num_chunks, sizeof(chunk_t), compare_chunks);
+    for (i = 0; i < num_chunks; i++) {
+        if (n > 0 && chunks[n - 1].addr + chunks[n - 1].length > chunks[i].addr)
+            return -1;
+        if (n > 0 && chunks[n - 1].addr + chunks[n - 1].length == chunks[i].addr) {
+            chunk_t *last = &chunks[n - 1];
+            last->data = realloc (last->data, last->length + chunks[i].length);
+            if (last->data == NULL)
+                return -1;
+            memcpy (last->data + last->length, chunks[i].data, chunks[i].length);
+            last->length += chunks[i].length;
+            free (chunks[i].data);
+        } else {
+            chunks[n++] = chunks[i];
+        }
+    }
+    num_chunks = n;
+    return 0;
+}
+
+/*
+ * Leave out of the image the segments in the XIP window of flash
+ * (BL_IS_XIP of blconfig.h), which are programmed to flash on their own.
+ */
+static void drop_xip_chunks (void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < num_chunks; i++) {
+        if (BL_IS_XIP ((uint32_t)chunks[i].addr)) {
+            printf ("  0x%08lX %8lu bytes left in flash (XIP), not in the image\n",
+                    chunks[i].addr, chunks[i].length);
+            free (chunks[i].data);
+        } else {
+            chunks[n++] = chunks[i];
+        }
+    }
+    num_chunks = n;
+}
+
+/*
+ * Field of the given size of an ELF file in its byte order.
+ */
+static unsigned long elf_field (const uint8_t *p, int size, int big)
+{
+    unsigned long v = 0;
+    int i;
+
+    for (i = 0; i < size; i++)
+        v |= (unsigned long)p[big ? i : size - 1 - i] << (8 * (size - 1 - i));
+    return v;
+}
+
+/*
+ * Read the PT_LOAD program headers of a 32 bit ELF file. The bytes in the
+ * file of each are loaded at its physical address; the rest of the memory
+ * size (.bss) is cleared by the C runtime of the application, as with an
+ * SREC made by objcopy.
+ */
+static int read_elf (const uint8_t *file, long len)
+{
+    int big = file[5] == 2;
+    unsigned long phoff, phentsize, phnum, i;
+
+    if (len < 52 || file[4] != 1) {
+        printf ("only 32 bit ELF files are supported\n");
+        return -1;
+    }
+    entry_point = elf_field (file + 24, 4, big);
+    phoff = elf_field (file + 28, 4, big);
+    phentsize = elf_field (file + 42, 2, big);
+    phnum = elf_field (file + 44, 2, big);
+    for (i = 0; i < phnum; i++) {
+        const uint8_t *ph = file + phoff + i * phentsize;
+        unsigned long offset, paddr, filesz;
+
+        if (ph + 32 > file + len)
+            return -1;
+        if (elf_field (ph, 4, big) != 1)        /* PT_LOAD */
+            continue;
+        offset = elf_field (ph + 4, 4, big);
+        paddr = elf_field (ph + 12, 4, big);
+        filesz = elf_field (ph + 16, 4, big);
+        if (offset + filesz > (unsigned long)len)
+            return -1;
+        if (add_chunk (paddr, file + offset, filesz) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * Read an SREC file with the decoder of the bootloader, so that a file it
+ * would refuse is refused here too.
+ */
+static int read_srec (uint8_t *file, long len)
+{
+    srec_info_t info;
+    uint8_t *p;
+    int ret;
+
+    info.sr_data = sr_data_buf;
+    for (p = file; p < file + len; p = info.next) {
+        if ((ret = decode_srec_line (p, &info)) != 0) {
+            printf ("SREC line %d: error %d\n", srec_line, ret);
+            return -1;
+        }
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3) {
+            if (add_chunk ((unsigned long)info.addr, info.sr_data, info.dlen) != 0)
+                return -1;
+        } else if (info.type >= SREC_TYPE_7) {
+            entry_point = (unsigned long)info.addr;
+            return 0;
+        }
+    }
+    printf ("no S7-S9 record\n");
+    return -1;
+}
+
+/*
+ * Append a length of n - base to the token at *token (a nybble at shift),
+ * with the extra bytes of a length of 15 or more.
+ */
+static uint8_t *lz_length (uint8_t *out, uint8_t *token, int shift, unsigned long n)
+{
+    if (n < 15) {
+        *token |= (uint8_t)(n << shift);
+        return out;
+    }
+    *token |= (uint8_t)(15 << shift);
+    for (n -= 15; n >= 255; n -= 255)
+        *out++ = 255;
+    *out++ = (uint8_t)n;
+    return out;
+}
+
+/*
+ * LZ compress len bytes of in to out, in the format of blimage.h, and
+ * return the compressed size. out must hold len + len / 255 + 16 bytes.
+ */
+static unsigned long lz_compress (const uint8_t *in, unsigned long len, uint8_t *out)
+{
+    static long head[1 << LZ_HASH_BITS];
+    unsigned long i = 0, anchor = 0, n, mlen, j;
+    uint8_t *start = out, *token;
+    long cand;
+
+#define LZ_HASH(p)  ((((uint32_t)(p)[0] | (uint32_t)(p)[1] << 8 | (uint32_t)(p)[2] << 16 | \
+                       (uint32_t)(p)[3] << 24) * 2654435761U) >> (32 - LZ_HASH_BITS))
+
+    memset (head, 0xFF, sizeof(head));
+    while (i + LZ_MIN_MATCH <= len) {
+        uint32_t h = LZ_HASH (in + i);
+
+        cand = head[h];
+        head[h] = (long)i;
+        if (cand < 0 || i - cand > LZ_MAX_OFFSET || memcmp (in + cand, in + i, LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+        for (mlen = LZ_MIN_MATCH; i + mlen < len && in[cand + mlen] == in[i + mlen]; mlen++)
+            ;
+        /* Literals since the last match, then the match */
+        n = i - anchor;
+        token = out++;
+        *token = 0;
+        out = lz_length (out, token, 4, n);
+        memcpy (out, in + anchor, n);
+        out += n;
+        *out++ = (uint8_t)(i - cand);
+        *out++ = (uint8_t)((i - cand) >> 8);
+        out = lz_length (out, token, 0, mlen - LZ_MIN_MATCH);
+        for (j = i + 1; j < i + mlen && j + LZ_MIN_MATCH <= len; j++)
+            head[LZ_HASH (in + j)] = (long)j;
+        i += mlen;
+        anchor = i;
+    }
+    if (anchor < len) {
+        n = len - anchor;
+        token = out++;
+        *token = 0;
+        out = lz_length (out, token, 4, n);
+        memcpy (out, in + anchor, n);
+        out += n;
+    }
+    return (unsigned long)(out - start);
+}
+
+/*
+ * Compress each chunk, keeping it as it is when that does not make it
+ * smaller, and print the ratios.
+ */
+static void compress_chunks (void)
+{
+    unsigned long length = 0, stored = 0;
+    int i;
+
+    for (i = 0; i < num_chunks; i++) {
+        chunk_t *c = &chunks[i];
+        uint8_t *z = (uint8_t *)malloc (c->length + c->length / 255 + 16);
+        unsigned long n = lz_compress (c->data, c->length, z);
+
+        if (n < c->length) {
+            c->stored = n;
+            c->stored_data = z;
+        } else {
+            free (z);
+        }
+        printf ("  0x%08lX %8lu -> %8lu bytes (%5.1f%%)\n", c->addr, c->length,
+                c->stored, 100.0 * c->stored / c->length);
+        length += c->length;
+        stored += c->stored;
+    }
+    printf ("payload %lu -> %lu bytes, %.1f%% (ratio %.2f)\n", length, stored,
+            100.0 * stored / length, (double)length / stored);
+}
+
+static void put_word (uint8_t *p, uint32_t v, int big)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (big ? 24 - 8 * i : 8 * i));
+}
+
+/*
+ * Lay out the image with its header and table in host byte order, and
+ * return its size.
+ */
+static unsigned long build_image (uint8_t *image)
+{
+    blimage_header_t *header = (blimage_header_t *)image;
+    blimage_segment_t *segment = (blimage_segment_t *)(header + 1);
+    uint8_t *payload = (uint8_t *)(segment + num_chunks);
+    int i;
+
+    header->magic = BLIMAGE_MAGIC;
+    header->entry = (uint32_t)entry_point;
+    header->num_segments = (uint32_t)num_chunks;
+    header->header_crc = 0;
+    for (i = 0; i < num_chunks; i++) {
+        segment[i].addr = (uint32_t)chunks[i].addr;
+        segment[i].length = (uint32_t)chunks[i].length;
+        segment[i].stored = (uint32_t)chunks[i].stored;
+        segment[i].crc = blimage_crc32 (0, chunks[i].data, (uint32_t)chunks[i].length);
+        memcpy (payload, chunks[i].stored_data, chunks[i].stored);
+        memset (payload + chunks[i].stored, 0, (4 - chunks[i].stored % 4) % 4);
+        payload += (chunks[i].stored + 3) / 4 * 4;
+    }
+    header->header_crc = blimage_crc32 (blimage_crc32 (0, image, sizeof(*header)),
+                                        (uint8_t *)segment, num_chunks * sizeof(*segment));
+    return (unsigned long)(payload - image);
+}
+
+/*
+ * Boot from an SREC the way load_exec() in bootloader.c does, into host memory.
+ */
+static int srec_boot (uint8_t *flbuf, unsigned long *entry)
+{
+    srec_info_t info;
+    int ret;
+
+    info.sr_data = sr_data_buf;
+    while (1) {
+        if ((ret = decode_srec_line (flbuf, &info)) != 0)
+            return ret;
+        flbuf = info.next;
+        if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3) {
+            if (!BL_IS_XIP ((uint32_t)(unsigned long)info.addr))
+                memcpy (bl_host_addr ((uint32_t)(unsigned long)info.addr), info.sr_data, info.dlen);
+        } else if (info.type >= SREC_TYPE_7) {
+            *entry = (unsigned long)info.addr;
+            return 0;
+        }
+    }
+}
+
+/* What boot_time() times */
+#define BOOT_IMAGE          0   /* blimage_load */
+#define BOOT_COPY           1   /* A plain copy of the bytes of the segments */
+#define BOOT_SREC           2   /* The SREC boot decode */
+#define BOOT_LZ             3   /* Decompressing the compressed segments only */
+#define BOOT_CRC            4   /* The CRC-32 of the loaded bytes only */
+
+/*
+ * Seconds of one boot of the kind given.
+ */
+static double boot_time (int kind, uint8_t *image, uint8_t *srec)
+{
+    clock_t start = clock ();
+    double secs;
+    uint32_t entry;
+    unsigned long srec_entry;
+    int boots = 0, i;
+
+    do {
+        if (kind == BOOT_IMAGE) {
+            blimage_load (image, &entry);
+        } else if (kind == BOOT_SREC) {
+            srec_boot (srec, &srec_entry);
+        } else {
+            for (i = 0; i < num_chunks; i++) {
+                uint8_t *dst = bl_host_addr ((uint32_t)chunks[i].addr);
+                if (kind == BOOT_COPY)
+                    memcpy (dst, chunks[i].data, chunks[i].length);
+                else if (kind == BOOT_CRC)
+                    blimage_crc32 (0, dst, (uint32_t)chunks[i].length);
+                else if (chunks[i].stored < chunks[i].length)
+                    blimage_lz_decompress (dst, chunks[i].stored_data, (uint32_t)chunks[i].stored,
+                                           (uint32_t)chunks[i].length);
+            }
+        }
+        boots++;
+        secs = (double)(clock () - start) / CLOCKS_PER_SEC;
+    } while (secs < BENCH_SECONDS);
+    return secs / boots;
+}
+
+/*
+ * Check that the image boots to the memory image and entry point of the
+ * input, that corrupting it is caught, and time the boot.
+ */
+static int test_image (uint8_t *image, unsigned long image_size, uint8_t *srec, long srec_len)
+{
+    uint8_t *expected;
+    uint32_t entry;
+    unsigned long payload = 0, compressed = 0, last;
+    int i, ret, failed = 0;
+    blimage_segment_t *segment = (blimage_segment_t *)(image + sizeof(blimage_header_t));
+    double secs, copy_secs;
+
+    host_base = chunks[0].addr;
+    host_size = chunks[num_chunks - 1].addr + chunks[num_chunks - 1].length - host_base;
+    host_memory = calloc (host_size, 1);
+    expected = calloc (host_size, 1);
+    for (i = 0; i < num_chunks; i++) {
+        memcpy (expected + (chunks[i].addr - host_base), chunks[i].data, chunks[i].length);
+        payload += chunks[i].length;
+        if (chunks[i].stored < chunks[i].length)
+            compressed += chunks[i].length;
+    }
+
+    if (!blimage_check (image) || (ret = blimage_load (image, &entry)) != 0) {
+        printf ("test: the image does not load\n");
+        return 1;
+    }
+    if (memcmp (host_memory, expected, host_size) != 0 || entry != entry_point) {
+        printf ("test: the image loads a different memory image or entry point\n");
+        return 1;
+    }
+    if (srec != NULL) {
+        unsigned long srec_entry;
+
+        memset (host_memory, 0, host_size);
+        if (srec_boot (srec, &srec_entry) != 0 || srec_entry != entry_point
+            || memcmp (host_memory, expected, host_size) != 0) {
+            printf ("test: the SREC boot differs from the image\n");
+            return 1;
+        }
+    }
+
+    /* A changed payload byte (the last stored one, not padding), and a
+       changed segment table */
+    last = image_size - 1 - (4 - chunks[num_chunks - 1].stored % 4) % 4;
+    image[last] ^= 0x01;
+    ret = blimage_load (image, &entry);
+    if (ret != BLIMAGE_CRC_ERROR && ret != BLIMAGE_LZ_ERROR) {
+        printf ("test: a changed payload byte is not caught\n");
+        failed = 1;
+    }
+    image[last] ^= 0x01;
+    segment[0].length ^= 0x10;
+    if (blimage_load (image, &entry) != BLIMAGE_HEADER_ERROR) {
+        printf ("test: a changed segment table is not caught\n");
+        failed = 1;
+    }
+    segment[0].length ^= 0x10;
+    if (failed)
+        return 1;
+
+    secs = boot_time (BOOT_IMAGE, image, NULL);
+    copy_secs = boot_time (BOOT_COPY, image, NULL);
+    printf ("boot from                    ms       MB/s loaded\n");
+    printf ("binary image       %12.3f  %16.1f\n", secs * 1e3, payload / secs / 1e6);
+    printf ("  copy only        %12.3f  %16.1f\n", copy_secs * 1e3, payload / copy_secs / 1e6);
+    if (compressed > 0) {
+        double lz_secs = boot_time (BOOT_LZ, image, NULL);
+        printf ("  LZ decompression %12.3f  %16.1f  (of %lu bytes)\n", lz_secs * 1e3,
+                compressed / lz_secs / 1e6, compressed);
+    }
+    copy_secs = boot_time (BOOT_CRC, image, NULL);
+    printf ("  CRC-32 check     %12.3f  %16.1f\n", copy_secs * 1e3, payload / copy_secs / 1e6);
+    if (srec != NULL) {
+        double srec_secs = boot_time (BOOT_SREC, NULL, srec);
+        printf ("SREC               %12.3f  %16.1f\n", srec_secs * 1e3, payload / srec_secs / 1e6);
+        printf ("flash bytes: SREC %ld, binary %lu; SREC boot %.2fx the time\n",
+                srec_len, image_size, srec_secs / secs);
+    } else {
+        printf ("flash bytes: binary %lu for %lu loaded\n", image_size, payload);
+    }
+    free (expected);
+    return 0;
+}
+
+static void usage (void)
+{
+    printf ("usage: mkbootimg [-o image.bin] [-e big|little] [-z] [-t] [-v] app.elf|app.srec\n");
+    exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+    const char *output = NULL, *input = NULL;
+    uint8_t *file, *image, *out;
+    unsigned long image_size, words, i;
+    long len;
+    int big = 1, compress = 0, test = 0, verbose = 0, is_srec, a;
+    FILE *f;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp (argv[a], "-o") == 0 && a + 1 < argc)
+            output = argv[++a];
+        else if (strcmp (argv[a], "-e") == 0 && a + 1 < argc)
+            big = strcmp (argv[++a], "little") != 0;
+        else if (strcmp (argv[a], "-z") == 0)
+            compress = 1;
+        else if (strcmp (argv[a], "-t") == 0)
+            test = 1;
+        else if (strcmp (argv[a], "-v") == 0)
+            verbose = 1;
+        else if (argv[a][0] != '-' && input == NULL)
+            input = argv[a];
+        else
+            usage ();
+    }
+    if (input == NULL || (output == NULL && !test))
+        usage ();
+
+    /* Word aligned, like the image in flash */
+    file = (uint8_t *)malloc (MAX_INPUT_BYTES + 4);
+    f = fopen (input, "rb");
+    if (file == NULL || f == NULL) {
+        perror (input);
+        return 1;
+    }
+    len = (long)fread (file, 1, MAX_INPUT_BYTES, f);
+    fclose (f);
+    file[len] = '\0';
+
+    is_srec = len > 0 && file[0] == 'S';
+    if (len > 4 && memcmp (file, "\177ELF", 4) == 0) {
+        if (read_elf (file, len) != 0) {
+            printf ("%s: bad ELF file\n", input);
+            return 1;
+        }
+    } else if (is_srec) {
+        if (read_srec (file, len) != 0)
+            return 1;
+    } else {
+        printf ("%s: neither an ELF nor an SREC file\n", input);
+        return 1;
+    }
+    if (merge_chunks () != 0 || num_chunks == 0) {
+        printf ("%s: no load segments, or overlapping ones\n", input);
+        return 1;
+    }
+    drop_xip_chunks ();
+    if (num_chunks == 0) {
+        printf ("%s: nothing to load outside of the XIP window\n", input);
+        return 1;
+    }
+    if (num_chunks > BLIMAGE_MAX_SEGMENTS) {
+        printf ("%s: %d segments, more than the %d of the loader\n",
+                input, num_chunks, BLIMAGE_MAX_SEGMENTS);
+        return 1;
+    }
+    for (a = 0; a < num_chunks; a++) {
+        chunks[a].stored = chunks[a].length;
+        chunks[a].stored_data = chunks[a].data;
+    }
+    if (compress)
+        compress_chunks ();
+
+    image_size = sizeof(blimage_header_t) + num_chunks * sizeof(blimage_segment_t);
+    for (a = 0; a < num_chunks; a++)
+        image_size += (chunks[a].stored + 3) / 4 * 4;
+    image = (uint8_t *)malloc (image_size);
+    image_size = build_image (image);
+
+    if (verbose) {
+        blimage_segment_t *segment = (blimage_segment_t *)(image + sizeof(blimage_header_t));
+        printf ("entry 0x%08lX, %d segments\n", entry_point, num_chunks);
+        for (a = 0; a < num_chunks; a++)
+            printf ("  0x%08lX %8lu bytes, %8lu stored  crc %08lX\n", (unsigned long)segment[a].addr,
+                    (unsigned long)segment[a].length, (unsigned long)segment[a].stored,
+                    (unsigned long)segment[a].crc);
+    }
+
+    if (output != NULL) {
+        /* Header and table in the byte order of the target; the payload is bytes */
+        out = (uint8_t *)malloc (image_size);
+        memcpy (out, image, image_size);
+        words = (sizeof(blimage_header_t) + num_chunks * sizeof(blimage_segment_t)) / 4;
+        for (i = 0; i < words; i++)
+            put_word (out + 4 * i, ((uint32_t *)image)[i], big);
+        f = fopen (output, "wb");
+        if (f == NULL || fwrite (out, 1, image_size, f) != image_size) {
+            perror (output);
+            return 1;
+        }
+        fclose (f);
+        printf ("%s: %lu bytes, %d segments, entry 0x%08lX\n",
+                output, image_size, num_chunks, entry_point);
+        free (out);
+    }
+
+    if (test)
+        return test_image (image, image_size, is_srec ? file : NULL, len);
+    return 0;
+}
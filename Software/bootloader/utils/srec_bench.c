@@ -0,0 +1,403 @@
+/**
+ *
+ * Carlos III University of Madrid.
+ *
+ * Master's Final Thesis. Heartbeat sorter based on Artificial Neural
+ * Network. Development & implementation on FPGA.
+ *
+ * Host benchmark of the SREC decoding of the bootloader (src/srec.c). An
+ * application image in SREC format is decoded the way the bootloader boots
+ * it from flash, with the decoder of src/srec.c and with the decoder it
+ * replaced (each line copied out of flash, then decoded a nybble at a time
+ * with grab_hex_byte), and the time of a whole boot decode of both is
+ * printed. The memory images and entry points they produce are compared,
+ * and corrupted records are checked to be refused.
+ *
+ * Build (from this directory; -std=c99 keeps the system headers from
+ * redefining the types of src/portab.h):
+ *   gcc -std=c99 -O2 -I../src srec_bench.c ../src/srec.c -o srec_bench
+ *
+ * Usage:
+ *   srec_bench [image.srec]
+ *
+ * Without a file, a 256 KB image at 0x8C000000 is made up, in records of
+ * 16 data bytes as EDK and objcopy write them. To use a real application:
+ *   mb-objcopy -O srec app.elf app.srec
+ *
+ * @file srec_bench.c
+ *
+ * @version %G%
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "portab.h"
+#include "srec.h"
+#include "errors.h"
+
+#define MAX_IMAGE_BYTES     (16 * 1024 * 1024)
+#define MADE_UP_BYTES       (256 * 1024)
+#define MADE_UP_BASEADDR    0x8C000000
+#define RECORD_DATA_BYTES   16
+#define BENCH_SECONDS       1.0
+
+extern int srec_line;
+
+static uint8_t sr_data_buf[SREC_DATA_MAX_BYTES];
+
+/*
+ * The decoder that src/srec.c replaced, kept as the reference for the
+ * benchmark; pointers are no longer cast to int.
+ */
+static uint8_t old_nybble_to_val (char x)
+{
+    if (x >= '0' && x <= '9')
+        return (uint8_t)(x-'0');
+
+    return (uint8_t)((x-'A') + 10);
+}
+
+static uint8_t old_grab_hex_byte (uint8_t *buf)
+{
+    return  (uint8_t)((old_nybble_to_val ((char)buf[0]) << 4) +
+                       old_nybble_to_val ((char)buf[1]));
+}
+
+static uint16_t old_grab_hex_word (uint8_t *buf)
+{
+    return (uint16_t)(((uint16_t)old_grab_hex_byte (buf) << 8)
+                      + old_grab_hex_byte (buf + 2));
+}
+
+static uint32_t old_grab_hex_word24 (uint8_t *buf)
+{
+    return (uint32_t)(((uint32_t)old_grab_hex_byte (buf) << 16)
+                      + old_grab_hex_word (buf + 2));
+}
+
+static uint32_t old_grab_hex_dword (uint8_t *buf)
+{
+    return (uint32_t)(((uint32_t)old_grab_hex_word (buf) << 16)
+                      + old_grab_hex_word (buf + 4));
+}
+
+static uint8_t old_decode_srec_data (uint8_t *bufs, uint8_t *bufd, uint8_t count, uint8_t skip)
+{
+    uint8_t cksum = 0, cbyte;
+    int i;
+
+    for (i=0; i < count; i++) {
+        cbyte = old_grab_hex_byte (bufs);
+        if ((i >= skip - 1) && (i != count-1))
+            *bufd++ = cbyte;
+        bufs  += 2;
+        cksum += cbyte;
+    }
+    return cksum;
+}
+
+static uint8_t old_eatup_srec_line (uint8_t *bufs, uint8_t count)
+{
+    int i;
+    uint8_t cksum = 0;
+
+    for (i=0; i < count; i++) {
+        cksum += old_grab_hex_byte(bufs);
+        bufs += 2;
+    }
+    return cksum;
+}
+
+static uint8_t old_decode_srec_line (uint8_t *sr_buf, srec_info_t *info)
+{
+    uint8_t count;
+    uint8_t *bufs = sr_buf;
+    uint8_t cksum = 0, skip;
+    int type;
+
+    if (*bufs != 'S')
+        return SREC_PARSE_ERROR;
+    type = *++bufs - '0';
+    count = old_grab_hex_byte (++bufs);
+    bufs += 2;
+    cksum = count;
+
+    switch (type) {
+        case 0:
+            info->type = SREC_TYPE_0;
+            info->dlen = count;
+            cksum += old_eatup_srec_line (bufs, count);
+            break;
+        case 1:
+        case 2:
+        case 3:
+            info->type = (int8_t)type;
+            skip = (uint8_t)(type + 2);
+            info->addr = (uint8_t *)(unsigned long)(type == 1 ? old_grab_hex_word (bufs) :
+                                                    type == 2 ? old_grab_hex_word24 (bufs) :
+                                                    old_grab_hex_dword (bufs));
+            info->dlen = count - skip;
+            cksum += old_decode_srec_data (bufs, info->sr_data, count, skip);
+            break;
+        case 5:
+        case 9:
+            info->type = (int8_t)type;
+            info->addr = (uint8_t *)(unsigned long)old_grab_hex_word (bufs);
+            cksum += old_eatup_srec_line (bufs, count);
+            break;
+        case 7:
+            info->type = SREC_TYPE_7;
+            info->addr = (uint8_t *)(unsigned long)old_grab_hex_dword (bufs);
+            cksum += old_eatup_srec_line (bufs, count);
+            break;
+        case 8:
+            info->type = SREC_TYPE_8;
+            info->addr = (uint8_t *)(unsigned long)old_grab_hex_word24 (bufs);
+            cksum += old_eatup_srec_line (bufs, count);
+            break;
+        default:
+            return SREC_PARSE_ERROR;
+    }
+    if (++cksum)
+        return SREC_CKSUM_ERROR;
+    return 0;
+}
+
+/*
+ * The old line reader of bootloader.c: copy up to CR, skip the LF.
+ */
+static uint8_t old_get_srec_line (uint8_t **flbuf, uint8_t *buf)
+{
+    uint8_t c;
+    int count = 0;
+
+    while (1) {
+        c = *(*flbuf)++;
+        if (c == 0xD) {
+            (*flbuf)++;
+            return 0;
+        }
+        *buf++ = c;
+        count++;
+        if (count > SREC_MAX_BYTES)
+            return LD_SREC_LINE_ERROR;
+    }
+}
+
+/*
+ * Boot from an SREC in memory the way load_exec() in bootloader.c does,
+ * copying the data to image (which stands for the memory at base) instead
+ * of jumping to the entry point.
+ * Returns 0 or the error of the bad record; *entry is the entry point.
+ */
+static int boot_decode (int old, uint8_t *flbuf, uint8_t *image, unsigned long base,
+                        unsigned long size, unsigned long *entry)
+{
+    static uint8_t sr_buf[SREC_MAX_BYTES];
+    srec_info_t info;
+    unsigned long addr;
+    int ret;
+
+    info.sr_data = sr_data_buf;
+    while (1) {
+        if (old) {
+            if ((ret = old_get_srec_line (&flbuf, sr_buf)) != 0)
+                return ret;
+            ret = old_decode_srec_line (sr_buf, &info);
+        } else {
+            ret = decode_srec_line (flbuf, &info);
+            flbuf = info.next;
+        }
+        if (ret != 0)
+            return ret;
+        switch (info.type) {
+            case SREC_TYPE_1:
+            case SREC_TYPE_2:
+            case SREC_TYPE_3:
+                addr = (unsigned long)info.addr;
+                if (addr < base || addr + info.dlen > base + size)
+                    return LD_MEM_WRITE_ERROR;
+                memcpy (image + (addr - base), info.sr_data, info.dlen);
+                break;
+            case SREC_TYPE_7:
+            case SREC_TYPE_8:
+            case SREC_TYPE_9:
+                *entry = (unsigned long)info.addr;
+                return 0;
+        }
+    }
+}
+
+/*
+ * Append one record of the given type to text.
+ */
+static long put_record (char *text, int type, unsigned long addr, const uint8_t *data, int dlen)
+{
+    int alen = (type == 0 || type == 1 || type == 9) ? 2 : (type == 2 || type == 8) ? 3 : 4;
+    int count = alen + dlen + 1;
+    uint8_t cksum = (uint8_t)count;
+    long n;
+    int i;
+
+    n = sprintf (text, "S%d%02X", type, count);
+    for (i = alen - 1; i >= 0; i--) {
+        n += sprintf (text + n, "%02X", (unsigned)((addr >> (8 * i)) & 0xFF));
+        cksum += (uint8_t)(addr >> (8 * i));
+    }
+    for (i = 0; i < dlen; i++) {
+        n += sprintf (text + n, "%02X", data[i]);
+        cksum += data[i];
+    }
+    n += sprintf (text + n, "%02X\r\n", (uint8_t)~cksum);
+    return n;
+}
+
+static double boot_time (int old, uint8_t *srec, uint8_t *image, unsigned long base,
+                         unsigned long size, int *boots)
+{
+    unsigned long entry;
+    clock_t start = clock();
+    double secs;
+
+    *boots = 0;
+    do {
+        boot_decode (old, srec, image, base, size, &entry);
+        (*boots)++;
+        secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (secs < BENCH_SECONDS);
+    return secs / *boots;
+}
+
+/*
+ * A record that must be refused: the bad_line-th line of srec with one
+ * character changed.
+ */
+static int check_refused (uint8_t *srec, long len, int bad_line, int offset, uint8_t c,
+                          int expected, const char *what)
+{
+    uint8_t *copy = malloc (len + 4);
+    uint8_t *p;
+    unsigned long entry;
+    int ret, line;
+
+    memcpy (copy, srec, len + 1);
+    for (p = copy, line = 0; line < bad_line; p++)
+        if (*p == '\n')
+            line++;
+    p[offset] = c;
+    ret = boot_decode (0, copy, NULL, 0, 0, &entry);
+    free (copy);
+    if (ret != expected) {
+        printf ("%s: error %d instead of %d\n", what, ret, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t *srec_words;
+    uint8_t *srec, *data, *image_old, *image_new;
+    unsigned long base = MADE_UP_BASEADDR, size = 0, end = 0;
+    unsigned long entry_old = 0, entry_new = 0;
+    long len = 0, payload = 0;
+    double old_secs, new_secs;
+    int boots_old, boots_new, ret, failed = 0, i;
+
+    /* Word aligned, like the image in flash */
+    srec_words = malloc (MAX_IMAGE_BYTES * 3 + 16);
+    srec = (uint8_t *)srec_words;
+    if (srec == NULL)
+        return 1;
+
+    if (argc > 1) {
+        FILE *f = fopen (argv[1], "rb");
+        srec_info_t info;
+        uint8_t *p;
+
+        if (f == NULL) {
+            perror (argv[1]);
+            return 1;
+        }
+        len = (long)fread (srec, 1, MAX_IMAGE_BYTES * 3, f);
+        fclose (f);
+        srec[len] = '\0';
+        /* Extent of the memory image */
+        base = ~0UL;
+        info.sr_data = sr_data_buf;
+        for (p = srec; p < srec + len && decode_srec_line (p, &info) == 0; p = info.next) {
+            if (info.type >= SREC_TYPE_1 && info.type <= SREC_TYPE_3) {
+                if ((unsigned long)info.addr < base)
+                    base = (unsigned long)info.addr;
+                if ((unsigned long)info.addr + info.dlen > end)
+                    end = (unsigned long)info.addr + info.dlen;
+                payload += info.dlen;
+            }
+            if (info.type >= SREC_TYPE_7)
+                break;
+        }
+        if (end == 0 || p >= srec + len) {
+            printf ("%s: no image, or no S7-S9 record, at line %d\n", argv[1], srec_line);
+            return 1;
+        }
+        size = end - base;
+    } else {
+        uint8_t header[] = "srec_bench";
+
+        size = MADE_UP_BYTES;
+        data = malloc (size);
+        srand (1);
+        for (i = 0; i < (int)size; i++)
+            data[i] = (uint8_t)(rand () >> 7);
+        len = put_record ((char *)srec, 0, 0, header, sizeof(header) - 1);
+        for (i = 0; i < (int)size; i += RECORD_DATA_BYTES)
+            len += put_record ((char *)srec + len, 3, base + i, data + i, RECORD_DATA_BYTES);
+        len += put_record ((char *)srec + len, 7, base, NULL, 0);
+        payload = size;
+        free (data);
+    }
+
+    image_old = calloc (size, 1);
+    image_new = calloc (size, 1);
+    ret = boot_decode (1, srec, image_old, base, size, &entry_old);
+    if (ret == 0)
+        ret = boot_decode (0, srec, image_new, base, size, &entry_new);
+    if (ret != 0) {
+        printf ("decoding failed with error %d\n", ret);
+        return 1;
+    }
+    if (memcmp (image_old, image_new, size) != 0 || entry_old != entry_new) {
+        printf ("the decoders do not agree\n");
+        return 1;
+    }
+
+    /* Also from a flash address that is only halfword aligned */
+    memmove (srec + 2, srec, len + 1);
+    memset (image_new, 0, size);
+    ret = boot_decode (0, srec + 2, image_new, base, size, &entry_new);
+    memmove (srec, srec + 2, len + 1);
+    if (ret != 0 || memcmp (image_old, image_new, size) != 0) {
+        printf ("decoding from a halfword aligned line failed\n");
+        return 1;
+    }
+
+    failed |= check_refused (srec, len, 1, 12, srec[12] == '0' ? '1' : '0', SREC_CKSUM_ERROR, "changed data");
+    failed |= check_refused (srec, len, 1, 14, 'G', SREC_PARSE_ERROR, "character that is not hex");
+    failed |= check_refused (srec, len, 1, 3, srec[3] == '0' ? '1' : '0', LD_SREC_LINE_ERROR, "wrong byte count");
+    failed |= check_refused (srec, len, 1, 1, '4', SREC_PARSE_ERROR, "record type S4");
+    if (failed)
+        return 1;
+
+    old_secs = boot_time (1, srec, image_old, base, size, &boots_old);
+    new_secs = boot_time (0, srec, image_new, base, size, &boots_new);
+    printf ("SREC of %ld bytes, %ld bytes of image at 0x%08lX, entry 0x%08lX\n",
+            len, payload, base, entry_new);
+    printf ("decoder                  boot decode ms      MB/s of SREC\n");
+    printf ("grab_hex_byte            %14.3f  %16.1f\n", old_secs * 1e3, len / old_secs / 1e6);
+    printf ("srec.c                   %14.3f  %16.1f\n", new_secs * 1e3, len / new_secs / 1e6);
+    printf ("speedup %.1fx\n", old_secs / new_secs);
+    return 0;
+}
@@ -0,0 +1,31 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+/* Note: This file depends on the following files having been included prior to self being included.
+   1. portab.h
+*/
+
+#ifndef BL_BLCOPY_H
+#define BL_BLCOPY_H
+
+/*
+ * Copies of the loaded image to RAM. With BL_COPY_DMA they are queued to
+ * the DMA engine and run while the CPU decodes the next chunk; otherwise
+ * they are done with memcpy as they are queued.
+ */
+
+uint8_t   blcopy_init (void);
+uint8_t   blcopy_queue (uint8_t *dst, const uint8_t *src, uint32_t len);
+uint8_t   blcopy_wait (uint32_t pending);
+uint8_t   blcopy_load_srec (uint8_t *flbuf, uint32_t *entry, void (*progress) (uint32_t));
+
+#endif /* BL_BLCOPY_H */
@@ -0,0 +1,29 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+
+/* Note: This file depends on the following files having been included prior to self being included.
+   1. portab.h
+*/
+
+#ifndef BL_BLFLASH_H
+#define BL_BLFLASH_H
+
+/*
+ * Erase and program of the 8 bit Intel StrataFlash of the board, for
+ * BL_UPLOAD. Blocks are BL_FLASH_BLOCK_SIZE bytes; their lock bits are
+ * cleared before they are erased.
+ */
+
+uint8_t   blflash_erase (uint32_t addr, uint32_t len);
+uint8_t   blflash_program (uint32_t addr, const uint8_t *src, uint32_t len);
+
+#endif /* BL_BLFLASH_H */
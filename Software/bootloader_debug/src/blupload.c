@@ -0,0 +1,278 @@
+/////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004 Xilinx, Inc. All Rights Reserved.
+//
+// You may copy and modify these files for your own internal use solely with
+// Xilinx programmable logic devices and  Xilinx EDK system or create IP
+// modules solely for Xilinx programmable logic devices and Xilinx EDK system.
+// No rights are granted to distribute any files unless they are distributed in
+// Xilinx programmable logic devices.
+//
+/////////////////////////////////////////////////////////////////////////////////
+#include <string.h>
+#include "blconfig.h"
+#include "portab.h"
+#include "errors.h"
+#include "blimage.h"
+#include "blflash.h"
+#include "blupload.h"
+
+/* Host tests run the upload on the UART stand-in of utils/blsend.c */
+#ifdef BL_HOST_TEST
+#undef BL_UPLOAD
+#define BL_UPLOAD               1
+uint32_t bl_host_uart_in (uint32_t reg);
+void bl_host_uart_out (uint32_t reg, uint32_t value);
+#define UART_IN(reg)            bl_host_uart_in (reg)
+#define UART_OUT(reg, value)    bl_host_uart_out (reg, value)
+#else
+#include "xparameters.h"
+#define UART_IN(reg)            (*(volatile uint32_t *)(STDIN_BASEADDRESS + (reg)))
+#define UART_OUT(reg, value)    (*(volatile uint32_t *)(STDIN_BASEADDRESS + (reg)) = (value))
+#endif
+
+#if BL_UPLOAD
+
+/* UART Lite registers and status bits */
+#define UART_RX_FIFO            0x0
+#define UART_TX_FIFO            0x4
+#define UART_STATUS             0x8
+#define UART_RX_VALID           0x01
+#define UART_TX_FULL            0x08
+
+#define FRAME_TIMEOUT           -1
+#define FRAME_BAD               -2
+
+#define GET_BE32(p)             (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) \
+                                 | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+
+/* The frame being received, from its type to its CRC */
+static uint8_t frame[BLUP_HEADER_BYTES - 1 + BLUP_MAX_PAYLOAD + BLUP_CRC_BYTES];
+static uint8_t expected;
+
+/* What has been loaded, for the boot image of a commit */
+static blimage_segment_t segments[BL_UPLOAD_MAX_SEGMENTS];
+static uint32_t num_segments;
+static int too_many_segments;
+
+static const uint8_t padding[3];
+
+/*
+ * Next byte from the UART, or -1 when polls, if not 0, runs out first.
+ */
+static int uart_getc (uint32_t *polls)
+{
+    while (!(UART_IN (UART_STATUS) & UART_RX_VALID)) {
+        if (polls != 0 && (*polls)-- == 0)
+            return -1;
+    }
+    return (int)(UART_IN (UART_RX_FIFO) & 0xFF);
+}
+
+static void uart_putc (uint8_t c)
+{
+    while (UART_IN (UART_STATUS) & UART_TX_FULL)
+        ;
+    UART_OUT (UART_TX_FIFO, c);
+}
+
+static void reply (uint8_t type, uint8_t value)
+{
+    uart_putc (BLUP_SYNC);
+    uart_putc (type);
+    uart_putc (value);
+    uart_putc ((uint8_t)~(type ^ value));
+}
+
+/*
+ * Receive a frame into frame[]. Bytes before BLUP_SYNC are skipped.
+ * Returns the length of its payload, FRAME_BAD if its length or CRC is
+ * wrong, or FRAME_TIMEOUT.
+ */
+static int read_frame (uint32_t *polls)
+{
+    uint32_t i, len, crc;
+    int c;
+
+    do {
+        if ((c = uart_getc (polls)) < 0)
+            return FRAME_TIMEOUT;
+    } while (c != BLUP_SYNC);
+
+    for (i = 0; i < BLUP_HEADER_BYTES - 1; i++) {
+        if ((c = uart_getc (polls)) < 0)
+            return FRAME_TIMEOUT;
+        frame[i] = (uint8_t)c;
+    }
+    len = ((uint32_t)frame[2] << 8) | frame[3];
+    if (len > BLUP_MAX_PAYLOAD)
+        return FRAME_BAD;
+    for (; i < BLUP_HEADER_BYTES - 1 + len + BLUP_CRC_BYTES; i++) {
+        if ((c = uart_getc (polls)) < 0)
+            return FRAME_TIMEOUT;
+        frame[i] = (uint8_t)c;
+    }
+    crc = blimage_crc32 (0, frame, BLUP_HEADER_BYTES - 1 + len);
+    if (crc != GET_BE32 (frame + BLUP_HEADER_BYTES - 1 + len))
+        return FRAME_BAD;
+    return (int)len;
+}
+
+static void start_upload (uint8_t seq)
+{
+    expected = seq + 1;
+    num_segments = 0;
+    too_many_segments = 0;
+    reply (BLUP_ACK, seq);
+}
+
+/*
+ * Note len bytes loaded at addr, adding them to the last segment when
+ * they follow it.
+ */
+static void add_segment (uint32_t addr, uint32_t len)
+{
+    if (num_segments > 0 && segments[num_segments - 1].addr + segments[num_segments - 1].length == addr) {
+        segments[num_segments - 1].length += len;
+    } else if (num_segments < BL_UPLOAD_MAX_SEGMENTS) {
+        segments[num_segments].addr = addr;
+        segments[num_segments].length = len;
+        num_segments++;
+    } else {
+        too_many_segments = 1;
+    }
+}
+
+/*
+ * Program what has been loaded to flash, as a binary boot image with
+ * uncompressed segments at FLASH_IMAGE_BASEADDR.
+ */
+static uint8_t commit (uint32_t entry)
+{
+    blimage_header_t header;
+    uint32_t i, size, addr;
+    uint8_t ret;
+
+    if (too_many_segments)
+        return UPLOAD_ERROR;
+    size = sizeof(header) + num_segments * sizeof(blimage_segment_t);
+    for (i = 0; i < num_segments; i++) {
+        segments[i].stored = segments[i].length;
+        segments[i].crc = blimage_crc32 (0, BL_TARGET_ADDR (segments[i].addr), segments[i].length);
+        size += (segments[i].length + 3) & ~3;
+    }
+    if (size > BL_UPLOAD_FLASH_SIZE)
+        return UPLOAD_ERROR;
+
+    header.magic = BLIMAGE_MAGIC;
+    header.entry = entry;
+    header.num_segments = num_segments;
+    header.header_crc = 0;
+    header.header_crc = blimage_crc32 (blimage_crc32 (0, (uint8_t *)&header, sizeof(header)),
+                                       (uint8_t *)segments, num_segments * sizeof(blimage_segment_t));
+
+    addr = FLASH_IMAGE_BASEADDR;
+    if ((ret = blflash_erase (addr, size)) != 0
+        || (ret = blflash_program (addr, (uint8_t *)&header, sizeof(header))) != 0)
+        return ret;
+    addr += sizeof(header);
+    if ((ret = blflash_program (addr, (uint8_t *)segments, num_segments * sizeof(blimage_segment_t))) != 0)
+        return ret;
+    addr += num_segments * sizeof(blimage_segment_t);
+    for (i = 0; i < num_segments; i++) {
+        if ((ret = blflash_program (addr, BL_TARGET_ADDR (segments[i].addr), segments[i].length)) != 0
+            || (ret = blflash_program (addr + segments[i].length, padding,
+                                       (0 - segments[i].length) & 3)) != 0)
+            return ret;
+        addr += (segments[i].length + 3) & ~3;
+    }
+    return 0;
+}
+
+/*
+ * Whether the host is calling: waits BL_UPLOAD_WAIT_POLLS polls of the
+ * UART for a HELLO frame, and acknowledges it.
+ */
+int blupload_requested (void)
+{
+    uint32_t polls = BL_UPLOAD_WAIT_POLLS;
+    int len;
+
+    while ((len = read_frame (&polls)) != FRAME_TIMEOUT) {
+        if (len == 0 && frame[0] == BLUP_HELLO) {
+            start_upload (frame[1]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Take the frames of the upload up to END, and commit the image to flash
+ * if asked to. Returns 0 and the entry point, or the error, which the host
+ * is told of too.
+ */
+uint8_t blupload_load (uint32_t *entry)
+{
+    uint32_t addr, flags;
+    uint8_t *payload = frame + BLUP_HEADER_BYTES - 1;
+    uint8_t ret;
+    int len, nak_sent = 0;
+
+    while (1) {
+        len = read_frame (0);
+        if (len >= 0 && frame[0] == BLUP_HELLO) {
+            /* The host started over */
+            start_upload (frame[1]);
+            nak_sent = 0;
+            continue;
+        }
+        if (len < 0) {
+            /* Each bad frame is NAKed, so that the loss of one sent again
+               does not wait for the host to time out */
+            reply (BLUP_NAK, expected);
+            nak_sent = 1;
+            continue;
+        }
+        if (frame[1] != expected) {
+            /* A frame sent again because its ACK was lost is acknowledged
+               again; the frames after a lost one are dropped, and NAKed once */
+            if ((uint8_t)(expected - frame[1]) <= BLUP_WINDOW)
+                reply (BLUP_ACK, expected - 1);
+            else if (!nak_sent) {
+                reply (BLUP_NAK, expected);
+                nak_sent = 1;
+            }
+            continue;
+        }
+        nak_sent = 0;
+
+        if (frame[0] == BLUP_DATA && len > 4) {
+            addr = GET_BE32 (payload);
+            len -= 4;
+            if (addr < BL_UPLOAD_LOWADDR || addr > BL_UPLOAD_HIGHADDR
+                || (uint32_t)len - 1 > BL_UPLOAD_HIGHADDR - addr) {
+                reply (BLUP_STATUS, UPLOAD_ERROR);
+                return UPLOAD_ERROR;
+            }
+            memcpy (BL_TARGET_ADDR (addr), payload + 4, len);
+            add_segment (addr, len);
+        } else if (frame[0] == BLUP_END && len == 8) {
+            *entry = GET_BE32 (payload);
+            flags = GET_BE32 (payload + 4);
+            reply (BLUP_ACK, frame[1]);
+            ret = (flags & BLUP_COMMIT) ? commit (*entry) : 0;
+            /* Twice, as it cannot be sent again once the image runs */
+            reply (BLUP_STATUS, ret);
+            reply (BLUP_STATUS, ret);
+            return ret;
+        } else {
+            reply (BLUP_STATUS, UPLOAD_ERROR);
+            return UPLOAD_ERROR;
+        }
+        expected = frame[1] + 1;
+        reply (BLUP_ACK, frame[1]);
+    }
+}
+
+#endif /* BL_UPLOAD */
@@ -16,5 +16,10 @@
 #define LD_SREC_LINE_ERROR  2
 #define SREC_PARSE_ERROR    3
 #define SREC_CKSUM_ERROR    4
+#define BLIMAGE_HEADER_ERROR 5
+#define BLIMAGE_CRC_ERROR    6
+#define BLIMAGE_LZ_ERROR     7
+#define UPLOAD_ERROR         8
+#define FLASH_ERROR          9
 
 #endif /* BL_ERRORS_H */
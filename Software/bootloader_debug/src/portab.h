@@ -20,6 +20,14 @@ typedef char   int8_t;
 typedef short  int16_t;
 typedef int    int32_t;
 
+/* Where the loader writes a load address; host tests map it to a buffer */
+#ifdef BL_HOST_TEST
+uint8_t  *bl_host_addr (uint32_t addr);
+#define BL_TARGET_ADDR(addr)  bl_host_addr (addr)
+#else
+#define BL_TARGET_ADDR(addr)  ((uint8_t *)(addr))
+#endif
+
 
 
 /* An anonymous union allows the compiler to report typedef errors automatically */
@@ -13,149 +13,172 @@
 #include "srec.h"
 #include "errors.h"
 
-uint8_t  grab_hex_byte (uint8_t *buf);
-uint16_t grab_hex_word (uint8_t *buf);
-uint32_t grab_hex_dword (uint8_t *buf);
-uint32_t grab_hex_word24 (uint8_t *buf);
-
 int srec_line = 0;
 
-uint8_t nybble_to_val (char x)
-{
-    if (x >= '0' && x <= '9')
-        return (uint8_t)(x-'0');
-    
-    return (uint8_t)((x-'A') + 10);
-}
-
-uint8_t grab_hex_byte (uint8_t *buf)
-{
-    return  (uint8_t)((nybble_to_val ((char)buf[0]) << 4) + 
-                       nybble_to_val ((char)buf[1]));
-}
-
-uint16_t grab_hex_word (uint8_t *buf)
-{
-    return (uint16_t)(((uint16_t)grab_hex_byte (buf) << 8) 
-                      + grab_hex_byte ((uint8_t*)((int)buf+2))
-                     );
-}
-
-uint32_t grab_hex_word24 (uint8_t *buf)
+/* Value of each character as a hex digit, SREC_HEX_BAD for the others.
+   Upper and lower case digits are both accepted. */
+#define SREC_HEX_BAD  0xF0
+
+static const uint8_t hex_val[256] = {
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+    0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0,
+};
+
+/* Number of address bytes of each record type, 0 for the types that do
+   not exist */
+static const uint8_t addr_bytes[10] = { 2, 2, 3, 4, 0, 2, 0, 4, 3, 2 };
+
+/* Character i (0 to 3) of a word loaded from the line */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define WORD_CHAR(w, i)  ((uint8_t)((w) >> (8 * (i))))
+#else
+#define WORD_CHAR(w, i)  ((uint8_t)((w) >> (24 - 8 * (i))))
+#endif
+
+/* Decode one pair of hex characters c0 c1 into b, adding both digits to bad */
+#define DECODE_PAIR(c0, c1, b) \
+    do { \
+        uint8_t hi_ = hex_val[c0], lo_ = hex_val[c1]; \
+        bad |= hi_ | lo_; \
+        (b) = (uint8_t)((hi_ << 4) | lo_); \
+    } while (0)
+
+/*
+ * Decode count hex pairs from bufs to bufd, or only sum them if bufd is 0.
+ * Four pairs are decoded per iteration, from two word loads once bufs is
+ * word aligned, so the characters are read from flash a word at a time.
+ * Returns the sum of the bytes for the checksum; a character that is not
+ * a hex digit sets the high bits of *badp.
+ */
+static uint8_t decode_hex (const uint8_t *bufs, uint8_t *bufd, int count, uint8_t *badp)
 {
-    return (uint32_t)(((uint32_t)grab_hex_byte (buf) << 16) 
-                      + grab_hex_word ((uint8_t*)((int)buf+2))
-                     );
-}
-
-uint32_t grab_hex_dword (uint8_t *buf)
-{
-    return (uint32_t)(((uint32_t)grab_hex_word (buf) << 16) 
-                      + grab_hex_word ((uint8_t*)((int)buf+4))
-                     );
-}
-
-uint8_t decode_srec_data (uint8_t *bufs, uint8_t *bufd, uint8_t count, uint8_t skip)
-{
-    uint8_t cksum = 0, cbyte;
-    int i;
-
-    /* Parse remaining character pairs */
-    for (i=0; i < count; i++) {
-        cbyte = grab_hex_byte (bufs);
-        if ((i >= skip - 1) && (i != count-1))   /* Copy over only data bytes */
-            *bufd++ = cbyte;
+    uint8_t cksum = 0, bad = 0;
+    uint8_t b0, b1, b2, b3;
+    uint32_t w0, w1;
+
+    /* Pairs start at even offsets of a line; get to a word boundary */
+    while (count > 0 && ((unsigned long)bufs & 3) != 0) {
+        DECODE_PAIR (bufs[0], bufs[1], b0);
+        cksum += b0;
+        if (bufd)
+            *bufd++ = b0;
         bufs  += 2;
-        cksum += cbyte;
+        count--;
     }
 
-    return cksum;
-}
-
-uint8_t eatup_srec_line (uint8_t *bufs, uint8_t count)
-{
-    int i;
-    uint8_t cksum = 0;
+    if (((unsigned long)bufs & 3) == 0) {
+        while (count >= 4) {
+            w0 = ((const uint32_t *)bufs)[0];
+            w1 = ((const uint32_t *)bufs)[1];
+            DECODE_PAIR (WORD_CHAR (w0, 0), WORD_CHAR (w0, 1), b0);
+            DECODE_PAIR (WORD_CHAR (w0, 2), WORD_CHAR (w0, 3), b1);
+            DECODE_PAIR (WORD_CHAR (w1, 0), WORD_CHAR (w1, 1), b2);
+            DECODE_PAIR (WORD_CHAR (w1, 2), WORD_CHAR (w1, 3), b3);
+            cksum += (uint8_t)(b0 + b1 + b2 + b3);
+            if (bufd) {
+                bufd[0] = b0;
+                bufd[1] = b1;
+                bufd[2] = b2;
+                bufd[3] = b3;
+                bufd += 4;
+            }
+            bufs  += 8;
+            count -= 4;
+        }
+    }
 
-    for (i=0; i < count; i++) {
-        cksum += grab_hex_byte(bufs);
-        bufs += 2;
+    /* Odd line starts, and the last pairs */
+    while (count > 0) {
+        DECODE_PAIR (bufs[0], bufs[1], b0);
+        cksum += b0;
+        if (bufd)
+            *bufd++ = b0;
+        bufs  += 2;
+        count--;
     }
 
+    *badp |= bad;
     return cksum;
 }
 
+/*
+ * Decode the S-record at sr_buf in a single pass over its characters.
+ * The byte count of the record gives the length of the line, which must
+ * end right after the checksum with CR LF (or LF alone); info->next is set
+ * to the start of the next line. Addresses, data and checksum are decoded
+ * and summed as they are read, so the line is not scanned for its end first.
+ */
 uint8_t decode_srec_line (uint8_t *sr_buf, srec_info_t *info)
 {
-    uint8_t count;
-    uint8_t *bufs;
-    uint8_t cksum = 0, skip;
-    int type;
-
-    bufs = sr_buf;
+    const uint8_t *bufs = sr_buf;
+    uint8_t addr[4];
+    uint8_t count, cksum, bad = 0;
+    int type, alen, dlen;
 
     srec_line++; /* for debug purposes on errors */
 
-    if ( *bufs != 'S') {
+    if (bufs[0] != 'S')
         return SREC_PARSE_ERROR;
-    }
-    
-    type = *++bufs - '0';
-    count = grab_hex_byte (++bufs);
-    bufs += 2;
-    cksum = count;
 
-    switch (type)
-    {
-        case 0: 
-            info->type = SREC_TYPE_0;
-            info->dlen = count;
-            cksum += eatup_srec_line (bufs, count);
-            break;
-        case 1: 
-            info->type = SREC_TYPE_1;
-            skip = 3;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_word (bufs);
-            info->dlen = count - skip;
-            cksum += decode_srec_data (bufs, info->sr_data, count, skip);
-            break;
-        case 2: 
-            info->type = SREC_TYPE_2;
-            skip = 4;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_word24 (bufs);
-            info->dlen = count - skip;
-            cksum += decode_srec_data (bufs, info->sr_data, count, skip);
-            break;
-        case 3: 
-            info->type = SREC_TYPE_3;
-            skip = 5;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_dword (bufs);
-            info->dlen = count - skip;
-            cksum += decode_srec_data (bufs, info->sr_data, count, skip);
-            break;
-        case 5:
-            info->type = SREC_TYPE_5;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_word (bufs);
-            cksum += eatup_srec_line (bufs, count);
-            break;
-        case 7:
-            info->type = SREC_TYPE_7;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_dword (bufs);
-            cksum += eatup_srec_line (bufs, count);
-            break;
-        case 8:
-            info->type = SREC_TYPE_8;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_word24 (bufs);
-            cksum += eatup_srec_line (bufs, count);
-            break;
-        case 9:
-            info->type = SREC_TYPE_9;
-            info->addr = (uint8_t*)(uint32_t)grab_hex_word (bufs);
-            cksum += eatup_srec_line (bufs, count);
-            break;
-        default:
+    type = bufs[1] - '0';
+    if (type < 0 || type > 9 || addr_bytes[type] == 0)
+        return SREC_PARSE_ERROR;
+    alen = addr_bytes[type];
+
+    DECODE_PAIR (bufs[2], bufs[3], count);
+    if (bad & SREC_HEX_BAD)
+        return SREC_PARSE_ERROR;
+    dlen = count - alen - 1;
+    if (dlen < 0)
+        return SREC_PARSE_ERROR;
+
+    /* The line ends after the count pairs; check that before decoding */
+    bufs += 4 + 2 * count;
+    if (bufs[0] == '\r')
+        bufs++;
+    if (bufs[0] != '\n')
+        return LD_SREC_LINE_ERROR;
+    info->next = (uint8_t *)bufs + 1;
+    bufs = sr_buf + 4;
+
+    cksum = count;
+    cksum += decode_hex (bufs, addr, alen, &bad);
+    bufs += 2 * alen;
+    info->addr = (uint8_t *)(unsigned long)
+        (alen == 2 ? ((uint32_t)addr[0] << 8) | addr[1] :
+         alen == 3 ? ((uint32_t)addr[0] << 16) | ((uint32_t)addr[1] << 8) | addr[2] :
+         ((uint32_t)addr[0] << 24) | ((uint32_t)addr[1] << 16) | ((uint32_t)addr[2] << 8) | addr[3]);
+
+    /* Data of S1-S3 is copied, that of the other records only summed,
+       along with the checksum */
+    if (type >= SREC_TYPE_1 && type <= SREC_TYPE_3) {
+        if (dlen > SREC_DATA_MAX_BYTES)
             return SREC_PARSE_ERROR;
+        cksum += decode_hex (bufs, info->sr_data, dlen, &bad);
+        cksum += decode_hex (bufs + 2 * dlen, 0, 1, &bad);
+        info->dlen = (uint8_t)dlen;
+    } else {
+        cksum += decode_hex (bufs, 0, dlen + 1, &bad);
+        info->dlen = (type == SREC_TYPE_0) ? count : 0;
     }
+    info->type = (int8_t)type;
+
+    if (bad & SREC_HEX_BAD)
+        return SREC_PARSE_ERROR;
 
     if (++cksum) {
         return SREC_CKSUM_ERROR;
@@ -163,5 +186,3 @@ uint8_t decode_srec_line (uint8_t *sr_buf, srec_info_t *info)
    
     return 0;
 }
-
-
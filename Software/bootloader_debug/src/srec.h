@@ -35,6 +35,7 @@ typedef struct srec_info_s {
     uint8_t*  addr;
     uint8_t*  sr_data;
     uint8_t   dlen;
+    uint8_t*  next;     /* Start of the line after the record */
 } srec_info_t;
 
 uint8_t   decode_srec_line (uint8_t *sr_buf, srec_info_t *info);
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////-*-C-*-
+//
+// Copyright (c) 2002, 2003 Xilinx, Inc.  All rights reserved.
+//
+// Xilinx, Inc.
+//
+// XILINX IS PROVIDING THIS DESIGN, CODE, OR INFORMATION "AS IS" AS A
+// COURTESY TO YOU.  BY PROVIDING THIS DESIGN, CODE, OR INFORMATION AS
+// ONE POSSIBLE   IMPLEMENTATION OF THIS FEATURE, APPLICATION OR
+// STANDARD, XILINX IS MAKING NO REPRESENTATION THAT THIS IMPLEMENTATION
+// IS FREE FROM ANY CLAIMS OF INFRINGEMENT, AND YOU ARE RESPONSIBLE
+// FOR OBTAINING ANY RIGHTS YOU MAY REQUIRE FOR YOUR IMPLEMENTATION.
+// XILINX EXPRESSLY DISCLAIMS ANY WARRANTY WHATSOEVER WITH RESPECT TO
+// THE ADEQUACY OF THE IMPLEMENTATION, INCLUDING BUT NOT LIMITED TO
+// ANY WARRANTIES OR REPRESENTATIONS THAT THIS IMPLEMENTATION IS FREE
+// FROM CLAIMS OF INFRINGEMENT, IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// File   : mfs_stdio.h
+//
+// Description :
+//
+// stdio streams over Xil MFS files, for fscanf, fgets, fread, fprintf
+// and the rest of stdio on files of the memory file system.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MFS_STDIO_H
+#define MFS_STDIO_H
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* streams opened with mfs_fopen get a buffer of MFS_STDIO_BUFFER_SIZE
+ * bytes from a pool of MFS_STDIO_BUFFERS, so that stdio refills the buffer
+ * with one mfs_file_read of several blocks, copied word by word from the
+ * blocks to the buffer. Once the pool is used up, streams get the default
+ * stdio buffer, or none when the heap is too small for it */
+#ifndef MFS_STDIO_BUFFER_SIZE
+#define MFS_STDIO_BUFFER_SIZE 4096
+#endif
+#ifndef MFS_STDIO_BUFFERS
+#define MFS_STDIO_BUFFERS 2
+#endif
+
+/**
+ * open a file of the memory file system as a stdio stream
+ * the stream is closed with fclose, which closes the file
+ * setvbuf can still change the buffer before the first read or write
+ * @param filename is the name of the file
+ * @param mode is "r" to read the file, or "w" to create it, replacing
+ * a file of that name; a "b" in the mode is ignored
+ * @return the stream, or NULL if the file cannot be opened
+ */
+FILE *mfs_fopen(const char *filename, const char *mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MFS_STDIO_H
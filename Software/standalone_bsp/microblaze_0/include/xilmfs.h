@@ -45,6 +45,74 @@ extern "C" {
 
 /* MFS_MAX_FILENAME_LENGTH determines the size of mfs_dir_ent_block - see below */
 
+/* number of slots in the hashed index of directory entry names; a power
+ * of two. Up to 3/4 of the slots are used, directories are scanned when
+ * there are more entries. Each slot takes 12 bytes; the directories are
+ * always scanned unless MFS_DIR_HASH_SIZE is defined */
+#ifndef MFS_DIR_HASH_SIZE
+#define MFS_DIR_HASH_SIZE 0
+#endif
+
+/* number of recently resolved paths remembered, so that looking up the
+ * same path again (mfs_exists_file and then mfs_file_open, say) does not
+ * walk the directories. Paths of MFS_PATH_CACHE_NAME_LENGTH characters or
+ * more are not remembered. The cache is emptied whenever a file or
+ * directory is created, deleted or renamed. Define as 0 to disable */
+#ifndef MFS_PATH_CACHE_SIZE
+#define MFS_PATH_CACHE_SIZE 8
+#endif
+#define MFS_PATH_CACHE_NAME_LENGTH 48
+
+/* free blocks are tracked in a bitmap of MFS_FREE_BITMAP_BLOCKS bits
+ * instead of the free block list, so that files can be given runs of
+ * consecutive blocks: a file grows into the block after its last one
+ * when that is free, and otherwise moves on to the start of a free run;
+ * mfs_file_reserve() sets a run aside for a writer that knows the size.
+ * File systems of more blocks, or all of them unless this is defined
+ * (8192, in 1 KB, say), use the free block list. The bitmap does not keep
+ * the list up to date in the image; MFSINIT_IMAGE links it again from the
+ * block types, so images can be mounted by builds with and without the
+ * bitmap */
+#ifndef MFS_FREE_BITMAP_BLOCKS
+#define MFS_FREE_BITMAP_BLOCKS 0
+#endif
+
+/* files can be stored compressed (see mfsimage -z); they are read-only,
+ * and are decompressed as they are read through one of MFS_LZ_STREAMS
+ * streams of MFS_LZ_WINDOW_SIZE bytes each. Opening more compressed files
+ * at a time fails. Compressed files are not supported unless
+ * MFS_LZ_STREAMS is defined, as 1 for one file at a time (4 KB) say
+ *
+ * The data of a compressed file is an LZSS stream: a flag byte, then
+ * 8 items, one for each bit of the flag byte from the lowest up; a 1
+ * bit is a literal byte, a 0 bit a match of 2 bytes, b0 b1, that repeats
+ * (b1 & 15) + 3 bytes from ((b1 >> 4) << 8 | b0) + 1 bytes back. The stream
+ * ends when the size of the file, in the first block, has been decoded.
+ * The blocks hold the number of bytes of the stream in them, as usual,
+ * except for the first, which is full unless it is the only one */
+#ifndef MFS_LZ_STREAMS
+#define MFS_LZ_STREAMS 0
+#endif
+#define MFS_LZ_WINDOW_SIZE 4096
+#define MFS_LZ_MIN_MATCH 3
+#define MFS_LZ_MAX_MATCH 18
+
+/* blocks of a file system mounted with MFSINIT_ROM_IMAGE can be copied
+ * to a cache in faster memory as files are read, see mfs_set_block_cache().
+ * The cache is left out unless MFS_BLOCK_CACHE is defined as 1 */
+#ifndef MFS_BLOCK_CACHE
+#define MFS_BLOCK_CACHE 0
+#endif
+
+/* define MFS_STATS as 1 to count what the file system does, see
+ * mfs_get_stats() and mfs_print_stats(). Define MFS_STATS_TIMER as the name
+ * of a function of the application, unsigned long f(void), that returns a
+ * free running count of cycles (of a timer, say) for the API calls to be
+ * timed as well; without it they are only counted */
+#ifndef MFS_STATS
+#define MFS_STATS 0
+#endif
+
 #define MFS_MAX_FILENAME_LENGTH 23
 
 /**
@@ -55,7 +123,7 @@ extern "C" {
  */
 struct mfs_dir_ent_block {
   char name[MFS_MAX_FILENAME_LENGTH];
-  char deleted; /* value ='y' for deleted files and dirs, 'n' otherwise */
+  char deleted; /* value ='y' for deleted files and dirs, 'z' for compressed files, 'n' otherwise */
   unsigned int index;
 };
 
@@ -102,19 +170,104 @@ struct mfs_file_block {
 /* MFS_MODE_CREATE creates a new file and opens it with MFS_MODE_WRITE */
 #define MFS_MODE_CREATE 3
 #define MFS_MODE_FREE 8
+/* block index of a file opened for reading, built on its first seek
+ * a file whose blocks follow each other needs no table: block n of the
+ * file is first_block + n. Other files get a table of their block numbers
+ * from a pool of MFS_BLOCK_INDEX_POOL_SIZE entries shared by all open
+ * files, or are walked through next_block when the pool is full.
+ * The pool is left out unless MFS_BLOCK_INDEX_POOL_SIZE is defined, as
+ * 1024 (4 KB) say; other files are then always walked */
+#ifndef MFS_BLOCK_INDEX_POOL_SIZE
+#define MFS_BLOCK_INDEX_POOL_SIZE 0
+#endif
+#define MFS_INDEX_NONE 0 /* not built yet */
+#define MFS_INDEX_CONTIGUOUS 1
+#define MFS_INDEX_TABLE 2
+#define MFS_INDEX_WALK 3 /* no index, follow next_block */
 struct mfs_open_file_struct {
   unsigned int first_block; /* first block of file */
   unsigned int current_block; /* currently accessed block */
   unsigned short offset; /* current offset within block */
   unsigned short mode ; /* read or write */
+  unsigned int block_num; /* number of current_block within the file, from 0 */
+  unsigned short index_type; /* MFS_INDEX_NONE, _CONTIGUOUS, _TABLE or _WALK */
+  unsigned short index_start; /* first entry of the table in the pool */
+  unsigned int num_indexed; /* number of blocks covered by the index */
+  short lz_stream; /* decompression stream of a compressed file, or -1 */
 } ;
 
+/**
+ * a contiguous piece of file data, in place in the file system memory
+ * see mfs_file_map and mfs_file_get_extents
+ */
+struct mfs_extent {
+  const char *data;
+  int length;
+};
+
+/* how scattered the blocks of the file system are; see mfs_get_fragmentation */
+struct mfs_frag_report {
+  int num_free_blocks;
+  int num_free_runs; /* runs of consecutive free blocks */
+  int largest_free_run; /* blocks in the longest of them */
+  int num_files;
+  int num_fragmented_files; /* files whose blocks are not all consecutive */
+  int num_file_extents; /* runs of consecutive blocks, over all files */
+};
+
+/* what the block cache did since it was set up; see mfs_get_block_cache_stats */
+struct mfs_block_cache_stats {
+  unsigned long num_hits; /* blocks read from the cache */
+  unsigned long num_misses; /* blocks copied to the cache when they were read */
+  unsigned long num_prefetched; /* blocks copied to the cache ahead of reading */
+  unsigned long num_prefetch_hits; /* blocks read that had been copied ahead */
+  unsigned long num_evicted; /* blocks dropped for others, least recently used first */
+};
+
+/* the API calls counted and timed in struct mfs_stats; calls made by
+ * another of them, mfs_file_pread seeking, say, are part of that call */
+#define MFS_CALL_OPEN 0
+#define MFS_CALL_CLOSE 1
+#define MFS_CALL_READ 2
+#define MFS_CALL_WRITE 3
+#define MFS_CALL_LSEEK 4
+#define MFS_CALL_PREAD 5
+#define MFS_CALL_MAP 6
+#define MFS_CALL_EXISTS 7
+#define MFS_CALL_DELETE 8
+#define MFS_NUM_CALLS 9
+
+struct mfs_call_stats {
+  unsigned long num_calls;
+  unsigned long cycles; /* in all of them, 0 without MFS_STATS_TIMER; wraps around */
+  unsigned long max_cycles; /* in the longest one */
+};
+
+/* what the file system did since mfs_init_fs; see mfs_get_stats */
+struct mfs_stats {
+  unsigned long num_dir_lookups; /* names looked up in a directory, one per path component */
+  unsigned long num_dir_hash_answers; /* of those answered by the hashed index */
+  unsigned long num_dir_ents_scanned; /* directory entries compared by the others */
+  unsigned long num_seek_blocks; /* blocks walked through next_block to find a file position */
+  unsigned long num_bytes_read; /* by mfs_file_read and mfs_file_pread */
+  unsigned long num_bytes_mapped; /* by mfs_file_map */
+  unsigned long num_bytes_written;
+  unsigned long num_blocks_allocated;
+  unsigned long num_blocks_off_goal; /* allocated elsewhere than after the last block of the file */
+  unsigned long num_blocks_freed;
+  unsigned long num_opens; /* files and directories opened */
+  unsigned long num_opens_full; /* opens refused with all MFS_MAX_OPEN_FILES in use */
+  int max_open_files; /* most files open at a time */
+  struct mfs_call_stats calls[MFS_NUM_CALLS]; /* by MFS_CALL_ */
+};
+
 /* number of mfs_file_blocks that can fit in the memory reserved for the file system */
 extern int mfs_max_file_blocks;
 /* pointer to block of memory allocated or reserved for the file system */
 extern struct mfs_file_block* mfs_file_system; 
 
-/* index of first free block; the next_block value in this one continues the doubly linked free block list; the prev_block value of the first free block is 0 and the next_block value of the last free block is 0 */
+/* index of first free block; the next_block value in this one continues the doubly linked free block list; the prev_block value of the first free block is 0 and the next_block value of the last free block is 0
+ * the list is not kept, and this is 0, while the free block bitmap is used (see MFS_FREE_BITMAP_BLOCKS) */
 extern int mfs_free_block_list;
 /* the current directory is initialized to 0 for the top level directory, and is modified by change_dir() calls
 */
@@ -225,6 +378,60 @@ int mfs_get_current_dir_name(char *dirname);
  */
 int mfs_get_usage(int *num_blocks_used, int *num_blocks_free);
 
+/**
+ * get the number of path lookups answered by the path cache and the
+ * number that had to walk the directories, since mfs_init_fs
+ * @param num_hits
+ * @param num_misses
+ * the return value is 1, or 0 if the path cache is disabled
+ */
+int mfs_get_path_cache_stats(unsigned long *num_hits, unsigned long *num_misses);
+
+/**
+ * get what the block cache did since mfs_set_block_cache or mfs_init_fs
+ * the hit rate is num_hits / (num_hits + num_misses)
+ * @param stats is filled in
+ * the return value is 1, or 0 if the block cache is not in use
+ */
+int mfs_get_block_cache_stats(struct mfs_block_cache_stats *stats);
+
+/**
+ * get what the file system did since mfs_init_fs or mfs_clear_stats:
+ * directory entries scanned, blocks walked to seek, bytes copied, blocks
+ * allocated and freed, use of the open file table and API calls
+ * @param stats is filled in
+ * the return value is 1, or 0 if MFS_STATS is 0
+ */
+int mfs_get_stats(struct mfs_stats *stats);
+
+/**
+ * set the counts of mfs_get_stats back to 0
+ */
+void mfs_clear_stats(void);
+
+/**
+ * keep copies of the blocks read from files in a cache, for file systems
+ * mounted with MFSINIT_ROM_IMAGE; with the image in flash, files are read
+ * from copies in DDR after the first time. Blocks are dropped least recently
+ * used first, and the blocks that follow the one read in a file are copied
+ * ahead of reading, so that sequential reads find their blocks in the cache
+ * mfs_file_read, mfs_file_map and compressed files use the cache; the data
+ * of mfs_file_map then stays valid until the next read or map
+ * it can be called before or after mfs_init_fs, which empties the cache
+ * @param address is the start of the memory for the cache, word aligned
+ * @param numbytes is its size, about 550 bytes per block; 0 turns the cache off
+ * @param read_ahead is the number of blocks copied ahead, 0 for none
+ * @return the number of blocks the cache holds
+ */
+int mfs_set_block_cache(char *address, int numbytes, int read_ahead);
+
+/**
+ * report how fragmented the file system is
+ * @param report is filled in
+ * the return value is 1
+ */
+int mfs_get_fragmentation(struct mfs_frag_report *report);
+
 /**
  * open a directory for reading
  * each subsequent call to mfs_dir_read() returns one directory entry until
@@ -260,7 +467,7 @@ int mfs_dir_read(int fd, char **filename, int *filesize, int *filetype);
  * this function should be used for FILEs and not DIRs
  * no error checking (is this FILE and not DIR?) is done for MFS_MODE_READ
  * MFS_MODE_CREATE automatically creates a FILE and not a DIR
- * MFS_MODE_WRITE fails if the specified file is a DIR
+ * MFS_MODE_WRITE fails if the specified file is a DIR or a compressed file
  * @return index of file in array mfs_open_files or -1 
  */
 int mfs_file_open(const char *filename, int mode) ;
@@ -279,6 +486,37 @@ int mfs_file_open(const char *filename, int mode) ;
 */
 int mfs_file_read(int fd, char *buf, int buflen) ;
 
+/**
+ * map the file data at the current position of an open file
+ * meant for file systems initialized with MFSINIT_ROM_IMAGE, where the
+ * contents can be used in place instead of being copied by mfs_file_read
+ * file data is contiguous within each block, so a call maps the rest of
+ * the current block and moves the file position past it; repeated calls
+ * walk the whole file one extent at a time
+ * @param fd is a descriptor for the file
+ * @param data is set to the first byte of the extent
+ * @return length of the extent, 0 at end of file, -1 if fd is not an open file
+ * the data stays valid until the file is written to or deleted; the data
+ * of a compressed file is decompressed into the window of its stream and
+ * stays valid until the next read, map or seek on fd, and with the block
+ * cache on (see mfs_set_block_cache) data is in the cache and stays valid
+ * until the next read or map
+ */
+int mfs_file_map(int fd, const char **data);
+
+/**
+ * get the extents of an open file from its current position to the end
+ * of the file, without moving the position
+ * a file that fits in one block has a single extent, so the whole file
+ * is then at extents[0].data
+ * @param fd is a descriptor for the file
+ * @param extents is an array of at least max_extents entries, filled in file order
+ * @param max_extents is the number of entries in extents
+ * @return the number of extents left in the file, which may be more than
+ * max_extents, or -1 if fd is not an open file or is a compressed file
+ */
+int mfs_file_get_extents(int fd, struct mfs_extent *extents, int max_extents);
+
 /**
  * write characters to a file
  * @param fd is a descriptor for the file to which the characters are written
@@ -291,6 +529,18 @@ int mfs_file_read(int fd, char *buf, int buflen) ;
 */ 
 int mfs_file_write (int fd, const char *buf, int buflen) ;
 
+/**
+ * reserve blocks for a file open for writing, so that the next size
+ * bytes written from the current position go to blocks set aside now,
+ * consecutive ones when a long enough run of free blocks exists
+ * reserved blocks that are not written to are freed when the file is closed
+ * @param fd is a descriptor for the file
+ * @param size is the number of bytes that will be written
+ * @return 1 for success or 0 if fd is not open for writing, file data
+ * follows the current block or the file system is full
+ */
+int mfs_file_reserve(int fd, int size);
+
 /**
  * close an open file and
  * recover the file table entry in mfs_open_files corresponding to the fd
@@ -319,6 +569,17 @@ int mfs_file_close(int fd);
  */
 long mfs_file_lseek(int fd, long offset, int whence);
 
+/**
+ * read characters from a given offset of a file
+ * the file position is not changed
+ * @param fd is a descriptor for the file from which the characters are read
+ * @param buf is a pre allocated buffer that will contain the read characters
+ * @param buflen is the number of characters to be read
+ * @param offset is the offset from the beginning of the file
+ * @return num bytes read or 0 for error=no bytes read
+ */
+int mfs_file_pread(int fd, char *buf, int buflen, long offset);
+
 /*** Additional Utility Functions ***/
 
 /**
@@ -369,6 +630,12 @@ int mfs_copy_stdin_to_file(char *filename) ;
 
 int mfs_file_copy(char *from_file, char *to_file) ;
 
+/**
+ * print the counts of mfs_get_stats to stdout, the UART on the board
+ * @return 1 on success, 0 if MFS_STATS is 0
+ */
+int mfs_print_stats(void) ;
+
 #ifdef __cplusplus
 }
 #endif
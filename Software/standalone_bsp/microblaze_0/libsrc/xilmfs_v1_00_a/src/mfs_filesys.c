@@ -43,6 +43,138 @@ int mfs_free_block_list; /* first element in free list; set by mfs_init */
 struct mfs_open_file_struct mfs_open_files[MFS_MAX_OPEN_FILES];
 int mfs_num_open_files; /* the number of mfs_open_files */
 int mfs_current_dir; /* index of current directory block */
+#if MFS_DIR_HASH_SIZE > 0
+/* hashed index of all directory entries, see dir_hash_lookup() */
+struct mfs_dir_hash_ent {
+  unsigned int key; /* hash of directory and name; MFS_DIR_HASH_EMPTY or _REMOVED when unused */
+  int dir_block; /* where the entry is */
+  int dir_index;
+};
+#define MFS_DIR_HASH_EMPTY 0
+#define MFS_DIR_HASH_REMOVED 1
+static struct mfs_dir_hash_ent mfs_dir_hash[MFS_DIR_HASH_SIZE];
+static int mfs_dir_hash_used; /* entries not MFS_DIR_HASH_EMPTY */
+static int mfs_dir_hash_valid; /* every directory entry is in the index */
+static void dir_hash_build(void);
+#endif
+#if MFS_PATH_CACHE_SIZE > 0
+/* recently resolved paths, see path_cache_lookup() */
+struct mfs_path_cache_ent {
+  unsigned int key; /* hash of path */
+  int start_dir; /* directory the path is relative to */
+  int found; /* what get_dir_ent_base returned */
+  int dir_block;
+  int dir_index;
+  char path[MFS_PATH_CACHE_NAME_LENGTH];
+};
+static struct mfs_path_cache_ent mfs_path_cache[MFS_PATH_CACHE_SIZE];
+static int mfs_path_cache_used; /* valid entries */
+static int mfs_path_cache_next; /* entry replaced next */
+static unsigned long mfs_path_cache_hits;
+static unsigned long mfs_path_cache_misses;
+#endif
+#if MFS_FREE_BITMAP_BLOCKS > 0
+/* one bit per block, set for a free block, see alloc_block() */
+static unsigned int mfs_free_bitmap[(MFS_FREE_BITMAP_BLOCKS + 31) / 32];
+static int mfs_free_bitmap_valid; /* the bitmap is used instead of mfs_free_block_list */
+static int mfs_free_bitmap_hint; /* no block below this one is free */
+static void free_bitmap_build(int init_type);
+#endif
+static void free_list_build(void);
+/* consecutive free blocks a new file, or a file that cannot grow in
+ * place, looks for so that it can go on growing in place */
+#define MFS_ALLOC_RUN 8
+#if MFS_BLOCK_INDEX_POOL_SIZE > 0
+/* block index tables of open files, see get_file_block() */
+static unsigned int mfs_block_index_pool[MFS_BLOCK_INDEX_POOL_SIZE];
+#endif
+#if MFS_LZ_STREAMS > 0
+/* decompression state of an open compressed file */
+struct mfs_lz_stream {
+  int in_offset; /* next byte of the stream in the current block */
+  int in_left; /* bytes of the stream left in the current block */
+  unsigned int flags; /* flag bits not used yet, above a 1 bit */
+  unsigned int match_dist; /* distance back of the match being copied */
+  int match_left; /* bytes of it left to copy */
+  unsigned int out_pos; /* place in window of the next byte decoded */
+  long out_total; /* bytes decoded, the position in the file */
+  unsigned char window[MFS_LZ_WINDOW_SIZE];
+};
+static struct mfs_lz_stream mfs_lz_streams[MFS_LZ_STREAMS];
+#endif
+static int lz_open(int fd);
+#if MFS_BLOCK_CACHE > 0
+/* an entry of the block cache, see read_block() */
+struct mfs_cache_ent {
+  int block; /* index of the block copied to the entry, or -1 */
+  int hash_next; /* next entry of the same hash chain, or -1 */
+  int lru_prev; /* entry used more recently, or -1 */
+  int lru_next; /* entry used less recently, or -1 */
+  int prefetched; /* copied ahead of reading, not read yet */
+};
+static struct mfs_file_block *mfs_cache_blocks; /* the copies, one per entry */
+static struct mfs_cache_ent *mfs_cache_ents;
+static int *mfs_cache_hash; /* first entry of each hash chain, or -1 */
+static int mfs_cache_hash_mask;
+static int mfs_cache_size; /* number of entries */
+static int mfs_cache_read_ahead;
+static int mfs_cache_lru_first; /* entry used most recently */
+static int mfs_cache_lru_last; /* entry used least recently, replaced next */
+static int mfs_cache_rom; /* the file system is mounted with MFSINIT_ROM_IMAGE */
+static int mfs_cache_on; /* and there is a cache */
+static struct mfs_block_cache_stats mfs_cache_stats;
+static void block_cache_clear(void);
+#endif
+#if MFS_STATS > 0
+/* counts of what the file system does, see mfs_get_stats() */
+static struct mfs_stats mfs_stats;
+static int mfs_stats_depth; /* API calls in progress, the outer one and those it made */
+#define MFS_STATS_ADD(field, n) (mfs_stats.field += (n))
+#ifdef MFS_STATS_TIMER
+unsigned long MFS_STATS_TIMER(void);
+#endif
+
+/**
+ * start an API call
+ * @return the cycle count at its start
+ */
+static unsigned long stats_call_begin(void) {
+  mfs_stats_depth++;
+#ifdef MFS_STATS_TIMER
+  return MFS_STATS_TIMER();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * count and time an API call unless it was made by another one
+ * @param call is one of MFS_CALL_
+ * @param start is what stats_call_begin returned
+ */
+static void stats_call_end(int call, unsigned long start) {
+  unsigned long cycles = 0;
+#ifdef MFS_STATS_TIMER
+  cycles = MFS_STATS_TIMER() - start;
+#else
+  (void)start;
+#endif
+  if (--mfs_stats_depth > 0)
+    return;
+  mfs_stats.calls[call].num_calls++;
+  mfs_stats.calls[call].cycles += cycles;
+  if (cycles > mfs_stats.calls[call].max_cycles)
+    mfs_stats.calls[call].max_cycles = cycles;
+}
+/* the API functions call the static ones that do the work, mfs_file_read
+ * calls file_read and so on, through this, so that each call is timed in
+ * one place */
+#define MFS_STATS_CALL(call, result, expr) \
+  do { unsigned long start = stats_call_begin(); result = (expr); stats_call_end(call, start); } while (0)
+#else
+#define MFS_STATS_ADD(field, n) ((void)0)
+#define MFS_STATS_CALL(call, result, expr) result = (expr)
+#endif
 
 /**
  * initialize the file system;
@@ -88,24 +220,46 @@ if (init_type == MFSINIT_NEW) {
   mfs_free_block_list = 1;
 }
 else if (init_type == MFSINIT_IMAGE) {
-  i = 0;
-  while (mfs_file_system[i].block_type != MFS_BLOCK_TYPE_EMPTY) {
-    i++;
-  }	
-  /* initialize free block list to the first free index = 1 */
-  mfs_free_block_list = i;
+  /* link up the free block list from the block types, since an image
+     written with the free block bitmap does not keep it */
+  free_list_build();
 }
 else { // (init_type == MFSINIT_ROM_IMAGE)
 	 mfs_free_block_list = 0;
 }
 
+#if MFS_FREE_BITMAP_BLOCKS > 0
+  /* track the free blocks in the bitmap if it is large enough */
+  free_bitmap_build(init_type);
+#endif
+
   /* initialize current dir to the top level */
   mfs_current_dir = 0;
 
+#if MFS_DIR_HASH_SIZE > 0
+  /* index the names of the directory entries */
+  dir_hash_build();
+#endif
+
+#if MFS_PATH_CACHE_SIZE > 0
+  mfs_path_cache_used = 0;
+  mfs_path_cache_next = 0;
+  mfs_path_cache_hits = 0;
+  mfs_path_cache_misses = 0;
+#endif
+
   /* initialize mfs_open_files */
   for (i = 0; i < MFS_MAX_OPEN_FILES; i++)
     mfs_open_files[i].mode = MFS_MODE_FREE;
   mfs_num_open_files = 0;
+
+  mfs_clear_stats();
+
+#if MFS_BLOCK_CACHE > 0
+  /* only blocks that cannot change are cached */
+  mfs_cache_rom = (init_type == MFSINIT_ROM_IMAGE);
+  block_cache_clear();
+#endif
 }
 
 /**
@@ -132,12 +286,167 @@ void mfs_init_genimage(int numbytes, char *address, int init_type) {
 }
 
 
+#if MFS_DIR_HASH_SIZE > 0
+/**
+ * hash a name within a directory
+ * @param dir is the index of the first block of the directory
+ * @param name is the entry name
+ * @return the key, never MFS_DIR_HASH_EMPTY or MFS_DIR_HASH_REMOVED
+ */
+static unsigned int dir_hash_key(int dir, const char *name) {
+  unsigned int key = 2166136261u ^ (unsigned int)dir;
+  while (*name != '\0') {
+    key = (key ^ (unsigned char)*name) * 16777619u;
+    name++;
+  }
+  if (key <= MFS_DIR_HASH_REMOVED)
+    key += 2;
+  return key;
+}
+
+/**
+ * look up a name in the hashed directory index
+ * @param dir is the index of the first block of the directory
+ * @param name is the entry name
+ * @param dir_block is set to the block that holds the entry
+ * @param dir_index is set to the index of the entry within dir_block
+ * @return 1 if found, 0 if the directory has no entry of that name,
+ * -1 if it has several (mfs_rename_file can make them) and only a scan
+ * finds the one that comes first
+ */
+static int dir_hash_lookup(int dir, const char *name, int *dir_block, int *dir_index) {
+  unsigned int key = dir_hash_key(dir, name);
+  unsigned int slot = key & (MFS_DIR_HASH_SIZE - 1);
+  struct mfs_dir_ent_block *ent;
+  int found = 0;
+  while (mfs_dir_hash[slot].key != MFS_DIR_HASH_EMPTY) {
+    if (mfs_dir_hash[slot].key == key) {
+      ent = &mfs_file_system[mfs_dir_hash[slot].dir_block].u.dir_data.dir_ent[mfs_dir_hash[slot].dir_index];
+      if (ent->deleted != 'y' && !strcmp(ent->name, name)) {
+        if (found)
+          return -1;
+        *dir_block = mfs_dir_hash[slot].dir_block;
+        *dir_index = mfs_dir_hash[slot].dir_index;
+        found = 1;
+      }
+    }
+    slot = (slot + 1) & (MFS_DIR_HASH_SIZE - 1);
+  }
+  return found;
+}
+
+/**
+ * add a directory entry to the hashed directory index
+ * the index is rebuilt when removed entries fill it up, and given up
+ * (lookups then scan the directories) when the live entries do
+ * @param dir is the index of the first block of the directory
+ * @param dir_block is the block that holds the entry
+ * @param dir_index is the index of the entry within dir_block
+ */
+static void dir_hash_insert(int dir, int dir_block, int dir_index) {
+  unsigned int key;
+  unsigned int slot;
+  if (!mfs_dir_hash_valid)
+    return;
+  if (mfs_dir_hash_used >= MFS_DIR_HASH_SIZE - MFS_DIR_HASH_SIZE / 4) {
+    /* full - the entry is already in the file system, so a rebuild adds it */
+    dir_hash_build();
+    return;
+  }
+  key = dir_hash_key(dir, mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].name);
+  slot = key & (MFS_DIR_HASH_SIZE - 1);
+  while (mfs_dir_hash[slot].key != MFS_DIR_HASH_EMPTY && mfs_dir_hash[slot].key != MFS_DIR_HASH_REMOVED)
+    slot = (slot + 1) & (MFS_DIR_HASH_SIZE - 1);
+  if (mfs_dir_hash[slot].key == MFS_DIR_HASH_EMPTY)
+    mfs_dir_hash_used++;
+  mfs_dir_hash[slot].key = key;
+  mfs_dir_hash[slot].dir_block = dir_block;
+  mfs_dir_hash[slot].dir_index = dir_index;
+}
+
+/**
+ * remove a directory entry from the hashed directory index
+ * must be called while the entry still has its name
+ * @param dir is the index of the first block of the directory
+ * @param dir_block is the block that holds the entry
+ * @param dir_index is the index of the entry within dir_block
+ */
+static void dir_hash_remove(int dir, int dir_block, int dir_index) {
+  unsigned int key;
+  unsigned int slot;
+  if (!mfs_dir_hash_valid)
+    return;
+  key = dir_hash_key(dir, mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].name);
+  slot = key & (MFS_DIR_HASH_SIZE - 1);
+  while (mfs_dir_hash[slot].key != MFS_DIR_HASH_EMPTY) {
+    if (mfs_dir_hash[slot].key == key && mfs_dir_hash[slot].dir_block == dir_block &&
+        mfs_dir_hash[slot].dir_index == dir_index) {
+      mfs_dir_hash[slot].key = MFS_DIR_HASH_REMOVED;
+      return;
+    }
+    slot = (slot + 1) & (MFS_DIR_HASH_SIZE - 1);
+  }
+}
+
+/**
+ * add the entries of a directory and of the directories below it to the
+ * hashed directory index
+ * the tree is walked from the root rather than the blocks scanned, since
+ * a ROM image may be mounted with a numbytes that covers only its start
+ * @param dir is the index of the first block of the directory
+ */
+static void dir_hash_add_dir(int dir) {
+  int dir_block = dir;
+  int dir_index = 0;
+  int numentriesleft = mfs_file_system[dir].u.dir_data.num_entries;
+  struct mfs_dir_ent_block *ent;
+  while (numentriesleft > 0 && mfs_dir_hash_valid) {
+    if (dir_index == MFS_MAX_LOCAL_ENT) { /* move to the next dir block */
+      dir_index = 0;
+      dir_block = mfs_file_system[dir_block].next_block;
+    }
+    ent = &mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index];
+    if (ent->deleted != 'y') {
+      if (mfs_dir_hash_used >= MFS_DIR_HASH_SIZE - MFS_DIR_HASH_SIZE / 4) {
+        /* too many entries - scan the directories instead */
+        mfs_dir_hash_valid = 0;
+        return;
+      }
+      dir_hash_insert(dir, dir_block, dir_index);
+      /* .. and . are the first two entries */
+      if ((dir_block != dir || dir_index >= 2) &&
+          mfs_file_system[ent->index].block_type == MFS_BLOCK_TYPE_DIR)
+        dir_hash_add_dir(ent->index);
+    }
+    dir_index += 1;
+    numentriesleft--;
+  }
+}
+
+/**
+ * build the hashed directory index from all the directories in the
+ * file system
+ */
+static void dir_hash_build(void) {
+  int i;
+  for (i = 0; i < MFS_DIR_HASH_SIZE; i++)
+    mfs_dir_hash[i].key = MFS_DIR_HASH_EMPTY;
+  mfs_dir_hash_used = 0;
+  mfs_dir_hash_valid = 1;
+  dir_hash_add_dir(0);
+}
+#endif
+
 /**
  * Given a filename, get the directory block and the directory index within
  * that block that correspond to the entry for this filename
  * @param filename 
  * @param dir_block is a pointer to the block that is found
  * @param dir_index is a pointer to the index within the block that is found
+ * @param reuse_block is a pointer to the block of the first deleted entry, or NULL
+ * @param reuse_index is a pointer to the index within that block, or NULL
+ * pass NULL as reuse_block when the free entry is not needed: the hashed
+ * directory index then answers without scanning the directory
  * @return 0 for failure and 1 for success
  * on success:
  * return dir_block = index of dir block (may not always be mfs_current_dir)
@@ -158,6 +467,11 @@ static int get_dir_ent_base(const char *filename,  int *dir_block, int *dir_inde
   int index = 0;
   int basename = 0;
   int looking_for_reuse = 0;
+#if MFS_DIR_HASH_SIZE > 0
+  int found;
+  int found_block;
+  int found_index;
+#endif
  
   while(*filename != '/' && *filename != '\0') {
     tmpfilename[index] = *filename; 
@@ -165,15 +479,37 @@ static int get_dir_ent_base(const char *filename,  int *dir_block, int *dir_inde
     index++;
   }
   tmpfilename[index] = '\0';
+  MFS_STATS_ADD(num_dir_lookups, 1);
   if (*filename == '\0' || (*filename == '/' && *(filename+1)=='\0')) { /* this is the basename */
 	  basename = 1;
-	  looking_for_reuse = 1;
+	  looking_for_reuse = (reuse_block != NULL);
+  }
+#if MFS_DIR_HASH_SIZE > 0
+  /* the index answers everything but where to add a missing entry */
+  if (mfs_dir_hash_valid && !looking_for_reuse &&
+      (found = dir_hash_lookup(*dir_block, tmpfilename, &found_block, &found_index)) >= 0) {
+    MFS_STATS_ADD(num_dir_hash_answers, 1);
+    if (!found) {
+      *dir_block = -1;
+      *dir_index = -1;
+      return 0;
+    }
+    *dir_block = found_block;
+    *dir_index = found_index;
+    if (basename == 1) /* this is the base file name, ignore final '/' if present */
+      return 1;
+    *dir_block = mfs_file_system[*dir_block].u.dir_data.dir_ent[*dir_index].index;
+    *dir_index = 0;
+    filename++;
+    return(get_dir_ent_base(filename, dir_block, dir_index, reuse_block, reuse_index));
   }
+#endif
   while (numentriesleft > 0) {
     if (*dir_index == MFS_MAX_LOCAL_ENT) { /* move to the next dir block */
       *dir_index = 0;
       *dir_block = mfs_file_system[*dir_block].next_block;
     }
+    MFS_STATS_ADD(num_dir_ents_scanned, 1);
     if (mfs_file_system[*dir_block].u.dir_data.dir_ent[*dir_index].deleted != 'y' &&
         !strcmp(mfs_file_system[*dir_block].u.dir_data.dir_ent[*dir_index].name, 
                 tmpfilename)) { /* found the entry */
@@ -207,6 +543,60 @@ static int get_dir_ent_base(const char *filename,  int *dir_block, int *dir_inde
     return 0;
   }
 }
+#if MFS_PATH_CACHE_SIZE > 0
+/**
+ * get_dir_ent_base without the walk when the same path was resolved
+ * from the same directory since the last change to a directory
+ * @param filename is the path, relative to *dir_block
+ * @param dir_block is the directory on entry and as for get_dir_ent_base on return
+ * @param dir_index is as for get_dir_ent_base
+ * @return what get_dir_ent_base returns
+ */
+static int path_cache_lookup(const char *filename, int *dir_block, int *dir_index) {
+  struct mfs_path_cache_ent *ent;
+  int start_dir = *dir_block;
+  unsigned int key = 2166136261u;
+  int len;
+  int i;
+  for (len = 0; filename[len] != '\0'; len++)
+    key = (key ^ (unsigned char)filename[len]) * 16777619u;
+  for (i = 0; i < mfs_path_cache_used; i++) {
+    ent = &mfs_path_cache[i];
+    if (ent->key == key && ent->start_dir == start_dir && !strcmp(ent->path, filename)) {
+      mfs_path_cache_hits++;
+      *dir_block = ent->dir_block;
+      *dir_index = ent->dir_index;
+      return ent->found;
+    }
+  }
+  mfs_path_cache_misses++;
+  i = get_dir_ent_base(filename, dir_block, dir_index, NULL, NULL);
+  if (len < MFS_PATH_CACHE_NAME_LENGTH) {
+    ent = &mfs_path_cache[mfs_path_cache_next];
+    ent->key = key;
+    ent->start_dir = start_dir;
+    ent->found = i;
+    ent->dir_block = *dir_block;
+    ent->dir_index = *dir_index;
+    memcpy(ent->path, filename, len + 1);
+    if (mfs_path_cache_used < MFS_PATH_CACHE_SIZE)
+      mfs_path_cache_used++;
+    mfs_path_cache_next = (mfs_path_cache_next + 1) % MFS_PATH_CACHE_SIZE;
+  }
+  return i;
+}
+#endif
+
+/**
+ * forget the resolved paths; called whenever a directory entry changes
+ */
+static void path_cache_clear(void) {
+#if MFS_PATH_CACHE_SIZE > 0
+  mfs_path_cache_used = 0;
+  mfs_path_cache_next = 0;
+#endif
+}
+
 /**
  * filename is an arbitrarily long  '/' separated path name 
  * each component of the path name is never longer than MFS_MAX_FILENAME_LENGTH
@@ -237,8 +627,11 @@ static int get_dir_ent(const char *filename,  int *dir_block, int *dir_index, in
     *dir_index = 0;
     if (*filename == '\0') /* done - looking for the root directory */
       return 1;
-    else
-      return(get_dir_ent_base(filename, dir_block, dir_index, reuse_block, reuse_index));
+#if MFS_PATH_CACHE_SIZE > 0
+    if (reuse_block == NULL)
+      return(path_cache_lookup(filename, dir_block, dir_index));
+#endif
+    return(get_dir_ent_base(filename, dir_block, dir_index, reuse_block, reuse_index));
   }
   /* error condition */
   *dir_block = -1;
@@ -300,15 +693,168 @@ int mfs_change_dir(const char *newdir) {
   /* return 1 for success, 0 for failure */
   int new_dir_block;
   int new_dir_index;
-  int reuse_block = -1;
-  int reuse_index = -1;
-  if (get_dir_ent(newdir, &new_dir_block, &new_dir_index, &reuse_block, &reuse_index)) {
+  if (get_dir_ent(newdir, &new_dir_block, &new_dir_index, NULL, NULL)) {
     mfs_current_dir = mfs_file_system[new_dir_block].u.dir_data.dir_ent[new_dir_index].index;
     return 1;
   }
   return 0;
 }
 
+/**
+ * link every empty block of the file system into the free block list,
+ * in block order
+ * the free block list of an image is not trusted: the free block bitmap
+ * does not keep it, so an image written by a library built with the
+ * bitmap can only be mounted without it once the list is linked again
+ */
+static void free_list_build(void) {
+  int last_free = 0;
+  int i;
+  mfs_free_block_list = 0;
+  for (i = 1; i < mfs_max_file_blocks; i++) {
+    if (mfs_file_system[i].block_type != MFS_BLOCK_TYPE_EMPTY)
+      continue;
+    if (last_free == 0)
+      mfs_free_block_list = i;
+    else
+      mfs_file_system[last_free].next_block = i;
+    mfs_file_system[i].prev_block = last_free;
+    mfs_file_system[i].next_block = 0;
+    last_free = i;
+  }
+}
+
+#if MFS_FREE_BITMAP_BLOCKS > 0
+/**
+ * set up the free block bitmap from the block types of the file system;
+ * when the file system is too large for the bitmap the free block list
+ * is used instead
+ * @param init_type is as for mfs_init_fs; a MFSINIT_ROM_IMAGE has no free blocks
+ */
+static void free_bitmap_build(int init_type) {
+  int i;
+  for (i = 0; i < (MFS_FREE_BITMAP_BLOCKS + 31) / 32; i++)
+    mfs_free_bitmap[i] = 0;
+  mfs_free_bitmap_hint = mfs_max_file_blocks;
+  mfs_free_bitmap_valid = (mfs_max_file_blocks <= MFS_FREE_BITMAP_BLOCKS);
+  if (init_type == MFSINIT_ROM_IMAGE)
+    return;
+  if (mfs_free_bitmap_valid)
+    mfs_free_block_list = 0;
+  for (i = 1; i < mfs_max_file_blocks; i++) {
+    if (mfs_file_system[i].block_type != MFS_BLOCK_TYPE_EMPTY)
+      continue;
+    if (mfs_free_bitmap_valid) {
+      mfs_free_bitmap[i >> 5] |= 1u << (i & 31);
+      if (i < mfs_free_bitmap_hint)
+        mfs_free_bitmap_hint = i;
+    }
+  }
+}
+
+/**
+ * find the first free block at or after a given block
+ * @param from is the block to start from
+ * @return the free block, or 0 if there is none
+ */
+static int find_free_block(int from) {
+  unsigned int bits;
+  int word;
+  if (from >= mfs_max_file_blocks)
+    return 0;
+  word = from >> 5;
+  bits = mfs_free_bitmap[word] & (~0u << (from & 31));
+  while (bits == 0) {
+    word++;
+    if ((word << 5) >= mfs_max_file_blocks)
+      return 0;
+    bits = mfs_free_bitmap[word];
+  }
+  from = word << 5;
+  while ((bits & 1) == 0) {
+    bits >>= 1;
+    from++;
+  }
+  return from;
+}
+
+/**
+ * find the first block in use at or after a given block
+ * @param from is the block to start from
+ * @return the block, or mfs_max_file_blocks if there is none
+ */
+static int find_used_block(int from) {
+  unsigned int bits;
+  int word;
+  if (from >= mfs_max_file_blocks)
+    return mfs_max_file_blocks;
+  word = from >> 5;
+  bits = ~mfs_free_bitmap[word] & (~0u << (from & 31));
+  while (bits == 0) {
+    word++;
+    if ((word << 5) >= mfs_max_file_blocks)
+      return mfs_max_file_blocks;
+    bits = ~mfs_free_bitmap[word];
+  }
+  from = word << 5;
+  while ((bits & 1) == 0) {
+    bits >>= 1;
+    from++;
+  }
+  return (from < mfs_max_file_blocks) ? from : mfs_max_file_blocks;
+}
+
+/**
+ * is a block the last block of a file that is open for writing
+ * @param block is a block index
+ * @return 1 if so, in which case the file is likely to grow into block + 1
+ */
+static int is_growing_file_block(int block) {
+  int i;
+  if (mfs_file_system[block].block_type != MFS_BLOCK_TYPE_FILE ||
+      mfs_file_system[block].next_block != 0)
+    return 0;
+  for (i = 0; i < MFS_MAX_OPEN_FILES; i++) {
+    if (mfs_open_files[i].mode == MFS_MODE_WRITE && mfs_open_files[i].current_block == (unsigned int)block)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * find where to put blocks that cannot follow the block before them
+ * runs of free blocks are tried in order; a run that comes right after
+ * the last block of a file being written is left half to that file
+ * @param want is the number of consecutive blocks wanted
+ * @return the first block of the first run long enough, or of the
+ * longest run if none is, or 0 if there are no free blocks
+ */
+static int find_free_run(int want) {
+  int best = 0;
+  int best_len = 0;
+  int start;
+  int end;
+  int len;
+  start = find_free_block(mfs_free_bitmap_hint);
+  while (start != 0) {
+    end = find_used_block(start);
+    len = end - start;
+    if (is_growing_file_block(start - 1)) {
+      start += len / 2;
+      len -= len / 2;
+    }
+    if (len >= want)
+      return start;
+    if (len > best_len) {
+      best = start;
+      best_len = len;
+    }
+    start = find_free_block(end);
+  }
+  return best;
+}
+#endif
+
 /**
  * allocate a new block from the free list
  * @param new_entry_index is modified to point to the newly allocated block
@@ -329,11 +875,53 @@ static int get_next_free_block(int *new_entry_index) {
     /* remove block from free list */
     mfs_file_system[*new_entry_index].prev_block = 0;
     mfs_file_system[*new_entry_index].next_block = 0;
+    MFS_STATS_ADD(num_blocks_allocated, 1);
     return 1;
   }
   return 0; /* failed to get free block */
 }
 
+/**
+ * allocate a new block
+ * with the free block bitmap the block is the one wanted when it is
+ * free, otherwise the start of a run of free blocks; from the free block
+ * list it is whichever block comes first
+ * @param goal is the block wanted, usually the one after the last block
+ * of the file, or 0 for none
+ * @param want is the number of consecutive blocks the caller expects to need
+ * @param new_entry_index is modified to point to the newly allocated block
+ * @return 1 on success, 0 on failure
+ */
+static int alloc_block(int goal, int want, int *new_entry_index) {
+#if MFS_FREE_BITMAP_BLOCKS > 0
+  int block;
+  if (mfs_free_bitmap_valid) {
+    if (goal > 0 && goal < mfs_max_file_blocks &&
+        (mfs_free_bitmap[goal >> 5] & (1u << (goal & 31))) != 0)
+      block = goal;
+    else
+      block = find_free_run(want);
+    if (block == 0)
+      return 0; /* failed to get free block */
+    MFS_STATS_ADD(num_blocks_allocated, 1);
+    if (goal > 0 && block != goal)
+      MFS_STATS_ADD(num_blocks_off_goal, 1);
+    mfs_free_bitmap[block >> 5] &= ~(1u << (block & 31));
+    mfs_file_system[block].prev_block = 0;
+    mfs_file_system[block].next_block = 0;
+    *new_entry_index = block;
+    return 1;
+  }
+#else
+  (void)want;
+#endif
+  if (!get_next_free_block(new_entry_index))
+    return 0;
+  if (goal > 0 && *new_entry_index != goal)
+    MFS_STATS_ADD(num_blocks_off_goal, 1);
+  return 1;
+}
+
 /**
  * create a new directory block, and initialize it with info about . and .. 
  * if this dir wants to know its name, it needs to ask its parent 
@@ -343,7 +931,7 @@ static int get_next_free_block(int *new_entry_index) {
  * @return 1 for success and 0 for failure
  */
 static int create_new_file(int file_type, int *new_entry_index, int parent_dir_block) {
-  if (get_next_free_block(new_entry_index)) {
+  if (alloc_block(0, MFS_ALLOC_RUN, new_entry_index)) {
     if (file_type == MFS_BLOCK_TYPE_DIR) {
       /* fill in the new dir block with .. and . */
       mfs_file_system[*new_entry_index].block_type = MFS_BLOCK_TYPE_DIR;
@@ -355,6 +943,10 @@ static int create_new_file(int file_type, int *new_entry_index, int parent_dir_b
       mfs_file_system[*new_entry_index].u.dir_data.dir_ent[1].index = *new_entry_index;
       strcpy(mfs_file_system[*new_entry_index].u.dir_data.dir_ent[1].name, ".");
       mfs_file_system[*new_entry_index].u.dir_data.dir_ent[1].deleted = 'n';
+#if MFS_DIR_HASH_SIZE > 0
+      dir_hash_insert(*new_entry_index, *new_entry_index, 0);
+      dir_hash_insert(*new_entry_index, *new_entry_index, 1);
+#endif
       return 1;
     }
     else if (file_type == MFS_BLOCK_TYPE_FILE) {
@@ -475,7 +1067,7 @@ static int create_file(const char *filename, int file_type) {
  
       if (new_dir_index == MFS_MAX_LOCAL_ENT) { 
         /* create a new dir block linked from this one */
-        if (get_next_free_block(&new_block)) { /* found a free block */
+        if (alloc_block(new_dir_block + 1, 1, &new_block)) { /* found a free block */
 	      mfs_file_system[new_block].prev_block = new_dir_block;
 	      mfs_file_system[new_block].next_block = 0;
 	      mfs_file_system[new_block].block_type = MFS_BLOCK_TYPE_DIR;
@@ -508,6 +1100,10 @@ static int create_file(const char *filename, int file_type) {
     mfs_file_system[new_dir_block].u.dir_data.dir_ent[new_dir_index].index = new_entry_index;
     set_filename(mfs_file_system[new_dir_block].u.dir_data.dir_ent[new_dir_index].name, get_basename(filename));
     mfs_file_system[new_dir_block].u.dir_data.dir_ent[new_dir_index].deleted = 'n';
+#if MFS_DIR_HASH_SIZE > 0
+    dir_hash_insert(first_dir_block, new_dir_block, new_dir_index);
+#endif
+    path_cache_clear();
     return new_entry_index;
   }
 }
@@ -523,6 +1119,30 @@ static int create_file(const char *filename, int file_type) {
  * @return 1 - always succeeds
  */
 static int move_to_free_list(int start_index, int end_index) {
+#if MFS_STATS > 0
+  int block;
+#endif
+#if MFS_FREE_BITMAP_BLOCKS > 0
+  if (mfs_free_bitmap_valid) { /* mark them free in the bitmap instead */
+    while (1) {
+      MFS_STATS_ADD(num_blocks_freed, 1);
+      mfs_free_bitmap[start_index >> 5] |= 1u << (start_index & 31);
+      if (start_index < mfs_free_bitmap_hint)
+        mfs_free_bitmap_hint = start_index;
+      if (start_index == end_index)
+        break;
+      start_index = mfs_file_system[start_index].next_block;
+    }
+    return 1;
+  }
+#endif
+#if MFS_STATS > 0
+  for (block = start_index; ; block = mfs_file_system[block].next_block) {
+    MFS_STATS_ADD(num_blocks_freed, 1);
+    if (block == end_index)
+      break;
+  }
+#endif
   if (mfs_free_block_list != 0) { /* free list exists and is non empty */
     /* prepend this list to the existing free list */
     mfs_file_system[mfs_free_block_list].prev_block = end_index;
@@ -553,6 +1173,11 @@ static int delete_data_in_file(int file_index) {
       /* dir is not empty so cannot delete */
       return 0;
     }
+#if MFS_DIR_HASH_SIZE > 0
+    /* only .. and . are left */
+    dir_hash_remove(file_index, file_index, 0);
+    dir_hash_remove(file_index, file_index, 1);
+#endif
   }
   else { /* don't know what this is; cannot delete */
     return 0;
@@ -577,30 +1202,38 @@ static int delete_data_in_file(int file_index) {
  * @return 1 on success, 0 on failure
  * delete will not work on a directory unless the directory is empty
  */
-int mfs_delete_file (char *filename) {
+static int delete_file(char *filename) {
   int dir_block;
   int dir_index;
   int entry_index;
   int first_dir_block;
-  int reuse_block = -1;
-  int reuse_index = -1;
 
-  if (!get_dir_ent(filename, &dir_block, &dir_index, &reuse_block, &reuse_index)) { 
+  if (!get_dir_ent(filename, &dir_block, &dir_index, NULL, NULL)) { 
     /* file does not exist */
     return 0 ; /* cannot delete file if it does not exist */
   }
   entry_index = mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].index;
   if (delete_data_in_file(entry_index)) {
     /* now delete the file entry from the directory */
+    first_dir_block = get_first_dir_block(dir_block);
+#if MFS_DIR_HASH_SIZE > 0
+    dir_hash_remove(first_dir_block, dir_block, dir_index);
+#endif
     mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].deleted = 'y';
     mfs_file_system[dir_block].u.dir_data.num_deleted += 1;
-    first_dir_block = get_first_dir_block(dir_block);
     if (dir_block != first_dir_block)
       mfs_file_system[first_dir_block].u.dir_data.num_deleted += 1;
+    path_cache_clear();
   }
   return 1;
 }
 
+int mfs_delete_file (char *filename) {
+  int deleted;
+  MFS_STATS_CALL(MFS_CALL_DELETE, deleted, delete_file(filename));
+  return deleted;
+}
+
 /**
  * create a new empty directory inside the current directory
  * @param newdir is the name of the directory
@@ -634,11 +1267,16 @@ int mfs_rename_file(char *from_file, char *to_file) {
   int to_dir_block;
   int from_dir_index;
   int to_dir_index;
-  int reuse_block = -1;
-  int reuse_index = -1;
-  if (get_dir_ent(from_file, &from_dir_block, &from_dir_index, &reuse_block, &reuse_index) &&
-      !get_dir_ent(to_file, &to_dir_block, &to_dir_index, &reuse_block, &reuse_index)) {
+  if (get_dir_ent(from_file, &from_dir_block, &from_dir_index, NULL, NULL) &&
+      !get_dir_ent(to_file, &to_dir_block, &to_dir_index, NULL, NULL)) {
+#if MFS_DIR_HASH_SIZE > 0
+    dir_hash_remove(get_first_dir_block(from_dir_block), from_dir_block, from_dir_index);
+#endif
     set_filename(mfs_file_system[from_dir_block].u.dir_data.dir_ent[from_dir_index].name, get_basename(to_file));
+#if MFS_DIR_HASH_SIZE > 0
+    dir_hash_insert(get_first_dir_block(from_dir_block), from_dir_block, from_dir_index);
+#endif
+    path_cache_clear();
     return 1;
   }
   return 0;
@@ -651,13 +1289,11 @@ int mfs_rename_file(char *from_file, char *to_file) {
  * @return 1 if filename is a file in the current directory
  * @return 2 if filename is a directory in the current directory
  */
-int mfs_exists_file(char *filename) {
+static int exists_file(char *filename) {
   int dir_block;
   int dir_index;
   int file_block;
-  int reuse_block = -1;
-  int reuse_index = -1;
-  if (get_dir_ent(filename, &dir_block, &dir_index, &reuse_block, &reuse_index)) {
+  if (get_dir_ent(filename, &dir_block, &dir_index, NULL, NULL)) {
     file_block = mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].index;
     if (mfs_file_system[file_block].block_type == MFS_BLOCK_TYPE_DIR)
       return 2;
@@ -668,6 +1304,12 @@ int mfs_exists_file(char *filename) {
   return 0;
 }
 
+int mfs_exists_file(char *filename) {
+  int exists;
+  MFS_STATS_CALL(MFS_CALL_EXISTS, exists, exists_file(filename));
+  return exists;
+}
+
 /**
  * get the name of the current directory 
  * @param dirname =  pre_allocated buffer of at least MFS_MAX_FILENAME_SIZE+1 chars
@@ -710,6 +1352,107 @@ int mfs_get_usage(int *num_blocks_used, int *num_blocks_free) {
   return 1;
 }
 
+/**
+ * report how fragmented the file system is
+ * the first block of a file is a file block with prev_block 0
+ * @param report is filled in
+ * the return value is 1
+ */
+int mfs_get_fragmentation(struct mfs_frag_report *report) {
+  int i;
+  int run = 0;
+  int block;
+  int extents;
+  report->num_free_blocks = 0;
+  report->num_free_runs = 0;
+  report->largest_free_run = 0;
+  report->num_files = 0;
+  report->num_fragmented_files = 0;
+  report->num_file_extents = 0;
+  for (i = 1; i < mfs_max_file_blocks; i++) {
+    if (mfs_file_system[i].block_type == MFS_BLOCK_TYPE_EMPTY) {
+      report->num_free_blocks++;
+      if (run == 0)
+        report->num_free_runs++;
+      run++;
+      if (run > report->largest_free_run)
+        report->largest_free_run = run;
+      continue;
+    }
+    run = 0;
+    if (mfs_file_system[i].block_type != MFS_BLOCK_TYPE_FILE || mfs_file_system[i].prev_block != 0)
+      continue;
+    extents = 1;
+    for (block = i; mfs_file_system[block].next_block != 0; block = mfs_file_system[block].next_block) {
+      if (mfs_file_system[block].next_block != (unsigned int)block + 1)
+        extents++;
+    }
+    report->num_files++;
+    report->num_file_extents += extents;
+    if (extents > 1)
+      report->num_fragmented_files++;
+  }
+  return 1;
+}
+
+/**
+ * get the number of path lookups answered by the path cache and the
+ * number that walked the directories
+ * @param num_hits
+ * @param num_misses
+ * the return value is 1, or 0 if the path cache is disabled
+ */
+int mfs_get_path_cache_stats(unsigned long *num_hits, unsigned long *num_misses) {
+#if MFS_PATH_CACHE_SIZE > 0
+  *num_hits = mfs_path_cache_hits;
+  *num_misses = mfs_path_cache_misses;
+  return 1;
+#else
+  *num_hits = 0;
+  *num_misses = 0;
+  return 0;
+#endif
+}
+
+/**
+ * get what the block cache did since mfs_set_block_cache or mfs_init_fs
+ * @param stats is filled in
+ * the return value is 1, or 0 if the block cache is not in use
+ */
+int mfs_get_block_cache_stats(struct mfs_block_cache_stats *stats) {
+#if MFS_BLOCK_CACHE > 0
+  *stats = mfs_cache_stats;
+  return mfs_cache_on;
+#else
+  memset(stats, 0, sizeof(*stats));
+  return 0;
+#endif
+}
+
+/**
+ * get what the file system did since mfs_init_fs or mfs_clear_stats
+ * @param stats is filled in
+ * the return value is 1, or 0 if MFS_STATS is 0
+ */
+int mfs_get_stats(struct mfs_stats *stats) {
+#if MFS_STATS > 0
+  *stats = mfs_stats;
+  return 1;
+#else
+  memset(stats, 0, sizeof(*stats));
+  return 0;
+#endif
+}
+
+/**
+ * set the counts of mfs_get_stats back to 0
+ */
+void mfs_clear_stats(void) {
+#if MFS_STATS > 0
+  memset(&mfs_stats, 0, sizeof(mfs_stats));
+  mfs_stats.max_open_files = mfs_num_open_files;
+#endif
+}
 
 /**
  * get the first available/free block
@@ -808,21 +1551,20 @@ int mfs_dir_read(int fd, char **filename, int *filesize, int *filetype) {
  * this function should be used for FILEs and not DIRs
  * no error checking (is this FILE and not DIR?) is done for MFS_MODE_READ
  * MFS_MODE_CREATE automatically creates a FILE and not a DIR
- * MFS_MODE_WRITE fails if the specified file is a DIR
+ * MFS_MODE_WRITE fails if the specified file is a DIR or a compressed file
  * @return index of file in array mfs_open_files or -1 
  */
-int mfs_file_open(const char *filename, int mode) {
+static int file_open(const char *filename, int mode) {
   int dir_block;
   int dir_index;
   int current_index;
-  int reuse_block = -1;
-  int reuse_index = -1;
 
   if (mfs_num_open_files >= MFS_MAX_OPEN_FILES) {/* cannot open any more files */
+    MFS_STATS_ADD(num_opens_full, 1);
     return -1;
   }
   if (mode == MFS_MODE_READ || mode == MFS_MODE_WRITE) { /* look for existing file */
-    if (get_dir_ent(filename, &dir_block, &dir_index, &reuse_block, &reuse_index)) { /* found it */
+    if (get_dir_ent(filename, &dir_block, &dir_index, NULL, NULL)) { /* found it */
       if (mode == MFS_MODE_WRITE && mfs_file_system[mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].index].block_type != MFS_BLOCK_TYPE_FILE) {
 	/* cannot open anything other than FILE for write */
 	return -1;
@@ -833,6 +1575,15 @@ int mfs_file_open(const char *filename, int mode) {
       mfs_open_files[current_index].current_block = mfs_open_files[current_index].first_block;
       mfs_open_files[current_index].mode = mode;
       mfs_open_files[current_index].offset = 0;
+      mfs_open_files[current_index].block_num = 0;
+      mfs_open_files[current_index].index_type = MFS_INDEX_NONE;
+      mfs_open_files[current_index].lz_stream = -1;
+      if (mfs_file_system[dir_block].u.dir_data.dir_ent[dir_index].deleted == 'z' && !lz_open(current_index)) {
+	/* compressed files are read-only, and need a free stream */
+	mfs_open_files[current_index].mode = MFS_MODE_FREE;
+	mfs_num_open_files--;
+	return -1;
+      }
       return current_index;
     }
     else {
@@ -853,11 +1604,374 @@ int mfs_file_open(const char *filename, int mode) {
     mfs_open_files[current_index].current_block = dir_block;
     mfs_open_files[current_index].mode = MFS_MODE_WRITE;
     mfs_open_files[current_index].offset = 0;
+    mfs_open_files[current_index].block_num = 0;
+    mfs_open_files[current_index].index_type = MFS_INDEX_NONE;
+    mfs_open_files[current_index].lz_stream = -1;
     return current_index;
   }
   return -1;
 }
 
+int mfs_file_open(const char *filename, int mode) {
+  int fd;
+  MFS_STATS_CALL(MFS_CALL_OPEN, fd, file_open(filename, mode));
+  if (fd >= 0) {
+    MFS_STATS_ADD(num_opens, 1);
+#if MFS_STATS > 0
+    if (mfs_num_open_files > mfs_stats.max_open_files)
+      mfs_stats.max_open_files = mfs_num_open_files;
+#endif
+  }
+  return fd;
+}
+
+#if MFS_BLOCK_CACHE > 0
+/**
+ * empty the block cache and reset its counts
+ */
+static void block_cache_clear(void) {
+  int i;
+  for (i = 0; i < mfs_cache_size; i++) {
+    mfs_cache_ents[i].block = -1;
+    mfs_cache_ents[i].prefetched = 0;
+    mfs_cache_ents[i].lru_prev = i - 1;
+    mfs_cache_ents[i].lru_next = (i + 1 < mfs_cache_size) ? i + 1 : -1;
+  }
+  for (i = 0; mfs_cache_size > 0 && i <= mfs_cache_hash_mask; i++)
+    mfs_cache_hash[i] = -1;
+  mfs_cache_lru_first = 0;
+  mfs_cache_lru_last = mfs_cache_size - 1;
+  memset(&mfs_cache_stats, 0, sizeof(mfs_cache_stats));
+  mfs_cache_on = mfs_cache_rom && mfs_cache_size > 0;
+}
+
+/**
+ * find a block in the block cache
+ * @param block is the index of the block
+ * @return the entry holding it, or -1
+ */
+static int cache_find(int block) {
+  int ent = mfs_cache_hash[block & mfs_cache_hash_mask];
+  while (ent >= 0 && mfs_cache_ents[ent].block != block)
+    ent = mfs_cache_ents[ent].hash_next;
+  return ent;
+}
+
+/**
+ * make an entry of the block cache the most recently used one
+ * @param ent is the entry
+ */
+static void cache_use(int ent) {
+  int prev = mfs_cache_ents[ent].lru_prev;
+  int next = mfs_cache_ents[ent].lru_next;
+  if (ent == mfs_cache_lru_first)
+    return;
+  mfs_cache_ents[prev].lru_next = next;
+  if (next >= 0)
+    mfs_cache_ents[next].lru_prev = prev;
+  else
+    mfs_cache_lru_last = prev;
+  mfs_cache_ents[ent].lru_prev = -1;
+  mfs_cache_ents[ent].lru_next = mfs_cache_lru_first;
+  mfs_cache_ents[mfs_cache_lru_first].lru_prev = ent;
+  mfs_cache_lru_first = ent;
+}
+
+/**
+ * copy a block to the block cache, in place of the least recently used one
+ * @param block is the index of the block, not in the cache
+ * @param prefetched is 1 if the block is copied ahead of reading
+ * @return the entry it is copied to, now the most recently used one
+ */
+static int cache_load(int block, int prefetched) {
+  int ent = mfs_cache_lru_last;
+  int *link;
+  if (mfs_cache_ents[ent].block >= 0) { /* take it out of its hash chain */
+    link = &mfs_cache_hash[mfs_cache_ents[ent].block & mfs_cache_hash_mask];
+    while (*link != ent)
+      link = &mfs_cache_ents[*link].hash_next;
+    *link = mfs_cache_ents[ent].hash_next;
+    mfs_cache_stats.num_evicted++;
+  }
+  memcpy(&mfs_cache_blocks[ent], &mfs_file_system[block], sizeof(struct mfs_file_block));
+  mfs_cache_ents[ent].block = block;
+  mfs_cache_ents[ent].prefetched = prefetched;
+  mfs_cache_ents[ent].hash_next = mfs_cache_hash[block & mfs_cache_hash_mask];
+  mfs_cache_hash[block & mfs_cache_hash_mask] = ent;
+  cache_use(ent);
+  return ent;
+}
+
+/**
+ * copy the blocks that follow a block in its file to the block cache,
+ * up to mfs_cache_read_ahead of them
+ * there are at least mfs_cache_read_ahead + 2 entries, so the ones
+ * copied do not replace the block nor each other
+ * @param ent is the entry of the block
+ */
+static void cache_read_ahead(int ent) {
+  int next_block;
+  int next;
+  int i;
+  for (i = 0; i < mfs_cache_read_ahead; i++) {
+    next_block = mfs_cache_blocks[ent].next_block;
+    if (next_block == 0)
+      return;
+    next = cache_find(next_block);
+    if (next < 0) {
+      next = cache_load(next_block, 1);
+      mfs_cache_stats.num_prefetched++;
+    }
+    ent = next;
+  }
+}
+#endif
+
+/**
+ * get a block of the file system to read file data from
+ * with the block cache on, this is the copy of the block in the cache,
+ * copied there now if it was not, together with the blocks that follow it
+ * @param block is the index of the block
+ * @return the block, valid until the next block is read
+ */
+static const struct mfs_file_block *read_block(int block) {
+#if MFS_BLOCK_CACHE > 0
+  int ent;
+  if (mfs_cache_on) {
+    ent = cache_find(block);
+    if (ent >= 0) {
+      mfs_cache_stats.num_hits++;
+      cache_use(ent);
+      if (mfs_cache_ents[ent].prefetched) { /* keep ahead of a sequential reader */
+        mfs_cache_ents[ent].prefetched = 0;
+        mfs_cache_stats.num_prefetch_hits++;
+        cache_read_ahead(ent);
+      }
+    }
+    else {
+      mfs_cache_stats.num_misses++;
+      ent = cache_load(block, 0);
+      cache_read_ahead(ent);
+    }
+    return &mfs_cache_blocks[ent];
+  }
+#endif
+  return &mfs_file_system[block];
+}
+
+/**
+ * set up the block cache for file systems mounted with MFSINIT_ROM_IMAGE
+ * the memory holds the copies of the blocks, then the entries, then the
+ * hash chains
+ * @param address is the start of the memory for the cache, word aligned
+ * @param numbytes is its size; 0 turns the cache off
+ * @param read_ahead is the number of blocks copied ahead, 0 for none
+ * @return the number of blocks the cache holds
+ */
+int mfs_set_block_cache(char *address, int numbytes, int read_ahead) {
+#if MFS_BLOCK_CACHE > 0
+  int num_entries = numbytes / (sizeof(struct mfs_file_block) + sizeof(struct mfs_cache_ent) + sizeof(int));
+  mfs_cache_blocks = (struct mfs_file_block *)address;
+  mfs_cache_ents = (struct mfs_cache_ent *)(mfs_cache_blocks + num_entries);
+  mfs_cache_hash = (int *)(mfs_cache_ents + num_entries);
+  /* a power of two hash chains, up to one per entry */
+  mfs_cache_hash_mask = 0;
+  while (num_entries > 0 && (mfs_cache_hash_mask + 1) * 2 <= num_entries)
+    mfs_cache_hash_mask = mfs_cache_hash_mask * 2 + 1;
+  if (num_entries < 2)
+    num_entries = 0; /* too small to be of use */
+  if (read_ahead > num_entries - 2)
+    read_ahead = (num_entries > 2) ? num_entries - 2 : 0;
+  mfs_cache_size = num_entries;
+  mfs_cache_read_ahead = read_ahead;
+  block_cache_clear();
+  return num_entries;
+#else
+  (void)address;
+  (void)numbytes;
+  (void)read_ahead;
+  return 0;
+#endif
+}
+
+#if MFS_LZ_STREAMS > 0
+/**
+ * start decompressing an open compressed file from its beginning
+ * @param fd should be a valid file descriptor for a compressed file with a stream
+ */
+static void lz_rewind(int fd) {
+  struct mfs_lz_stream *s = &mfs_lz_streams[mfs_open_files[fd].lz_stream];
+  int block = mfs_open_files[fd].first_block;
+  mfs_open_files[fd].current_block = block;
+  mfs_open_files[fd].offset = 0;
+  mfs_open_files[fd].block_num = 0;
+  s->in_offset = 0;
+  s->in_left = mfs_file_system[block].block_size;
+  if (s->in_left > MFS_BLOCK_DATA_SIZE)
+    s->in_left = MFS_BLOCK_DATA_SIZE;
+  s->flags = 1;
+  s->match_left = 0;
+  s->out_pos = 0;
+  s->out_total = 0;
+}
+
+/**
+ * get the next byte of the stream of a compressed file
+ * @param fd should be a valid file descriptor for a compressed file with a stream
+ * @param s is its stream
+ * @param in is the current block of the file, from read_block(); it is
+ * changed to the next block when the current one is done
+ * @return the byte, or -1 at the end of the file
+ */
+static int lz_byte(int fd, struct mfs_lz_stream *s, const struct mfs_file_block **in) {
+  if (s->in_left <= 0) { /* see if there is a next_block */
+    int block = (*in)->next_block;
+    if (block == 0)
+      return -1;
+    *in = read_block(block);
+    if ((*in)->block_size == 0) /* nothing more to read */
+      return -1;
+    mfs_open_files[fd].current_block = block;
+    mfs_open_files[fd].block_num += 1;
+    s->in_offset = 0;
+    s->in_left = (*in)->block_size;
+    if (s->in_left > MFS_BLOCK_DATA_SIZE)
+      s->in_left = MFS_BLOCK_DATA_SIZE;
+  }
+  s->in_left--;
+  return (*in)->u.block_data[s->in_offset++];
+}
+
+/**
+ * decompress the next bytes of a compressed file into the window of its
+ * stream, from the place of the next byte up to the end of the window
+ * at most, so that the bytes are contiguous
+ * @param fd should be a valid file descriptor for a compressed file with a stream
+ * @param max is the number of bytes wanted
+ * @return the number of bytes decompressed, 0 at the end of the file
+ */
+static int lz_decode(int fd, long max) {
+  struct mfs_lz_stream *s = &mfs_lz_streams[mfs_open_files[fd].lz_stream];
+  const struct mfs_file_block *in = read_block(mfs_open_files[fd].current_block);
+  unsigned char *window = s->window;
+  unsigned int pos = s->out_pos;
+  unsigned int end;
+  unsigned int from;
+  long size_left = (long)mfs_file_system[mfs_open_files[fd].first_block].block_size - s->out_total;
+  int num_copy;
+  int c;
+  int b1;
+  if (max > MFS_LZ_WINDOW_SIZE - pos)
+    max = MFS_LZ_WINDOW_SIZE - pos;
+  if (max > size_left)
+    max = size_left;
+  end = pos + max;
+  while (pos < end) {
+    if (s->match_left > 0) { /* go on copying the match */
+      num_copy = (s->match_left < (int)(end - pos)) ? s->match_left : (int)(end - pos);
+      s->match_left -= num_copy;
+      from = (pos - s->match_dist) & (MFS_LZ_WINDOW_SIZE - 1);
+      while (num_copy > 0) {
+	window[pos++] = window[from];
+	from = (from + 1) & (MFS_LZ_WINDOW_SIZE - 1);
+	num_copy--;
+      }
+      continue;
+    }
+    if (s->flags == 1) { /* all 8 items of the last flag byte done */
+      if ((c = lz_byte(fd, s, &in)) < 0)
+	break;
+      s->flags = c | 0x100;
+    }
+    if (s->flags & 1) { /* a literal */
+      if ((c = lz_byte(fd, s, &in)) < 0)
+	break;
+      window[pos++] = c;
+    }
+    else { /* a match */
+      if ((c = lz_byte(fd, s, &in)) < 0 || (b1 = lz_byte(fd, s, &in)) < 0)
+	break;
+      s->match_dist = (((b1 >> 4) << 8) | c) + 1;
+      s->match_left = (b1 & 15) + MFS_LZ_MIN_MATCH;
+    }
+    s->flags >>= 1;
+  }
+  num_copy = pos - s->out_pos;
+  s->out_pos = pos & (MFS_LZ_WINDOW_SIZE - 1);
+  s->out_total += num_copy;
+  return num_copy;
+}
+
+/**
+ * read from a compressed file, see mfs_file_read
+ */
+static int lz_read(int fd, char *buf, int buflen) {
+  struct mfs_lz_stream *s = &mfs_lz_streams[mfs_open_files[fd].lz_stream];
+  const unsigned char *data;
+  int num_read = 0;
+  int num_copy;
+  while (buflen > 0) {
+    data = &s->window[s->out_pos];
+    num_copy = lz_decode(fd, buflen);
+    if (num_copy == 0)
+      break;
+    memcpy(buf, data, num_copy);
+    buf += num_copy;
+    num_read += num_copy;
+    buflen -= num_copy;
+  }
+  return num_read;
+}
+
+/**
+ * move the position of a compressed file, decompressing from the
+ * beginning of the file when the new position is behind
+ * @param fd should be a valid file descriptor for a compressed file with a stream
+ * @param offset is the new position, at most the size of the file
+ * @return offset, or -1 if the file is shorter
+ */
+static long lz_seek(int fd, long offset) {
+  struct mfs_lz_stream *s = &mfs_lz_streams[mfs_open_files[fd].lz_stream];
+  if (offset < s->out_total)
+    lz_rewind(fd);
+  while (s->out_total < offset) {
+    if (lz_decode(fd, offset - s->out_total) == 0)
+      return -1;
+  }
+  return offset;
+}
+#endif
+
+/**
+ * give an open compressed file a stream to decompress it with
+ * a stream is free when no open file uses it
+ * @param fd should be a valid file descriptor for a compressed file
+ * @return 1 on success, 0 if the file is not open for reading or all
+ * streams are in use
+ */
+static int lz_open(int fd) {
+#if MFS_LZ_STREAMS > 0
+  int stream;
+  int i;
+  if (mfs_open_files[fd].mode != MFS_MODE_READ)
+    return 0;
+  for (stream = 0; stream < MFS_LZ_STREAMS; stream++) {
+    for (i = 0; i < MFS_MAX_OPEN_FILES; i++) {
+      if (mfs_open_files[i].mode != MFS_MODE_FREE && mfs_open_files[i].lz_stream == stream)
+	break;
+    }
+    if (i == MFS_MAX_OPEN_FILES) {
+      mfs_open_files[fd].lz_stream = stream;
+      lz_rewind(fd);
+      return 1;
+    }
+  }
+#else
+  (void)fd;
+#endif
+  return 0;
+}
+
 /**
  * read characters to a file
  * @param fd is a descriptor for the file from which the characters are read
@@ -870,40 +1984,173 @@ int mfs_file_open(const char *filename, int mode) {
  * if fewer than buflen chars are available then only that many chars are read
  * @return num bytes read or 0 for error=no bytes read
 */
-int mfs_file_read(int fd, char *buf, int buflen) {
+static int file_read(int fd, char *buf, int buflen) {
   int num_read = 0;
-  char *from_ptr = (char *) &(mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset]);
   int num_left ;
-  num_left =  mfs_file_system[mfs_open_files[fd].current_block].block_size ;
+  int num_copy;
+  const struct mfs_file_block *block;
+#if MFS_LZ_STREAMS > 0
+  if (mfs_open_files[fd].lz_stream >= 0)
+    return lz_read(fd, buf, buflen);
+#endif
+  block = read_block(mfs_open_files[fd].current_block);
+  num_left =  block->block_size ;
   if (num_left > MFS_BLOCK_DATA_SIZE)
     num_left = MFS_BLOCK_DATA_SIZE;
   num_left -=  mfs_open_files[fd].offset ;
   while (buflen > 0) {
-    if (num_left == 0) { /* see if there is a next_block */
-      int next_block = mfs_file_system[mfs_open_files[fd].current_block].next_block;
+    if (num_left <= 0) { /* see if there is a next_block */
+      int next_block = block->next_block;
       if (next_block == 0) { /* nothing more to read */
 	break;
       }
-      if (mfs_file_system[next_block].block_size == 0) { /* nothing more to read */
+      block = read_block(next_block);
+      if (block->block_size == 0) { /* nothing more to read */
 	break;
       }
-      from_ptr = (char *) &(mfs_file_system[next_block].u.block_data[0]);
-      num_left = mfs_file_system[next_block].block_size;
+      num_left = block->block_size;
       mfs_open_files[fd].current_block = next_block;
       mfs_open_files[fd].offset = 0;
+      mfs_open_files[fd].block_num += 1;
     }
-   
-    *buf = *from_ptr;
-    buf++;
-    from_ptr++;
-    mfs_open_files[fd].offset += 1;
-    num_read++;
-    num_left--;
-    buflen--;
+
+    /* copy everything wanted from this block in one go */
+    num_copy = (buflen < num_left) ? buflen : num_left;
+    memcpy(buf, &block->u.block_data[mfs_open_files[fd].offset], num_copy);
+    mfs_open_files[fd].offset += num_copy;
+    buf += num_copy;
+    num_read += num_copy;
+    num_left -= num_copy;
+    buflen -= num_copy;
   }
   return num_read;
 }
 
+int mfs_file_read(int fd, char *buf, int buflen) {
+  int num_read;
+  MFS_STATS_CALL(MFS_CALL_READ, num_read, file_read(fd, buf, buflen));
+  MFS_STATS_ADD(num_bytes_read, num_read);
+  return num_read;
+}
+
+/**
+ * number of file data bytes in a block from a given offset on
+ * the first block of a file holds the size of the whole file, the
+ * other blocks hold the number of bytes in the block
+ * @param block is the index of a file block
+ * @param offset is the offset within the block
+ * @return the number of bytes, or a value <= 0 if there are none
+ */
+static int block_data_left(int block, int offset) {
+  int num_left = mfs_file_system[block].block_size;
+  if (num_left > MFS_BLOCK_DATA_SIZE)
+    num_left = MFS_BLOCK_DATA_SIZE;
+  return num_left - offset;
+}
+
+/**
+ * map the file data at the current position of an open file
+ * meant for file systems initialized with MFSINIT_ROM_IMAGE, where the
+ * contents can be used in place instead of being copied by mfs_file_read
+ * file data is contiguous within each block, so a call maps the rest of
+ * the current block and moves the file position past it; repeated calls
+ * walk the whole file one extent at a time
+ * @param fd is a descriptor for the file
+ * @param data is set to the first byte of the extent
+ * @return length of the extent, 0 at end of file, -1 if fd is not an open file
+ * the data stays valid until the file is written to or deleted; the data
+ * of a compressed file is decompressed into the window of its stream and
+ * stays valid until the next read, map or seek on fd, and with the block
+ * cache on (see mfs_set_block_cache) data is in the cache and stays valid
+ * until the next read or map
+ */
+static int file_map(int fd, const char **data) {
+  const struct mfs_file_block *block;
+  int next_block;
+  int num_left;
+  if (fd <0 || fd >= MFS_MAX_OPEN_FILES || mfs_open_files[fd].mode == MFS_MODE_FREE)
+    return -1;
+  if (mfs_file_system[mfs_open_files[fd].first_block].block_type != MFS_BLOCK_TYPE_FILE)
+    return -1;
+#if MFS_LZ_STREAMS > 0
+  if (mfs_open_files[fd].lz_stream >= 0) { /* decompress the next bytes */
+    struct mfs_lz_stream *s = &mfs_lz_streams[mfs_open_files[fd].lz_stream];
+    *data = (const char *) &(s->window[s->out_pos]);
+    return lz_decode(fd, MFS_LZ_WINDOW_SIZE);
+  }
+#endif
+  block = read_block(mfs_open_files[fd].current_block);
+  num_left = block->block_size;
+  if (num_left > MFS_BLOCK_DATA_SIZE)
+    num_left = MFS_BLOCK_DATA_SIZE;
+  num_left -= mfs_open_files[fd].offset;
+  if (num_left <= 0) { /* see if there is a next_block */
+    next_block = block->next_block;
+    if (next_block == 0)
+      return 0;
+    block = read_block(next_block);
+    if (block->block_size == 0) /* nothing more to read */
+      return 0;
+    mfs_open_files[fd].current_block = next_block;
+    mfs_open_files[fd].offset = 0;
+    mfs_open_files[fd].block_num += 1;
+    num_left = block->block_size;
+  }
+  *data = (const char *) &(block->u.block_data[mfs_open_files[fd].offset]);
+  mfs_open_files[fd].offset += num_left;
+  return num_left;
+}
+
+int mfs_file_map(int fd, const char **data) {
+  int length;
+  MFS_STATS_CALL(MFS_CALL_MAP, length, file_map(fd, data));
+  if (length > 0)
+    MFS_STATS_ADD(num_bytes_mapped, length);
+  return length;
+}
+
+/**
+ * get the extents of an open file from its current position to the end
+ * of the file, without moving the position
+ * a file that fits in one block has a single extent, so the whole file
+ * is then at extents[0].data
+ * @param fd is a descriptor for the file
+ * @param extents is an array of at least max_extents entries, filled in file order
+ * @param max_extents is the number of entries in extents
+ * @return the number of extents left in the file, which may be more than
+ * max_extents, or -1 if fd is not an open file or is a compressed file
+ */
+int mfs_file_get_extents(int fd, struct mfs_extent *extents, int max_extents) {
+  int block;
+  int offset;
+  int num_left;
+  int num_extents = 0;
+  if (fd <0 || fd >= MFS_MAX_OPEN_FILES || mfs_open_files[fd].mode == MFS_MODE_FREE)
+    return -1;
+  if (mfs_file_system[mfs_open_files[fd].first_block].block_type != MFS_BLOCK_TYPE_FILE)
+    return -1;
+  if (mfs_open_files[fd].lz_stream >= 0) /* not in place */
+    return -1;
+  block = mfs_open_files[fd].current_block;
+  offset = mfs_open_files[fd].offset;
+  num_left = block_data_left(block, offset);
+  while (1) {
+    if (num_left > 0) {
+      if (num_extents < max_extents) {
+        extents[num_extents].data = (const char *) &(mfs_file_system[block].u.block_data[offset]);
+        extents[num_extents].length = num_left;
+      }
+      num_extents++;
+    }
+    block = mfs_file_system[block].next_block;
+    if (block == 0 || mfs_file_system[block].block_size == 0) /* nothing more to read */
+      break;
+    offset = 0;
+    num_left = mfs_file_system[block].block_size;
+  }
+  return num_extents;
+}
+
 /**
  * write characters to a file
  * @param fd is a descriptor for the file to which the characters are written
@@ -914,15 +2161,21 @@ int mfs_file_read(int fd, char *buf, int buflen) {
  * buflen chars are read from buf and written to 1 or more blocks of the file
  * @return 1 for success or 0 for error=unable to write to file
 */ 
-int mfs_file_write (int fd, const char *buf, int buflen) {
-  char *to_ptr = (char *) &(mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset]);
+static int file_write(int fd, const char *buf, int buflen) {
   int num_left = MFS_BLOCK_DATA_SIZE - mfs_open_files[fd].offset;
+  int num_copy;
 
   while (buflen > 0) {
     if (num_left == 0) { /* create next_block */
-      int new_block;
+      int new_block = mfs_file_system[mfs_open_files[fd].current_block].next_block;
+      if (new_block != 0 && mfs_file_system[new_block].block_size == 0) {
+	/* move on to a block set aside by mfs_file_reserve */
+	mfs_open_files[fd].current_block = new_block;
+	mfs_open_files[fd].offset = 0;
+	mfs_open_files[fd].block_num += 1;
+      }
       /* create a new file block linked from this one */
-      if (get_next_free_block(&new_block)) { /* found a free block */
+      else if (alloc_block(mfs_open_files[fd].current_block + 1, MFS_ALLOC_RUN, &new_block)) { /* found a free block */
 	mfs_file_system[new_block].prev_block = mfs_open_files[fd].current_block;
 	mfs_file_system[new_block].next_block = 0;
 	mfs_file_system[new_block].block_type = MFS_BLOCK_TYPE_FILE;
@@ -930,29 +2183,102 @@ int mfs_file_write (int fd, const char *buf, int buflen) {
 	mfs_file_system[mfs_open_files[fd].current_block].next_block = new_block;
 	mfs_open_files[fd].current_block = new_block;
 	mfs_open_files[fd].offset = 0;
+	mfs_open_files[fd].block_num += 1;
       }
       else { /* no space for new block  - return failure */
 	return 0;
       }
      
-      to_ptr = (char *) &(mfs_file_system[new_block].u.block_data[0]);
       num_left = MFS_BLOCK_DATA_SIZE;
     }
 
-    *to_ptr = *buf;
-    buf++;
-    to_ptr++;
-    mfs_open_files[fd].offset += 1;
-    num_left--;
-    mfs_file_system[mfs_open_files[fd].current_block].block_size +=1;
+    /* copy everything that fits in this block in one go */
+    num_copy = (buflen < num_left) ? buflen : num_left;
+    memcpy(&mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset], buf, num_copy);
+    buf += num_copy;
+    mfs_open_files[fd].offset += num_copy;
+    num_left -= num_copy;
+    mfs_file_system[mfs_open_files[fd].current_block].block_size += num_copy;
     if (mfs_open_files[fd].current_block != mfs_open_files[fd].first_block)
-      mfs_file_system[mfs_open_files[fd].first_block].block_size += 1;
-    buflen--;
+      mfs_file_system[mfs_open_files[fd].first_block].block_size += num_copy;
+    buflen -= num_copy;
+  }
+  return 1;
+}
 
+int mfs_file_write (int fd, const char *buf, int buflen) {
+  int written;
+  MFS_STATS_CALL(MFS_CALL_WRITE, written, file_write(fd, buf, buflen));
+  if (written)
+    MFS_STATS_ADD(num_bytes_written, buflen);
+  return written;
+}
+
+/**
+ * reserve blocks for a file open for writing
+ * the blocks are linked after the current block with a block_size of 0,
+ * which readers take as the end of the file, and mfs_file_write moves on
+ * to them instead of allocating new ones
+ * @param fd is a descriptor for the file
+ * @param size is the number of bytes that will be written
+ * @return 1 for success or 0 if fd is not open for writing, file data
+ * follows the current block or the file system is full
+ */
+int mfs_file_reserve(int fd, int size) {
+  int block;
+  int next_block;
+  long room;
+  if (fd <0 || fd >= MFS_MAX_OPEN_FILES || mfs_open_files[fd].mode != MFS_MODE_WRITE)
+    return 0;
+  block = mfs_open_files[fd].current_block;
+  room = MFS_BLOCK_DATA_SIZE - mfs_open_files[fd].offset;
+  /* count the blocks already reserved */
+  while ((next_block = mfs_file_system[block].next_block) != 0) {
+    if (mfs_file_system[next_block].block_size != 0) /* file data */
+      return 0;
+    block = next_block;
+    room += MFS_BLOCK_DATA_SIZE;
+  }
+  while (room < size) {
+    if (!alloc_block(block + 1, (int)((size - room + MFS_BLOCK_DATA_SIZE - 1) / MFS_BLOCK_DATA_SIZE), &next_block))
+      return 0; /* the blocks reserved so far are freed at close */
+    mfs_file_system[next_block].prev_block = block;
+    mfs_file_system[next_block].next_block = 0;
+    mfs_file_system[next_block].block_type = MFS_BLOCK_TYPE_FILE;
+    mfs_file_system[next_block].block_size = 0;
+    mfs_file_system[block].next_block = next_block;
+    block = next_block;
+    room += MFS_BLOCK_DATA_SIZE;
   }
   return 1;
 }
 
+/**
+ * free the blocks reserved for a file and not written to
+ * @param fd is a descriptor for a file open for writing
+ */
+static void free_reserved_blocks(int fd) {
+  int block = mfs_open_files[fd].current_block;
+  int next_block;
+  int last_block;
+  /* data blocks have a block_size; the reserved ones come after them */
+  while ((next_block = mfs_file_system[block].next_block) != 0 &&
+         mfs_file_system[next_block].block_size != 0)
+    block = next_block;
+  if (next_block == 0)
+    return;
+  mfs_file_system[block].next_block = 0;
+  mfs_file_system[next_block].prev_block = 0;
+  last_block = next_block;
+  while (1) {
+    mfs_file_system[last_block].block_type = MFS_BLOCK_TYPE_EMPTY;
+    if (mfs_file_system[last_block].next_block == 0)
+      break;
+    last_block = mfs_file_system[last_block].next_block;
+  }
+  move_to_free_list(next_block, last_block);
+}
+
 /**
  * close an open file and
  * recover the file table entry in mfs_open_files corresponding to the fd
@@ -962,10 +2288,12 @@ int mfs_file_write (int fd, const char *buf, int buflen) {
  * @param fd is the file descriptor for the file to be closed
  * @return 1 on success, 0 otherwise
  */
-int mfs_file_close(int fd) {
+static int file_close(int fd) {
   if (fd <0 || fd >= MFS_MAX_OPEN_FILES)
     return 0;
   if (mfs_open_files[fd].mode != MFS_MODE_FREE) {
+    if (mfs_open_files[fd].mode == MFS_MODE_WRITE)
+      free_reserved_blocks(fd);
     mfs_open_files[fd].mode = MFS_MODE_FREE;
     mfs_num_open_files--;
     return 1;
@@ -973,6 +2301,128 @@ int mfs_file_close(int fd) {
   return 0;
 }
 
+int mfs_file_close(int fd) {
+  int closed;
+  MFS_STATS_CALL(MFS_CALL_CLOSE, closed, file_close(fd));
+  return closed;
+}
+
+#if MFS_BLOCK_INDEX_POOL_SIZE > 0
+/**
+ * find room in mfs_block_index_pool for a block index table
+ * the tables of the files open with MFS_INDEX_TABLE are in use,
+ * everything else is free
+ * @param num_entries is the number of entries needed
+ * @return the first entry of the room, or -1 if there is none
+ */
+static int alloc_block_index(unsigned int num_entries) {
+  unsigned int start = 0;
+  int moved = 1;
+  int i;
+  while (moved) {
+    moved = 0;
+    if (start + num_entries > MFS_BLOCK_INDEX_POOL_SIZE)
+      return -1;
+    for (i = 0; i < MFS_MAX_OPEN_FILES; i++) {
+      if (mfs_open_files[i].mode != MFS_MODE_FREE &&
+          mfs_open_files[i].index_type == MFS_INDEX_TABLE &&
+          start < mfs_open_files[i].index_start + mfs_open_files[i].num_indexed &&
+          mfs_open_files[i].index_start < start + num_entries) {
+        /* overlaps a table in use - try after it */
+        start = mfs_open_files[i].index_start + mfs_open_files[i].num_indexed;
+        moved = 1;
+      }
+    }
+  }
+  return start;
+}
+#endif
+
+/**
+ * build the block index of an open file
+ * only files open for reading are indexed, since writes change their
+ * list of blocks; the others are walked
+ * @param fd should be a valid file descriptor for an open file
+ */
+static void build_block_index(int fd) {
+  int block = mfs_open_files[fd].first_block;
+  int next_block;
+  unsigned int num_blocks = 1;
+  int contiguous = 1;
+#if MFS_BLOCK_INDEX_POOL_SIZE > 0
+  unsigned int i;
+  int start;
+#endif
+
+  mfs_open_files[fd].index_type = MFS_INDEX_WALK;
+  mfs_open_files[fd].num_indexed = 0;
+  if (mfs_open_files[fd].mode != MFS_MODE_READ)
+    return;
+  while ((next_block = mfs_file_system[block].next_block) != 0) {
+    if (next_block != block + 1)
+      contiguous = 0;
+    block = next_block;
+    num_blocks++;
+  }
+  MFS_STATS_ADD(num_seek_blocks, num_blocks);
+  if (contiguous) { /* block n of the file is first_block + n */
+    mfs_open_files[fd].index_type = MFS_INDEX_CONTIGUOUS;
+    mfs_open_files[fd].num_indexed = num_blocks;
+    return;
+  }
+#if MFS_BLOCK_INDEX_POOL_SIZE > 0
+  start = alloc_block_index(num_blocks);
+  if (start < 0) /* no room, keep walking */
+    return;
+  block = mfs_open_files[fd].first_block;
+  for (i = 0; i < num_blocks; i++) {
+    mfs_block_index_pool[start + i] = block;
+    block = mfs_file_system[block].next_block;
+  }
+  mfs_open_files[fd].index_type = MFS_INDEX_TABLE;
+  mfs_open_files[fd].index_start = start;
+  mfs_open_files[fd].num_indexed = num_blocks;
+#endif
+}
+
+/**
+ * get a block of an open file by its number within the file
+ * the block index is built the first time it is needed; blocks it does
+ * not cover are found by walking next_block from the current block, or
+ * from the first block if the wanted one is behind
+ * @param fd should be a valid file descriptor for an open file
+ * @param block_num is the number of the block within the file, from 0
+ * @return index of the block, or 0 if the file has fewer blocks
+ */
+static int get_file_block(int fd, unsigned int block_num) {
+  int block;
+  unsigned int num;
+  if (mfs_open_files[fd].index_type == MFS_INDEX_NONE)
+    build_block_index(fd);
+  if (block_num < mfs_open_files[fd].num_indexed) {
+    if (mfs_open_files[fd].index_type == MFS_INDEX_CONTIGUOUS)
+      return mfs_open_files[fd].first_block + block_num;
+#if MFS_BLOCK_INDEX_POOL_SIZE > 0
+    if (mfs_open_files[fd].index_type == MFS_INDEX_TABLE)
+      return mfs_block_index_pool[mfs_open_files[fd].index_start + block_num];
+#endif
+  }
+  if (block_num >= mfs_open_files[fd].block_num) {
+    block = mfs_open_files[fd].current_block;
+    num = mfs_open_files[fd].block_num;
+  }
+  else {
+    block = mfs_open_files[fd].first_block;
+    num = 0;
+  }
+  while (num < block_num && block != 0) {
+    block = mfs_file_system[block].next_block;
+    MFS_STATS_ADD(num_seek_blocks, 1);
+    num++;
+  }
+  return block;
+}
+
 /**
  * seek to a given offset within the file
  * @param fd should be a valid file descriptor for an open file
@@ -981,23 +2431,26 @@ int mfs_file_close(int fd) {
  * if MFS_SEEK_END is specified, the offset can be either 0 or negative
  * otherwise offset should be positive or 0
  * it is an error to seek before beginning of file or after the end of file
+ * the block is found through the block index of the file, so the cost
+ * does not depend on the offset for files open for reading; compressed
+ * files are decompressed up to the offset, from the beginning if it is behind
  * @return -1 on failure, value of offset from beginning of file on success
  */
-long mfs_file_lseek(int fd, long offset, int whence) {
-  long local_offset;
-  int local_block;
+static long file_lseek(int fd, long offset, int whence) {
+  int block;
   if (fd <0 || fd >= MFS_MAX_OPEN_FILES || mfs_open_files[fd].mode == MFS_MODE_FREE)
     return -1;
+#if MFS_LZ_STREAMS > 0
+  if (mfs_open_files[fd].lz_stream >= 0 && whence == MFS_SEEK_CUR) {
+    offset += mfs_lz_streams[mfs_open_files[fd].lz_stream].out_total;
+    whence = MFS_SEEK_SET;
+  }
+#endif
   /* calculate value of offset from the beginning of the file */
   if (whence == MFS_SEEK_SET || whence == MFS_SEEK_CUR) {
     if (whence == MFS_SEEK_CUR) {
-      /* add the size of all the previous blocks if any */
-      local_block = mfs_open_files[fd].first_block;
-      while (mfs_open_files[fd].current_block != local_block) {
-        local_block = mfs_file_system[local_block].next_block;
-        offset += MFS_BLOCK_DATA_SIZE;
-      }
-      /* add the offset within the current block */
+      /* add the offset of the current block and the offset within it */
+      offset += (long)mfs_open_files[fd].block_num * MFS_BLOCK_DATA_SIZE;
       offset += mfs_open_files[fd].offset;
     } else {
       /* nothing to do here - offset is already calculated from the beginning of the file */
@@ -1017,23 +2470,72 @@ long mfs_file_lseek(int fd, long offset, int whence) {
       offset += mfs_file_system[mfs_open_files[fd].first_block].block_size;
     }
   }
+  if (offset < 0) { /* attempting to seek before beginning of file */
+    return -1;
+  }
   /* at this point offset is a positive value, guaranteed to be within the file 
    */
-  local_offset = offset;
-  local_block = mfs_open_files[fd].first_block;
-  while(local_offset >= MFS_BLOCK_DATA_SIZE) {
-    local_block = mfs_file_system[local_block].next_block;
-    local_offset -= MFS_BLOCK_DATA_SIZE;
-  }
-  mfs_open_files[fd].current_block = local_block;
-  mfs_open_files[fd].offset = local_offset;
+#if MFS_LZ_STREAMS > 0
+  if (mfs_open_files[fd].lz_stream >= 0)
+    return lz_seek(fd, offset);
+#endif
+  block = get_file_block(fd, offset / MFS_BLOCK_DATA_SIZE);
+  if (block == 0) {
+    return -1;
+  }
+  mfs_open_files[fd].current_block = block;
+  mfs_open_files[fd].offset = offset % MFS_BLOCK_DATA_SIZE;
+  mfs_open_files[fd].block_num = offset / MFS_BLOCK_DATA_SIZE;
   return offset;
 }
 
+long mfs_file_lseek(int fd, long offset, int whence) {
+  long position;
+  MFS_STATS_CALL(MFS_CALL_LSEEK, position, file_lseek(fd, offset, whence));
+  return position;
+}
 
+/**
+ * read characters from a given offset of a file
+ * the file position is not changed
+ * @param fd is a descriptor for the file from which the characters are read
+ * @param buf is a pre allocated buffer that will contain the read characters
+ * @param buflen is the number of characters to be read
+ * @param offset is the offset from the beginning of the file
+ * @return num bytes read or 0 for error=no bytes read
+ */
+static int file_pread(int fd, char *buf, int buflen, long offset) {
+  unsigned int current_block;
+  unsigned short block_offset;
+  unsigned int block_num;
+  int num_read;
+  if (fd <0 || fd >= MFS_MAX_OPEN_FILES || mfs_open_files[fd].mode == MFS_MODE_FREE)
+    return 0;
+#if MFS_LZ_STREAMS > 0
+  if (mfs_open_files[fd].lz_stream >= 0) { /* seek there and back */
+    long position = mfs_lz_streams[mfs_open_files[fd].lz_stream].out_total;
+    num_read = 0;
+    if (mfs_file_lseek(fd, offset, MFS_SEEK_SET) >= 0)
+      num_read = mfs_file_read(fd, buf, buflen);
+    lz_seek(fd, position);
+    return num_read;
+  }
+#endif
+  current_block = mfs_open_files[fd].current_block;
+  block_offset = mfs_open_files[fd].offset;
+  block_num = mfs_open_files[fd].block_num;
+  num_read = 0;
+  if (mfs_file_lseek(fd, offset, MFS_SEEK_SET) >= 0)
+    num_read = mfs_file_read(fd, buf, buflen);
+  mfs_open_files[fd].current_block = current_block;
+  mfs_open_files[fd].offset = block_offset;
+  mfs_open_files[fd].block_num = block_num;
+  return num_read;
+}
 
-
-
-
-
+int mfs_file_pread(int fd, char *buf, int buflen, long offset) {
+  int num_read;
+  MFS_STATS_CALL(MFS_CALL_PREAD, num_read, file_pread(fd, buf, buflen, offset));
+  return num_read;
+}
 
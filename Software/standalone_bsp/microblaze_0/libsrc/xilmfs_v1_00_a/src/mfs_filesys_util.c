@@ -185,6 +185,8 @@ int mfs_file_copy(char *from_file, char *to_file) {
     mfs_file_close(fdw);
     return 0;
   }
+  /* the size is known, so keep the copy in consecutive blocks */
+  mfs_file_reserve(fdw, mfs_file_lseek(fdr, 0, MFS_SEEK_END));
   while((tmp= mfs_file_read(fdr, buf2, 512))== 512){
     mfs_file_write(fdw, buf2, 512);
   }
@@ -217,3 +219,34 @@ int mfs_file_copy(char *from_file, char *to_file) {
 
 
 
+
+/**
+ * print the counts of mfs_get_stats to stdout, the UART on the board
+ * @return 1 on success, 0 if MFS_STATS is 0
+ */
+int mfs_print_stats(void) {
+  static const char *call_names[MFS_NUM_CALLS] = {
+    "open", "close", "read", "write", "lseek", "pread", "map", "exists", "delete"
+  };
+  struct mfs_stats stats;
+  int i;
+  if (!mfs_get_stats(&stats))
+    return 0;
+  printf("dir lookups %lu, by index %lu, entries scanned %lu\r\n",
+         stats.num_dir_lookups, stats.num_dir_hash_answers, stats.num_dir_ents_scanned);
+  printf("seek blocks walked %lu\r\n", stats.num_seek_blocks);
+  printf("bytes read %lu, mapped %lu, written %lu\r\n",
+         stats.num_bytes_read, stats.num_bytes_mapped, stats.num_bytes_written);
+  printf("blocks allocated %lu, off goal %lu, freed %lu\r\n",
+         stats.num_blocks_allocated, stats.num_blocks_off_goal, stats.num_blocks_freed);
+  printf("opens %lu, refused %lu, most open %d of %d\r\n",
+         stats.num_opens, stats.num_opens_full, stats.max_open_files, MFS_MAX_OPEN_FILES);
+  printf("call        calls      cycles  max cycles\r\n");
+  for (i = 0; i < MFS_NUM_CALLS; i++) {
+    if (stats.calls[i].num_calls == 0)
+      continue;
+    printf("%-6s %10lu  %10lu  %10lu\r\n", call_names[i], stats.calls[i].num_calls,
+           stats.calls[i].cycles, stats.calls[i].max_cycles);
+  }
+  return 1;
+}
@@ -0,0 +1,166 @@
+/////////////////////////////////////////////////////////////////////////-*-C-*-
+//
+// Copyright (c) 2002, 2003 Xilinx, Inc.  All rights reserved.
+//
+// Xilinx, Inc.
+//
+// XILINX IS PROVIDING THIS DESIGN, CODE, OR INFORMATION "AS IS" AS A
+// COURTESY TO YOU.  BY PROVIDING THIS DESIGN, CODE, OR INFORMATION AS
+// ONE POSSIBLE   IMPLEMENTATION OF THIS FEATURE, APPLICATION OR
+// STANDARD, XILINX IS MAKING NO REPRESENTATION THAT THIS IMPLEMENTATION
+// IS FREE FROM ANY CLAIMS OF INFRINGEMENT, AND YOU ARE RESPONSIBLE
+// FOR OBTAINING ANY RIGHTS YOU MAY REQUIRE FOR YOUR IMPLEMENTATION.
+// XILINX EXPRESSLY DISCLAIMS ANY WARRANTY WHATSOEVER WITH RESPECT TO
+// THE ADEQUACY OF THE IMPLEMENTATION, INCLUDING BUT NOT LIMITED TO
+// ANY WARRANTIES OR REPRESENTATIONS THAT THIS IMPLEMENTATION IS FREE
+// FROM CLAIMS OF INFRINGEMENT, IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// File   : mfs_stdio.c
+//
+// Description :
+// stdio streams over Memory File System files, made with fopencookie()
+// of newlib (and glibc, for host based testing)
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "xilmfs.h"
+#include "mfs_stdio.h"
+
+/* the offset type of the seek function of fopencookie: newlib only takes
+   a 64 bit one when built with __LARGE64_FILES */
+#if defined(__GLIBC__)
+typedef __off64_t mfs_stdio_off_t;
+#elif defined(__LARGE64_FILES)
+typedef _off64_t mfs_stdio_off_t;
+#else
+typedef off_t mfs_stdio_off_t;
+#endif
+
+/* what the functions of a stream get as their cookie */
+struct mfs_stdio_cookie {
+  int fd; /* the MFS file */
+  int buffer; /* the buffer of the pool it uses, or -1 */
+};
+
+static struct mfs_stdio_cookie mfs_stdio_cookies[MFS_MAX_OPEN_FILES]; /* by fd */
+#if MFS_STDIO_BUFFERS > 0
+static unsigned int mfs_stdio_buffers[MFS_STDIO_BUFFERS][MFS_STDIO_BUFFER_SIZE / sizeof(unsigned int)];
+static int mfs_stdio_buffer_used[MFS_STDIO_BUFFERS];
+#endif
+
+/**
+ * stdio refills its buffer, or reads a large request straight to the
+ * caller, through this; the file data is copied once, to buf
+ */
+static ssize_t mfs_stdio_read(void *cookie, char *buf, size_t size) {
+  struct mfs_stdio_cookie *c = (struct mfs_stdio_cookie *)cookie;
+  return mfs_file_read(c->fd, buf, (int)size);
+}
+
+static ssize_t mfs_stdio_write(void *cookie, const char *buf, size_t size) {
+  struct mfs_stdio_cookie *c = (struct mfs_stdio_cookie *)cookie;
+  if (!mfs_file_write(c->fd, buf, (int)size))
+    return -1;
+  return size;
+}
+
+/**
+ * mfs_file_lseek cannot seek to the end of a file, one past its last byte,
+ * and answers a seek of 0 from the end with the size only, so the end is
+ * reached by seeking to the last byte and reading it
+ */
+static int mfs_stdio_seek(void *cookie, mfs_stdio_off_t *offset, int whence) {
+  struct mfs_stdio_cookie *c = (struct mfs_stdio_cookie *)cookie;
+  long size, current, position;
+  char last;
+  size = mfs_file_lseek(c->fd, 0, MFS_SEEK_END);
+  if (size < 0)
+    return -1;
+  current = mfs_file_lseek(c->fd, 0, MFS_SEEK_CUR);
+  if (current < 0) /* at the end of the file */
+    current = size;
+  if (whence == SEEK_SET)
+    position = (long)*offset;
+  else if (whence == SEEK_CUR)
+    position = current + (long)*offset;
+  else
+    position = size + (long)*offset;
+  if (position < 0 || position > size)
+    return -1;
+  if (position != current) {
+    if (position < size) {
+      if (mfs_file_lseek(c->fd, position, MFS_SEEK_SET) < 0)
+        return -1;
+    }
+    else if (mfs_file_lseek(c->fd, size - 1, MFS_SEEK_SET) < 0 ||
+             mfs_file_read(c->fd, &last, 1) != 1) {
+      return -1;
+    }
+  }
+  *offset = position;
+  return 0;
+}
+
+static int mfs_stdio_close(void *cookie) {
+  struct mfs_stdio_cookie *c = (struct mfs_stdio_cookie *)cookie;
+#if MFS_STDIO_BUFFERS > 0
+  if (c->buffer >= 0)
+    mfs_stdio_buffer_used[c->buffer] = 0;
+#endif
+  return mfs_file_close(c->fd) ? 0 : -1;
+}
+
+FILE *mfs_fopen(const char *filename, const char *mode) {
+  cookie_io_functions_t functions;
+  struct mfs_stdio_cookie *c;
+  FILE *stream;
+  int fd;
+#if MFS_STDIO_BUFFERS > 0
+  int i;
+#endif
+  if (mode[0] == 'r' && strchr(mode, '+') == NULL) {
+    fd = mfs_file_open(filename, MFS_MODE_READ);
+  }
+  else if (mode[0] == 'w' && strchr(mode, '+') == NULL) {
+    if (mfs_exists_file((char *)filename) == 1)
+      mfs_delete_file((char *)filename);
+    fd = mfs_file_open(filename, MFS_MODE_CREATE);
+  }
+  else {
+    return NULL;
+  }
+  if (fd < 0)
+    return NULL;
+  memset(&functions, 0, sizeof(functions));
+  if (mode[0] == 'r')
+    functions.read = mfs_stdio_read;
+  else
+    functions.write = mfs_stdio_write;
+  functions.seek = mfs_stdio_seek;
+  functions.close = mfs_stdio_close;
+  c = &mfs_stdio_cookies[fd];
+  c->fd = fd;
+  c->buffer = -1;
+  stream = fopencookie(c, mode, functions);
+  if (stream == NULL) {
+    mfs_file_close(fd);
+    return NULL;
+  }
+#if MFS_STDIO_BUFFERS > 0
+  for (i = 0; i < MFS_STDIO_BUFFERS; i++) {
+    if (!mfs_stdio_buffer_used[i]) {
+      if (setvbuf(stream, (char *)mfs_stdio_buffers[i], _IOFBF, MFS_STDIO_BUFFER_SIZE) == 0) {
+        mfs_stdio_buffer_used[i] = 1;
+        c->buffer = i;
+      }
+      break;
+    }
+  }
+#endif
+  return stream;
+}
@@ -0,0 +1,84 @@
+/////////////////////////////////////////////////////////////////////////-*-C-*-
+//
+// Copyright (c) 2002, 2003 Xilinx, Inc.  All rights reserved.
+//
+// Xilinx, Inc.
+//
+// XILINX IS PROVIDING THIS DESIGN, CODE, OR INFORMATION "AS IS" AS A
+// COURTESY TO YOU.  BY PROVIDING THIS DESIGN, CODE, OR INFORMATION AS
+// ONE POSSIBLE   IMPLEMENTATION OF THIS FEATURE, APPLICATION OR
+// STANDARD, XILINX IS MAKING NO REPRESENTATION THAT THIS IMPLEMENTATION
+// IS FREE FROM ANY CLAIMS OF INFRINGEMENT, AND YOU ARE RESPONSIBLE
+// FOR OBTAINING ANY RIGHTS YOU MAY REQUIRE FOR YOUR IMPLEMENTATION.
+// XILINX EXPRESSLY DISCLAIMS ANY WARRANTY WHATSOEVER WITH RESPECT TO
+// THE ADEQUACY OF THE IMPLEMENTATION, INCLUDING BUT NOT LIMITED TO
+// ANY WARRANTIES OR REPRESENTATIONS THAT THIS IMPLEMENTATION IS FREE
+// FROM CLAIMS OF INFRINGEMENT, IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Description :
+// Write benchmark to run on the board: a results log is written to a
+// RAM based file system, line by line and in 512 byte chunks, many times
+// over. The board has no timer, so each run is framed by a line on the
+// UART; time them with a terminal that timestamps its input and divide
+// the bytes written, printed at the end of each run, by the time.
+// Compare with a build of the previous mfs_filesys.c for the byte loop.
+//
+//          mb-gcc $OPTIONS benchmfs.c  mfs_filesys.c mfs_filesys_util.c -o benchmfs
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <string.h>
+#include "xilmfs.h"
+#include "xil_printf.h"
+
+char *fs = (char *)0x8E000000; /* DDR, above the application */
+#define NUMBLOCKS 2000
+/* times each log is written */
+#define RUNS 20
+
+static char line[600];
+
+/*
+ * write a log of NUMBLOCKS - 10 blocks of lines of chunk bytes, or of
+ * lines like the ones of the heartbeat sorter if chunk is 0
+ */
+static int write_log(int chunk) {
+  int numbytes = NUMBLOCKS * sizeof(struct mfs_file_block);
+  int size = (NUMBLOCKS - 10) * MFS_BLOCK_DATA_SIZE;
+  int pos;
+  int len;
+  int beat = 0;
+  int fd;
+  mfs_init_fs(numbytes, fs, MFSINIT_NEW);
+  fd = mfs_file_open("log", MFS_MODE_CREATE);
+  for (pos = 0; pos + 600 < size; pos += len) {
+    if (chunk > 0) {
+      len = chunk;
+    }
+    else {
+      len = sprintf(line, "beat %d class %d confidence 0.%03d\r\n", beat, beat % 4, (beat * 37) % 1000);
+      beat++;
+    }
+    if (!mfs_file_write(fd, line, len))
+      return -1;
+  }
+  mfs_file_close(fd);
+  return pos;
+}
+
+int main(int argc, char *argv[]) {
+  int i;
+  int run;
+  long total;
+  for (i = 0; i < (int)sizeof(line); i++)
+    line[i] = 'a' + i % 26;
+  for (i = 0; i < 2; i++) {
+    total = 0;
+    xil_printf("start %s\r\n", (i == 0) ? "log lines" : "512 byte writes");
+    for (run = 0; run < RUNS; run++)
+      total += write_log((i == 0) ? 0 : 512);
+    xil_printf("done %d bytes\r\n", (int)total);
+  }
+  return 0;
+}
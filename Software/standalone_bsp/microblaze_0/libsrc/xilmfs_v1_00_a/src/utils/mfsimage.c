@@ -0,0 +1,698 @@
+/////////////////////////////////////////////////////////////////////////-*-C-*-
+//
+// Copyright (c) 2002, 2003 Xilinx, Inc.  All rights reserved.
+//
+// Xilinx, Inc.
+//
+// XILINX IS PROVIDING THIS DESIGN, CODE, OR INFORMATION "AS IS" AS A
+// COURTESY TO YOU.  BY PROVIDING THIS DESIGN, CODE, OR INFORMATION AS
+// ONE POSSIBLE   IMPLEMENTATION OF THIS FEATURE, APPLICATION OR
+// STANDARD, XILINX IS MAKING NO REPRESENTATION THAT THIS IMPLEMENTATION
+// IS FREE FROM ANY CLAIMS OF INFRINGEMENT, AND YOU ARE RESPONSIBLE
+// FOR OBTAINING ANY RIGHTS YOU MAY REQUIRE FOR YOUR IMPLEMENTATION.
+// XILINX EXPRESSLY DISCLAIMS ANY WARRANTY WHATSOEVER WITH RESPECT TO
+// THE ADEQUACY OF THE IMPLEMENTATION, INCLUDING BUT NOT LIMITED TO
+// ANY WARRANTIES OR REPRESENTATIONS THAT THIS IMPLEMENTATION IS FREE
+// FROM CLAIMS OF INFRINGEMENT, IMPLIED WARRANTIES OF MERCHANTABILITY
+// AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Description :
+// Host tool that builds an MFS image for mfs_init_genimage, in place of
+// mfsgen -cvf. The files and directories given on the command line go
+// to the root directory of the image, directories with all they contain.
+//
+// The layout is chosen for reading:
+//  - all directories come first, root at block 0, each in consecutive blocks
+//  - then the files, each in consecutive blocks, in directory order, so
+//    that mfs_file_read, mfs_file_map and mfs_file_lseek take their
+//    contiguous paths (no block index table is needed for any file)
+//  - directory entries are sorted by name, and the number of entries is
+//    checked against MFS_DIR_HASH_SIZE so that lookups use the hashed
+//    index built at mount
+//  - block data is word aligned (it starts 24 + 532 * n bytes into the
+//    image) when the image is loaded at a word aligned address, which is
+//    what the word copies of mfs_file_read need
+//
+// With -z files are stored compressed (see MFS_LZ_STREAMS in xilmfs.h)
+// when that makes them smaller. They are read-only on the board, and are
+// decompressed as they are read. The library on the board and the one
+// mfsimage is built with both need MFS_LZ_STREAMS for that.
+//
+// The image is mounted with the library compiled natively and every file
+// is read back and compared before it is written out, in the byte order
+// of the target (big endian for the MicroBlaze unless -e little).
+//
+// usage: mfsimage [-o image.mfs] [-n num_blocks] [-e big|little] [-z]
+//                 [-i layout.txt] [-b runs] [-v] file_or_dir...
+//   -n   total blocks, for free blocks in an MFSINIT_IMAGE file system
+//   -i   write the layout of the image: first block, number of blocks,
+//        size, size stored and path of every file and directory
+//   -b   time reading every file of the image runs times, with
+//        mfs_file_read and with mfs_file_map, to compare the throughput
+//        of compressed and plain files
+//
+// Build it with the MFS_ flags of the library on the board (see
+// EXTRA_COMPILER_FLAGS in standalone_bsp/system.mss), so that the entries
+// are checked against the same hashed index:
+//
+//          gcc -O2 -DMFS_DIR_HASH_SIZE=64 -DMFS_LZ_STREAMS=1 -I.. mfsimage.c ../mfs_filesys.c -o mfsimage
+//
+////////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "xilmfs.h"
+
+#define NODE_DIR 1
+#define NODE_FILE 2
+
+struct node {
+  char name[MFS_MAX_FILENAME_LENGTH];
+  int type;
+  char *data; /* file contents */
+  long size;
+  char *stored; /* what goes in the blocks, data or data compressed */
+  long stored_size;
+  int compressed;
+  int first_block;
+  int num_blocks;
+  struct node *parent;
+  struct node **children; /* sorted by name */
+  int num_children;
+};
+
+static int verbose;
+static int compress;
+
+static void *xmalloc(size_t size) {
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) {
+    fprintf(stderr, "mfsimage: out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+static int compare_nodes(const void *a, const void *b) {
+  return strcmp((*(const struct node **)a)->name, (*(const struct node **)b)->name);
+}
+
+/* hash of the 3 bytes that start a match, for the compressor */
+#define LZ_HASH_SIZE 4096
+#define LZ_HASH(p) ((((p)[0] << 8) ^ ((p)[1] << 4) ^ (p)[2]) & (LZ_HASH_SIZE - 1))
+/* candidates tried for each match */
+#define LZ_MAX_CHAIN 256
+
+/**
+ * compress data into the LZSS stream that mfs_file_read decompresses;
+ * greedy, taking the longest match among the last LZ_MAX_CHAIN places
+ * with the same hash
+ * @param in is the data
+ * @param len is its length
+ * @param out has room for len + len / 8 + 1 bytes
+ * @return the length of the stream
+ */
+static long lz_compress(const unsigned char *in, long len, unsigned char *out) {
+  static long head[LZ_HASH_SIZE];
+  long *prev = xmalloc(len * sizeof(long));
+  long pos = 0;
+  long n = 0;
+  long flag_pos = 0;
+  int bit = 8;
+  long candidate;
+  long p;
+  int chain;
+  int best_len;
+  long best_dist = 0;
+  int max;
+  int i;
+  for (i = 0; i < LZ_HASH_SIZE; i++)
+    head[i] = -1;
+  while (pos < len) {
+    if (bit == 8) {
+      flag_pos = n++;
+      out[flag_pos] = 0;
+      bit = 0;
+    }
+    best_len = 0;
+    max = (len - pos < MFS_LZ_MAX_MATCH) ? (int)(len - pos) : MFS_LZ_MAX_MATCH;
+    if (max >= MFS_LZ_MIN_MATCH) {
+      candidate = head[LZ_HASH(in + pos)];
+      for (chain = 0; candidate >= 0 && pos - candidate <= MFS_LZ_WINDOW_SIZE && chain < LZ_MAX_CHAIN; chain++) {
+        for (i = 0; i < max && in[candidate + i] == in[pos + i]; i++)
+          ;
+        if (i > best_len) {
+          best_len = i;
+          best_dist = pos - candidate;
+          if (i == max)
+            break;
+        }
+        candidate = prev[candidate];
+      }
+    }
+    if (best_len >= MFS_LZ_MIN_MATCH) {
+      out[n++] = (best_dist - 1) & 0xff;
+      out[n++] = (((best_dist - 1) >> 8) << 4) | (best_len - MFS_LZ_MIN_MATCH);
+    }
+    else {
+      out[flag_pos] |= 1 << bit;
+      out[n++] = in[pos];
+      best_len = 1;
+    }
+    bit++;
+    for (p = pos; p < pos + best_len; p++) {
+      if (p + MFS_LZ_MIN_MATCH <= len) {
+        prev[p] = head[LZ_HASH(in + p)];
+        head[LZ_HASH(in + p)] = p;
+      }
+    }
+    pos += best_len;
+  }
+  free(prev);
+  return n;
+}
+
+/**
+ * read a file or directory of the host into a tree of nodes
+ * @return the node, or NULL on error (reported)
+ */
+static struct node *read_tree(const char *path, const char *name, struct node *parent) {
+  struct node *node;
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    perror(path);
+    return NULL;
+  }
+  if (strlen(name) >= MFS_MAX_FILENAME_LENGTH || strchr(name, '/') != NULL || name[0] == '\0') {
+    fprintf(stderr, "mfsimage: %s: names must be 1 to %d characters\n", path, MFS_MAX_FILENAME_LENGTH - 1);
+    return NULL;
+  }
+  node = xmalloc(sizeof(*node));
+  memset(node, 0, sizeof(*node));
+  strcpy(node->name, name);
+  node->parent = parent;
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path);
+    struct dirent *de;
+    int max_children = 16;
+    node->type = NODE_DIR;
+    node->children = xmalloc(max_children * sizeof(struct node *));
+    if (dir == NULL) {
+      perror(path);
+      return NULL;
+    }
+    while ((de = readdir(dir)) != NULL) {
+      char *child_path;
+      struct node *child;
+      if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+        continue;
+      child_path = xmalloc(strlen(path) + strlen(de->d_name) + 2);
+      sprintf(child_path, "%s/%s", path, de->d_name);
+      child = read_tree(child_path, de->d_name, node);
+      free(child_path);
+      if (child == NULL) {
+        closedir(dir);
+        return NULL;
+      }
+      if (node->num_children == max_children) {
+        max_children *= 2;
+        node->children = realloc(node->children, max_children * sizeof(struct node *));
+        if (node->children == NULL) {
+          fprintf(stderr, "mfsimage: out of memory\n");
+          exit(1);
+        }
+      }
+      node->children[node->num_children++] = child;
+    }
+    closedir(dir);
+    qsort(node->children, node->num_children, sizeof(struct node *), compare_nodes);
+  }
+  else {
+    FILE *f = fopen(path, "rb");
+    node->type = NODE_FILE;
+    node->size = st.st_size;
+    node->data = xmalloc(node->size);
+    if (f == NULL || fread(node->data, 1, node->size, f) != (size_t)node->size) {
+      perror(path);
+      return NULL;
+    }
+    fclose(f);
+    node->stored = node->data;
+    node->stored_size = node->size;
+    if (compress && node->size > 0) {
+      char *packed = xmalloc(node->size + node->size / 8 + 1);
+      long packed_size = lz_compress((unsigned char *)node->data, node->size, (unsigned char *)packed);
+      if (packed_size < node->size) {
+        node->stored = packed;
+        node->stored_size = packed_size;
+        node->compressed = 1;
+      }
+      else {
+        free(packed);
+      }
+    }
+  }
+  return node;
+}
+
+/**
+ * number of blocks a directory needs: its entries plus .. and .
+ */
+static int dir_blocks(const struct node *node) {
+  return (node->num_children + 2 + MFS_MAX_LOCAL_ENT - 1) / MFS_MAX_LOCAL_ENT;
+}
+
+/**
+ * give the directories their blocks, breadth first
+ */
+static int place_dirs(struct node *root, int next_block) {
+  struct node **queue;
+  int head = 0;
+  int tail = 0;
+  int max = 1;
+  int i;
+  queue = xmalloc(max * sizeof(struct node *));
+  queue[tail++] = root;
+  while (head < tail) {
+    struct node *node = queue[head++];
+    node->first_block = next_block;
+    node->num_blocks = dir_blocks(node);
+    next_block += node->num_blocks;
+    for (i = 0; i < node->num_children; i++) {
+      if (node->children[i]->type != NODE_DIR)
+        continue;
+      if (tail == max) {
+        max *= 2;
+        queue = realloc(queue, max * sizeof(struct node *));
+        if (queue == NULL) {
+          fprintf(stderr, "mfsimage: out of memory\n");
+          exit(1);
+        }
+      }
+      queue[tail++] = node->children[i];
+    }
+  }
+  free(queue);
+  return next_block;
+}
+
+/**
+ * give the files their blocks, depth first in directory order
+ */
+static int place_files(struct node *node, int next_block) {
+  int i;
+  for (i = 0; i < node->num_children; i++) {
+    struct node *child = node->children[i];
+    if (child->type == NODE_DIR) {
+      next_block = place_files(child, next_block);
+    }
+    else {
+      child->first_block = next_block;
+      child->num_blocks = (child->stored_size > 0) ? (int)((child->stored_size + MFS_BLOCK_DATA_SIZE - 1) / MFS_BLOCK_DATA_SIZE) : 1;
+      next_block += child->num_blocks;
+    }
+  }
+  return next_block;
+}
+
+/**
+ * link a run of blocks into a block list
+ */
+static void link_blocks(struct mfs_file_block *fs, int first, int num, int type) {
+  int i;
+  for (i = 0; i < num; i++) {
+    fs[first + i].block_type = type;
+    fs[first + i].index = first + i;
+    fs[first + i].prev_block = (i == 0) ? 0 : first + i - 1;
+    fs[first + i].next_block = (i == num - 1) ? 0 : first + i + 1;
+    fs[first + i].block_size = 0;
+  }
+}
+
+/**
+ * fill in the blocks of a node and of everything below it
+ */
+static void fill_blocks(struct mfs_file_block *fs, const struct node *node) {
+  int i;
+  if (node->type == NODE_FILE) {
+    long left = node->stored_size;
+    link_blocks(fs, node->first_block, node->num_blocks, MFS_BLOCK_TYPE_FILE);
+    for (i = 0; i < node->num_blocks; i++) {
+      int len = (left < MFS_BLOCK_DATA_SIZE) ? (int)left : MFS_BLOCK_DATA_SIZE;
+      memcpy(fs[node->first_block + i].u.block_data, node->stored + (long)i * MFS_BLOCK_DATA_SIZE, len);
+      fs[node->first_block + i].block_size = len;
+      left -= len;
+    }
+    /* the first block holds the size of the whole file */
+    fs[node->first_block].block_size = node->size;
+    return;
+  }
+  link_blocks(fs, node->first_block, node->num_blocks, MFS_BLOCK_TYPE_DIR);
+  for (i = 0; i < node->num_children + 2; i++) {
+    struct mfs_file_block *block = &fs[node->first_block + i / MFS_MAX_LOCAL_ENT];
+    struct mfs_dir_ent_block *ent = &block->u.dir_data.dir_ent[i % MFS_MAX_LOCAL_ENT];
+    if (i == 0) {
+      strcpy(ent->name, "..");
+      ent->index = node->parent ? node->parent->first_block : 0;
+    }
+    else if (i == 1) {
+      strcpy(ent->name, ".");
+      ent->index = node->first_block;
+    }
+    else {
+      strcpy(ent->name, node->children[i - 2]->name);
+      ent->index = node->children[i - 2]->first_block;
+    }
+    ent->deleted = (i >= 2 && node->children[i - 2]->compressed) ? 'z' : 'n';
+    block->u.dir_data.num_entries++;
+  }
+  /* the first block holds the number of entries of the whole directory */
+  fs[node->first_block].u.dir_data.num_entries = node->num_children + 2;
+  for (i = 0; i < node->num_children; i++)
+    fill_blocks(fs, node->children[i]);
+}
+
+static int count_entries(const struct node *node) {
+  int n = node->num_children + 2;
+  int i;
+  for (i = 0; i < node->num_children; i++) {
+    if (node->children[i]->type == NODE_DIR)
+      n += count_entries(node->children[i]);
+  }
+  return n;
+}
+
+/**
+ * write the layout of the image and check it by reading every file
+ * back through the library; the image is mounted as a ROM image
+ * @return the number of errors
+ */
+static int verify(const struct node *node, const char *path, FILE *layout) {
+  static char buf[4096];
+  char *child_path;
+  int errors = 0;
+  int i;
+  if (layout != NULL)
+    fprintf(layout, "%6d %6d %9ld %9ld %s %s\n", node->first_block, node->num_blocks, node->size,
+            node->stored_size, (node->type == NODE_DIR) ? "d" : (node->compressed ? "z" : "f"), path);
+  if (node->type == NODE_FILE) {
+    const char *data;
+    long pos = 0;
+    int fd = mfs_file_open(path, MFS_MODE_READ);
+    int len;
+    if (fd < 0 || mfs_exists_file((char *)path) != 1) {
+      fprintf(stderr, "mfsimage: verify: cannot open %s\n", path);
+      return 1;
+    }
+    if (mfs_file_lseek(fd, 0, MFS_SEEK_END) != node->size) {
+      fprintf(stderr, "mfsimage: verify: %s has the wrong size\n", path);
+      errors++;
+    }
+    while ((len = mfs_file_read(fd, buf, sizeof(buf))) > 0) {
+      if (pos + len > node->size || memcmp(buf, node->data + pos, len) != 0)
+        break;
+      pos += len;
+    }
+    if (pos != node->size) {
+      fprintf(stderr, "mfsimage: verify: %s reads back wrong\n", path);
+      errors++;
+    }
+    mfs_file_close(fd);
+    /* mapped in place, a block at a time */
+    fd = mfs_file_open(path, MFS_MODE_READ);
+    pos = 0;
+    while ((len = mfs_file_map(fd, &data)) > 0) {
+      if ((((unsigned long)data & 3) != 0 && !node->compressed) || pos + len > node->size || memcmp(data, node->data + pos, len) != 0)
+        break;
+      pos += len;
+    }
+    if (pos != node->size) {
+      fprintf(stderr, "mfsimage: verify: %s maps wrong\n", path);
+      errors++;
+    }
+    /* from the middle, and back to the start */
+    for (i = 0; i < 2 && node->size > 0; i++) {
+      pos = (i == 0) ? node->size / 2 : 0;
+      len = (node->size - pos < (long)sizeof(buf)) ? (int)(node->size - pos) : (int)sizeof(buf);
+      if (mfs_file_pread(fd, buf, len, pos) != len || memcmp(buf, node->data + pos, len) != 0) {
+        fprintf(stderr, "mfsimage: verify: %s seeks wrong\n", path);
+        errors++;
+      }
+    }
+    mfs_file_close(fd);
+    return errors;
+  }
+  if (node->parent != NULL && mfs_exists_file((char *)path) != 2) {
+    fprintf(stderr, "mfsimage: verify: cannot find directory %s\n", path);
+    errors++;
+  }
+  for (i = 0; i < node->num_children; i++) {
+    child_path = xmalloc(strlen(path) + MFS_MAX_FILENAME_LENGTH + 2);
+    sprintf(child_path, "%s%s%s", path, (node->parent != NULL) ? "/" : "", node->children[i]->name);
+    errors += verify(node->children[i], child_path, layout);
+    free(child_path);
+  }
+  return errors;
+}
+
+/**
+ * read all the files below a node through the library, once
+ * @param map is 1 to read them with mfs_file_map, 0 with mfs_file_read
+ * @return the number of bytes read
+ */
+static long read_all(const struct node *node, const char *path, int map) {
+  static char buf[MFS_BLOCK_DATA_SIZE];
+  const char *data;
+  char *child_path;
+  long total = 0;
+  int fd;
+  int len;
+  int i;
+  if (node->type == NODE_FILE) {
+    fd = mfs_file_open(path, MFS_MODE_READ);
+    if (map) {
+      while ((len = mfs_file_map(fd, &data)) > 0)
+        total += len;
+    }
+    else {
+      while ((len = mfs_file_read(fd, buf, sizeof(buf))) > 0)
+        total += len;
+    }
+    mfs_file_close(fd);
+    return total;
+  }
+  for (i = 0; i < node->num_children; i++) {
+    child_path = xmalloc(strlen(path) + MFS_MAX_FILENAME_LENGTH + 2);
+    sprintf(child_path, "%s%s%s", path, (node->parent != NULL) ? "/" : "", node->children[i]->name);
+    total += read_all(node->children[i], child_path, map);
+    free(child_path);
+  }
+  return total;
+}
+
+/**
+ * time reading the files of the image
+ * @param runs is the number of times each file is read
+ */
+static void benchmark(const struct node *root, int runs) {
+  clock_t start;
+  double seconds;
+  long total;
+  int map;
+  int i;
+  for (map = 0; map < 2; map++) {
+    total = 0;
+    start = clock();
+    for (i = 0; i < runs; i++)
+      total += read_all(root, "/", map);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("%s: %ld bytes in %.3f s, %.1f MB/s\n", map ? "mfs_file_map" : "mfs_file_read",
+           total, seconds, (seconds > 0) ? total / seconds / 1e6 : 0.0);
+  }
+}
+
+/**
+ * add up the sizes of the files below a node
+ * @param stored is 1 for the sizes in the image, 0 for the sizes of the files
+ */
+static long total_size(const struct node *node, int stored) {
+  long total = 0;
+  int i;
+  if (node->type == NODE_FILE)
+    return stored ? node->stored_size : node->size;
+  for (i = 0; i < node->num_children; i++)
+    total += total_size(node->children[i], stored);
+  return total;
+}
+
+static unsigned int swap32(unsigned int v) {
+  return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static unsigned short swap16(unsigned short v) {
+  return (unsigned short)((v >> 8) | (v << 8));
+}
+
+/**
+ * convert the image from host byte order to the other one
+ */
+static void swap_image(struct mfs_file_block *fs, int num_blocks) {
+  int i;
+  int j;
+  for (i = 0; i < num_blocks; i++) {
+    if (fs[i].block_type == MFS_BLOCK_TYPE_DIR) {
+      fs[i].u.dir_data.num_entries = swap16(fs[i].u.dir_data.num_entries);
+      fs[i].u.dir_data.num_deleted = swap16(fs[i].u.dir_data.num_deleted);
+      for (j = 0; j < MFS_MAX_LOCAL_ENT; j++)
+        fs[i].u.dir_data.dir_ent[j].index = swap32(fs[i].u.dir_data.dir_ent[j].index);
+    }
+    fs[i].block_size = swap32(fs[i].block_size);
+    fs[i].block_type = swap32(fs[i].block_type);
+    fs[i].next_block = swap32(fs[i].next_block);
+    fs[i].prev_block = swap32(fs[i].prev_block);
+    fs[i].index = swap32(fs[i].index);
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: mfsimage [-o image.mfs] [-n num_blocks] [-e big|little] [-z] [-i layout.txt] [-b runs] [-v] file_or_dir...\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  const char *output = "filesys.mfs";
+  const char *layout_name = NULL;
+  int big_endian = 1;
+  int num_blocks = 0;
+  int runs = 0;
+  int used_blocks;
+  int num_entries;
+  struct node root;
+  struct mfs_frag_report report;
+  char *image;
+  long image_size;
+  FILE *f;
+  FILE *layout = NULL;
+  int host_big_endian;
+  unsigned int one = 1;
+  int errors;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      num_blocks = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      layout_name = argv[++i];
+    else if (!strcmp(argv[i], "-e") && i + 1 < argc) {
+      i++;
+      if (!strcmp(argv[i], "big"))
+        big_endian = 1;
+      else if (!strcmp(argv[i], "little"))
+        big_endian = 0;
+      else
+        usage();
+    }
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      runs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-z"))
+      compress = 1;
+    else if (!strcmp(argv[i], "-v"))
+      verbose = 1;
+    else
+      usage();
+  }
+  if (i == argc)
+    usage();
+  if (compress && MFS_LZ_STREAMS == 0) {
+    fprintf(stderr, "mfsimage: -z needs a build with MFS_LZ_STREAMS\n");
+    return 1;
+  }
+
+  /* the arguments are the entries of the root directory */
+  memset(&root, 0, sizeof(root));
+  strcpy(root.name, "/");
+  root.type = NODE_DIR;
+  root.children = xmalloc((argc - i) * sizeof(struct node *));
+  for (; i < argc; i++) {
+    const char *name = strrchr(argv[i], '/');
+    struct node *child;
+    name = (name != NULL && name[1] != '\0') ? name + 1 : argv[i];
+    child = read_tree(argv[i], name, &root);
+    if (child == NULL)
+      return 1;
+    root.children[root.num_children++] = child;
+  }
+  qsort(root.children, root.num_children, sizeof(struct node *), compare_nodes);
+  for (i = 1; i < root.num_children; i++) {
+    if (!strcmp(root.children[i - 1]->name, root.children[i]->name)) {
+      fprintf(stderr, "mfsimage: %s given twice\n", root.children[i]->name);
+      return 1;
+    }
+  }
+
+  used_blocks = place_files(&root, place_dirs(&root, 0));
+  if (num_blocks == 0)
+    num_blocks = used_blocks;
+  if (num_blocks < used_blocks) {
+    fprintf(stderr, "mfsimage: %d blocks are needed\n", used_blocks);
+    return 1;
+  }
+  num_entries = count_entries(&root);
+  if (MFS_DIR_HASH_SIZE > 0 && num_entries > MFS_DIR_HASH_SIZE - MFS_DIR_HASH_SIZE / 4)
+    fprintf(stderr, "mfsimage: warning: %d directory entries, more than the hashed index of "
+            "MFS_DIR_HASH_SIZE %d holds; lookups will scan the directories\n", num_entries, MFS_DIR_HASH_SIZE);
+
+  /* the image: 4 bytes of file type, then the blocks */
+  image_size = 4 + (long)num_blocks * sizeof(struct mfs_file_block);
+  image = xmalloc(image_size + 4);
+  memset(image, 0, image_size + 4);
+  image += 4 - ((unsigned long)image & 3); /* so that the blocks are word aligned */
+  memcpy(image, big_endian ? "MFS2" : "mfs2", 4);
+  fill_blocks((struct mfs_file_block *)(image + 4), &root);
+  /* free blocks, in a free block list for MFSINIT_IMAGE */
+  link_blocks((struct mfs_file_block *)(image + 4), used_blocks, num_blocks - used_blocks, MFS_BLOCK_TYPE_EMPTY);
+
+  /* read everything back through the library */
+  if (layout_name != NULL && (layout = fopen(layout_name, "w")) == NULL) {
+    perror(layout_name);
+    return 1;
+  }
+  if (layout != NULL)
+    fprintf(layout, " block blocks      size    stored   path\n");
+  mfs_init_genimage(image_size, image, MFSINIT_ROM_IMAGE);
+  errors = verify(&root, "/", layout);
+  if (layout != NULL)
+    fclose(layout);
+  mfs_get_fragmentation(&report);
+  if (report.num_fragmented_files != 0)
+    errors++;
+  if (errors) {
+    fprintf(stderr, "mfsimage: the image does not read back right\n");
+    return 1;
+  }
+  if (runs > 0)
+    benchmark(&root, runs);
+
+  host_big_endian = (*(unsigned char *)&one == 0);
+  if (big_endian != host_big_endian)
+    swap_image((struct mfs_file_block *)(image + 4), num_blocks);
+  f = fopen(output, "wb");
+  if (f == NULL || fwrite(image, 1, image_size, f) != (size_t)image_size || fclose(f) != 0) {
+    perror(output);
+    return 1;
+  }
+  if (verbose) {
+    printf("%d files, %d directory entries, all files contiguous\n", report.num_files, num_entries);
+    printf("%ld bytes of files stored in %ld bytes (%.1f%%)\n", total_size(&root, 0), total_size(&root, 1),
+           total_size(&root, 0) ? 100.0 * total_size(&root, 1) / total_size(&root, 0) : 100.0);
+  }
+  printf("MFS block usage (used / free / total) = %d / %d / %d\n", used_blocks, num_blocks - used_blocks, num_blocks);
+  printf("Size of memory is %ld bytes\n", image_size);
+  printf("Block size is %d\n", (int)sizeof(struct mfs_file_block));
+  return 0;
+}
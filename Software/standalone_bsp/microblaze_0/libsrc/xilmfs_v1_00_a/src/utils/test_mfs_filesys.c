@@ -21,15 +21,867 @@
 // This program has been compiled and tested using gcc under Cygwin and Solariste
 //          gcc test_mfs_filesys.c  mfs_filesys.c mfs_filesys_util.c -o test_mfs_filesys
 //
+// test_mfs_filesys -b runs a read benchmark instead: a large file is read
+// with mfs_file_read and with the byte at a time loop it used before, for
+// several buffer sizes, and the throughput of both is printed in MB/s
+// test_mfs_filesys -s runs a random access benchmark: small reads at random
+// offsets of large files, positioned with mfs_file_lseek and with the block
+// list walk it used before, and with mfs_file_pread; build it with
+// -DMFS_BLOCK_INDEX_POOL_SIZE=1024 for the block index of the interleaved file
+// test_mfs_filesys -d runs a path lookup benchmark: mfs_exists_file on
+// every file of directories of several sizes, and the check then open of
+// the same few paths that an application does; build it with
+// -DMFS_DIR_HASH_SIZE=1024, and a second time with -DMFS_PATH_CACHE_SIZE=0
+// for the directory scan they replace
+// test_mfs_filesys -f writes two files at the same time, a chunk each in
+// turn, into a file system with holes left by deleted files, without and
+// with mfs_file_reserve, and prints the fragmentation report; build it
+// with -DMFS_FREE_BITMAP_BLOCKS=8192, and a second time without for the
+// free block list
+// test_mfs_filesys -m image writes a file system with scattered free blocks
+// to the file image, or when it exists mounts it with MFSINIT_IMAGE and
+// fills it up, checking that every free block is used and that no file is
+// overwritten; write it with the build with -DMFS_FREE_BITMAP_BLOCKS=8192
+// and mount it with one without, and the other way round
+// test_mfs_filesys -w runs a write benchmark: a large file is written with
+// mfs_file_write and with the byte at a time loop it used before, in
+// several buffer sizes and as a log of lines of varying length
+// test_mfs_filesys -c reads a file of a read-only file system three times
+// over through block caches of several sizes and read ahead depths, and
+// prints the cache counts and the throughput of each pass; on the host the
+// image is in RAM rather than flash, so the throughput shows the cost of
+// the cache and not its gain; build it with -DMFS_BLOCK_CACHE=1
+// test_mfs_filesys -t [image] reads every file of an image made by mfsimage
+// (-e little on a PC), or of a file system with scattered files made on the
+// spot, with mfs_file_read and with mfs_file_pread at random offsets, and
+// prints the statistics of the file system (mfs_print_stats) after each;
+// build it with the statistics on and timed in nanoseconds:
+//          gcc -O2 -DTESTING_XILMFS -DMFS_STATS=1 -DMFS_STATS_TIMER=test_cycles -I.. test_mfs_filesys.c ../mfs_filesys.c ../mfs_filesys_util.c -o test_mfs_filesys
+// Build it with optimization for meaningful numbers:
+//          gcc -O2 -DTESTING_XILMFS -I.. test_mfs_filesys.c ../mfs_filesys.c ../mfs_filesys_util.c -o test_mfs_filesys
+//
 // $Id: test_mfs_filesys.c,v 1.1.16.7 2010/10/01 18:53:25 jece Exp $
 //
 ////////////////////////////////////////////////////////////////////////////////
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "xilmfs.h"
 
 struct mfs_file_block efs[200];
 
+#define BENCH_FILE_BLOCKS 2048
+#define BENCH_BYTES (64L*1024*1024)
+
+static struct mfs_file_block *efs_big;
+
+/**
+ * mfs_file_read as it was, copying one byte per iteration
+ * kept here as the reference for the benchmark
+ */
+static int read_bytewise(int fd, char *buf, int buflen) {
+  int num_read = 0;
+  char *from_ptr = (char *) &(mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset]);
+  int num_left ;
+  num_left =  mfs_file_system[mfs_open_files[fd].current_block].block_size ;
+  if (num_left > MFS_BLOCK_DATA_SIZE)
+    num_left = MFS_BLOCK_DATA_SIZE;
+  num_left -=  mfs_open_files[fd].offset ;
+  while (buflen > 0) {
+    if (num_left == 0) {
+      int next_block = mfs_file_system[mfs_open_files[fd].current_block].next_block;
+      if (next_block == 0)
+        break;
+      if (mfs_file_system[next_block].block_size == 0)
+        break;
+      from_ptr = (char *) &(mfs_file_system[next_block].u.block_data[0]);
+      num_left = mfs_file_system[next_block].block_size;
+      mfs_open_files[fd].current_block = next_block;
+      mfs_open_files[fd].offset = 0;
+    }
+    *buf = *from_ptr;
+    buf++;
+    from_ptr++;
+    mfs_open_files[fd].offset += 1;
+    num_read++;
+    num_left--;
+    buflen--;
+  }
+  return num_read;
+}
+
+/**
+ * read the whole file repeatedly until BENCH_BYTES have been read
+ * @return throughput in MB/s, or -1 if the data read is wrong
+ */
+static double bench_read(int (*read_fn)(int, char *, int), const char *filename,
+                         const char *data, int size, char *buf, int buflen) {
+  long total = 0;
+  clock_t start;
+  double secs;
+  start = clock();
+  while (total < BENCH_BYTES) {
+    int fdr = mfs_file_open(filename, MFS_MODE_READ);
+    int pos = 0;
+    int tmp;
+    while ((tmp = read_fn(fdr, buf, buflen)) > 0) {
+      if (total == 0 && memcmp(buf, data + pos, tmp) != 0) { /* check the first pass */
+        mfs_file_close(fdr);
+        return -1;
+      }
+      pos += tmp;
+    }
+    mfs_file_close(fdr);
+    if (pos != size)
+      return -1;
+    total += size;
+  }
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  return total / (1024.0 * 1024.0) / secs;
+}
+
+/**
+ * mfs_file_write as it was, copying one byte per iteration and updating
+ * the block sizes for each; kept here as the reference for the benchmark
+ * the byte that needs a new block is written with mfs_file_write
+ */
+static int write_bytewise(int fd, const char *buf, int buflen) {
+  char *to_ptr = (char *) &(mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset]);
+  int num_left = MFS_BLOCK_DATA_SIZE - mfs_open_files[fd].offset;
+  while (buflen > 0) {
+    if (num_left == 0) {
+      if (!mfs_file_write(fd, buf, 1))
+        return 0;
+      buf++;
+      buflen--;
+      to_ptr = (char *) &(mfs_file_system[mfs_open_files[fd].current_block].u.block_data[mfs_open_files[fd].offset]);
+      num_left = MFS_BLOCK_DATA_SIZE - mfs_open_files[fd].offset;
+      continue;
+    }
+    *to_ptr = *buf;
+    buf++;
+    to_ptr++;
+    mfs_open_files[fd].offset += 1;
+    num_left--;
+    mfs_file_system[mfs_open_files[fd].current_block].block_size +=1;
+    if (mfs_open_files[fd].current_block != mfs_open_files[fd].first_block)
+      mfs_file_system[mfs_open_files[fd].first_block].block_size += 1;
+    buflen--;
+  }
+  return 1;
+}
+
+/**
+ * write a file of size bytes repeatedly until BENCH_BYTES have been written
+ * @param buflen is the size of each write, or 0 for log lines of 20 to 83
+ * bytes, all written from the start of the same buffer
+ * @return throughput in MB/s, or -1 if the data read back is wrong
+ */
+static double bench_write(int (*write_fn)(int, const char *, int), char *fs, const char *data,
+                          int size, char *buf, int buflen) {
+  long total = 0;
+  clock_t start;
+  double secs;
+  int fdw;
+  int pos;
+  int len;
+  secs = 0;
+  while (total < BENCH_BYTES) {
+    mfs_init_fs(BENCH_FILE_BLOCKS*sizeof(struct mfs_file_block), fs, MFSINIT_NEW);
+    start = clock();
+    fdw = mfs_file_open("bench", MFS_MODE_CREATE);
+    for (pos = 0; pos < size; pos += len) {
+      len = (buflen > 0) ? buflen : 20 + (pos * 7) % 64;
+      if (len > size - pos)
+        len = size - pos;
+      if (buflen == 0) /* a log line formatted into buf */
+        memcpy(buf, data + pos, len);
+      if (!write_fn(fdw, (buflen > 0) ? data + pos : buf, len))
+        return -1;
+    }
+    mfs_file_close(fdw);
+    secs += (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (total == 0) { /* check the first pass */
+      int fdr = mfs_file_open("bench", MFS_MODE_READ);
+      for (pos = 0; pos < size; pos += len) {
+        len = mfs_file_read(fdr, buf, 4096);
+        if (len <= 0 || memcmp(buf, data + pos, len) != 0)
+          return -1;
+      }
+      if (mfs_file_read(fdr, buf, 1) != 0 || mfs_file_lseek(fdr, 0, MFS_SEEK_END) != size)
+        return -1;
+      mfs_file_close(fdr);
+    }
+    total += size;
+  }
+  return total / secs / 1e6;
+}
+
+/**
+ * mfs_file_lseek(fd, offset, MFS_SEEK_SET) as it was, walking the block
+ * list from the first block; kept here as the reference for the benchmark
+ */
+static long lseek_walk(int fd, long offset) {
+  long local_offset;
+  int local_block;
+  if (offset >= mfs_file_system[mfs_open_files[fd].first_block].block_size)
+    return -1;
+  local_offset = offset;
+  local_block = mfs_open_files[fd].first_block;
+  while(local_offset >= MFS_BLOCK_DATA_SIZE) {
+    local_block = mfs_file_system[local_block].next_block;
+    local_offset -= MFS_BLOCK_DATA_SIZE;
+  }
+  mfs_open_files[fd].current_block = local_block;
+  mfs_open_files[fd].offset = local_offset;
+  return offset;
+}
+
+#define SEEK_RECORD 224 /* one beat of 28 doubles */
+#define SEEK_COUNT 20000
+#define SEEK_WALK 0
+#define SEEK_LSEEK 1
+#define SEEK_PREAD 2
+
+/**
+ * read SEEK_COUNT records at pseudo random offsets
+ * @return microseconds per record, or -1 if the data read is wrong
+ */
+static double bench_seek(int how, const char *filename, const char *data, int size) {
+  char buf[SEEK_RECORD];
+  unsigned long seed = 12345;
+  clock_t start;
+  int fdr;
+  int i;
+  fdr = mfs_file_open(filename, MFS_MODE_READ);
+  start = clock();
+  for (i = 0; i < SEEK_COUNT; i++) {
+    long offset;
+    int tmp;
+    seed = seed * 1103515245 + 12345;
+    offset = (long)((seed >> 8) % (unsigned long)(size - SEEK_RECORD));
+    if (how == SEEK_PREAD) {
+      tmp = mfs_file_pread(fdr, buf, SEEK_RECORD, offset);
+    }
+    else {
+      if (how == SEEK_WALK)
+        lseek_walk(fdr, offset);
+      else
+        mfs_file_lseek(fdr, offset, MFS_SEEK_SET);
+      tmp = mfs_file_read(fdr, buf, SEEK_RECORD);
+    }
+    if (tmp != SEEK_RECORD || memcmp(buf, data + offset, SEEK_RECORD) != 0) {
+      mfs_file_close(fdr);
+      return -1;
+    }
+  }
+  mfs_file_close(fdr);
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / SEEK_COUNT;
+}
+
+static int seek_benchmark(void) {
+  static const char *names[] = { "contiguous", "interleaved" };
+  struct mfs_file_block *fs;
+  char *data;
+  int size;
+  int fdw;
+  int fdw2;
+  int i;
+  fs = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  size = 600 * MFS_BLOCK_DATA_SIZE;
+  data = malloc(size);
+  if (fs == NULL || data == NULL)
+    return 1;
+  for (i = 0; i < size; i++)
+    data[i] = (char)(i * 7 + (i >> 9));
+  mfs_init_fs(BENCH_FILE_BLOCKS*sizeof(struct mfs_file_block), (char *)fs, MFSINIT_NEW);
+  /* one file with consecutive blocks and one sharing blocks with another */
+  fdw = mfs_file_open("contiguous", MFS_MODE_CREATE);
+  mfs_file_write(fdw, data, size);
+  mfs_file_close(fdw);
+  fdw = mfs_file_open("interleaved", MFS_MODE_CREATE);
+  fdw2 = mfs_file_open("other", MFS_MODE_CREATE);
+  for (i = 0; i < size; i += MFS_BLOCK_DATA_SIZE) {
+    mfs_file_write(fdw, data + i, MFS_BLOCK_DATA_SIZE);
+    mfs_file_write(fdw2, data + i, MFS_BLOCK_DATA_SIZE);
+  }
+  mfs_file_close(fdw);
+  mfs_file_close(fdw2);
+  printf("%d reads of %d bytes at random offsets of %d byte files\n", SEEK_COUNT, SEEK_RECORD, size);
+  printf("file           list walk us    mfs_file_lseek us    mfs_file_pread us\n");
+  for (i = 0; i < 2; i++) {
+    double walk = bench_seek(SEEK_WALK, names[i], data, size);
+    double lseek = bench_seek(SEEK_LSEEK, names[i], data, size);
+    double pread = bench_seek(SEEK_PREAD, names[i], data, size);
+    if (walk < 0 || lseek < 0 || pread < 0) {
+      printf("data read back is wrong\n");
+      return 1;
+    }
+    printf("%-11s    %12.3f    %17.3f    %17.3f\n", names[i], walk, lseek, pread);
+  }
+  free(data);
+  free(fs);
+  return 0;
+}
+
+#define LOOKUP_COUNT 200000
+
+/**
+ * look up every file of a directory of num_files files, then names that
+ * are not there, by full path
+ * @return microseconds per lookup, or -1 if a lookup is wrong
+ */
+static double bench_lookup(int num_files) {
+  char name[32];
+  clock_t start;
+  double secs;
+  int fdw;
+  int i;
+  mfs_change_dir("/");
+  mfs_create_dir("lookup");
+  for (i = 0; i < num_files; i++) {
+    sprintf(name, "lookup/beat%d", i);
+    fdw = mfs_file_open(name, MFS_MODE_CREATE);
+    if (fdw < 0)
+      return -1;
+    mfs_file_close(fdw);
+  }
+  start = clock();
+  for (i = 0; i < LOOKUP_COUNT; i++) {
+    if (i & 1)
+      sprintf(name, "/lookup/beat%d", (i >> 1) % num_files);
+    else
+      sprintf(name, "/lookup/none%d", (i >> 1) % num_files);
+    if (mfs_exists_file(name) != (i & 1))
+      return -1;
+  }
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  for (i = 0; i < num_files; i++) {
+    sprintf(name, "lookup/beat%d", i);
+    mfs_delete_file(name);
+  }
+  mfs_delete_file("lookup");
+  return secs * 1e6 / LOOKUP_COUNT;
+}
+
+/**
+ * check and then open the same path, cycling over four files of a
+ * directory of num_files files two levels down
+ * @return microseconds per check and open, or -1 if one fails
+ */
+static double bench_reopen(int num_files) {
+  char name[48];
+  clock_t start;
+  double secs;
+  int fdr;
+  int i;
+  mfs_change_dir("/");
+  mfs_create_dir("data");
+  mfs_create_dir("data/beats");
+  for (i = 0; i < num_files; i++) {
+    sprintf(name, "data/beats/beat%d", i);
+    fdr = mfs_file_open(name, MFS_MODE_CREATE);
+    if (fdr < 0)
+      return -1;
+    mfs_file_close(fdr);
+  }
+  start = clock();
+  for (i = 0; i < LOOKUP_COUNT; i++) {
+    sprintf(name, "/data/beats/beat%d", num_files - 1 - (i & 3));
+    if (mfs_exists_file(name) != 1)
+      return -1;
+    fdr = mfs_file_open(name, MFS_MODE_READ);
+    if (fdr < 0)
+      return -1;
+    mfs_file_close(fdr);
+  }
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+  for (i = 0; i < num_files; i++) {
+    sprintf(name, "data/beats/beat%d", i);
+    mfs_delete_file(name);
+  }
+  mfs_delete_file("data/beats");
+  mfs_delete_file("data");
+  return secs * 1e6 / LOOKUP_COUNT;
+}
+
+static int lookup_benchmark(void) {
+  static const int sizes[] = { 16, 64, 256, 500 };
+  struct mfs_file_block *fs;
+  unsigned long hits;
+  unsigned long misses;
+  int i;
+  fs = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  if (fs == NULL)
+    return 1;
+  mfs_init_fs(BENCH_FILE_BLOCKS*sizeof(struct mfs_file_block), (char *)fs, MFSINIT_NEW);
+  printf("%d lookups, half of them of missing files, MFS_DIR_HASH_SIZE %d\n", LOOKUP_COUNT, MFS_DIR_HASH_SIZE);
+  printf("MFS_PATH_CACHE_SIZE %d\n", MFS_PATH_CACHE_SIZE);
+  printf("files    mfs_exists_file us    exists + open same path us\n");
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+    double us = bench_lookup(sizes[i]);
+    double reopen_us = bench_reopen(sizes[i]);
+    if (us < 0 || reopen_us < 0) {
+      printf("lookup is wrong\n");
+      return 1;
+    }
+    printf("%5d    %18.3f    %26.3f\n", sizes[i], us, reopen_us);
+  }
+  if (mfs_get_path_cache_stats(&hits, &misses))
+    printf("path cache: %lu hits, %lu misses\n", hits, misses);
+  free(fs);
+  return 0;
+}
+
+/**
+ * write two files of num_chunks chunks, a chunk each in turn, into a
+ * file system where every other small file has been deleted, and print
+ * how fragmented it is; the holes are long enough for the allocator to
+ * start a file in them, but not to hold one, which only a reserve of
+ * the whole file avoids
+ */
+static int frag_write(const char *title, int reserve, const char *data, int num_chunks) {
+  struct mfs_frag_report report;
+  char name[16];
+  int fdw;
+  int fdw2;
+  int i;
+  mfs_init_fs(BENCH_FILE_BLOCKS*sizeof(struct mfs_file_block), (char *)efs_big, MFSINIT_NEW);
+  for (i = 0; i < 100; i++) {
+    sprintf(name, "small%d", i);
+    fdw = mfs_file_open(name, MFS_MODE_CREATE);
+    mfs_file_write(fdw, data, (8 + i % 5) * MFS_BLOCK_DATA_SIZE);
+    mfs_file_close(fdw);
+  }
+  for (i = 0; i < 100; i += 2) {
+    sprintf(name, "small%d", i);
+    mfs_delete_file(name);
+  }
+  fdw = mfs_file_open("first", MFS_MODE_CREATE);
+  fdw2 = mfs_file_open("second", MFS_MODE_CREATE);
+  if (reserve && (!mfs_file_reserve(fdw, num_chunks * 512) || !mfs_file_reserve(fdw2, num_chunks * 512)))
+    return 1;
+  for (i = 0; i < num_chunks; i++) {
+    if (!mfs_file_write(fdw, data + i * 512, 512) || !mfs_file_write(fdw2, data + i * 512, 512))
+      return 1;
+  }
+  mfs_file_close(fdw);
+  mfs_file_close(fdw2);
+  mfs_get_fragmentation(&report);
+  printf("%-16s %5d %10d %8d %10d %12d %8d\n", title, report.num_files, report.num_fragmented_files,
+         report.num_file_extents, report.num_free_blocks, report.num_free_runs, report.largest_free_run);
+  return 0;
+}
+
+static int frag_benchmark(void) {
+  char *data;
+  int num_chunks = 400;
+  int i;
+  efs_big = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  data = malloc(num_chunks * 512);
+  if (efs_big == NULL || data == NULL)
+    return 1;
+  for (i = 0; i < num_chunks * 512; i++)
+    data[i] = (char)(i * 7 + (i >> 9));
+  printf("MFS_FREE_BITMAP_BLOCKS %d\n", MFS_FREE_BITMAP_BLOCKS);
+  printf("                 files fragmented  extents free blocks  free runs  largest\n");
+  if (frag_write("write", 0, data, num_chunks) || frag_write("reserve, write", 1, data, num_chunks)) {
+    printf("file system full\n");
+    return 1;
+  }
+  free(data);
+  free(efs_big);
+  return 0;
+}
+
+#define CACHE_FILE_BLOCKS 1000
+
+static int cache_benchmark(void) {
+  static const int configs[][2] = { { 0, 0 }, { 64, 0 }, { 64, 4 }, { 64, 16 }, { 1100, 4 } };
+  struct mfs_block_cache_stats stats;
+  struct mfs_block_cache_stats last;
+  char *fs;
+  char *cache;
+  char *data;
+  char *buf;
+  int size;
+  int fd;
+  int pass;
+  int pos;
+  int len;
+  int total;
+  clock_t start;
+  double secs;
+  int i;
+  fs = malloc((CACHE_FILE_BLOCKS + 10) * sizeof(struct mfs_file_block));
+  cache = malloc(1100 * (sizeof(struct mfs_file_block) + 24));
+  size = CACHE_FILE_BLOCKS * MFS_BLOCK_DATA_SIZE - 300;
+  data = malloc(size);
+  buf = malloc(4096);
+  if (fs == NULL || cache == NULL || data == NULL || buf == NULL)
+    return 1;
+  for (i = 0; i < size; i++)
+    data[i] = (char)(i * 7 + (i >> 9));
+  mfs_init_fs((CACHE_FILE_BLOCKS + 10) * sizeof(struct mfs_file_block), fs, MFSINIT_NEW);
+  fd = mfs_file_open("beats", MFS_MODE_CREATE);
+  mfs_file_write(fd, data, size);
+  mfs_file_close(fd);
+  printf("reading a %d byte file (%d blocks) of a read-only file system\n", size, (size + MFS_BLOCK_DATA_SIZE - 1) / MFS_BLOCK_DATA_SIZE);
+  printf("cache  ahead  pass      hits    misses  prefetched  prefetch hits      MB/s\n");
+  for (i = 0; i < (int)(sizeof(configs) / sizeof(configs[0])); i++) {
+    mfs_set_block_cache(cache, configs[i][0] * (sizeof(struct mfs_file_block) + 24), configs[i][1]);
+    mfs_init_fs((CACHE_FILE_BLOCKS + 10) * sizeof(struct mfs_file_block), fs, MFSINIT_ROM_IMAGE);
+    memset(&last, 0, sizeof(last));
+    for (pass = 1; pass <= 3; pass++) {
+      total = 0;
+      start = clock();
+      while (total < 32 * 1024 * 1024) {
+        fd = mfs_file_open("beats", MFS_MODE_READ);
+        pos = 0;
+        while ((len = mfs_file_read(fd, buf, 4096)) > 0) {
+          if (total == 0 && memcmp(buf, data + pos, len) != 0) {
+            printf("data read back is wrong\n");
+            return 1;
+          }
+          pos += len;
+        }
+        mfs_file_close(fd);
+        total += pos;
+        if (total == pos) /* counts for the first read of the pass */
+          mfs_get_block_cache_stats(&stats);
+      }
+      secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+      printf("%5d  %5d  %4d  %8lu  %8lu  %10lu  %13lu  %8.1f\n", configs[i][0], configs[i][1], pass,
+             stats.num_hits - last.num_hits, stats.num_misses - last.num_misses,
+             stats.num_prefetched - last.num_prefetched, stats.num_prefetch_hits - last.num_prefetch_hits,
+             total / (1024.0 * 1024.0) / secs);
+      mfs_get_block_cache_stats(&last);
+    }
+  }
+  mfs_set_block_cache(NULL, 0, 0);
+  free(buf);
+  free(data);
+  free(cache);
+  free(fs);
+  return 0;
+}
+
+/**
+ * the timer of the statistics, see MFS_STATS_TIMER
+ * @return nanoseconds
+ */
+unsigned long test_cycles(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+#define STATS_PREAD 32 /* reads at random offsets of each file */
+
+/**
+ * read every file of the current directory and the directories in it,
+ * whole and at random offsets
+ * @param pread is 0 to read the files whole, 1 for the random reads
+ * @return the number of files
+ */
+static int stats_read_dir(int pread) {
+  char buf[SEEK_RECORD];
+  char *name;
+  unsigned long seed = 12345;
+  int size;
+  int type;
+  int num_files = 0;
+  int fdd;
+  int fdr;
+  int i;
+  fdd = mfs_dir_open(".");
+  while (mfs_dir_read(fdd, &name, &size, &type)) {
+    if (type == MFS_BLOCK_TYPE_DIR) {
+      if (strcmp(name, ".") != 0 && strcmp(name, "..") != 0 && mfs_change_dir(name)) {
+        num_files += stats_read_dir(pread);
+        mfs_change_dir("..");
+      }
+      continue;
+    }
+    if (mfs_exists_file(name) != 1 || (fdr = mfs_file_open(name, MFS_MODE_READ)) < 0)
+      continue;
+    num_files++;
+    if (!pread) {
+      while (mfs_file_read(fdr, buf, sizeof(buf)) > 0)
+        ;
+    }
+    else if (size > 0) {
+      for (i = 0; i < STATS_PREAD; i++) {
+        seed = seed * 1103515245 + 12345;
+        mfs_file_pread(fdr, buf, sizeof(buf), (long)((seed >> 8) % (unsigned long)size));
+      }
+    }
+    mfs_file_close(fdr);
+  }
+  mfs_dir_close(fdd);
+  return num_files;
+}
+
+static int stats_report(const char *image_name) {
+  char *image;
+  char name[16];
+  char data[MFS_BLOCK_DATA_SIZE];
+  long size = 0;
+  int fdw;
+  int fdw2;
+  int num_files;
+  int i;
+  if (image_name != NULL) {
+    FILE *f = fopen(image_name, "rb");
+    if (f == NULL) {
+      perror(image_name);
+      return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image = malloc(size);
+    if (image == NULL || fread(image, 1, size, f) != (size_t)size) {
+      fclose(f);
+      return 1;
+    }
+    fclose(f);
+    if (size < 4 || memcmp(image, "mfs2", 4) != 0) {
+      printf("%s is not an image for this host, see mfsimage -e\n", image_name);
+      return 1;
+    }
+    mfs_init_genimage(size, image, MFSINIT_ROM_IMAGE);
+    printf("%s, %d blocks\n", image_name, mfs_max_file_blocks);
+  }
+  else {
+    /* small files in a large directory, and two files written a block
+     * each in turn into the holes left by deleting half of them */
+    image = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+    if (image == NULL)
+      return 1;
+    memset(data, 'x', sizeof(data));
+    mfs_init_fs(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block), image, MFSINIT_NEW);
+    for (i = 0; i < 400; i++) {
+      sprintf(name, "small%d", i);
+      fdw = mfs_file_open(name, MFS_MODE_CREATE);
+      mfs_file_write(fdw, data, (1 + i % 3) * 100);
+      mfs_file_close(fdw);
+    }
+    for (i = 0; i < 400; i += 2) {
+      sprintf(name, "small%d", i);
+      mfs_delete_file(name);
+    }
+    fdw = mfs_file_open("first", MFS_MODE_CREATE);
+    fdw2 = mfs_file_open("second", MFS_MODE_CREATE);
+    for (i = 0; i < 400; i++) {
+      mfs_file_write(fdw, data, sizeof(data));
+      mfs_file_write(fdw2, data, sizeof(data));
+    }
+    mfs_file_close(fdw);
+    mfs_file_close(fdw2);
+    printf("writing 400 files, deleting 200, writing 2 files a block each in turn\n");
+    if (!mfs_print_stats()) {
+      printf("built with MFS_STATS 0, see the build command\n");
+      return 1;
+    }
+  }
+  mfs_clear_stats();
+  num_files = stats_read_dir(0);
+  printf("\nreading %d files\n", num_files);
+  if (!mfs_print_stats()) {
+    printf("built with MFS_STATS 0, see the build command\n");
+    return 1;
+  }
+  mfs_clear_stats();
+  stats_read_dir(1);
+  printf("\nreading %d records at random offsets of each\n", STATS_PREAD);
+  mfs_print_stats();
+  free(image);
+  return 0;
+}
+
+#define IMAGE_FILE_BLOCKS 512
+#define IMAGE_FILES 40
+
+/**
+ * file i of the image test holds 1 + i % 7 blocks of this
+ */
+static void image_file_data(int i, char *data, int size) {
+  int j;
+  for (j = 0; j < size; j++)
+    data[j] = (char)(i * 31 + j);
+}
+
+/**
+ * an image written by one build of the library, with its free blocks
+ * scattered, is mounted with MFSINIT_IMAGE by another, which fills it up:
+ * the files must be left as they were, and every free block used
+ * @param image_name is the image file; when it does not exist it is written
+ */
+static int image_test(const char *image_name) {
+  char *image;
+  char name[16];
+  char data[7 * MFS_BLOCK_DATA_SIZE];
+  char buf[7 * MFS_BLOCK_DATA_SIZE];
+  long size;
+  int num_free = 0;
+  int num_filled = 0;
+  int failed = 0;
+  int fdw;
+  int fdr;
+  int i;
+  FILE *f = fopen(image_name, "rb");
+  image = malloc(IMAGE_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  if (image == NULL)
+    return 1;
+  if (f == NULL) {
+    /* files written, every other one deleted, written again in the
+     * holes, and a few of those deleted again */
+    mfs_init_fs(IMAGE_FILE_BLOCKS * sizeof(struct mfs_file_block), image, MFSINIT_NEW);
+    for (i = 0; i < IMAGE_FILES; i++) {
+      sprintf(name, "file%d", i);
+      image_file_data(i, data, (1 + i % 7) * MFS_BLOCK_DATA_SIZE);
+      fdw = mfs_file_open(name, MFS_MODE_CREATE);
+      mfs_file_write(fdw, data, (1 + i % 7) * MFS_BLOCK_DATA_SIZE);
+      mfs_file_close(fdw);
+      if (i % 2 == 1 && i < IMAGE_FILES / 2) {
+        sprintf(name, "file%d", i - 1);
+        mfs_delete_file(name);
+      }
+    }
+    for (i = IMAGE_FILES / 2; i < IMAGE_FILES; i += 3) {
+      sprintf(name, "file%d", i);
+      mfs_delete_file(name);
+    }
+    f = fopen(image_name, "wb");
+    if (f == NULL || fwrite(image, sizeof(struct mfs_file_block), IMAGE_FILE_BLOCKS, f) != IMAGE_FILE_BLOCKS) {
+      perror(image_name);
+      return 1;
+    }
+    fclose(f);
+    printf("wrote %s with MFS_FREE_BITMAP_BLOCKS %d, run -m %s again with the other build\n",
+           image_name, MFS_FREE_BITMAP_BLOCKS, image_name);
+    free(image);
+    return 0;
+  }
+  size = (long)fread(image, 1, IMAGE_FILE_BLOCKS * sizeof(struct mfs_file_block), f);
+  fclose(f);
+  if (size != IMAGE_FILE_BLOCKS * (long)sizeof(struct mfs_file_block)) {
+    printf("%s is not an image of this test\n", image_name);
+    return 1;
+  }
+  mfs_init_fs(size, image, MFSINIT_IMAGE);
+  printf("mounting %s with MFS_FREE_BITMAP_BLOCKS %d\n", image_name, MFS_FREE_BITMAP_BLOCKS);
+  for (i = 1; i < IMAGE_FILE_BLOCKS; i++) {
+    if (((struct mfs_file_block *)image)[i].block_type == MFS_BLOCK_TYPE_EMPTY)
+      num_free++;
+  }
+  /* the new file takes a block when it is created, and one per write */
+  image_file_data(IMAGE_FILES, data, MFS_BLOCK_DATA_SIZE);
+  fdw = mfs_file_open("fill", MFS_MODE_CREATE);
+  if (fdw >= 0)
+    num_filled++;
+  while (fdw >= 0 && num_filled < num_free && mfs_file_write(fdw, data, MFS_BLOCK_DATA_SIZE))
+    num_filled++;
+  mfs_file_close(fdw);
+  if (num_filled != num_free) {
+    printf("%d of the %d free blocks could be allocated\n", num_filled, num_free);
+    failed = 1;
+  }
+  for (i = 0; i < IMAGE_FILES; i++) {
+    sprintf(name, "file%d", i);
+    if (mfs_exists_file(name) != 1)
+      continue;
+    image_file_data(i, data, (1 + i % 7) * MFS_BLOCK_DATA_SIZE);
+    fdr = mfs_file_open(name, MFS_MODE_READ);
+    if (mfs_file_read(fdr, buf, sizeof(buf)) != (1 + i % 7) * MFS_BLOCK_DATA_SIZE ||
+        memcmp(buf, data, (1 + i % 7) * MFS_BLOCK_DATA_SIZE) != 0) {
+      printf("%s was overwritten\n", name);
+      failed = 1;
+    }
+    mfs_file_close(fdr);
+  }
+  free(image);
+  if (failed)
+    return 1;
+  printf("all tests passed\n");
+  return 0;
+}
+
+static int read_benchmark(void) {
+  static const int buflens[] = { 1, 23, 512, 4096, 65536 };
+  struct mfs_file_block *fs;
+  char *data;
+  char *buf;
+  int size;
+  int fdw;
+  int i;
+  fs = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  size = (BENCH_FILE_BLOCKS - 8) * MFS_BLOCK_DATA_SIZE + 100;
+  data = malloc(size);
+  buf = malloc(65536);
+  if (fs == NULL || data == NULL || buf == NULL)
+    return 1;
+  for (i = 0; i < size; i++)
+    data[i] = (char)(i * 7 + (i >> 9));
+  mfs_init_fs(BENCH_FILE_BLOCKS*sizeof(struct mfs_file_block), (char *)fs, MFSINIT_NEW);
+  fdw = mfs_file_open("bench", MFS_MODE_CREATE);
+  for (i = 0; i < size; i += 4096)
+    mfs_file_write(fdw, data + i, (size - i < 4096) ? size - i : 4096);
+  mfs_file_close(fdw);
+  printf("reading a %d byte file (%d blocks)\n", size, (size + MFS_BLOCK_DATA_SIZE - 1) / MFS_BLOCK_DATA_SIZE);
+  printf("buflen    byte loop MB/s    mfs_file_read MB/s\n");
+  for (i = 0; i < (int)(sizeof(buflens) / sizeof(buflens[0])); i++) {
+    double before = bench_read(read_bytewise, "bench", data, size, buf, buflens[i]);
+    double after = bench_read(mfs_file_read, "bench", data, size, buf, buflens[i]);
+    if (before < 0 || after < 0) {
+      printf("data read back is wrong\n");
+      return 1;
+    }
+    printf("%6d    %14.1f    %18.1f\n", buflens[i], before, after);
+  }
+  free(buf);
+  free(data);
+  free(fs);
+  return 0;
+}
+
+static int write_benchmark(void) {
+  static const int buflens[] = { 1, 23, 512, 4096, 0 };
+  char *fs;
+  char *data;
+  char *buf;
+  int size;
+  int i;
+  fs = malloc(BENCH_FILE_BLOCKS * sizeof(struct mfs_file_block));
+  size = (BENCH_FILE_BLOCKS - 8) * MFS_BLOCK_DATA_SIZE + 100;
+  data = malloc(size);
+  buf = malloc(4096);
+  if (fs == NULL || data == NULL || buf == NULL)
+    return 1;
+  for (i = 0; i < size; i++)
+    data[i] = (char)(i * 7 + (i >> 9));
+  printf("writing a %d byte file (%d blocks)\n", size, (size + MFS_BLOCK_DATA_SIZE - 1) / MFS_BLOCK_DATA_SIZE);
+  printf("buflen    byte loop MB/s    mfs_file_write MB/s\n");
+  for (i = 0; i < (int)(sizeof(buflens) / sizeof(buflens[0])); i++) {
+    double before = bench_write(write_bytewise, fs, data, size, buf, buflens[i]);
+    double after = bench_write(mfs_file_write, fs, data, size, buf, buflens[i]);
+    if (before < 0 || after < 0) {
+      printf("data read back is wrong\n");
+      return 1;
+    }
+    if (buflens[i] > 0)
+      printf("%6d    %14.1f    %19.1f\n", buflens[i], before, after);
+    else
+      printf("   log    %14.1f    %19.1f\n", before, after);
+  }
+  free(buf);
+  free(data);
+  free(fs);
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   char buf[512];
   char buf2[512];
@@ -37,6 +889,22 @@ int main(int argc, char *argv[]) {
   int fdw;
   int tmp;
   int num_iter;
+  if (argc > 1 && !strcmp(argv[1], "-b"))
+    return read_benchmark();
+  if (argc > 1 && !strcmp(argv[1], "-s"))
+    return seek_benchmark();
+  if (argc > 1 && !strcmp(argv[1], "-d"))
+    return lookup_benchmark();
+  if (argc > 1 && !strcmp(argv[1], "-f"))
+    return frag_benchmark();
+  if (argc > 1 && !strcmp(argv[1], "-w"))
+    return write_benchmark();
+  if (argc > 1 && !strcmp(argv[1], "-c"))
+    return cache_benchmark();
+  if (argc > 2 && !strcmp(argv[1], "-m"))
+    return image_test(argv[2]);
+  if (argc > 1 && !strcmp(argv[1], "-t"))
+    return stats_report(argc > 2 ? argv[2] : NULL);
   mfs_init_fs(20*sizeof(struct mfs_file_block), (char *)efs, MFSINIT_NEW);
   fdr = mfs_file_open(".", MFS_MODE_READ);
   tmp = mfs_file_read(fdr, &(buf[0]), 512);